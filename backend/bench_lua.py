@@ -0,0 +1,344 @@
+#!/usr/bin/env python3
+
+# This is free and unencumbered software released into the public domain.
+# For more details, see the LICENSE file in the project root.
+"""
+LuaEnv Interpreter Benchmarks (luaenv bench)
+
+Runs the fixed suite in bench_suite.lua against one or more installations and
+reports wall time (median, mean, standard deviation and coefficient of
+variation) and peak working set per benchmark. Every sample is a fresh
+lua.exe process, so the times include interpreter start-up (a few ms).
+
+With several installations the runs are interleaved (benchmark by benchmark,
+installation by installation) so that machine load drifts hit all of them
+alike, and a comparison against the first installation is printed.
+
+Results are stored per installation in the registry ("benchmark") unless
+--no-save is given; `luaenv list --detailed` shows them.
+
+Usage:
+    python bench_lua.py [<alias|uuid> ...] [options]
+
+Options:
+    --runs N            Timed runs per benchmark (default: 5, after one warm-up)
+    --only a,b          Run only these benchmarks
+    --scale N           Workload multiplier (default: 1)
+    --no-save           Do not store the results in the registry
+    --json              Print the results as JSON
+
+Examples:
+    python bench_lua.py                      # Benchmark the default installation
+    python bench_lua.py dev                  # Benchmark 'dev'
+    python bench_lua.py dev fast             # Compare 'fast' against 'dev'
+    python bench_lua.py dev --only calls,json --runs 10
+"""
+
+import argparse
+import json
+import math
+import os
+import statistics
+import subprocess
+import sys
+import time
+from datetime import datetime, timezone
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+# Ensure we can import from the current directory
+current_dir = os.path.dirname(os.path.abspath(__file__))
+if current_dir not in sys.path:
+    sys.path.insert(0, current_dir)
+
+try:
+    from registry import LuaEnvRegistry
+    from utils import print_error
+except ImportError as e:
+    print(f"[ERROR] Failed to import required modules: {e}")
+    sys.exit(1)
+
+
+# Bump when a workload in bench_suite.lua changes, so old results are not compared
+SUITE_VERSION = 1
+SUITE_FILE = Path(current_dir) / "bench_suite.lua"
+DEFAULT_RUNS = 5
+
+# Benchmarks in report order
+BENCHMARKS = {
+    "calls": "Function and method calls",
+    "table_insert": "Array appends, table.insert/remove",
+    "table_lookup": "Hash lookups (string and integer keys)",
+    "string_build": "String building and formatting",
+    "closures": "Closure creation and upvalues",
+    "gc_churn": "Allocation churn for the GC",
+    "coroutine_switch": "Coroutine resume/yield",
+    "json": "Pure-Lua JSON encode/decode",
+}
+
+# A difference is only reported when it exceeds this share and the run-to-run noise
+SIGNIFICANT_CHANGE = 0.03
+
+
+class BenchmarkError(Exception):
+    """Raised when an installation cannot be benchmarked."""
+
+
+def find_lua_executable(installation: Dict) -> Path:
+    """Path of the interpreter of an installation."""
+    bin_dir = Path(installation["installation_path"]) / "bin"
+    for name in ("lua.exe", "lua"):
+        if (bin_dir / name).exists():
+            return bin_dir / name
+    raise BenchmarkError(f"lua.exe not found in {bin_dir}")
+
+
+def _peak_working_set_windows(process: subprocess.Popen) -> int:
+    """Peak working set in bytes of a finished process (its handle is still open)."""
+    import ctypes
+    from ctypes import wintypes
+
+    class PROCESS_MEMORY_COUNTERS(ctypes.Structure):
+        _fields_ = [
+            ("cb", wintypes.DWORD),
+            ("PageFaultCount", wintypes.DWORD),
+            ("PeakWorkingSetSize", ctypes.c_size_t),
+            ("WorkingSetSize", ctypes.c_size_t),
+            ("QuotaPeakPagedPoolUsage", ctypes.c_size_t),
+            ("QuotaPagedPoolUsage", ctypes.c_size_t),
+            ("QuotaPeakNonPagedPoolUsage", ctypes.c_size_t),
+            ("QuotaNonPagedPoolUsage", ctypes.c_size_t),
+            ("PagefileUsage", ctypes.c_size_t),
+            ("PeakPagefileUsage", ctypes.c_size_t),
+        ]
+
+    counters = PROCESS_MEMORY_COUNTERS()
+    counters.cb = ctypes.sizeof(counters)
+    if not ctypes.windll.psapi.GetProcessMemoryInfo(int(process._handle), ctypes.byref(counters), counters.cb):
+        return 0
+    return counters.PeakWorkingSetSize
+
+
+def run_once(lua_exe: Path, benchmark: str, scale: int = 1) -> Tuple[float, int]:
+    """Run one benchmark in a fresh interpreter.
+
+    Returns:
+        Tuple of (wall time in ms, peak working set in KB)
+    """
+    command = [str(lua_exe), str(SUITE_FILE), benchmark, str(scale)]
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+
+    if os.name == "nt":
+        _, errors = process.communicate()
+        wall_ms = (time.perf_counter() - start) * 1000
+        peak_kb = _peak_working_set_windows(process) // 1024
+    else:
+        # wait4 reports the peak RSS of this child alone (in KB on Linux)
+        _, status, usage = os.wait4(process.pid, 0)
+        wall_ms = (time.perf_counter() - start) * 1000
+        process.returncode = os.waitstatus_to_exitcode(status)
+        errors = process.stderr.read()
+        process.stderr.close()
+        peak_kb = usage.ru_maxrss
+
+    if process.returncode != 0:
+        message = errors.decode("utf-8", "replace").strip()
+        raise BenchmarkError(f"{benchmark} failed with exit code {process.returncode}: {message}")
+
+    return wall_ms, peak_kb
+
+
+def summarize(samples: List[Tuple[float, int]]) -> Dict:
+    """Statistics over the (wall ms, peak KB) samples of one benchmark."""
+    times = [wall for wall, _ in samples]
+    mean = statistics.fmean(times)
+    stdev = statistics.stdev(times) if len(times) > 1 else 0.0
+    return {
+        "median_ms": round(statistics.median(times), 3),
+        "mean_ms": round(mean, 3),
+        "stdev_ms": round(stdev, 3),
+        "cv_percent": round(100 * stdev / mean, 2) if mean else 0.0,
+        "min_ms": round(min(times), 3),
+        "peak_working_set_kb": max(peak for _, peak in samples),
+    }
+
+
+def run_suite(targets: List[Tuple[Dict, Path]], benchmarks: List[str], runs: int = DEFAULT_RUNS,
+              scale: int = 1, progress=None) -> List[Dict]:
+    """Run the benchmarks against every (installation, lua_exe) target.
+
+    Returns one summary per target, in the order given, ready to be stored in the
+    registry: suite_version, updated, runs, scale, total_ms and results.
+    """
+    samples = [{name: [] for name in benchmarks} for _ in targets]
+
+    for name in benchmarks:
+        # The first round warms the file cache and is not recorded
+        for round_index in range(runs + 1):
+            for target_index, (installation, lua_exe) in enumerate(targets):
+                sample = run_once(lua_exe, name, scale)
+                if round_index > 0:
+                    samples[target_index][name].append(sample)
+                if progress:
+                    progress(installation, name, round_index, runs)
+
+    summaries = []
+    updated = datetime.now(timezone.utc).isoformat()
+    for target_samples in samples:
+        results = {name: summarize(values) for name, values in target_samples.items()}
+        summaries.append({
+            "suite_version": SUITE_VERSION,
+            "updated": updated,
+            "runs": runs,
+            "scale": scale,
+            "total_ms": round(sum(r["median_ms"] for r in results.values()), 3),
+            "results": results,
+        })
+    return summaries
+
+
+def merge_summary(previous: Optional[Dict], summary: Dict) -> Dict:
+    """Merge a partial run (--only) into the stored results of the same suite."""
+    if (not previous or previous.get("suite_version") != summary["suite_version"]
+            or previous.get("scale", 1) != summary["scale"]):
+        return summary
+    results = dict(previous.get("results", {}))
+    results.update(summary["results"])
+    return dict(summary, results=results,
+                total_ms=round(sum(r["median_ms"] for r in results.values()), 3))
+
+
+def describe(installation: Dict) -> str:
+    """Short label of an installation for reports."""
+    return installation.get("alias") or installation["id"][:8]
+
+
+def print_results(installation: Dict, summary: Dict) -> None:
+    """Print the results of one installation."""
+    print(f"\n{installation['name']} ({describe(installation)}), "
+          f"{installation['build_type']} {installation['build_config']}, "
+          f"{summary['runs']} runs:")
+    print(f"  {'Benchmark':<18} {'Median':>10} {'Mean':>10} {'Stdev':>9} {'CV':>7} {'Peak WS':>10}")
+    for name, result in summary["results"].items():
+        print(f"  {name:<18} {result['median_ms']:>8.1f}ms {result['mean_ms']:>8.1f}ms "
+              f"{result['stdev_ms']:>7.1f}ms {result['cv_percent']:>6.1f}% "
+              f"{result['peak_working_set_kb'] / 1024:>8.1f}MB")
+    print(f"  {'total (medians)':<18} {summary['total_ms']:>8.1f}ms")
+
+
+def compare(baseline: Dict, other: Dict) -> List[Tuple[str, float, float, float, str]]:
+    """Rows of (benchmark, baseline ms, other ms, ratio, verdict) for two summaries.
+
+    A benchmark counts as faster or slower only when the medians differ by more than
+    SIGNIFICANT_CHANGE and by more than the combined standard deviations.
+    """
+    rows = []
+    for name, base in baseline["results"].items():
+        if name not in other["results"]:
+            continue
+        new = other["results"][name]
+        ratio = new["median_ms"] / base["median_ms"] if base["median_ms"] else math.inf
+        difference = new["median_ms"] - base["median_ms"]
+        noise = base["stdev_ms"] + new["stdev_ms"]
+        verdict = "~"
+        if abs(ratio - 1) > SIGNIFICANT_CHANGE and abs(difference) > noise:
+            verdict = "faster" if difference < 0 else "slower"
+        rows.append((name, base["median_ms"], new["median_ms"], ratio, verdict))
+    return rows
+
+
+def print_comparison(baseline_installation: Dict, baseline: Dict,
+                     other_installation: Dict, other: Dict) -> None:
+    """Print how another installation compares with the baseline."""
+    base_label, other_label = describe(baseline_installation), describe(other_installation)
+    print(f"\n{other_label} vs {base_label}:")
+    print(f"  {'Benchmark':<18} {base_label:>12} {other_label:>12} {'Ratio':>7}")
+    for name, base_ms, other_ms, ratio, verdict in compare(baseline, other):
+        print(f"  {name:<18} {base_ms:>10.1f}ms {other_ms:>10.1f}ms {ratio:>6.2f}x  {verdict}")
+    print(f"  {'total (medians)':<18} {baseline['total_ms']:>10.1f}ms {other['total_ms']:>10.1f}ms "
+          f"{other['total_ms'] / baseline['total_ms']:>6.2f}x")
+
+
+def main(argv: Optional[List[str]] = None) -> int:
+    """Command line interface."""
+    parser = argparse.ArgumentParser(
+        description="Benchmark the Lua interpreter of LuaEnv installations",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog="Benchmarks:\n" + "\n".join(f"  {name:<18} {text}" for name, text in BENCHMARKS.items())
+    )
+    parser.add_argument("installations", nargs="*", metavar="ALIAS_OR_UUID",
+                        help="Installations to benchmark (default: the default installation)")
+    parser.add_argument("--runs", type=int, default=DEFAULT_RUNS,
+                        help=f"Timed runs per benchmark (default: {DEFAULT_RUNS})")
+    parser.add_argument("--only", help="Comma-separated benchmarks to run")
+    parser.add_argument("--scale", type=int, default=1, help="Workload multiplier (default: 1)")
+    parser.add_argument("--no-save", action="store_true", help="Do not store the results in the registry")
+    parser.add_argument("--json", action="store_true", help="Print the results as JSON")
+    args = parser.parse_args(argv)
+
+    if args.runs < 1 or args.scale < 1:
+        print_error("--runs and --scale must be at least 1")
+        return 1
+
+    benchmarks = list(BENCHMARKS)
+    if args.only:
+        benchmarks = [name.strip() for name in args.only.split(",") if name.strip()]
+        unknown = [name for name in benchmarks if name not in BENCHMARKS]
+        if unknown:
+            print_error(f"Unknown benchmark(s): {', '.join(unknown)}. Available: {', '.join(BENCHMARKS)}")
+            return 1
+
+    registry = LuaEnvRegistry()
+    if args.installations:
+        installations = []
+        for id_or_alias in args.installations:
+            installation = registry.get_installation(id_or_alias)
+            if not installation:
+                print_error(f"Installation '{id_or_alias}' not found")
+                return 1
+            installations.append(installation)
+    else:
+        default = registry.get_default()
+        if not default:
+            print_error("No default installation set. Name the installations to benchmark.")
+            return 1
+        installations = [default]
+
+    try:
+        targets = [(installation, find_lua_executable(installation)) for installation in installations]
+
+        def progress(installation, name, round_index, runs):
+            if not args.json:
+                label = "warm-up" if round_index == 0 else f"run {round_index}/{runs}"
+                print(f"\r[PROGRESS] {name:<18} {describe(installation):<12} {label:<10}", end="", flush=True)
+
+        summaries = run_suite(targets, benchmarks, args.runs, args.scale, progress)
+        if not args.json:
+            print("\r" + " " * 60 + "\r", end="")
+    except BenchmarkError as e:
+        print()
+        print_error(str(e))
+        return 1
+
+    if not args.no_save:
+        for installation, summary in zip(installations, summaries):
+            stored = merge_summary(installation.get("benchmark"), summary)
+            registry.record_benchmark(installation["id"], stored)
+
+    if args.json:
+        print(json.dumps([dict(summary, id=installation["id"], alias=installation.get("alias"))
+                          for installation, summary in zip(installations, summaries)], indent=2))
+        return 0
+
+    for installation, summary in zip(installations, summaries):
+        print_results(installation, summary)
+    for installation, summary in zip(installations[1:], summaries[1:]):
+        print_comparison(installations[0], summaries[0], installation, summary)
+    if not args.no_save:
+        print("\n[OK] Results saved to the registry (see luaenv list --detailed)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
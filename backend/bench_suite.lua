@@ -0,0 +1,236 @@
+-- This is free and unencumbered software released into the public domain.
+-- For more details, see the LICENSE file in the project root.
+
+-- Interpreter benchmarks for `luaenv bench` (see bench_lua.py)
+--
+-- Usage: lua bench_suite.lua <benchmark> [scale]
+--
+-- Each benchmark is a fixed, deterministic workload that takes a few hundred
+-- milliseconds on a release build at scale 1. The runner times the whole process and
+-- reads its peak working set, so a benchmark only has to do its work and print a
+-- checksum (printing keeps the work from being optimized into nothing).
+
+local name = arg[1]
+local scale = tonumber(arg[2]) or 1
+
+local benchmarks = {}
+
+-- Function and method calls
+benchmarks.calls = function(n)
+  local function fib(k)
+    if k < 2 then return k end
+    return fib(k - 1) + fib(k - 2)
+  end
+  local counter = {value = 0}
+  function counter:add(k) self.value = self.value + k end
+  for i = 1, 1000000 * n do counter:add(i % 7) end
+  return fib(25 + math.floor(math.log(n, 2))) + counter.value
+end
+
+-- Array appends and table.insert/remove
+benchmarks.table_insert = function(n)
+  local total = 0
+  for _ = 1, 10 * n do
+    local t = {}
+    for i = 1, 100000 do t[#t + 1] = i end
+    for i = 1, 1000 do table.insert(t, i) end
+    for _ = 1, 1000 do total = total + table.remove(t) end
+    total = total + #t
+  end
+  return total
+end
+
+-- Hash lookups with string and integer keys
+benchmarks.table_lookup = function(n)
+  local map, keys = {}, {}
+  for i = 1, 10000 do
+    keys[i] = "key" .. i
+    map[keys[i]] = i
+    map[i * 7] = i
+  end
+  local total = 0
+  for _ = 1, 100 * n do
+    for i = 1, 10000 do
+      total = total + map[keys[i]] + (map[i * 7] or 0)
+    end
+  end
+  return total
+end
+
+-- String building with concatenation, string.format and table.concat
+benchmarks.string_build = function(n)
+  local length = 0
+  for _ = 1, 5 * n do
+    local parts = {}
+    for i = 1, 20000 do
+      parts[i] = string.format("%d=%s;", i, tostring(i * 1.5))
+    end
+    local text = table.concat(parts)
+    local s = ""
+    for i = 1, 2000 do s = s .. i end
+    length = length + #text + #s + #text:gsub("%d", "x")
+  end
+  return length
+end
+
+-- Closure creation and upvalue access
+benchmarks.closures = function(n)
+  local total = 0
+  for _ = 1, 20 * n do
+    local fns = {}
+    for i = 1, 10000 do
+      local captured = i
+      fns[i] = function(x) captured = captured + x; return captured end
+    end
+    for i = 1, #fns do total = total + fns[i](1) end
+  end
+  return total
+end
+
+-- Allocation-heavy churn for the garbage collector
+benchmarks.gc_churn = function(n)
+  local survivors = {}
+  for i = 1, 1000000 * n do
+    local t = {i, {i}, "s" .. (i % 100)}
+    if i % 1000 == 0 then survivors[#survivors + 1] = t end
+  end
+  collectgarbage("collect")
+  return #survivors + math.floor(collectgarbage("count"))
+end
+
+-- Coroutine resume/yield switching
+benchmarks.coroutine_switch = function(n)
+  local co = coroutine.wrap(function()
+    local k = 0
+    while true do k = k + 1; coroutine.yield(k) end
+  end)
+  local total = 0
+  for _ = 1, 500000 * n do total = total + co() end
+  return total
+end
+
+-- Pure-Lua JSON encode and decode of a nested document
+local function json_encode(value, out)
+  local kind = type(value)
+  if kind == "table" then
+    if value[1] ~= nil or next(value) == nil then
+      out[#out + 1] = "["
+      for i = 1, #value do
+        if i > 1 then out[#out + 1] = "," end
+        json_encode(value[i], out)
+      end
+      out[#out + 1] = "]"
+    else
+      local keys = {}
+      for k in pairs(value) do keys[#keys + 1] = k end
+      table.sort(keys)
+      out[#out + 1] = "{"
+      for i, k in ipairs(keys) do
+        if i > 1 then out[#out + 1] = "," end
+        out[#out + 1] = string.format("%q:", k)
+        json_encode(value[k], out)
+      end
+      out[#out + 1] = "}"
+    end
+  elseif kind == "string" then
+    out[#out + 1] = '"' .. value:gsub('[%c"\\]', function(c)
+      return string.format("\\u%04x", c:byte())
+    end) .. '"'
+  else
+    out[#out + 1] = tostring(value)
+  end
+  return out
+end
+
+local function json_decode(text)
+  local pos = 1
+  local parse_value
+
+  local function skip()
+    pos = text:find("[^ \t\r\n]", pos) or #text + 1
+  end
+
+  local function parse_string()
+    local finish = text:find('"', pos + 1, true)
+    local s = text:sub(pos + 1, finish - 1):gsub("\\u(%x%x%x%x)", function(h)
+      return string.char(tonumber(h, 16))
+    end)
+    pos = finish + 1
+    return s
+  end
+
+  parse_value = function()
+    skip()
+    local c = text:sub(pos, pos)
+    if c == "{" then
+      local result = {}
+      pos = pos + 1
+      skip()
+      if text:sub(pos, pos) == "}" then pos = pos + 1; return result end
+      repeat
+        skip()
+        local key = parse_string()
+        skip()
+        pos = pos + 1 -- ':'
+        result[key] = parse_value()
+        skip()
+        c = text:sub(pos, pos)
+        pos = pos + 1
+      until c == "}"
+      return result
+    elseif c == "[" then
+      local result = {}
+      pos = pos + 1
+      skip()
+      if text:sub(pos, pos) == "]" then pos = pos + 1; return result end
+      repeat
+        result[#result + 1] = parse_value()
+        skip()
+        c = text:sub(pos, pos)
+        pos = pos + 1
+      until c == "]"
+      return result
+    elseif c == '"' then
+      return parse_string()
+    end
+    local literal = text:match("^[%w%.%+%-]+", pos)
+    pos = pos + #literal
+    if literal == "true" then return true elseif literal == "false" then return false end
+    return tonumber(literal)
+  end
+
+  return parse_value()
+end
+
+benchmarks.json = function(n)
+  local document = {}
+  for i = 1, 2000 do
+    document[i] = {
+      id = i, name = "item \"" .. i .. "\"", price = i * 1.25, active = i % 3 == 0,
+      tags = {"lua", "bench", tostring(i % 10)}, nested = {depth = {value = i}},
+    }
+  end
+  local total = 0
+  for _ = 1, 5 * n do
+    local text = table.concat(json_encode(document, {}))
+    local decoded = json_decode(text)
+    total = total + #text + #decoded + decoded[#decoded].nested.depth.value
+  end
+  return total
+end
+
+if name == "--list" then
+  local names = {}
+  for k in pairs(benchmarks) do names[#names + 1] = k end
+  table.sort(names)
+  print(table.concat(names, "\n"))
+  return
+end
+
+local benchmark = benchmarks[name]
+if not benchmark then
+  io.stderr:write("unknown benchmark: ", tostring(name), "\n")
+  os.exit(2)
+end
+
+print(benchmark(scale))
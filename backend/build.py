@@ -12,11 +12,13 @@ specified in build_config.txt.
 2 - Enter extracted luarocks directory and run the setup-luarocks.bat script
 """
 
+import contextlib
 import os
 import shutil
 import subprocess
 import argparse
 import sys
+import time
 from pathlib import Path
 
 # Ensure we can import from the current directory when run from CLI
@@ -28,17 +30,23 @@ if __name__ == "__main__" or "backend" not in sys.path:
 # Import configuration system and utilities with dual-context support
 try:
     from config import (
-        get_lua_dir_name, get_luarocks_dir_name,
+        get_lua_dir_name, get_luarocks_dir_name, get_lua_tests_dir_name,
         LUA_VERSION, LUAROCKS_VERSION, LUAROCKS_PLATFORM
     )
     from utils import ensure_extracted_folder
+    from download_manager import BuildCache
+    from shared_store import SharedStore
+    from install_timeline import phase, record_phase
 except ImportError:
     try:
         from .config import (
-            get_lua_dir_name, get_luarocks_dir_name,
+            get_lua_dir_name, get_luarocks_dir_name, get_lua_tests_dir_name,
             LUA_VERSION, LUAROCKS_VERSION, LUAROCKS_PLATFORM
         )
         from .utils import ensure_extracted_folder
+        from .download_manager import BuildCache
+        from .shared_store import SharedStore
+        from .install_timeline import phase, record_phase
     except ImportError as e:
         print(f"Error importing configuration: {e}")
         print("Make sure config.py and utils.py are in the same directory as this script.")
@@ -46,8 +54,125 @@ except ImportError:
 
 INSTALL_DIR = Path("./lua").resolve()
 
-def run_build_scripts(build_dll=False, build_debug=False, install_dir=INSTALL_DIR):
-    """Run the build scripts for Lua and LuaRocks from the extracted folder."""
+# Seconds allowed for each PGO training run
+PGO_TRAINING_TIMEOUT = 600
+
+def get_build_config(build_debug=False, optimize=None):
+    """Registry build_config for a build: "debug", "pgo" or "release"."""
+    if build_debug:
+        return "debug"
+    return "pgo" if optimize == "pgo" else "release"
+
+def find_cached_build(lua_dir, build_dll, build_config):
+    """Return (cache, key) for this build, or (None, None) when caching is not possible.
+
+    Set LUAENV_NO_BUILD_CACHE=1 to always compile.
+    """
+    if os.environ.get("LUAENV_NO_BUILD_CACHE") == "1":
+        return None, None
+
+    toolset_id = BuildCache.get_toolset_id()
+    if toolset_id is None:
+        return None, None
+
+    cache = BuildCache()
+    key = cache.compute_key(
+        lua_dir,
+        build_type="dll" if build_dll else "static",
+        build_config=build_config,
+        architecture=os.environ.get("VSCMD_ARG_TGT_ARCH", ""),
+        toolset_id=toolset_id
+    )
+    return cache, key
+
+@contextlib.contextmanager
+def build_script_phases(out_dir):
+    """Record a build script run in the enclosed block as compile, link and install phases.
+
+    The scripts compile, link and install in that order, so the run is split at
+    the newest object and at the newest library or executable written to out_dir
+    (Release or Debug). The objects written during the run are the files compiled.
+    """
+    start, wall_start = time.monotonic(), time.time()
+    status = "ok"
+    try:
+        yield
+    except BaseException:
+        status = "failed"
+        raise
+    finally:
+        end = time.monotonic()
+
+        def written(*patterns):
+            times = []
+            for pattern in patterns:
+                for path in Path(out_dir).rglob(pattern):
+                    try:
+                        mtime = path.stat().st_mtime
+                    except OSError:
+                        continue
+                    if mtime >= wall_start:
+                        times.append(mtime)
+            return times
+
+        def split_at(times, floor):
+            return min(end, max(floor, start + max(times) - wall_start)) if times else floor
+
+        objects = written("*.obj")
+        compiled = split_at(objects, start)
+        linked = split_at(written("*.lib", "*.dll", "*.exe"), compiled)
+        record_phase("compile", start, compiled - start, status, files=len(objects))
+        record_phase("link", compiled, linked - compiled, status)
+        record_phase("install", linked, end - linked, status)
+
+def run_lua_build_script(build_dll, build_debug, install_dir, env=None):
+    """Run the Lua build script in the current directory and install to install_dir."""
+    env = env or os.environ.copy()
+    with build_script_phases("Debug" if build_debug else "Release"):
+        if build_dll and build_debug:
+            subprocess.run(["build-dll-debug.bat", install_dir], check=True, shell=True, env=env)
+        elif build_dll:
+            subprocess.run(["build-dll.bat"], check=True, shell=True, env=env)
+            subprocess.run([sys.executable, "install_lua_dll.py", install_dir], check=True, env=env)
+        elif build_debug:
+            subprocess.run(["build-static-debug.bat", install_dir], check=True, shell=True, env=env)
+        else:
+            subprocess.run(["build-static.bat", install_dir], check=True, shell=True, env=env)
+
+def run_pgo_build(build_dll, install_dir, tests_dir):
+    """Build Lua with profile-guided optimisation in the current directory.
+
+    1 - Build with /GL and an instrumented lua.exe (static) or lua54.dll (dll)
+    2 - Train it on the basic Lua test suite and pgo-training.lua
+    3 - Relink with the collected profile and install as usual
+    """
+    print("PGO pass 1/3: instrumented build...")
+    script = "build-dll.bat" if build_dll else "build-static.bat"
+    with build_script_phases("Release"):
+        subprocess.run([script, install_dir], check=True, shell=True, env=dict(os.environ, LUAENV_PGO="instrument"))
+
+    print("PGO pass 2/3: training...")
+    lua_exe = os.path.abspath(os.path.join("Release", "lua.exe"))
+    with phase("pgo-training"):
+        if tests_dir.exists():
+            # Only the profile matters here; test failures are reported by the install tests
+            subprocess.run([lua_exe, "-e", "_U=true", "all.lua"], cwd=str(tests_dir),
+                           timeout=PGO_TRAINING_TIMEOUT, env=os.environ.copy())
+        else:
+            print(f"[WARNING] Lua tests not found at {tests_dir}, training on the workload only")
+        subprocess.run([lua_exe, "pgo-training.lua"], check=True, timeout=PGO_TRAINING_TIMEOUT, env=os.environ.copy())
+
+    print("PGO pass 3/3: optimized relink...")
+    run_lua_build_script(build_dll, False, install_dir, env=dict(os.environ, LUAENV_PGO="optimize"))
+
+def run_build_scripts(build_dll=False, build_debug=False, install_dir=INSTALL_DIR, use_cache=True,
+                      optimize=None):
+    """Run the build scripts for Lua and LuaRocks from the extracted folder.
+
+    Lua itself is restored from the BuildCache when an identical build (same sources,
+    build scripts, build type, architecture and MSVC toolset) was made before.
+    With optimize="pgo" a release build is trained and relinked with PGO.
+    """
     current_dir = os.path.dirname(os.path.abspath(__file__))
 
     # Ensure extracted folder exists
@@ -67,14 +192,15 @@ def run_build_scripts(build_dll=False, build_debug=False, install_dir=INSTALL_DI
     print(f"  Extracted folder: {extracted_folder}")
 
     # Determine build type
+    build_config = get_build_config(build_debug, optimize)
     if build_dll and build_debug:
         build_type = "DLL Debug"
     elif build_dll:
-        build_type = "DLL Release"
+        build_type = "DLL PGO" if build_config == "pgo" else "DLL Release"
     elif build_debug:
         build_type = "Static Debug"
     else:
-        build_type = "Static Release"
+        build_type = "Static PGO" if build_config == "pgo" else "Static Release"
 
     print(f"  Build type: {build_type}")
     print(f"  Install directory: {install_dir}")
@@ -114,20 +240,31 @@ def run_build_scripts(build_dll=False, build_debug=False, install_dir=INSTALL_DI
             print(f"  {var}: {value}")
     print()
 
+    cache, cache_key = find_cached_build(lua_dir, build_dll, build_config) if use_cache else (None, None)
+
     # Change to Lua directory and run the build script
     os.chdir(str(lua_dir))
     try:
-        if build_dll and build_debug:
-            subprocess.run(["build-dll-debug.bat", install_dir], check=True, shell=True, env=os.environ.copy())
-        elif build_dll:
-            subprocess.run(["build-dll.bat"], check=True, shell=True, env=os.environ.copy())
-            subprocess.run([sys.executable, "install_lua_dll.py", install_dir], check=True, env=os.environ.copy())
-        elif build_debug:
-            subprocess.run(["build-static-debug.bat", install_dir], check=True, shell=True, env=os.environ.copy())
+        with phase("cache-restore") as counters:
+            restored = cache is not None and cache.restore(cache_key, install_dir)
+            counters["hit"] = restored
+        if restored:
+            print(f"[OK] Lua restored from build cache ({cache_key[:12]}), skipping compilation.")
         else:
-            subprocess.run(["build-static.bat", install_dir], check=True, shell=True, env=os.environ.copy())
-        print("[OK] Lua build completed successfully.")
-    except subprocess.CalledProcessError as e:
+            if build_config == "pgo":
+                tests_dir = extracted_folder / get_lua_tests_dir_name()
+                run_pgo_build(build_dll, install_dir, tests_dir)
+            else:
+                run_lua_build_script(build_dll, build_debug, install_dir)
+            print("[OK] Lua build completed successfully.")
+            if cache is not None:
+                cache.store(cache_key, install_dir, {
+                    "lua_version": LUA_VERSION,
+                    "build_type": "dll" if build_dll else "static",
+                    "build_config": build_config,
+                    "architecture": os.environ.get("VSCMD_ARG_TGT_ARCH", "")
+                })
+    except (subprocess.CalledProcessError, subprocess.TimeoutExpired) as e:
         print(f"[ERROR] Lua build failed: {e}")
         return False
 
@@ -155,10 +292,18 @@ def run_build_scripts(build_dll=False, build_debug=False, install_dir=INSTALL_DI
         luarocks_dest.mkdir(parents=True, exist_ok=True)
 
     try:
-        shutil.copytree(str(luarocks_dir), luarocks_dest, dirs_exist_ok=True)
+        # The LuaRocks binaries are hardlinked from the store shared by all installations
+        with phase("luarocks-files") as counters:
+            if os.environ.get("LUAENV_NO_SHARED_STORE") == "1":
+                shutil.copytree(str(luarocks_dir), luarocks_dest, dirs_exist_ok=True)
+            else:
+                linked, copied = SharedStore().copy_tree(luarocks_dir, luarocks_dest)
+                counters.update(files=linked + copied, shared=linked)
+                print(f"[OK] LuaRocks files: {linked} shared, {copied} copied")
 
         os.chdir(luarocks_dest)
-        subprocess.run(["setup-luarocks.bat", install_dir], check=True, shell=True, env=os.environ.copy())
+        with phase("luarocks-config"):
+            subprocess.run(["setup-luarocks.bat", install_dir], check=True, shell=True, env=os.environ.copy())
         print("[OK] LuaRocks setup completed successfully.")
         return True
     except Exception as e:
@@ -181,12 +326,21 @@ Examples:
   python build.py --dll --debug                     # DLL debug build to ./lua
   python build.py --prefix C:\\lua                   # Static release build to C:\\lua
   python build.py --dll --debug --prefix C:\\Dev\\Lua # DLL debug build to C:\\Dev\\Lua
+  python build.py --no-cache                        # Compile even if an identical build is cached
+  python build.py --optimize pgo                    # Static release build with PGO/LTCG
 
 Build Types:
   Static Release:  Optimized static library build (default)
   DLL Release:     Optimized DLL build
   Static Debug:    Unoptimized static build with debug symbols
   DLL Debug:       Unoptimized DLL build with debug symbols
+  PGO:             Release build (static or DLL) with /GL, /LTCG and a profile
+                   trained on the Lua test suite and pgo-training.lua (--optimize pgo)
+
+Build Cache:
+  Finished Lua builds are kept in ~/.luaenv/cache/builds, keyed by the sources,
+  the build scripts, the build type, the architecture and the MSVC toolset.
+  An identical build is restored from there instead of being compiled.
 
 Prerequisites:
   1. Run 'python download_lua_luarocks.py' to download sources
@@ -209,6 +363,18 @@ To use different versions, edit build_config.txt and re-run the prerequisite ste
         help="Build Lua with debug symbols and unoptimized code"
     )
 
+    parser.add_argument(
+        "--optimize",
+        choices=["pgo"],
+        help="Whole-program optimisation: 'pgo' trains and relinks a release build with PGO/LTCG"
+    )
+
+    parser.add_argument(
+        "--no-cache",
+        action="store_true",
+        help="Always compile Lua instead of restoring an identical build from the build cache"
+    )
+
     parser.add_argument(
         "--prefix",
         default=str(INSTALL_DIR),
@@ -217,6 +383,9 @@ To use different versions, edit build_config.txt and re-run the prerequisite ste
 
     args = parser.parse_args()
 
+    if args.optimize and args.debug:
+        parser.error("--optimize cannot be combined with --debug")
+
     print(f"Lua MSVC Build System")
     print("=" * 40)
     print(f"Configuration: Lua {LUA_VERSION}, LuaRocks {LUAROCKS_VERSION}")
@@ -225,17 +394,18 @@ To use different versions, edit build_config.txt and re-run the prerequisite ste
     if args.dll and args.debug:
         build_type = "DLL Debug"
     elif args.dll:
-        build_type = "DLL Release"
+        build_type = "DLL PGO" if args.optimize else "DLL Release"
     elif args.debug:
         build_type = "Static Debug"
     else:
-        build_type = "Static Release"
+        build_type = "Static PGO" if args.optimize else "Static Release"
 
     print(f"Build type: {build_type}")
     print(f"Install directory: {args.prefix}")
     print()
 
-    success = run_build_scripts(build_dll=args.dll, build_debug=args.debug, install_dir=args.prefix)
+    success = run_build_scripts(build_dll=args.dll, build_debug=args.debug, install_dir=args.prefix,
+                                use_cache=not args.no_cache, optimize=args.optimize)
 
     if success:
         print("\n[SUCCESS] Build completed successfully!")
@@ -62,70 +62,49 @@ REM For backwards compatibility with old lua versions add to the CFLAGS: /DLUA_C
 set "CFLAGS=/Od /MDd /W3 /Zi /D_DEBUG /DLUA_BUILD_AS_DLL"
 set "LINKFLAGS=/DEBUG /INCREMENTAL:NO /DLL /NODEFAULTLIB:libcmt.lib /NODEFAULTLIB:libcmtd.lib /NODEFAULTLIB:msvcrt.lib"
 
-rem Clean previous build
-echo Cleaning previous debug DLL build...
-if exist "Debug\*.obj" del /q "Debug\*.obj"
-if exist "Debug\*.exe" del /q "Debug\*.exe"
-if exist "Debug\*.dll" del /q "Debug\*.dll"
-if exist "Debug\*.lib" del /q "Debug\*.lib"
-if exist "Debug\*.pdb" del /q "Debug\*.pdb"
-if exist "Debug\*.ilk" del /q "Debug\*.ilk"
-if exist "Debug\*.exp" del /q "Debug\*.exp"
+rem Clean previous build (only on request, objects are otherwise reused
+rem when their sources, headers, flags and toolset are unchanged)
+if "%LUAENV_CLEAN_BUILD%"=="1" (
+    echo Cleaning previous debug DLL build...
+    if exist "Debug\*.obj" del /q "Debug\*.obj"
+    if exist "Debug\*.exe" del /q "Debug\*.exe"
+    if exist "Debug\*.dll" del /q "Debug\*.dll"
+    if exist "Debug\*.lib" del /q "Debug\*.lib"
+    if exist "Debug\*.pdb" del /q "Debug\*.pdb"
+    if exist "Debug\*.ilk" del /q "Debug\*.ilk"
+    if exist "Debug\*.exp" del /q "Debug\*.exp"
+)
 
 echo.
 echo Compiling Lua library source files (Debug DLL mode)...
 
-rem Core files
-echo   Core files...
-cl /c %CFLAGS% /FoDebug\lapi.obj lapi.c
-cl /c %CFLAGS% /FoDebug\lcode.obj lcode.c
-cl /c %CFLAGS% /FoDebug\lctype.obj lctype.c
-cl /c %CFLAGS% /FoDebug\ldebug.obj ldebug.c
-cl /c %CFLAGS% /FoDebug\ldo.obj ldo.c
-cl /c %CFLAGS% /FoDebug\ldump.obj ldump.c
-cl /c %CFLAGS% /FoDebug\lfunc.obj lfunc.c
-cl /c %CFLAGS% /FoDebug\lgc.obj lgc.c
-cl /c %CFLAGS% /FoDebug\llex.obj llex.c
-cl /c %CFLAGS% /FoDebug\lmem.obj lmem.c
-cl /c %CFLAGS% /FoDebug\lobject.obj lobject.c
-cl /c %CFLAGS% /FoDebug\lopcodes.obj lopcodes.c
-cl /c %CFLAGS% /FoDebug\lparser.obj lparser.c
-cl /c %CFLAGS% /FoDebug\lstate.obj lstate.c
-cl /c %CFLAGS% /FoDebug\lstring.obj lstring.c
-cl /c %CFLAGS% /FoDebug\ltable.obj ltable.c
-cl /c %CFLAGS% /FoDebug\ltm.obj ltm.c
-cl /c %CFLAGS% /FoDebug\lundump.obj lundump.c
-cl /c %CFLAGS% /FoDebug\lvm.obj lvm.c
-cl /c %CFLAGS% /FoDebug\lzio.obj lzio.c
-
-rem Library files
-echo   Library files...
-cl /c %CFLAGS% /FoDebug\lauxlib.obj lauxlib.c
-cl /c %CFLAGS% /FoDebug\lbaselib.obj lbaselib.c
-cl /c %CFLAGS% /FoDebug\lcorolib.obj lcorolib.c
-cl /c %CFLAGS% /FoDebug\ldblib.obj ldblib.c
-cl /c %CFLAGS% /FoDebug\liolib.obj liolib.c
-cl /c %CFLAGS% /FoDebug\lmathlib.obj lmathlib.c
-cl /c %CFLAGS% /FoDebug\loadlib.obj loadlib.c
-cl /c %CFLAGS% /FoDebug\loslib.obj loslib.c
-cl /c %CFLAGS% /FoDebug\lstrlib.obj lstrlib.c
-cl /c %CFLAGS% /FoDebug\ltablib.obj ltablib.c
-cl /c %CFLAGS% /FoDebug\lutf8lib.obj lutf8lib.c
-cl /c %CFLAGS% /FoDebug\linit.obj linit.c
+rem Compiled in parallel; only out of date objects are rebuilt
+set "LUA_CORE=lapi lcode lctype ldebug ldo ldump lfunc lgc llex lmem lobject lopcodes lparser lstate lstring ltable ltm lundump lvm lzio"
+set "LUA_LIBS=lauxlib lbaselib lcorolib ldblib liolib lmathlib loadlib loslib lstrlib ltablib lutf8lib linit"
+call compile-lua.bat Debug "%CFLAGS%" "%LUA_CORE% %LUA_LIBS% lua luac"
+if errorlevel 1 (
+    echo.
+    echo ? Debug DLL compilation failed
+    exit /b 1
+)
+
+rem Relink everything when an object changed or an output is missing
+if not exist "Debug\lua54.dll" set "LUA_OBJECTS_CHANGED=1"
+if not exist "Debug\lua54.lib" set "LUA_OBJECTS_CHANGED=1"
+if not exist "Debug\lua.exe" set "LUA_OBJECTS_CHANGED=1"
+if not exist "Debug\luac.exe" set "LUA_OBJECTS_CHANGED=1"
 
 echo.
 echo Creating debug DLL...
-link /OUT:Debug\lua54.dll %LINKFLAGS% /IMPLIB:Debug\lua54.lib Debug\lapi.obj Debug\lcode.obj Debug\lctype.obj Debug\ldebug.obj Debug\ldo.obj Debug\ldump.obj Debug\lfunc.obj Debug\lgc.obj Debug\llex.obj Debug\lmem.obj Debug\lobject.obj Debug\lopcodes.obj Debug\lparser.obj Debug\lstate.obj Debug\lstring.obj Debug\ltable.obj Debug\ltm.obj Debug\lundump.obj Debug\lvm.obj Debug\lzio.obj Debug\lauxlib.obj Debug\lbaselib.obj Debug\lcorolib.obj Debug\ldblib.obj Debug\liolib.obj Debug\lmathlib.obj Debug\loadlib.obj Debug\loslib.obj Debug\lstrlib.obj Debug\ltablib.obj Debug\lutf8lib.obj Debug\linit.obj
+if "%LUA_OBJECTS_CHANGED%"=="1" link /OUT:Debug\lua54.dll %LINKFLAGS% /IMPLIB:Debug\lua54.lib Debug\lapi.obj Debug\lcode.obj Debug\lctype.obj Debug\ldebug.obj Debug\ldo.obj Debug\ldump.obj Debug\lfunc.obj Debug\lgc.obj Debug\llex.obj Debug\lmem.obj Debug\lobject.obj Debug\lopcodes.obj Debug\lparser.obj Debug\lstate.obj Debug\lstring.obj Debug\ltable.obj Debug\ltm.obj Debug\lundump.obj Debug\lvm.obj Debug\lzio.obj Debug\lauxlib.obj Debug\lbaselib.obj Debug\lcorolib.obj Debug\ldblib.obj Debug\liolib.obj Debug\lmathlib.obj Debug\loadlib.obj Debug\loslib.obj Debug\lstrlib.obj Debug\ltablib.obj Debug\lutf8lib.obj Debug\linit.obj
 
 echo.
 echo Compiling and linking debug executables...
 echo   lua.exe...
-cl /c %CFLAGS% /FoDebug\lua.obj lua.c
-link /OUT:Debug\lua.exe /DEBUG /INCREMENTAL:NO Debug\lua.obj Debug\lua54.lib
+if "%LUA_OBJECTS_CHANGED%"=="1" link /OUT:Debug\lua.exe /DEBUG /INCREMENTAL:NO Debug\lua.obj Debug\lua54.lib
 
 echo   luac.exe...
-cl /c %CFLAGS% /FoDebug\luac.obj luac.c
-link /OUT:Debug\luac.exe /DEBUG /INCREMENTAL:NO Debug\luac.obj Debug\lapi.obj Debug\lcode.obj Debug\lctype.obj Debug\ldebug.obj Debug\ldo.obj Debug\ldump.obj Debug\lfunc.obj Debug\lgc.obj Debug\llex.obj Debug\lmem.obj Debug\lobject.obj Debug\lopcodes.obj Debug\lparser.obj Debug\lstate.obj Debug\lstring.obj Debug\ltable.obj Debug\ltm.obj Debug\lundump.obj Debug\lvm.obj Debug\lzio.obj Debug\lauxlib.obj Debug\lbaselib.obj Debug\lcorolib.obj Debug\ldblib.obj Debug\liolib.obj Debug\lmathlib.obj Debug\loadlib.obj Debug\loslib.obj Debug\lstrlib.obj Debug\ltablib.obj Debug\lutf8lib.obj Debug\linit.obj
+if "%LUA_OBJECTS_CHANGED%"=="1" link /OUT:Debug\luac.exe /DEBUG /INCREMENTAL:NO Debug\luac.obj Debug\lapi.obj Debug\lcode.obj Debug\lctype.obj Debug\ldebug.obj Debug\ldo.obj Debug\ldump.obj Debug\lfunc.obj Debug\lgc.obj Debug\llex.obj Debug\lmem.obj Debug\lobject.obj Debug\lopcodes.obj Debug\lparser.obj Debug\lstate.obj Debug\lstring.obj Debug\ltable.obj Debug\ltm.obj Debug\lundump.obj Debug\lvm.obj Debug\lzio.obj Debug\lauxlib.obj Debug\lbaselib.obj Debug\lcorolib.obj Debug\ldblib.obj Debug\liolib.obj Debug\lmathlib.obj Debug\loadlib.obj Debug\loslib.obj Debug\lstrlib.obj Debug\ltablib.obj Debug\lutf8lib.obj Debug\linit.obj
 
 if %ERRORLEVEL% neq 0 (
     echo.
@@ -33,59 +33,55 @@ REM For backwards compatibility with old lua versions add to the CFLAGS: /DLUA_C
 set "CFLAGS=/O2 /MD /W4 /DNDEBUG /DLUA_BUILD_AS_DLL"
 set "LINKFLAGS=/RELEASE  /INCREMENTAL:NO /DLL /NODEFAULTLIB:libcmt.lib /NODEFAULTLIB:libcmtd.lib /NODEFAULTLIB:msvcrtd.lib"
 
-rem Clean previous build
-echo Cleaning previous build...
-if exist "Release\*.obj" del /q "Release\*.obj"
-if exist "Release\*.exe" del /q "Release\*.exe"
-if exist "Release\*.lib" del /q "Release\*.lib"
-if exist "Release\*.dll" del /q "Release\*.dll"
-if exist "Release\*.pdb" del /q "Release\*.pdb"
-if exist "Release\*.exp" del /q "Release\*.exp"
+rem Profile-guided optimisation, driven by build.py --optimize pgo:
+rem   LUAENV_PGO=instrument  compile with /GL and link lua54.dll with /GENPROFILE
+rem   LUAENV_PGO=optimize    relink lua54.dll with the collected profile (/USEPROFILE)
+set "LTCG_LINKFLAGS="
+set "PGO_LINKFLAGS="
+if defined LUAENV_PGO (
+    set "CFLAGS=%CFLAGS% /GL"
+    set "LTCG_LINKFLAGS=/LTCG"
+)
+if "%LUAENV_PGO%"=="instrument" set "PGO_LINKFLAGS=/LTCG /GENPROFILE"
+if "%LUAENV_PGO%"=="optimize" set "PGO_LINKFLAGS=/LTCG /USEPROFILE"
+
+rem Clean previous build (only on request, objects are otherwise reused
+rem when their sources, headers, flags and toolset are unchanged)
+if "%LUAENV_CLEAN_BUILD%"=="1" (
+    echo Cleaning previous build...
+    if exist "Release\*.obj" del /q "Release\*.obj"
+    if exist "Release\*.exe" del /q "Release\*.exe"
+    if exist "Release\*.lib" del /q "Release\*.lib"
+    if exist "Release\*.dll" del /q "Release\*.dll"
+    if exist "Release\*.pdb" del /q "Release\*.pdb"
+    if exist "Release\*.exp" del /q "Release\*.exp"
+)
 
 echo.
 echo Compiling Lua library source files for DLL...
 
-rem Core files
-echo   Core files...
-cl /c %CFLAGS% /FoRelease\lapi.obj lapi.c
-cl /c %CFLAGS% /Os /FoRelease\lcode.obj lcode.c
-cl /c %CFLAGS% /FoRelease\lctype.obj lctype.c
-cl /c %CFLAGS% /FoRelease\ldebug.obj ldebug.c
-cl /c %CFLAGS% /FoRelease\ldo.obj ldo.c
-cl /c %CFLAGS% /FoRelease\ldump.obj ldump.c
-cl /c %CFLAGS% /FoRelease\lfunc.obj lfunc.c
-cl /c %CFLAGS% /FoRelease\lgc.obj lgc.c
-cl /c %CFLAGS% /Os /FoRelease\llex.obj llex.c
-cl /c %CFLAGS% /FoRelease\lmem.obj lmem.c
-cl /c %CFLAGS% /FoRelease\lobject.obj lobject.c
-cl /c %CFLAGS% /FoRelease\lopcodes.obj lopcodes.c
-cl /c %CFLAGS% /Os /FoRelease\lparser.obj lparser.c
-cl /c %CFLAGS% /FoRelease\lstate.obj lstate.c
-cl /c %CFLAGS% /FoRelease\lstring.obj lstring.c
-cl /c %CFLAGS% /FoRelease\ltable.obj ltable.c
-cl /c %CFLAGS% /FoRelease\ltm.obj ltm.c
-cl /c %CFLAGS% /FoRelease\lundump.obj lundump.c
-cl /c %CFLAGS% /FoRelease\lvm.obj lvm.c
-cl /c %CFLAGS% /FoRelease\lzio.obj lzio.c
-
-rem Library files
-echo   Library files...
-cl /c %CFLAGS% /FoRelease\lauxlib.obj lauxlib.c
-cl /c %CFLAGS% /FoRelease\lbaselib.obj lbaselib.c
-cl /c %CFLAGS% /FoRelease\lcorolib.obj lcorolib.c
-cl /c %CFLAGS% /FoRelease\ldblib.obj ldblib.c
-cl /c %CFLAGS% /FoRelease\liolib.obj liolib.c
-cl /c %CFLAGS% /FoRelease\lmathlib.obj lmathlib.c
-cl /c %CFLAGS% /FoRelease\loadlib.obj loadlib.c
-cl /c %CFLAGS% /FoRelease\loslib.obj loslib.c
-cl /c %CFLAGS% /FoRelease\lstrlib.obj lstrlib.c
-cl /c %CFLAGS% /FoRelease\ltablib.obj ltablib.c
-cl /c %CFLAGS% /FoRelease\lutf8lib.obj lutf8lib.c
-cl /c %CFLAGS% /FoRelease\linit.obj linit.c
+rem Compiled in parallel; only out of date objects are rebuilt
+set "LUA_CORE=lapi lctype ldebug ldo ldump lfunc lgc lmem lobject lopcodes lstate lstring ltable ltm lundump lvm lzio"
+set "LUA_CORE_SIZE=lcode llex lparser"
+set "LUA_LIBS=lauxlib lbaselib lcorolib ldblib liolib lmathlib loadlib loslib lstrlib ltablib lutf8lib linit"
+call compile-lua.bat Release "%CFLAGS%" "%LUA_CORE% %LUA_LIBS% lua" "%LUA_CORE_SIZE%"
+if errorlevel 1 (
+    echo.
+    echo [ERROR] Compilation failed
+    exit /b 1
+)
+
+rem Relink everything when an object changed or an output is missing
+if not exist "Release\lua54.dll" set "LUA_OBJECTS_CHANGED=1"
+if not exist "Release\lua54.lib" set "LUA_OBJECTS_CHANGED=1"
+if not exist "Release\lua.exe" set "LUA_OBJECTS_CHANGED=1"
+rem Every PGO pass relinks; a fresh instrumented build starts a fresh profile
+if defined LUAENV_PGO set "LUA_OBJECTS_CHANGED=1"
+if "%LUAENV_PGO%"=="instrument" if exist "Release\*.pgc" del /q "Release\*.pgc"
 
 echo.
 echo Creating DLL and import library...
-link /OUT:Release\lua54.dll %LINKFLAGS% /IMPLIB:Release\lua54.lib Release\lapi.obj Release\lcode.obj Release\lctype.obj Release\ldebug.obj Release\ldo.obj Release\ldump.obj Release\lfunc.obj Release\lgc.obj Release\llex.obj Release\lmem.obj Release\lobject.obj Release\lopcodes.obj Release\lparser.obj Release\lstate.obj Release\lstring.obj Release\ltable.obj Release\ltm.obj Release\lundump.obj Release\lvm.obj Release\lzio.obj Release\lauxlib.obj Release\lbaselib.obj Release\lcorolib.obj Release\ldblib.obj Release\liolib.obj Release\lmathlib.obj Release\loadlib.obj Release\loslib.obj Release\lstrlib.obj Release\ltablib.obj Release\lutf8lib.obj Release\linit.obj
+if "%LUA_OBJECTS_CHANGED%"=="1" link /OUT:Release\lua54.dll %LINKFLAGS% %PGO_LINKFLAGS% /IMPLIB:Release\lua54.lib Release\lapi.obj Release\lcode.obj Release\lctype.obj Release\ldebug.obj Release\ldo.obj Release\ldump.obj Release\lfunc.obj Release\lgc.obj Release\llex.obj Release\lmem.obj Release\lobject.obj Release\lopcodes.obj Release\lparser.obj Release\lstate.obj Release\lstring.obj Release\ltable.obj Release\ltm.obj Release\lundump.obj Release\lvm.obj Release\lzio.obj Release\lauxlib.obj Release\lbaselib.obj Release\lcorolib.obj Release\ldblib.obj Release\liolib.obj Release\lmathlib.obj Release\loadlib.obj Release\loslib.obj Release\lstrlib.obj Release\ltablib.obj Release\lutf8lib.obj Release\linit.obj
 
 if %ERRORLEVEL% neq 0 (
     echo.
@@ -98,8 +94,7 @@ echo Compiling and linking executables...
 
 rem Lua interpreter (links to DLL)
 echo   lua.exe (using DLL)...
-cl /c %CFLAGS% /FoRelease\lua.obj lua.c
-link /OUT:Release\lua.exe /RELEASE /INCREMENTAL:NO Release\lua.obj Release\lua54.lib
+if "%LUA_OBJECTS_CHANGED%"=="1" link /OUT:Release\lua.exe /RELEASE /INCREMENTAL:NO %LTCG_LINKFLAGS% Release\lua.obj Release\lua54.lib
 
 if %ERRORLEVEL% neq 0 (
     echo.
@@ -110,33 +105,18 @@ if %ERRORLEVEL% neq 0 (
 rem Lua compiler (statically linked)
 echo   luac.exe (static)...
 set "CFLAGS_STATIC=/O2 /MT /W3 /DLUA_COMPAT_5_3 /DNDEBUG"
-cl /c %CFLAGS_STATIC% /FoRelease\luac.obj luac.c
 
 rem For luac, we need to compile the core files again without DLL flags
 echo   Compiling core files for static luac...
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lapi.obj lapi.c
-cl /c %CFLAGS_STATIC% /Os /FoRelease\luac_lcode.obj lcode.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lctype.obj lctype.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_ldebug.obj ldebug.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_ldo.obj ldo.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_ldump.obj ldump.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lfunc.obj lfunc.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lgc.obj lgc.c
-cl /c %CFLAGS_STATIC% /Os /FoRelease\luac_llex.obj llex.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lmem.obj lmem.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lobject.obj lobject.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lopcodes.obj lopcodes.c
-cl /c %CFLAGS_STATIC% /Os /FoRelease\luac_lparser.obj lparser.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lstate.obj lstate.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lstring.obj lstring.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_ltable.obj ltable.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_ltm.obj ltm.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lundump.obj lundump.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lvm.obj lvm.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lzio.obj lzio.c
-cl /c %CFLAGS_STATIC% /FoRelease\luac_lauxlib.obj lauxlib.c
-
-link /OUT:Release\luac.exe /RELEASE /INCREMENTAL:NO Release\luac.obj Release\luac_lapi.obj Release\luac_lcode.obj Release\luac_lctype.obj Release\luac_ldebug.obj Release\luac_ldo.obj Release\luac_ldump.obj Release\luac_lfunc.obj Release\luac_lgc.obj Release\luac_llex.obj Release\luac_lmem.obj Release\luac_lobject.obj Release\luac_lopcodes.obj Release\luac_lparser.obj Release\luac_lstate.obj Release\luac_lstring.obj Release\luac_ltable.obj Release\luac_ltm.obj Release\luac_lundump.obj Release\luac_lvm.obj Release\luac_lzio.obj Release\luac_lauxlib.obj
+call compile-lua.bat Release\luac "%CFLAGS_STATIC%" "%LUA_CORE% lauxlib luac" "%LUA_CORE_SIZE%"
+if errorlevel 1 (
+    echo.
+    echo [ERROR] Compilation of static luac failed
+    exit /b 1
+)
+if not exist "Release\luac.exe" set "LUA_OBJECTS_CHANGED=1"
+
+if "%LUA_OBJECTS_CHANGED%"=="1" link /OUT:Release\luac.exe /RELEASE /INCREMENTAL:NO Release\luac\luac.obj Release\luac\lapi.obj Release\luac\lcode.obj Release\luac\lctype.obj Release\luac\ldebug.obj Release\luac\ldo.obj Release\luac\ldump.obj Release\luac\lfunc.obj Release\luac\lgc.obj Release\luac\llex.obj Release\luac\lmem.obj Release\luac\lobject.obj Release\luac\lopcodes.obj Release\luac\lparser.obj Release\luac\lstate.obj Release\luac\lstring.obj Release\luac\ltable.obj Release\luac\ltm.obj Release\luac\lundump.obj Release\luac\lvm.obj Release\luac\lzio.obj Release\luac\lauxlib.obj
 
 if %ERRORLEVEL% neq 0 (
     echo.
@@ -64,67 +64,91 @@ REM For backwards compatibility add to the CFLAGS: /DLUA_COMPAT_5_3 /DLUA_COMPAT
 set "CFLAGS=/O2 /MT /W4 /DNDEBUG"
 set "LINKFLAGS=/RELEASE /INCREMENTAL:NO /NODEFAULTLIB:msvcrt.lib /NODEFAULTLIB:libcmtd.lib /NODEFAULTLIB:msvcrtd.lib"
 
-rem Clean previous build
-echo Cleaning previous build...
-if exist "Release\*.obj" del /q "Release\*.obj"
-if exist "Release\*.exe" del /q "Release\*.exe"
-if exist "Release\*.lib" del /q "Release\*.lib"
-if exist "Release\*.pdb" del /q "Release\*.pdb"
+rem Profile-guided optimisation, driven by build.py --optimize pgo:
+rem   LUAENV_PGO=instrument  compile with /GL and link lua.exe with /GENPROFILE
+rem   LUAENV_PGO=optimize    relink lua.exe with the collected profile (/USEPROFILE)
+rem The installed lua54.lib is always built from objects compiled without /GL
+rem (Release\lib), so consumers do not need /LTCG or the same MSVC toolset.
+set "LIB_CFLAGS=%CFLAGS%"
+set "LIB_DIR=Release"
+set "LTCG_LINKFLAGS="
+set "PGO_LINKFLAGS="
+if defined LUAENV_PGO (
+    set "CFLAGS=%CFLAGS% /GL"
+    set "LIB_DIR=Release\lib"
+    set "LTCG_LINKFLAGS=/LTCG"
+)
+if "%LUAENV_PGO%"=="instrument" set "PGO_LINKFLAGS=/LTCG /GENPROFILE"
+if "%LUAENV_PGO%"=="optimize" set "PGO_LINKFLAGS=/LTCG /USEPROFILE"
+
+rem Clean previous build (only on request, objects are otherwise reused
+rem when their sources, headers, flags and toolset are unchanged)
+if "%LUAENV_CLEAN_BUILD%"=="1" (
+    echo Cleaning previous build...
+    if exist "Release\*.obj" del /q "Release\*.obj"
+    if exist "Release\*.exe" del /q "Release\*.exe"
+    if exist "Release\*.lib" del /q "Release\*.lib"
+    if exist "Release\*.pdb" del /q "Release\*.pdb"
+)
 
 echo.
 echo Compiling Lua library source files...
 
-rem Core files
-echo   Core files...
-cl /c %CFLAGS% /FoRelease\lapi.obj lapi.c
-cl /c %CFLAGS% /Os /FoRelease\lcode.obj lcode.c
-cl /c %CFLAGS% /FoRelease\lctype.obj lctype.c
-cl /c %CFLAGS% /FoRelease\ldebug.obj ldebug.c
-cl /c %CFLAGS% /FoRelease\ldo.obj ldo.c
-cl /c %CFLAGS% /FoRelease\ldump.obj ldump.c
-cl /c %CFLAGS% /FoRelease\lfunc.obj lfunc.c
-cl /c %CFLAGS% /FoRelease\lgc.obj lgc.c
-cl /c %CFLAGS% /Os /FoRelease\llex.obj llex.c
-cl /c %CFLAGS% /FoRelease\lmem.obj lmem.c
-cl /c %CFLAGS% /FoRelease\lobject.obj lobject.c
-cl /c %CFLAGS% /FoRelease\lopcodes.obj lopcodes.c
-cl /c %CFLAGS% /Os /FoRelease\lparser.obj lparser.c
-cl /c %CFLAGS% /FoRelease\lstate.obj lstate.c
-cl /c %CFLAGS% /FoRelease\lstring.obj lstring.c
-cl /c %CFLAGS% /FoRelease\ltable.obj ltable.c
-cl /c %CFLAGS% /FoRelease\ltm.obj ltm.c
-cl /c %CFLAGS% /FoRelease\lundump.obj lundump.c
-cl /c %CFLAGS% /FoRelease\lvm.obj lvm.c
-cl /c %CFLAGS% /FoRelease\lzio.obj lzio.c
-
-rem Library files
-echo   Library files...
-cl /c %CFLAGS% /FoRelease\lauxlib.obj lauxlib.c
-cl /c %CFLAGS% /FoRelease\lbaselib.obj lbaselib.c
-cl /c %CFLAGS% /FoRelease\lcorolib.obj lcorolib.c
-cl /c %CFLAGS% /FoRelease\ldblib.obj ldblib.c
-cl /c %CFLAGS% /FoRelease\liolib.obj liolib.c
-cl /c %CFLAGS% /FoRelease\lmathlib.obj lmathlib.c
-cl /c %CFLAGS% /FoRelease\loadlib.obj loadlib.c
-cl /c %CFLAGS% /FoRelease\loslib.obj loslib.c
-cl /c %CFLAGS% /FoRelease\lstrlib.obj lstrlib.c
-cl /c %CFLAGS% /FoRelease\ltablib.obj ltablib.c
-cl /c %CFLAGS% /FoRelease\lutf8lib.obj lutf8lib.c
-cl /c %CFLAGS% /FoRelease\linit.obj linit.c
+rem Compiled in parallel; only out of date objects are rebuilt
+set "LUA_CORE=lapi lctype ldebug ldo ldump lfunc lgc lmem lobject lopcodes lstate lstring ltable ltm lundump lvm lzio"
+set "LUA_CORE_SIZE=lcode llex lparser"
+set "LUA_LIBS=lauxlib lbaselib lcorolib ldblib liolib lmathlib loadlib loslib lstrlib ltablib lutf8lib linit"
+call compile-lua.bat Release "%CFLAGS%" "%LUA_CORE% %LUA_LIBS% lua luac" "%LUA_CORE_SIZE%"
+if errorlevel 1 (
+    echo.
+    echo ? Compilation failed
+    exit /b 1
+)
+if defined LUAENV_PGO (
+    call compile-lua.bat !LIB_DIR! "%LIB_CFLAGS%" "%LUA_CORE% %LUA_LIBS%" "%LUA_CORE_SIZE%"
+    if errorlevel 1 (
+        echo.
+        echo ? Compilation of the library objects failed
+        exit /b 1
+    )
+)
+
+set "LUA_LIB_OBJECTS="
+set "LIB_OBJECTS="
+for %%S in (%LUA_CORE% %LUA_CORE_SIZE% %LUA_LIBS%) do (
+    set "LUA_LIB_OBJECTS=!LUA_LIB_OBJECTS! Release\%%S.obj"
+    set "LIB_OBJECTS=!LIB_OBJECTS! !LIB_DIR!\%%S.obj"
+)
+
+rem Relink everything when an object changed or an output is missing
+if not exist "Release\lua54.lib" set "LUA_OBJECTS_CHANGED=1"
+if not exist "Release\lua.exe" set "LUA_OBJECTS_CHANGED=1"
+if not exist "Release\luac.exe" set "LUA_OBJECTS_CHANGED=1"
+rem Every PGO pass relinks; a fresh instrumented build starts a fresh profile
+if defined LUAENV_PGO set "LUA_OBJECTS_CHANGED=1"
+if "%LUAENV_PGO%"=="instrument" if exist "Release\*.pgc" del /q "Release\*.pgc"
 
 echo.
 echo Creating static library...
-lib /OUT:Release\lua54.lib Release\lapi.obj Release\lcode.obj Release\lctype.obj Release\ldebug.obj Release\ldo.obj Release\ldump.obj Release\lfunc.obj Release\lgc.obj Release\llex.obj Release\lmem.obj Release\lobject.obj Release\lopcodes.obj Release\lparser.obj Release\lstate.obj Release\lstring.obj Release\ltable.obj Release\ltm.obj Release\lundump.obj Release\lvm.obj Release\lzio.obj Release\lauxlib.obj Release\lbaselib.obj Release\lcorolib.obj Release\ldblib.obj Release\liolib.obj Release\lmathlib.obj Release\loadlib.obj Release\loslib.obj Release\lstrlib.obj Release\ltablib.obj Release\lutf8lib.obj Release\linit.obj
+if "%LUA_OBJECTS_CHANGED%"=="1" lib /OUT:Release\lua54.lib !LIB_OBJECTS!
+if errorlevel 1 (
+    echo.
+    echo ? Static library creation failed
+    exit /b 1
+)
 
 echo.
 echo Compiling and linking executables...
 echo   lua.exe...
-cl /c %CFLAGS% /FoRelease\lua.obj lua.c
-link /OUT:Release\lua.exe %LINKFLAGS% Release\lua.obj Release\lua54.lib
+if "%LUA_OBJECTS_CHANGED%"=="1" link /OUT:Release\lua.exe %LINKFLAGS% %PGO_LINKFLAGS% Release\lua.obj !LUA_LIB_OBJECTS!
+if errorlevel 1 (
+    echo.
+    echo ? lua.exe linking failed
+    exit /b 1
+)
 
 echo   luac.exe...
-cl /c %CFLAGS% /FoRelease\luac.obj luac.c
-link /OUT:Release\luac.exe %LINKFLAGS% Release\luac.obj Release\lapi.obj Release\lcode.obj Release\lctype.obj Release\ldebug.obj Release\ldo.obj Release\ldump.obj Release\lfunc.obj Release\lgc.obj Release\llex.obj Release\lmem.obj Release\lobject.obj Release\lopcodes.obj Release\lparser.obj Release\lstate.obj Release\lstring.obj Release\ltable.obj Release\ltm.obj Release\lundump.obj Release\lvm.obj Release\lzio.obj Release\lauxlib.obj Release\lbaselib.obj Release\lcorolib.obj Release\ldblib.obj Release\liolib.obj Release\lmathlib.obj Release\loadlib.obj Release\loslib.obj Release\lstrlib.obj Release\ltablib.obj Release\lutf8lib.obj Release\linit.obj
+if "%LUA_OBJECTS_CHANGED%"=="1" link /OUT:Release\luac.exe %LINKFLAGS% %LTCG_LINKFLAGS% Release\luac.obj !LUA_LIB_OBJECTS!
 
 if %ERRORLEVEL% neq 0 (
     echo.
@@ -151,6 +175,13 @@ Release\luac.exe -v
 echo.
 echo All tests passed! Static build is ready for use.
 
+rem The instrumented build is only run for training, build.py relinks and installs it
+if "%LUAENV_PGO%"=="instrument" (
+    echo.
+    echo Instrumented build ready for PGO training.
+    exit /b 0
+)
+
 echo.
 echo Installing to !INSTALL_DIR!...
 
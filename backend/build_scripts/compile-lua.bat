@@ -0,0 +1,110 @@
+@echo off
+REM ====================================================================
+REM compile-lua.bat OUT_DIR "CFLAGS" "SOURCES" ["SIZE_SOURCES"]
+REM
+REM Arguments:
+REM   OUT_DIR      - Object directory (e.g. Release, Debug), created if missing
+REM   CFLAGS       - Compiler flags, quoted
+REM   SOURCES      - Source names without .c, quoted and space separated
+REM   SIZE_SOURCES - Optional sources compiled with an extra /Os
+REM
+REM Called by the build-*.bat scripts. Compiles the sources in parallel
+REM (cl /MP, one job per processor) and incrementally:
+REM   - an object is rebuilt only when the SHA-256 of its source differs from
+REM     the one recorded next to it (OUT_DIR\<name>.sha256)
+REM   - every object is rebuilt when the compile flags, LINKFLAGS, the MSVC
+REM     toolset, the target architecture, the Windows SDK or any header
+REM     changed (recorded in OUT_DIR\build.key)
+REM   - set LUAENV_CLEAN_BUILD=1 to rebuild everything
+REM
+REM On return LUA_OBJECTS_CHANGED is 1 when at least one object was
+REM compiled (the caller relinks), and ERRORLEVEL is 1 on failure.
+REM ====================================================================
+
+setlocal enabledelayedexpansion
+
+set "OUT_DIR=%~1"
+set "COMPILE_FLAGS=%~2"
+set "SOURCES=%~3"
+set "SIZE_SOURCES=%~4"
+set "CHANGED=0"
+
+if not exist "%OUT_DIR%" mkdir "%OUT_DIR%"
+
+rem Everything that affects every object goes into the build key
+copy /b *.h "%OUT_DIR%\headers.tmp" >nul
+set "HEADER_HASH="
+for /f "delims=" %%H in ('certutil -hashfile "%OUT_DIR%\headers.tmp" SHA256 ^| findstr /v ":"') do set "HEADER_HASH=%%H"
+del /q "%OUT_DIR%\headers.tmp"
+
+> "%OUT_DIR%\build.key.new" (
+    echo cflags=%COMPILE_FLAGS%
+    echo linkflags=%LINKFLAGS%
+    echo toolset=%VCToolsVersion% %VSCMD_ARG_TGT_ARCH% %WindowsSDKVersion%
+    echo headers=!HEADER_HASH!
+)
+
+set "REBUILD=0"
+if "%LUAENV_CLEAN_BUILD%"=="1" set "REBUILD=1"
+if not exist "%OUT_DIR%\build.key" set "REBUILD=1"
+if "!REBUILD!"=="0" (
+    fc /b "%OUT_DIR%\build.key" "%OUT_DIR%\build.key.new" >nul || set "REBUILD=1"
+)
+
+if "!REBUILD!"=="1" (
+    for %%S in (%SOURCES% %SIZE_SOURCES%) do (
+        if exist "%OUT_DIR%\%%S.obj" del /q "%OUT_DIR%\%%S.obj"
+        if exist "%OUT_DIR%\%%S.sha256" del /q "%OUT_DIR%\%%S.sha256"
+    )
+)
+
+rem Collect the sources whose object is missing or out of date
+set "PENDING="
+set "PENDING_SIZE="
+for %%S in (%SOURCES%) do call :check_source %%S PENDING
+for %%S in (%SIZE_SOURCES%) do call :check_source %%S PENDING_SIZE
+
+if not defined PENDING if not defined PENDING_SIZE (
+    echo   All objects in %OUT_DIR% are up to date.
+)
+
+if defined PENDING (
+    call :compile "%COMPILE_FLAGS%" "!PENDING!"
+    if errorlevel 1 goto :failed
+)
+
+if defined PENDING_SIZE (
+    call :compile "%COMPILE_FLAGS% /Os" "!PENDING_SIZE!"
+    if errorlevel 1 goto :failed
+)
+
+move /y "%OUT_DIR%\build.key.new" "%OUT_DIR%\build.key" >nul
+endlocal & set "LUA_OBJECTS_CHANGED=%CHANGED%" & exit /b 0
+
+:failed
+del /q "%OUT_DIR%\build.key.new"
+endlocal & set "LUA_OBJECTS_CHANGED=1" & exit /b 1
+
+rem :check_source NAME LIST_VARIABLE - append NAME to the list if it needs compiling
+:check_source
+set "SOURCE_HASH="
+for /f "delims=" %%H in ('certutil -hashfile "%~1.c" SHA256 ^| findstr /v ":"') do set "SOURCE_HASH=%%H"
+set "HASH_%~1=!SOURCE_HASH!"
+set "STORED_HASH="
+if exist "%OUT_DIR%\%~1.obj" if exist "%OUT_DIR%\%~1.sha256" set /p STORED_HASH=<"%OUT_DIR%\%~1.sha256"
+if not "!SOURCE_HASH!"=="!STORED_HASH!" set "%~2=!%~2! %~1"
+goto :eof
+
+rem :compile "FLAGS" "NAMES" - compile NAMES in one parallel cl run and record their hashes
+:compile
+set "FILES="
+for %%S in (%~2) do set "FILES=!FILES! %%S.c"
+echo   Compiling%FILES%
+rem /FS serialises writes to the shared PDB of /Zi builds
+cl /c /MP /FS %~1 /Fo%OUT_DIR%\ %FILES%
+if errorlevel 1 exit /b 1
+for %%S in (%~2) do (
+    > "%OUT_DIR%\%%S.sha256" echo(!HASH_%%S!
+)
+set "CHANGED=1"
+exit /b 0
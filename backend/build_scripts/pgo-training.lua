@@ -0,0 +1,133 @@
+-- This is free and unencumbered software released into the public domain.
+-- For more details, see the LICENSE file in the project root.
+
+-- PGO training workload for build.py --optimize pgo
+--
+-- Run by the instrumented lua.exe after the basic Lua test suite. It exercises the
+-- interpreter paths that dominate typical Lua tooling: calls, table access, string
+-- building and patterns, closures, coroutines, the garbage collector and the
+-- compiler itself (load). Keep it deterministic and a few seconds long.
+
+local ROUNDS = tonumber(arg and arg[1]) or 3
+
+local function fib(n)
+  if n < 2 then return n end
+  return fib(n - 1) + fib(n - 2)
+end
+
+local function calls()
+  local total = 0
+  for _ = 1, 3 do total = total + fib(24) end
+  local obj = {value = 0}
+  function obj:add(n) self.value = self.value + n end
+  for i = 1, 200000 do obj:add(i) end
+  return total + obj.value
+end
+
+local function tables()
+  local array, map = {}, {}
+  for i = 1, 200000 do
+    array[#array + 1] = i
+    map["key" .. (i % 5000)] = i
+  end
+  local sum = 0
+  for i = 1, #array do sum = sum + array[i] end
+  for _, v in pairs(map) do sum = sum + v end
+  table.sort(array, function(a, b) return a > b end)
+  local queue = table.move(array, 1, 10000, 1, {})
+  for _ = 1, 1000 do table.insert(queue, 1, table.remove(queue)) end
+  return sum + #table.concat(queue, ",", 1, 1000)
+end
+
+local function strings()
+  local parts = {}
+  for i = 1, 50000 do
+    parts[#parts + 1] = string.format("%d:%s:%.2f", i, tostring(i * 3), i / 7)
+  end
+  local text = table.concat(parts, "\n")
+  local count = 0
+  for a, b in text:gmatch("(%d+):(%d+)") do
+    if tonumber(a) * 3 == tonumber(b) then count = count + 1 end
+  end
+  text = text:gsub("%.(%d)%d", ".%1"):upper():lower()
+  return count + #text + #text:rep(2, "|"):sub(10, -10)
+end
+
+local function closures()
+  local counters = {}
+  for i = 1, 20000 do
+    local n = i
+    counters[i] = function(step) n = n + step; return n end
+  end
+  local sum = 0
+  for _ = 1, 10 do
+    for i = 1, #counters do sum = sum + counters[i](1) end
+  end
+  return sum
+end
+
+local function coroutines()
+  local producer = coroutine.wrap(function()
+    for i = 1, 100000 do coroutine.yield(i) end
+    return 0
+  end)
+  local sum = 0
+  for _ = 1, 100000 do sum = sum + producer() end
+  return sum
+end
+
+local function garbage()
+  local keep = {}
+  for i = 1, 300000 do
+    local t = {i, tostring(i), {i}}
+    if i % 100 == 0 then keep[#keep + 1] = t end
+  end
+  collectgarbage("collect")
+  local weak = setmetatable({}, {__mode = "k"})
+  for i = 1, 50000 do weak[{}] = i end
+  collectgarbage("collect")
+  return #keep
+end
+
+local function encode(value)
+  local kind = type(value)
+  if kind == "table" then
+    local out = {}
+    if #value > 0 then
+      for i = 1, #value do out[i] = encode(value[i]) end
+      return "[" .. table.concat(out, ",") .. "]"
+    end
+    for k, v in pairs(value) do out[#out + 1] = string.format("%q:%s", k, encode(v)) end
+    table.sort(out)
+    return "{" .. table.concat(out, ",") .. "}"
+  elseif kind == "string" then
+    return string.format("%q", value)
+  end
+  return tostring(value)
+end
+
+local function compiler()
+  local document = {}
+  for i = 1, 2000 do
+    document[i] = {id = i, name = "item" .. i, tags = {"a", "b", i % 7}, ok = i % 2 == 0}
+  end
+  local text = encode(document)
+  -- JSON arrays and objects are Lua table constructors once : becomes =
+  local chunk = assert(load("return " .. text:gsub('"(%w+)":', "%1="):gsub("%[", "{"):gsub("%]", "}")))
+  return #chunk() + #string.dump(chunk)
+end
+
+local workloads = {
+  {"calls", calls}, {"tables", tables}, {"strings", strings}, {"closures", closures},
+  {"coroutines", coroutines}, {"garbage", garbage}, {"compiler", compiler},
+}
+
+for round = 1, ROUNDS do
+  for _, workload in ipairs(workloads) do
+    local start = os.clock()
+    local result = workload[2]()
+    if round == ROUNDS then
+      print(string.format("%-10s %8.3fs  %s", workload[1], os.clock() - start, tostring(result)))
+    end
+  end
+end
@@ -7,7 +7,8 @@ Configuration file for LuaEnv
 This file reads configuration from build_config.txt and provides
 functions to access version information and URLs for Lua and LuaRocks.
 
-The scripts use the versions specified in build_config.txt
+The scripts use the versions specified in build_config.txt, or in the file named
+by LUAENV_BUILD_CONFIG (the private config of one install job, see setup_lua.py).
 """
 
 import os
@@ -19,12 +20,21 @@ import json
 import time
 from datetime import datetime, timedelta
 
+try:
+    from .utils import HttpSession, probe_urls, MAX_PARALLEL_PROBES
+except ImportError:
+    from utils import HttpSession, probe_urls, MAX_PARALLEL_PROBES
+
 # Default values (used if config file is missing or has errors)
 DEFAULT_LUA_VERSION = "5.4.8"
 DEFAULT_LUA_MAJOR_MINOR = "5.4"
 DEFAULT_LUAROCKS_VERSION = "3.12.2"
 DEFAULT_LUAROCKS_PLATFORM = "windows-64"
 
+def get_config_file():
+    """build_config.txt in use: LUAENV_BUILD_CONFIG when set, else the one next to this file."""
+    return Path(os.environ.get("LUAENV_BUILD_CONFIG") or Path(__file__).parent / "build_config.txt")
+
 def load_config():
     """Load configuration from build_config.txt file."""
     config = {
@@ -34,7 +44,7 @@ def load_config():
         'LUAROCKS_PLATFORM': DEFAULT_LUAROCKS_PLATFORM
     }
 
-    config_file = Path(__file__).parent / "build_config.txt"
+    config_file = get_config_file()
 
     if not config_file.exists():
         print(f"[WARNING] Configuration file not found: {config_file}")
@@ -278,6 +288,20 @@ def validate_current_configuration():
 
     return all_valid, results
 
+# Connections kept alive across the probes of one discovery
+_probe_session = HttpSession(timeout=5)
+
+def _probe_versions(name, versions, url_for, print_fn):
+    """Probe the archive of each version (a few at a time, over reused connections); returns the available ones."""
+    results = probe_urls([url_for(version) for version in versions], _probe_session)
+    available_versions = []
+    for version in versions:
+        exists = results[url_for(version)]
+        print_fn(f"  Checking {name} {version}... {'[AVAILABLE]' if exists else '[NOT FOUND]'}")
+        if exists:
+            available_versions.append(version)
+    return available_versions
+
 def get_available_lua_versions(max_versions=9, use_cache=True, force_refresh=False, use_stderr=False):
     """
     Try to discover available Lua versions by checking common version patterns.
@@ -292,7 +316,7 @@ def get_available_lua_versions(max_versions=9, use_cache=True, force_refresh=Fal
             return cached_lua
 
     print_fn("Discovering available Lua versions (this may take a moment)...")
-    print_fn("[INFO] Being respectful to lua.org servers with rate limiting...")
+    print_fn(f"[INFO] Checking at most {MAX_PARALLEL_PROBES} archives at a time on lua.org...")
 
     # Common Lua versions to check (most recent first)
     versions_to_check = [
@@ -301,30 +325,8 @@ def get_available_lua_versions(max_versions=9, use_cache=True, force_refresh=Fal
         # "5.2.4", "5.2.3", "5.2.2", "5.2.1", "5.2.0",
         # "5.1.5", "5.1.4", "5.1.3", "5.1.2", "5.1.1", "5.1"]
 
-    available_versions = []
-    checked_count = 0
-
-    for version in versions_to_check:
-        if checked_count >= max_versions:
-            break
-
-        url = f"{LUA_BASE_URL}/lua-{version}.tar.gz"
-        print_fn(f"  Checking Lua {version}...", end=' ')
-
-        exists, message = check_url_exists(url, timeout=5)
-        if exists:
-            available_versions.append(version)
-            print_fn("[AVAILABLE]")
-        else:
-            print_fn("[NOT FOUND]")
-
-        checked_count += 1
-
-        # Rate limiting: wait between requests to be respectful
-        if checked_count < max_versions:  # Don't wait after the last check
-            time.sleep(0.1)  # 500ms delay between requests
-
-    return available_versions
+    return _probe_versions("Lua", versions_to_check[:max_versions],
+                           lambda version: f"{LUA_BASE_URL}/lua-{version}.tar.gz", print_fn)
 
 def get_available_luarocks_versions(platform="windows-64", max_versions=9, use_cache=True, force_refresh=False, use_stderr=False):
     """
@@ -339,36 +341,14 @@ def get_available_luarocks_versions(platform="windows-64", max_versions=9, use_c
             return cached_luarocks[platform]
 
     print_fn(f"Discovering available LuaRocks versions for {platform}...")
-    print_fn("[INFO] Being respectful to luarocks.github.io servers with rate limiting...")
+    print_fn(f"[INFO] Checking at most {MAX_PARALLEL_PROBES} archives at a time on luarocks.github.io...")
 
     # Common LuaRocks versions to check (most recent first)
     versions_to_check = [
         "3.12.2", "3.12.1", "3.12.0", "3.11.1", "3.11.0", "3.10.0", "3.9.2", "3.9.1", "3.9.0"]
 
-    available_versions = []
-    checked_count = 0
-
-    for version in versions_to_check:
-        if checked_count >= max_versions:
-            break
-
-        url = f"{LUAROCKS_BASE_URL}/luarocks-{version}-{platform}.zip"
-        print_fn(f"  Checking LuaRocks {version}...", end=' ')
-
-        exists, message = check_url_exists(url, timeout=5)
-        if exists:
-            available_versions.append(version)
-            print_fn("[AVAILABLE]")
-        else:
-            print_fn("[NOT FOUND]")
-
-        checked_count += 1
-
-        # Rate limiting: wait between requests to be respectful
-        if checked_count < max_versions:  # Don't wait after the last check
-            time.sleep(0.1)  # 500ms delay between requests
-
-    return available_versions
+    return _probe_versions("LuaRocks", versions_to_check[:max_versions],
+                           lambda version: f"{LUAROCKS_BASE_URL}/luarocks-{version}-{platform}.zip", print_fn)
 
 def discover_and_cache_versions(force_refresh=False, quiet=False, use_stderr=False):
     """
@@ -477,7 +457,7 @@ if __name__ == "__main__":
                         'luarocks': get_luarocks_url()
                     },
                     'config_info': {
-                        'config_file': str(Path(__file__).parent / "build_config.txt")
+                        'config_file': str(get_config_file())
                     }
                 }
 
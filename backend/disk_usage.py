@@ -0,0 +1,108 @@
+# This is free and unencumbered software released into the public domain.
+# For more details, see the LICENSE file in the project root.
+"""
+Disk usage of installation and environment trees.
+
+Measuring a tree means visiting every file, which takes seconds for large rock
+trees, so the registry keeps the result together with the tree's marker: the
+newest modification time of the tree root, its direct subdirectories and the
+rock manifest. Installing or removing a rock rewrites the manifest and changes
+the directories that gain or lose entries, so a measurement is current while
+its marker is. The F# CLI computes the same marker (RegistryAccess.treeMarker)
+to tell which installations need measuring again.
+
+Sizes come with the directory listing. Hardlink counts do not on Windows, so
+they are only read for the files the shared store links (see shared_store.py);
+every other file belongs to one installation.
+"""
+
+import os
+from concurrent.futures import ThreadPoolExecutor, FIRST_COMPLETED, wait
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+try:
+    from .shared_store import LINKED_SUFFIXES, is_immutable_tree_file
+except ImportError:
+    from shared_store import LINKED_SUFFIXES, is_immutable_tree_file
+
+# The rock manifest of a tree, relative to the tree root
+ROCK_MANIFEST = Path("lib") / "luarocks" / "rocks-5.4" / "manifest"
+
+
+def tree_marker(root: Path) -> Optional[int]:
+    """Last-modified marker of a tree in milliseconds since the epoch, None if it is missing."""
+    try:
+        newest = os.stat(root).st_mtime_ns
+        with os.scandir(root) as entries:
+            for entry in entries:
+                # Linked directories count with their own time, as in .NET
+                if entry.is_dir():
+                    newest = max(newest, entry.stat(follow_symlinks=False).st_mtime_ns)
+    except OSError:
+        return None
+    try:
+        newest = max(newest, os.stat(root / ROCK_MANIFEST).st_mtime_ns)
+    except OSError:
+        pass
+    return newest // 1_000_000
+
+
+def may_be_linked(relative: Tuple[str, ...]) -> bool:
+    """Whether the shared store may have hardlinked the file at this path within a tree."""
+    return os.path.splitext(relative[-1])[1].lower() in LINKED_SUFFIXES or \
+        is_immutable_tree_file(Path(*relative))
+
+
+def _scan_directory(path: str, relative: Tuple[str, ...]) -> Tuple[int, int, List[Tuple[str, Tuple[str, ...]]]]:
+    """Bytes and hardlinked bytes of the files directly in a directory, and its subdirectories."""
+    total = shared = 0
+    subdirs = []
+    try:
+        with os.scandir(path) as entries:
+            for entry in entries:
+                try:
+                    if entry.is_dir(follow_symlinks=False):
+                        subdirs.append((entry.path, relative + (entry.name,)))
+                    elif entry.is_file(follow_symlinks=False):
+                        # On Windows the size comes with the directory listing, but the
+                        # link count needs the file itself
+                        stat = entry.stat(follow_symlinks=False)
+                        total += stat.st_size
+                        if os.name != "nt":
+                            links = stat.st_nlink
+                        elif may_be_linked(relative + (entry.name,)):
+                            links = os.stat(entry.path).st_nlink
+                        else:
+                            links = 1
+                        if links > 1:
+                            shared += stat.st_size
+                except OSError:
+                    continue
+    except OSError:
+        pass
+    return total, shared, subdirs
+
+
+def measure_tree(root: Path, jobs: Optional[int] = None) -> Optional[Dict]:
+    """Measure a tree, listing its directories in parallel.
+
+    Returns:
+        Dict with 'bytes', 'shared' (bytes in files hardlinked with the store or
+        other installations) and 'marker', or None when the tree is missing
+    """
+    marker = tree_marker(root)
+    if marker is None:
+        return None
+
+    total = shared = 0
+    with ThreadPoolExecutor(max_workers=jobs or min(32, (os.cpu_count() or 1) * 2)) as pool:
+        pending = {pool.submit(_scan_directory, str(root), ())}
+        while pending:
+            done, pending = wait(pending, return_when=FIRST_COMPLETED)
+            for future in done:
+                size, linked, subdirs = future.result()
+                total += size
+                shared += linked
+                pending.update(pool.submit(_scan_directory, subdir, parts) for subdir, parts in subdirs)
+    return {"bytes": total, "shared": shared, "marker": marker}
@@ -41,19 +41,24 @@ except ImportError:
 
 # Import download manager and utilities with dual-context support
 try:
-    from download_manager import DownloadManager
-    from utils import extract_file, ensure_extracted_folder, clean_extracted_folder, list_extracted_contents
+    from download_manager import DownloadManager, BuildCache
+    from utils import extract_file, ensure_extracted_folder, clean_extracted_folder, list_extracted_contents, format_file_size
+    from install_timeline import phase
 except ImportError:
     try:
-        from .download_manager import DownloadManager
-        from .utils import extract_file, ensure_extracted_folder, clean_extracted_folder, list_extracted_contents
+        from .download_manager import DownloadManager, BuildCache
+        from .utils import extract_file, ensure_extracted_folder, clean_extracted_folder, list_extracted_contents, format_file_size
+        from .install_timeline import phase
     except ImportError as e:
         print(f"Error importing utilities: {e}")
         print("Make sure utils.py and download_manager.py are in the same directory as this script.")
         sys.exit(1)
 
-def download():
-    """Download Lua and LuaRocks using the version-aware download manager."""
+def download(move_callback=None):
+    """Download Lua and LuaRocks using the version-aware download manager.
+
+    With move_callback, the archives are extracted while they download.
+    """
     # Check version compatibility first
     print("Checking version compatibility...")
     is_compatible, warnings = check_version_compatibility()
@@ -86,7 +91,9 @@ def download():
 
     # Validate URLs before proceeding
     print("Validating download URLs...")
-    all_valid, results = validate_current_configuration()
+    with phase("validate-urls") as counters:
+        all_valid, results = validate_current_configuration()
+        counters["urls"] = len(results)
 
     if not all_valid:
         print("\n[ERROR] Some download URLs are not accessible:")
@@ -121,7 +128,7 @@ def download():
 
     # Download using the download manager
     success, message = download_manager.download_version(
-        LUA_VERSION, LUAROCKS_VERSION, urls, filenames, LUAROCKS_PLATFORM
+        LUA_VERSION, LUAROCKS_VERSION, urls, filenames, LUAROCKS_PLATFORM, move_callback=move_callback
     )
 
     if success:
@@ -212,15 +219,20 @@ def main():
 
         elif sys.argv[1] in ['--cleanup', '--clean']:
             download_manager = DownloadManager()
+            build_cache = BuildCache()
             if len(sys.argv) > 2 and sys.argv[2] == '--all':
-                # Clean up all but the latest 1 version
+                # Clean up all but the latest 1 version and cached build
                 success, message = download_manager.cleanup_old_versions(keep_latest=1)
+                cache_success, cache_message = build_cache.cleanup_old_entries(keep_latest=1)
             else:
-                # Clean up old versions, keep latest 3
+                # Clean up old versions, keep latest 3; cached builds within their size limit
                 success, message = download_manager.cleanup_old_versions(keep_latest=3)
+                cache_success, cache_message = build_cache.cleanup_old_entries(
+                    keep_latest=build_cache.max_entries, max_size=build_cache.max_size)
 
             print(message)
-            sys.exit(0 if success else 1)
+            print(cache_message)
+            sys.exit(0 if success and cache_success else 1)
 
         elif sys.argv[1] in ['--registry-info', '--info']:
             download_manager = DownloadManager()
@@ -236,6 +248,15 @@ def main():
             print(f"Lua versions stored: {info['lua_versions']}")
             print(f"LuaRocks versions stored: {info['luarocks_versions']}")
             print(f"Total storage used: {info['formatted_size']}")
+
+            cache_info = BuildCache().get_cache_info()
+            print()
+            print("Build Cache Information:")
+            print("=" * 40)
+            print(f"Cache directory: {cache_info['base_dir']}")
+            print(f"Cached builds: {cache_info['entry_count']} (keeps {cache_info['max_entries']})")
+            print(f"Total storage used: {cache_info['formatted_size']} "
+                  f"(limit {format_file_size(cache_info['max_size'])})")
             sys.exit(0)
 
         elif sys.argv[1] in ['--list-extracted', '--list-ext']:
@@ -286,9 +307,9 @@ def main():
             print("  python download_lua_luarocks.py               # Download and extract files")
             print("  python download_lua_luarocks.py --config      # Show current configuration")
             print("  python download_lua_luarocks.py --list        # List downloaded versions")
-            print("  python download_lua_luarocks.py --cleanup     # Clean up old downloads (keep 3)")
-            print("  python download_lua_luarocks.py --cleanup --all  # Clean up all but latest")
-            print("  python download_lua_luarocks.py --info        # Show registry information")
+            print("  python download_lua_luarocks.py --cleanup     # Clean up old downloads (keep 3) and cached builds")
+            print("  python download_lua_luarocks.py --cleanup --all  # Clean up all but the latest download and build")
+            print("  python download_lua_luarocks.py --info        # Show registry and build cache information")
             print("  python download_lua_luarocks.py --help        # Show this help")
             print()
             print("Extraction Management:")
@@ -311,11 +332,11 @@ def main():
             print("  - Extracts to 'extracted' folder for build isolation")
             sys.exit(0)
 
-    # Normal download and extract process
-    download_manager = download()
+    # Normal download and extract process: new archives are extracted as they stream in
     callback = create_extraction_callback()
+    download_manager = download(callback)
 
-    # Extract the downloaded files
+    # Extract the archives that were already downloaded
     success, message = download_manager.extract_version(
         LUA_VERSION, LUAROCKS_VERSION, move_callback=callback, platform=LUAROCKS_PLATFORM
     )
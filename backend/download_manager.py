@@ -7,8 +7,15 @@ This module manages downloads by version, avoiding re-downloads and maintaining
 a registry of available versions.
 """
 
+import contextlib
+import hashlib
 import json
+import os
+import shutil
+import subprocess
 import sys
+import threading
+from concurrent.futures import ThreadPoolExecutor
 from datetime import datetime
 from pathlib import Path
 from typing import Dict, List, Optional, Tuple
@@ -19,16 +26,26 @@ sys.path.insert(0, str(current_dir))
 
 # Import utilities with dual-context support
 try:
-    from .utils import download_file, extract_file, verify_file_exists, get_file_size, format_file_size
+    from .utils import download_file, download_and_extract, extract_file, verify_file_exists, get_file_size, format_file_size, sha256_file
+    from .install_timeline import phase
+    from .registry_store import exclusive_lock
 except ImportError:
-    from utils import download_file, extract_file, verify_file_exists, get_file_size, format_file_size
+    from utils import download_file, download_and_extract, extract_file, verify_file_exists, get_file_size, format_file_size, sha256_file
+    from install_timeline import phase
+    from registry_store import exclusive_lock
+
+# Files fetched at the same time by download_version (lua, lua_tests and luarocks)
+MAX_PARALLEL_DOWNLOADS = 3
 
 
 class DownloadManager:
     """Manages version-aware downloads with caching and registry."""
 
-    def __init__(self, base_downloads_dir="downloads"):
+    def __init__(self, base_downloads_dir="downloads", max_parallel_downloads: int = MAX_PARALLEL_DOWNLOADS):
         self.base_dir = Path(base_downloads_dir)
+        self.max_parallel_downloads = max_parallel_downloads
+        # Archives extracted while they downloaded: {archive path: extract_to}
+        self.extracted = {}
         self.lua_dir = self.base_dir / "lua"
         self.luarocks_dir = self.base_dir / "luarocks"
         self.registry_file = self.base_dir / "download_registry.json"
@@ -71,6 +88,23 @@ class DownloadManager:
         """Get the registry key for a version combination."""
         return f"lua-{lua_version}_luarocks-{luarocks_version}"
 
+    @staticmethod
+    def _file_matches(file_path: Path, file_info: Dict) -> bool:
+        """Check a downloaded file against its registry record.
+
+        Files recorded with a SHA-256 digest must still have it; older records only
+        require the file to exist and not be empty.
+        """
+        if not verify_file_exists(file_path):
+            return False
+        expected = file_info.get("sha256")
+        return not expected or sha256_file(file_path) == expected
+
+    @staticmethod
+    def _file_sha256(file_path: Path) -> Optional[str]:
+        """Digest of a downloaded file, or None if there is no such file."""
+        return sha256_file(file_path) if verify_file_exists(file_path) else None
+
     def is_lua_downloaded(self, lua_version: str) -> bool:
         """Check if a Lua version is already downloaded."""
         if lua_version not in self.registry["lua_downloads"]:
@@ -79,10 +113,10 @@ class DownloadManager:
         lua_info = self.registry["lua_downloads"][lua_version]
         lua_dir = self.get_lua_dir(lua_version)
 
-        # Check if all Lua files exist and are not empty
+        # Check if all Lua files exist and still have the recorded digest
         for file_type, file_info in lua_info.get("files", {}).items():
             file_path = lua_dir / file_info["filename"]
-            if not verify_file_exists(file_path):
+            if not self._file_matches(file_path, file_info):
                 return False
 
         return True
@@ -96,10 +130,10 @@ class DownloadManager:
         luarocks_info = self.registry["luarocks_downloads"][luarocks_key]
         luarocks_dir = self.get_luarocks_dir(luarocks_version, platform)
 
-        # Check if LuaRocks file exists and is not empty
+        # Check if LuaRocks file exists and still has the recorded digest
         for file_type, file_info in luarocks_info.get("files", {}).items():
             file_path = luarocks_dir / file_info["filename"]
-            if not verify_file_exists(file_path):
+            if not self._file_matches(file_path, file_info):
                 return False
 
         return True
@@ -111,16 +145,26 @@ class DownloadManager:
 
     def download_version(self, lua_version: str, luarocks_version: str,
                         urls: Dict[str, str], filenames: Dict[str, str],
-                        platform: str = "windows-64") -> Tuple[bool, str]:
+                        platform: str = "windows-64", extract_to: Optional[Path] = None,
+                        move_callback=None) -> Tuple[bool, str]:
         """
         Download a specific version combination.
 
+        Missing files are fetched concurrently (up to max_parallel_downloads at a time).
+        Each file gets its SHA-256 digest recorded; a file that is downloaded again must
+        come back with the digest on record, and files that still match it are kept.
+
+        With move_callback, downloaded archives are also extracted as they stream in
+        (see utils.download_and_extract); extract_version then skips them.
+
         Args:
             lua_version: Lua version to download
             luarocks_version: LuaRocks version to download
             urls: Dictionary of URLs {type: url}
             filenames: Dictionary of filenames {type: filename}
             platform: Platform string for LuaRocks
+            extract_to: Directory to extract to (defaults to parent of downloads)
+            move_callback: Callback for placing extracted files; enables extraction
 
         Returns:
             Tuple of (success, message)
@@ -145,10 +189,14 @@ class DownloadManager:
             return True, f"Version {version_key} already downloaded"
 
         try:
-            # Download Lua components if needed
+            # Collect the files to fetch: (group, file type, url, path, expected digest)
+            jobs = []
+            lua_info = luarocks_info = None
+
             if lua_needs_download:
                 lua_dir = self.get_lua_dir(lua_version)
                 lua_dir.mkdir(parents=True, exist_ok=True)
+                previous = self.registry["lua_downloads"].get(lua_version, {}).get("files", {})
 
                 lua_info = {
                     "lua_version": lua_version,
@@ -159,28 +207,20 @@ class DownloadManager:
                 print(f"Downloading Lua {lua_version} components...")
                 for file_type in ['lua', 'lua_tests']:
                     if file_type in urls and file_type in filenames:
-                        filename = filenames[file_type]
-                        file_path = lua_dir / filename
-
-                        print(f"  Downloading {file_type}: {filename}")
-                        download_file(urls[file_type], str(file_path))
-
-                        lua_info["files"][file_type] = {
-                            "filename": filename,
-                            "url": urls[file_type],
-                            "size": get_file_size(file_path),
-                            "downloaded": datetime.now().isoformat()
-                        }
-
-                # Update registry
-                self.registry["lua_downloads"][lua_version] = lua_info
+                        file_path = lua_dir / filenames[file_type]
+                        file_info = previous.get(file_type, {})
+                        if (file_info.get("sha256") and file_info.get("filename") == file_path.name
+                                and self._file_matches(file_path, file_info)):
+                            lua_info["files"][file_type] = file_info
+                            continue
+                        jobs.append((lua_info, file_type, urls[file_type], file_path, file_info.get("sha256")))
             else:
                 print(f"[OK] Lua {lua_version} already downloaded, skipping...")
 
-            # Download LuaRocks if needed
             if luarocks_needs_download:
                 luarocks_dir = self.get_luarocks_dir(luarocks_version, platform)
                 luarocks_dir.mkdir(parents=True, exist_ok=True)
+                previous = self.registry["luarocks_downloads"].get(luarocks_key, {}).get("files", {})
 
                 luarocks_info = {
                     "luarocks_version": luarocks_version,
@@ -191,23 +231,49 @@ class DownloadManager:
 
                 print(f"Downloading LuaRocks {luarocks_version}-{platform}...")
                 if 'luarocks' in urls and 'luarocks' in filenames:
-                    filename = filenames['luarocks']
-                    file_path = luarocks_dir / filename
-
-                    print(f"  Downloading luarocks: {filename}")
-                    download_file(urls['luarocks'], str(file_path))
+                    jobs.append((luarocks_info, 'luarocks', urls['luarocks'], luarocks_dir / filenames['luarocks'],
+                                 previous.get('luarocks', {}).get("sha256")))
+            else:
+                print(f"[OK] LuaRocks {luarocks_version}-{platform} already downloaded, skipping...")
 
-                    luarocks_info["files"]['luarocks'] = {
-                        "filename": filename,
-                        "url": urls['luarocks'],
-                        "size": get_file_size(file_path),
-                        "downloaded": datetime.now().isoformat()
-                    }
+            # Fetch all files at once; the first failure is raised once the others are done,
+            # so their partial files are left complete or resumable
+            target = Path(extract_to) if extract_to is not None else self.base_dir.parent
+            # Timed as one phase; with move_callback it includes the extraction
+            with phase("fetch", files=len(jobs), extracted=bool(move_callback)) as counters, \
+                    ThreadPoolExecutor(max_workers=max(1, self.max_parallel_downloads)) as pool:
+                futures = []
+                for info, file_type, url, file_path, expected in jobs:
+                    print(f"  Downloading {file_type}: {file_path.name}")
+                    if move_callback:
+                        futures.append(pool.submit(download_and_extract, url, str(file_path), target,
+                                                   move_callback, expected_sha256=expected))
+                    else:
+                        futures.append(pool.submit(download_file, url, str(file_path), expected_sha256=expected))
+                for future in futures:
+                    future.exception()
+                for future in futures:
+                    future.result()
+                counters["bytes"] = sum(get_file_size(file_path) for _, _, _, file_path, _ in jobs)
+
+            if move_callback:
+                for info, file_type, url, file_path, expected in jobs:
+                    self.extracted[str(file_path)] = target
+
+            for info, file_type, url, file_path, expected in jobs:
+                info["files"][file_type] = {
+                    "filename": file_path.name,
+                    "url": url,
+                    "size": get_file_size(file_path),
+                    "sha256": self._file_sha256(file_path),
+                    "downloaded": datetime.now().isoformat()
+                }
 
-                # Update registry
+            # Update registry
+            if lua_info is not None:
+                self.registry["lua_downloads"][lua_version] = lua_info
+            if luarocks_info is not None:
                 self.registry["luarocks_downloads"][luarocks_key] = luarocks_info
-            else:
-                print(f"[OK] LuaRocks {luarocks_version}-{platform} already downloaded, skipping...")
 
             # Register the combination
             self.registry["combinations"][version_key] = {
@@ -229,6 +295,8 @@ class DownloadManager:
         """
         Extract a downloaded version.
 
+        Archives that download_version already extracted to the same place are skipped.
+
         Args:
             lua_version: Lua version
             luarocks_version: LuaRocks version
@@ -249,26 +317,33 @@ class DownloadManager:
             extract_to = self.base_dir.parent
 
         try:
-            # Extract Lua components
-            if lua_version in self.registry["lua_downloads"]:
-                lua_info = self.registry["lua_downloads"][lua_version]
-                lua_dir = self.get_lua_dir(lua_version)
-
-                for file_type, file_info in lua_info["files"].items():
-                    file_path = lua_dir / file_info["filename"]
-                    print(f"Extracting Lua {file_type}: {file_info['filename']}")
-                    extract_file(file_path, extract_to, move_callback)
-
-            # Extract LuaRocks
-            luarocks_key = f"{luarocks_version}-{platform}"
-            if luarocks_key in self.registry["luarocks_downloads"]:
-                luarocks_info = self.registry["luarocks_downloads"][luarocks_key]
-                luarocks_dir = self.get_luarocks_dir(luarocks_version, platform)
-
-                for file_type, file_info in luarocks_info["files"].items():
-                    file_path = luarocks_dir / file_info["filename"]
-                    print(f"Extracting LuaRocks {file_type}: {file_info['filename']}")
-                    extract_file(file_path, extract_to, move_callback)
+            with phase("extract", files=0) as counters:
+                # Extract Lua components
+                if lua_version in self.registry["lua_downloads"]:
+                    lua_info = self.registry["lua_downloads"][lua_version]
+                    lua_dir = self.get_lua_dir(lua_version)
+
+                    for file_type, file_info in lua_info["files"].items():
+                        file_path = lua_dir / file_info["filename"]
+                        if self.extracted.get(str(file_path)) == Path(extract_to):
+                            continue
+                        print(f"Extracting Lua {file_type}: {file_info['filename']}")
+                        extract_file(file_path, extract_to, move_callback)
+                        counters["files"] += 1
+
+                # Extract LuaRocks
+                luarocks_key = f"{luarocks_version}-{platform}"
+                if luarocks_key in self.registry["luarocks_downloads"]:
+                    luarocks_info = self.registry["luarocks_downloads"][luarocks_key]
+                    luarocks_dir = self.get_luarocks_dir(luarocks_version, platform)
+
+                    for file_type, file_info in luarocks_info["files"].items():
+                        file_path = luarocks_dir / file_info["filename"]
+                        if self.extracted.get(str(file_path)) == Path(extract_to):
+                            continue
+                        print(f"Extracting LuaRocks {file_type}: {file_info['filename']}")
+                        extract_file(file_path, extract_to, move_callback)
+                        counters["files"] += 1
 
             return True, f"Successfully extracted {version_key}"
 
@@ -409,3 +484,242 @@ class DownloadManager:
             "lua_dir": str(self.lua_dir),
             "luarocks_dir": str(self.luarocks_dir)
         }
+
+
+# Total size of the cached builds kept by BuildCache (bytes)
+BUILD_CACHE_MAX_SIZE = 512 * 1024 * 1024
+
+
+class BuildCache:
+    """Content-addressed cache of built Lua installations shared across installations.
+
+    An entry holds what the build scripts install (bin, include, lib, doc) for one key.
+    The key hashes the extracted Lua sources together with the build scripts copied
+    next to them (which carry CFLAGS/LINKFLAGS), the build type and configuration, the
+    target architecture and the MSVC toolset (the ``cl`` banner, VCToolsVersion and the
+    Windows SDK). A matching install is restored by copying the entry instead of
+    compiling. Concurrent installs (e.g. a matrix build) update the cache registry
+    under build_registry.lock.
+    """
+
+    def __init__(self, base_cache_dir=None, max_entries: int = 10, max_size: int = BUILD_CACHE_MAX_SIZE):
+        self.base_dir = Path(base_cache_dir) if base_cache_dir else Path.home() / ".luaenv" / "cache" / "builds"
+        self.registry_file = self.base_dir / "build_registry.json"
+        self.lock_file = self.base_dir / "build_registry.lock"
+        self.max_entries = max_entries
+        self.max_size = max_size
+        self.registry = self._load_registry()
+
+    def _load_registry(self) -> Dict:
+        """Load the build cache registry from disk."""
+        if self.registry_file.exists():
+            try:
+                with open(self.registry_file, 'r') as f:
+                    return json.load(f)
+            except (json.JSONDecodeError, OSError):
+                pass
+
+        return {
+            "version": "1.0",
+            "created": datetime.now().isoformat(),
+            "entries": {}
+        }
+
+    def _save_registry(self):
+        """Save the build cache registry to disk."""
+        self.base_dir.mkdir(parents=True, exist_ok=True)
+        self.registry["last_updated"] = datetime.now().isoformat()
+
+        temp_file = self.registry_file.with_name(
+            f"{self.registry_file.name}.{os.getpid()}.{threading.get_ident()}.tmp")
+        with open(temp_file, 'w') as f:
+            json.dump(self.registry, f, indent=2)
+        os.replace(temp_file, self.registry_file)
+
+    @contextlib.contextmanager
+    def _updating_registry(self):
+        """Reload the cache registry under its lock and save it when the block completes."""
+        with exclusive_lock(self.lock_file, description="build cache lock"):
+            self.registry = self._load_registry()
+            yield self.registry
+            self._save_registry()
+
+    def get_entry_dir(self, key: str) -> Path:
+        """Get the directory holding the artefacts for a cache key."""
+        return self.base_dir / key
+
+    @staticmethod
+    def get_toolset_id() -> Optional[str]:
+        """Identify the active MSVC toolset, or None when cl.exe is not available."""
+        try:
+            # cl prints its version banner to stderr when run without arguments
+            result = subprocess.run(["cl"], capture_output=True, text=True, timeout=30)
+        except (OSError, subprocess.SubprocessError):
+            return None
+
+        banner = (result.stderr or result.stdout).strip().splitlines()
+        if not banner:
+            return None
+
+        return " ".join([
+            banner[0].strip(),
+            os.environ.get("VCToolsVersion", ""),
+            os.environ.get("WindowsSDKVersion", "").strip("\\")
+        ])
+
+    def compute_key(self, source_dir: Path, build_type: str, build_config: str,
+                    architecture: str, toolset_id: str) -> str:
+        """Compute the cache key for building the sources in source_dir.
+
+        Only the top-level files of source_dir are hashed: the Lua sources and headers
+        and the build scripts. Object directories (Release, Debug) are ignored.
+        """
+        digest = hashlib.sha256()
+        for name in (build_type, build_config, architecture, toolset_id):
+            digest.update(name.encode("utf-8") + b"\0")
+
+        for file_path in sorted(Path(source_dir).iterdir()):
+            if not file_path.is_file():
+                continue
+            digest.update(file_path.name.encode("utf-8") + b"\0")
+            with open(file_path, 'rb') as f:
+                for chunk in iter(lambda: f.read(1024 * 1024), b""):
+                    digest.update(chunk)
+            digest.update(b"\0")
+
+        return digest.hexdigest()
+
+    def lookup(self, key: str) -> Optional[Path]:
+        """Return the entry directory for key if it is cached and complete."""
+        entry_dir = self.get_entry_dir(key)
+        if key not in self.registry["entries"] or not (entry_dir / "bin" / "lua.exe").exists():
+            return None
+        return entry_dir
+
+    def restore(self, key: str, install_dir: Path) -> bool:
+        """Populate install_dir from the cache entry for key.
+
+        Files are copied: a hardlink would let an in-place write to an installed
+        file (LuaRocks, a user edit) change the entry and every other installation
+        restored from it. The copy runs under the registry lock, so the entry
+        cannot be replaced or evicted halfway. Returns False on a cache miss.
+        """
+        install_dir = Path(install_dir)
+        with self._updating_registry() as registry:
+            entry_dir = self.lookup(key)
+            if entry_dir is None:
+                return False
+
+            for source in entry_dir.rglob("*"):
+                target = install_dir / source.relative_to(entry_dir)
+                if source.is_dir():
+                    target.mkdir(parents=True, exist_ok=True)
+                    continue
+                target.parent.mkdir(parents=True, exist_ok=True)
+                if target.exists():
+                    target.unlink()
+                shutil.copy2(source, target)
+
+            registry["entries"][key]["last_used"] = datetime.now().isoformat()
+        return True
+
+    def store(self, key: str, install_dir: Path, metadata: Dict) -> bool:
+        """Add the Lua part of a fresh installation to the cache under key.
+
+        The entry is staged next to its final location and renamed into place under
+        the registry lock, so a restore never sees a partial entry. A complete entry
+        that a concurrent install stored first is kept.
+        """
+        install_dir = Path(install_dir)
+        entry_dir = self.get_entry_dir(key)
+        staging_dir = self.base_dir / f"{key}.{os.getpid()}.{threading.get_ident()}.tmp"
+
+        try:
+            shutil.rmtree(staging_dir, ignore_errors=True)
+            staging_dir.mkdir(parents=True)
+            size = 0
+            for name in ("bin", "include", "lib", "doc"):
+                if (install_dir / name).is_dir():
+                    shutil.copytree(install_dir / name, staging_dir / name)
+            for file_path in staging_dir.rglob("*"):
+                if file_path.is_file():
+                    size += file_path.stat().st_size
+
+            now = datetime.now().isoformat()
+            with self._updating_registry() as registry:
+                if self.lookup(key) is None:
+                    self._remove_entry_dir(key)
+                    os.replace(staging_dir, entry_dir)
+                    registry["entries"][key] = dict(metadata, created=now, last_used=now, size=size)
+                self._evict(self.max_entries, self.max_size)
+        except OSError as e:
+            print(f"[WARNING] Could not add build to cache: {e}")
+            return False
+        finally:
+            shutil.rmtree(staging_dir, ignore_errors=True)
+        return True
+
+    def cleanup_old_entries(self, keep_latest: int = 10, max_size: Optional[int] = None) -> Tuple[bool, str]:
+        """Remove the least recently used cache entries, keeping only the latest N.
+
+        With max_size, further entries are removed until the cache fits in that many bytes.
+        """
+        with self._updating_registry():
+            removed = self._evict(keep_latest, max_size)
+        if not removed:
+            return True, "No build cache cleanup needed"
+        return True, f"Removed {removed} cached builds"
+
+    def _evict(self, keep_latest: int, max_size: Optional[int] = None) -> int:
+        """Drop all but the keep_latest most recently used entries (registry lock held).
+
+        With max_size, older entries are also dropped until the rest fit in max_size bytes.
+        """
+        entries = sorted(
+            self.registry["entries"].items(),
+            key=lambda x: x[1]["last_used"],
+            reverse=True
+        )
+        kept = entries[:keep_latest]
+        if max_size is not None:
+            total = 0
+            for count, (_, entry) in enumerate(kept):
+                total += entry.get("size", 0)
+                # The most recent entry is always kept
+                if total > max_size and count:
+                    kept = kept[:count]
+                    break
+        to_remove = entries[len(kept):]
+        for key, _ in to_remove:
+            self._remove_entry_dir(key)
+            del self.registry["entries"][key]
+        return len(to_remove)
+
+    def _remove_entry_dir(self, key: str) -> None:
+        """Delete the directory of an entry (registry lock held).
+
+        It is renamed aside first, so an interrupted delete never leaves a partial
+        entry under the key.
+        """
+        entry_dir = self.get_entry_dir(key)
+        if not entry_dir.exists():
+            return
+        trash_dir = self.base_dir / f"{key}.{os.getpid()}.{threading.get_ident()}.old"
+        try:
+            os.replace(entry_dir, trash_dir)
+        except OSError:
+            trash_dir = entry_dir
+        shutil.rmtree(trash_dir, ignore_errors=True)
+
+    def get_cache_info(self) -> Dict:
+        """Get information about the build cache."""
+        total_size = sum(entry.get("size", 0) for entry in self.registry["entries"].values())
+        return {
+            "entry_count": len(self.registry["entries"]),
+            "total_size": total_size,
+            "formatted_size": format_file_size(total_size),
+            "max_entries": self.max_entries,
+            "max_size": self.max_size,
+            "registry_file": str(self.registry_file),
+            "base_dir": str(self.base_dir)
+        }
@@ -0,0 +1,170 @@
+# This is free and unencumbered software released into the public domain.
+# For more details, see the LICENSE file in the project root.
+"""
+Per-phase timeline of an installation.
+
+setup_lua.py points LUAENV_TIMELINE at a file in the workspace of an install
+job. Every step of the job, including the ones that run as child processes
+(download_lua_luarocks.py, DownloadManager, build.py), appends the phases it
+times to that file as JSON lines:
+
+    {"name": "compile", "start": 81234.512, "duration": 14.203, "status": "ok", "files": 33}
+
+Start times come from time.monotonic(), a clock shared by all processes of
+the machine, so phases of different processes can be put on one timeline.
+Counters such as bytes (transferred) and files (compiled, extracted, tested)
+are stored as extra fields. When the job ends, load_timeline() turns the file
+into the record kept with the installation (see registry.record_install_timeline).
+
+Phases nest by time: a phase that lies within another one ran as part of it,
+e.g. "compile" within "build". Recording never fails the install.
+"""
+
+import contextlib
+import json
+import os
+import time
+from datetime import datetime, timezone
+from pathlib import Path
+from typing import Dict, List, Optional
+
+TIMELINE_ENV = "LUAENV_TIMELINE"
+
+# Set by the CLI to the Unix time in milliseconds at which it started the install
+STARTED_ENV = "LUAENV_INSTALL_STARTED"
+
+
+def record_phase(name: str, start: float, duration: float, status: str = "ok", **counters) -> None:
+    """Append one phase to the LUAENV_TIMELINE file, if there is one."""
+    timeline_path = os.environ.get(TIMELINE_ENV)
+    if not timeline_path:
+        return
+
+    entry = {"name": name, "start": round(start, 3), "duration": round(max(duration, 0.0), 3),
+             "status": status}
+    entry.update((key, value) for key, value in counters.items() if value is not None)
+    try:
+        # A single write per line keeps concurrent writers from interleaving
+        with open(timeline_path, "a", encoding="utf-8") as timeline_file:
+            timeline_file.write(json.dumps(entry, separators=(",", ":")) + "\n")
+    except OSError:
+        pass
+
+
+@contextlib.contextmanager
+def phase(name: str, **counters):
+    """Record the enclosed block as a phase.
+
+    Yields a dict of counters that the block can fill in (bytes, files, ...).
+    The phase is recorded as "failed" when the block raises.
+    """
+    values = dict(counters)
+    start = time.monotonic()
+    status = "ok"
+    try:
+        yield values
+    except BaseException:
+        status = "failed"
+        raise
+    finally:
+        record_phase(name, start, time.monotonic() - start, status, **values)
+
+
+def record_launch(origin: float) -> None:
+    """Record the time between the CLI starting the install and origin as the "launch" phase."""
+    started_ms = os.environ.get(STARTED_ENV)
+    if not started_ms:
+        return
+    try:
+        launch = time.time() - (time.monotonic() - origin) - int(started_ms) / 1000
+    except ValueError:
+        return
+    # Clocks of different processes can disagree slightly; a launch never takes minutes
+    if 0 <= launch < 60:
+        record_phase("launch", origin - launch, launch)
+
+
+def load_timeline(path: Path, origin: float, status: str) -> Optional[Dict]:
+    """Read a LUAENV_TIMELINE file into the record stored with an installation.
+
+    Args:
+        path: The timeline file
+        origin: time.monotonic() when the install started; phase starts are made
+            relative to it, or to the launch by the CLI when that came earlier
+        status: Outcome of the install ("active", "broken", ...)
+
+    Returns:
+        Dict with 'recorded', 'status', 'total' (seconds) and 'phases' sorted by
+        start, or None when nothing was recorded
+    """
+    phases: List[Dict] = []
+    try:
+        with open(path, "r", encoding="utf-8") as timeline_file:
+            for line in timeline_file:
+                try:
+                    entry = json.loads(line)
+                except json.JSONDecodeError:
+                    continue
+                if isinstance(entry, dict) and "start" in entry and "duration" in entry:
+                    phases.append(entry)
+    except OSError:
+        return None
+    if not phases:
+        return None
+
+    # Outer phases first when two start together
+    phases.sort(key=lambda entry: (entry["start"], -entry["duration"]))
+    origin = min(origin, phases[0]["start"])
+    for entry in phases:
+        entry["start"] = max(0.0, round(entry["start"] - origin, 3))
+    end = max(entry["start"] + entry["duration"] for entry in phases)
+    return {
+        "recorded": datetime.now(timezone.utc).isoformat(),
+        "status": status,
+        "total": round(end, 3),
+        "phases": phases,
+    }
+
+
+def _phase_depths(phases: List[Dict]) -> List[int]:
+    """Nesting depth of each phase (phases sorted by start)."""
+    depths = []
+    open_ends: List[float] = []
+    for entry in phases:
+        end = entry["start"] + entry["duration"]
+        # Starts and durations are rounded to milliseconds, and a child phase may
+        # end a few milliseconds after its parent was timed
+        while open_ends and entry["start"] >= open_ends[-1] - 0.005:
+            open_ends.pop()
+        while open_ends and end > open_ends[-1] + 0.05:
+            open_ends.pop()
+        depths.append(len(open_ends))
+        open_ends.append(end)
+    return depths
+
+
+def slowest_phase(timeline: Dict) -> Dict:
+    """The longest phase that is not part of another one."""
+    top = [entry for entry, depth in zip(timeline["phases"], _phase_depths(timeline["phases"])) if depth == 0]
+    return max(top, key=lambda entry: entry["duration"])
+
+
+def format_timeline(timeline: Dict) -> List[str]:
+    """Lines of a timeline table: start, duration, share of the total and counters per phase."""
+    total = timeline["total"] or 1.0
+    lines = [f"  {'phase':<24} {'start':>8} {'seconds':>9} {'share':>6}  details"]
+    for entry, depth in zip(timeline["phases"], _phase_depths(timeline["phases"])):
+        details = []
+        if entry.get("bytes") is not None:
+            details.append(f"{entry['bytes'] / (1024 * 1024):.1f} MB")
+        if entry.get("files") is not None:
+            details.append(f"{entry['files']} file(s)")
+        for key in sorted(set(entry) - {"name", "start", "duration", "status", "bytes", "files"}):
+            details.append(f"{key}={entry[key]}")
+        if entry["status"] != "ok":
+            details.append(entry["status"].upper())
+        name = "  " * depth + entry["name"]
+        lines.append(f"  {name:<24} {entry['start']:>8.2f} {entry['duration']:>9.2f}"
+                     f" {entry['duration'] / total:>6.0%}  {', '.join(details)}".rstrip())
+    lines.append(f"  {'total':<24} {'':>8} {timeline['total']:>9.2f}")
+    return lines
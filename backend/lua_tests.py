@@ -0,0 +1,147 @@
+# This is free and unencumbered software released into the public domain.
+# For more details, see the LICENSE file in the project root.
+"""
+Sharded runner of the official Lua test suite.
+
+Instead of running all.lua in one process, each test file that all.lua runs is
+started as its own lua.exe process, in a private copy of the tests directory (the
+tests write scratch files next to themselves), with several files running at
+once. The globals all.lua sets for them (_U, _soft, _port, _nomsg) are passed
+with -e.
+
+Failures of files in FLAKY_ON_WINDOWS are reported but do not fail the run. The
+"smoke" suite is a short subset of fast, platform-independent files for CI images.
+"""
+
+import os
+import re
+import shutil
+import subprocess
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+from typing import Dict, Iterable, List, Optional
+
+# Globals that all.lua defines for the test files in user mode (_U=true)
+PRELUDE = "_U=true; _soft=true; _port=true; _nomsg=true"
+
+# Seconds one test file may run
+FILE_TIMEOUT = 300
+
+# Test files whose failures are common on Windows, with the reason
+FLAKY_ON_WINDOWS = {
+    "main.lua": "spawns lua.exe through cmd.exe, quoting and popen differ from POSIX shells",
+    "files.lua": "depends on the C runtime's handling of os.date, tmpfile and popen",
+    "cstack.lua": "C stack limits are lower in x86 and debug builds",
+    "errors.lua": "messages of deep recursion depend on the stack size",
+}
+
+# Fast subset of the suite that exercises the core language and libraries
+SMOKE_TESTS = (
+    "calls.lua", "strings.lua", "literals.lua", "tpack.lua", "constructs.lua",
+    "nextvar.lua", "pm.lua", "utf8.lua", "events.lua", "vararg.lua",
+    "closure.lua", "goto.lua", "math.lua", "bitwise.lua",
+)
+
+SUITES = ("full", "smoke")
+
+_DOFILE = re.compile(r"""\b(?:old)?dofile\s*\(?\s*['"]([\w-]+\.lua)['"]""")
+
+
+def discover_test_files(tests_dir) -> List[str]:
+    """Test files all.lua runs, in its order (empty when all.lua is missing)."""
+    try:
+        source = (Path(tests_dir) / "all.lua").read_text(encoding="utf-8", errors="replace")
+    except OSError:
+        return []
+    files = []
+    for name in _DOFILE.findall(source):
+        if name not in files and (Path(tests_dir) / name).exists():
+            files.append(name)
+    return files
+
+
+def select_tests(files: Iterable[str], suite: str = "full") -> List[str]:
+    """The files of a suite ("full" or "smoke") among the discovered ones."""
+    files = list(files)
+    if suite == "smoke":
+        return [name for name in files if name in SMOKE_TESTS]
+    return files
+
+
+def default_jobs() -> int:
+    return max(1, os.cpu_count() or 1)
+
+
+def run_test_file(lua_exe, tests_dir, name: str, scratch_root, timeout: float = FILE_TIMEOUT) -> Dict:
+    """Run one test file in its own copy of the tests directory.
+
+    Returns:
+        Dict with name, status ("passed", "failed" or "timeout"), seconds and output
+    """
+    scratch = Path(scratch_root) / Path(name).stem
+    shutil.copytree(tests_dir, scratch)
+    started = time.monotonic()
+    try:
+        result = subprocess.run([str(lua_exe), "-e", PRELUDE, name], cwd=str(scratch),
+                                capture_output=True, text=True, errors="replace",
+                                timeout=timeout, stdin=subprocess.DEVNULL)
+        status = "passed" if result.returncode == 0 else "failed"
+        output = (result.stdout or "") + (result.stderr or "")
+    except subprocess.TimeoutExpired as e:
+        status = "timeout"
+        output = e.stdout.decode(errors="replace") if isinstance(e.stdout, bytes) else (e.stdout or "")
+    finally:
+        shutil.rmtree(scratch, ignore_errors=True)
+    return {"name": name, "status": status, "seconds": time.monotonic() - started, "output": output}
+
+
+def run_suite(lua_exe, tests_dir, files: Iterable[str], jobs: Optional[int] = None,
+              flaky: Optional[Dict[str, str]] = None, timeout: float = FILE_TIMEOUT) -> List[Dict]:
+    """Run test files concurrently, up to jobs at a time (results in the order of files).
+
+    Each result also has "flaky": the reason a failure of the file is tolerated, or None.
+    """
+    lua_exe = os.path.abspath(lua_exe)
+    flaky = FLAKY_ON_WINDOWS if flaky is None else flaky
+    files = list(files)
+    scratch_root = Path(tempfile.mkdtemp(prefix="luaenv-tests-"))
+    try:
+        with ThreadPoolExecutor(max_workers=jobs or default_jobs()) as executor:
+            results = list(executor.map(
+                lambda name: run_test_file(lua_exe, tests_dir, name, scratch_root, timeout), files))
+    finally:
+        shutil.rmtree(scratch_root, ignore_errors=True)
+    for result in results:
+        result["flaky"] = flaky.get(result["name"])
+    return results
+
+
+def print_report(results: List[Dict], tail_lines: int = 15) -> bool:
+    """Print per-file status and timing, and the output of failed files.
+
+    Returns:
+        True when every file passed or only flaky files failed
+    """
+    width = max((len(result["name"]) for result in results), default=0)
+    for result in results:
+        if result["status"] == "passed":
+            mark = "PASS"
+        else:
+            mark = "FLAKY" if result["flaky"] else result["status"].upper()
+        print(f"  [{mark:<7}] {result['name']:<{width}}  {result['seconds']:6.1f}s")
+
+    failed = [result for result in results if result["status"] != "passed"]
+    for result in failed:
+        header = f"{result['name']} ({result['status']}"
+        header += f", known flaky: {result['flaky']})" if result["flaky"] else ")"
+        print(f"\n  --- {header} ---")
+        for line in [line for line in result["output"].splitlines() if line.strip()][-tail_lines:]:
+            print(f"    {line}")
+
+    passed = sum(1 for result in results if result["status"] == "passed")
+    tolerated = sum(1 for result in failed if result["flaky"])
+    print(f"\n  {passed}/{len(results)} test files passed"
+          + (f", {tolerated} known flaky failures tolerated" if tolerated else ""))
+    return all(result["status"] == "passed" or result["flaky"] for result in results)
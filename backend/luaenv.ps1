@@ -123,6 +123,9 @@ function Invoke-ActivateCommand {
     $showEnv = $false
     $customTree = $null
     $customDevShell = $null
+    $lazyToolchain = $env:LUAENV_LAZY_TOOLCHAIN -eq "1"
+    $noBytecodeCache = $env:LUAENV_BYTECODE_CACHE -eq "0"
+    $noModuleIndex = $env:LUAENV_MODULE_INDEX -eq "0"
 
     # Handle null or empty arguments
     if (-not $Arguments) {
@@ -135,6 +138,12 @@ function Invoke-ActivateCommand {
             "-h" { Show-ActivateHelp; return }
             "--list" { $showList = $true }
             "--env" { $showEnv = $true }
+            "--lazy" { $lazyToolchain = $true }
+            "--eager" { $lazyToolchain = $false }
+            "--no-bytecode-cache" { $noBytecodeCache = $true }
+            "--bytecode-cache" { $noBytecodeCache = $false }
+            "--no-module-index" { $noModuleIndex = $true }
+            "--module-index" { $noModuleIndex = $false }
             "--tree" {
                 if ($i + 1 -lt $Arguments.Length) {
                     $customTree = $Arguments[++$i]
@@ -218,7 +227,7 @@ function Invoke-ActivateCommand {
         }
 
         # Initialize the environment
-        $success = Initialize-LuaEnvironment -Installation $installation -CustomTree $customTree -CustomDevShell $customDevShell
+        $success = Initialize-LuaEnvironment -Installation $installation -CustomTree $customTree -CustomDevShell $customDevShell -LazyToolchain:$lazyToolchain -NoBytecodeCache:$noBytecodeCache -NoModuleIndex:$noModuleIndex
 
         if (-not $success) {
             Write-Host "[ERROR] Failed to initialize Lua environment" -ForegroundColor Red
@@ -265,6 +274,11 @@ function Invoke-DeactivateCommand {
     }
 
     try {
+        # A toolchain deferred by 'activate --lazy' is no longer wanted
+        Remove-LuaEnvToolchainShims
+        Disable-LuaBytecodeCache
+        Disable-LuaModuleIndex
+
         # Restore original PATH
         if ($env:LUAENV_ORIGINAL_PATH) {
             $env:PATH = $env:LUAENV_ORIGINAL_PATH
@@ -408,6 +422,45 @@ function Invoke-LocalCommand {
     }
 }
 
+function Invoke-LuaEnvServer {
+    # Send a request to a running "luaenv server" (see cli\LuaEnv.Core\Server.fs).
+    # Returns @{ ExitCode; Output } or $null when the CLI has to be started instead.
+    param([string[]]$CliArgs)
+
+    $pipeName = "luaenv-cli-" + [Environment]::UserName.ToLowerInvariant()
+    $pipe = New-Object System.IO.Pipes.NamedPipeClientStream(".", $pipeName, [System.IO.Pipes.PipeDirection]::InOut)
+    try {
+        $pipe.Connect(50)
+        $pipe.ReadMode = [System.IO.Pipes.PipeTransmissionMode]::Message
+
+        $request = [System.Text.Encoding]::UTF8.GetBytes(($CliArgs -join "`n"))
+        $pipe.Write($request, 0, $request.Length)
+        $pipe.Flush()
+
+        $buffer = New-Object System.IO.MemoryStream
+        $chunk = New-Object byte[] 4096
+        do {
+            $count = $pipe.Read($chunk, 0, $chunk.Length)
+            $buffer.Write($chunk, 0, $count)
+        } while ($count -gt 0 -and -not $pipe.IsMessageComplete)
+        $reply = [System.Text.Encoding]::UTF8.GetString($buffer.ToArray())
+    } catch {
+        # No server running (or it went away): use the CLI
+        return $null
+    } finally {
+        $pipe.Dispose()
+    }
+
+    # Reply: "<exit code>`n<output>", or "-`n" for requests the server does not handle
+    $newline = $reply.IndexOf("`n")
+    $exitCode = 0
+    if ($newline -lt 0 -or -not [int]::TryParse($reply.Substring(0, $newline), [ref]$exitCode)) {
+        return $null
+    }
+
+    return @{ ExitCode = $exitCode; Output = $reply.Substring($newline + 1) }
+}
+
 function Invoke-LuaEnvCLI {
     # Get the CLI executable and configuration paths
     $BinDir = $ScriptRoot
@@ -432,6 +485,22 @@ function Invoke-LuaEnvCLI {
     }
     $allArgs += $Arguments
 
+    # pkg-config queries are answered by the resident server when one is running
+    if ($Command -eq "pkg-config") {
+        $reply = Invoke-LuaEnvServer -CliArgs $allArgs
+        if ($reply) {
+            $text = $reply.Output
+            if ($text.EndsWith("`n")) {
+                $text = $text.Substring(0, $text.Length - 1)
+            }
+            if ($text) {
+                $text -split "`r?`n"
+            }
+            $global:LASTEXITCODE = $reply.ExitCode
+            return
+        }
+    }
+
     # Execute CLI with backend configuration and forward all arguments
     try {
         & $CliExe --config $BackendConfig $allArgs
@@ -457,28 +526,30 @@ $luaenvCompleter = {
     $mainCommands = @(
         'activate', 'deactivate', 'current', 'local',
         'install', 'uninstall', 'list', 'status', 'versions',
-        'default', 'pkg-config', 'config', 'set-alias', 'remove-alias', 'help'
+        'default', 'pkg-config', 'config', 'set-alias', 'remove-alias', 'server', 'bench', 'help'
     )
 
     # Command-specific options
     $commandOptions = @{
-        'activate' = @('--id', '--alias', '--list', '--env', '--tree', '--devshell', '--help', '-h')
+        'activate' = @('--id', '--alias', '--list', '--env', '--tree', '--devshell', '--lazy', '--eager', '--bytecode-cache', '--no-bytecode-cache', '--module-index', '--no-module-index', '--help', '-h')
         'deactivate' = @('--help', '-h')
         'current' = @('--verbose', '-v', '--help', '-h')
         'local' = @('--unset', '-u', '--help', '-h')
         'install' = @('--lua-version', '--luarocks-version', '--alias', '--name',
-                      '--dll', '--debug', '--x86', '--x64', '--skip-env-check',
-                      '--skip-tests', '--help', '-h')
+                      '--dll', '--debug', '--optimize', '--x86', '--x64', '--skip-env-check',
+                      '--skip-tests', '--test-suite', '--test-jobs', '--matrix', '--arch', '--build-type', '--jobs', '--help', '-h')
         'uninstall' = @('--force', '--yes', '--help', '-h')
         'list' = @('--detailed', '--help', '-h')
-        'status' = @('--help', '-h')
+        'status' = @('--timings', '--json', '--help', '-h')
         'versions' = @('--available', '-a', '--online', '--refresh', '--help', '-h')
         'default' = @('--help', '-h')
         'pkg-config' = @('--cflag', '--lua-include', '--liblua', '--libdir',
-                         '--path', '--path-style', '--help', '-h')
+                         '--path', '--path-style', '--format', '--emit', '--help', '-h')
         'config' = @('--help', '-h')
         'set-alias' = @('--help', '-h')
         'remove-alias' = @('--help', '-h')
+        'server' = @('start', 'stop', 'status', 'run', '--idle-timeout', '--help', '-h')
+        'bench' = @('--runs', '--only', '--no-save', '--help', '-h')
         'help' = @()
     }
 
@@ -0,0 +1,163 @@
+-- luaenv_init.lua - faster require for activated environments (loaded via LUA_INIT_5_4)
+--
+-- `luaenv activate` prepares two files for the rock tree (see luaenv_core.psm1):
+--
+--   LUAENV_INDEX_FILE   module index (Update-LuaModuleIndex): module name -> file
+--                       for every Lua and C module under the absolute templates
+--                       of package.path and package.cpath
+--   LUAENV_BYTECODE_DIR bytecode cache (Update-LuaBytecodeCache): the .lua files
+--                       of the tree compiled by luac.exe, listed in manifest.lua
+--
+-- The index searcher answers `require` without probing the templates. Only the
+-- templates it cannot index (relative ones such as .\?.lua) are still checked,
+-- and only those that come before the indexed file, so the result is the one
+-- package.searchpath would give. Lua modules are loaded from the bytecode
+-- cache when their source still has the content it was compiled from (the
+-- cache keeps a copy of it next to the chunk; the size is checked first). Anything
+-- the index does not cover, or that fails to load, falls through to the
+-- standard searchers.
+--
+-- Set LUAENV_MODULE_INDEX=0 or LUAENV_BYTECODE_CACHE=0 to turn either off.
+
+local getenv, open, loadfile = os.getenv, io.open, loadfile
+
+local function exists(path)
+    local file = open(path, "rb")
+    if not file then
+        return false
+    end
+    file:close()
+    return true
+end
+
+-- Bytecode cache ---------------------------------------------------------------
+
+local cache_dir = getenv("LUAENV_BYTECODE_DIR")
+local chunks
+
+if cache_dir and getenv("LUAENV_BYTECODE_CACHE") ~= "0" then
+    local ok, manifest = pcall(dofile, cache_dir .. "\\manifest.lua")
+    if ok and type(manifest) == "table" and manifest.version == _VERSION and manifest.format == 2 then
+        chunks = manifest
+    end
+end
+
+-- Contents of a file, or nil
+local function read_all(path)
+    local file = open(path, "rb")
+    if not file then
+        return nil
+    end
+    local data = file:read("a")
+    file:close()
+    return data
+end
+
+-- Cached chunk of a source file, or nil
+local function cached_chunk(path)
+    local entry = chunks.modules[path:gsub("/", "\\"):lower()]
+    if not entry then
+        return nil
+    end
+    local file = open(path, "rb")
+    if not file then
+        return nil
+    end
+    -- Sizes tell most edits apart without reading the file
+    if file:seek("end") ~= entry.size then
+        file:close()
+        return nil
+    end
+    file:seek("set")
+    local source = file:read("a")
+    file:close()
+    local base = cache_dir .. "\\" .. entry.chunk:gsub("%.luac$", "")
+    if source ~= read_all(base .. ".lua") then
+        return nil
+    end
+    return loadfile(base .. ".luac", "b")
+end
+
+-- Module index -----------------------------------------------------------------
+
+local index_file = getenv("LUAENV_INDEX_FILE")
+local index
+
+if index_file and getenv("LUAENV_MODULE_INDEX") ~= "0" then
+    local ok, loaded = pcall(dofile, index_file)
+    if ok and type(loaded) == "table" and loaded.version == _VERSION then
+        index = loaded
+    end
+end
+
+-- True when a file reachable through a live template before pos exists
+local function shadowed(live, pos, name)
+    local file = name:gsub("%.", "\\"):gsub("%%", "%%%%")
+    for i = 1, #live do
+        local template = live[i]
+        if template[1] >= pos then
+            break
+        end
+        if exists((template[2]:gsub("%?", file))) then
+            return true
+        end
+    end
+    return false
+end
+
+local function index_searcher(name)
+    -- The index only describes the paths it was built for
+    if package.path ~= index.path or package.cpath ~= index.cpath then
+        return nil
+    end
+
+    local entry = index.lua[name]
+    if entry then
+        if shadowed(index.lua_live, entry[2], name) then
+            return nil
+        end
+        local chunk = chunks and cached_chunk(entry[1]) or loadfile(entry[1])
+        if not chunk then
+            return nil
+        end
+        return chunk, entry[1]
+    end
+
+    -- The Lua searcher runs first, so every live Lua template comes before a C module
+    entry = index.c[name]
+    if entry and not name:find("-", 1, true) then
+        if shadowed(index.lua_live, math.huge, name) or shadowed(index.c_live, entry[2], name) then
+            return nil
+        end
+        local loader = package.loadlib(entry[1], "luaopen_" .. name:gsub("%.", "_"))
+        if not loader then
+            return nil
+        end
+        return loader, entry[1]
+    end
+    return nil
+end
+
+-- Bytecode for modules found by the standard path search (index off or stale)
+local function bytecode_searcher(name)
+    if not chunks.names[name] then
+        return nil
+    end
+    -- Same resolution as the Lua searcher, so local files still shadow the tree
+    local path = package.searchpath(name, package.path)
+    if not path then
+        return nil
+    end
+    local chunk = cached_chunk(path)
+    if not chunk then
+        return nil
+    end
+    return chunk, path
+end
+
+if chunks then
+    table.insert(package.searchers, 2, bytecode_searcher)
+end
+if index then
+    table.insert(package.searchers, 2, index_searcher)
+end
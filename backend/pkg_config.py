@@ -18,8 +18,33 @@ Options:
     --libdir        Show lib directory path
     --path          Show installation paths
     --json          Output in JSON format
+    --format FMT    Print several fields at once as cmake, json or env (KEY=VALUE)
+    --emit [DIR]    Write static build-system files (see BUILD_FILES) to DIR
     --help          Show this help message
 
+Several query flags may be combined; their answers are printed in the order
+--cflag, --lua-include, --liblua, --libdir, --path.
+
+Worker mode:
+    python pkg_config.py --serve
+
+    Used by the resident LuaEnv.CLI server. Reads one JSON argument list per
+    line on stdin and answers each with one JSON line holding the exit code
+    and the captured output, reusing the loaded registry between requests.
+
+Static build files:
+    registry.py keeps LuaEnvConfig.cmake, luaenv.pc, luaenv-native.ini and
+    LuaEnv.props for every installation, alias and the default installation in
+    %USERPROFILE%\.luaenv\buildconfig\<uuid|alias|default>, rewriting them after
+    each registry change (only files whose text changed are written). Build
+    systems include one of them instead of running luaconfig at configure time.
+
+Native engine:
+    cli/LuaEnv.Core/PkgConfig.fs produces the same output inside the CLI without
+    starting Python and only falls back to this script for errors and unusual
+    paths. Any change to the output here must be mirrored there (set
+    LUAENV_PKGCONFIG_PYTHON=1 to force this script when comparing).
+
 Examples:
     python pkg_config.py dev                # Show all information
     python pkg_config.py dev --cflag        # Show compiler flag (/I"path")
@@ -29,14 +54,26 @@ Examples:
     python pkg_config.py 12345678 --path    # Show paths for partial UUID
     python pkg_config.py dev --json         # Output in JSON format
     python pkg_config.py dev --lua-include --path-style unix # Show include path with forward slashes
+    python pkg_config.py dev --lua-include --liblua --format cmake # CMake set() script
+    python pkg_config.py dev --emit build/lua   # Write the static build files to build/lua
 """
 
+import time
+
+# Start of module loading, for the "pkg_config.py import" trace span
+_IMPORT_START_US = time.time_ns() // 1000
+
 import argparse
+import contextlib
+import io
 import json
 import sys
 import os
+import shutil
+import threading
 from pathlib import Path
-from typing import Dict, List, Optional
+from typing import Dict, Iterable, List, Optional
+from xml.sax.saxutils import escape as _xml_escape
 
 # Ensure we can import from the current directory
 current_dir = os.path.dirname(os.path.abspath(__file__))
@@ -45,18 +82,78 @@ if current_dir not in sys.path:
 
 try:
     from registry import LuaEnvRegistry
-    from utils import print_error
+    from utils import print_error, trace_event, trace_now_us, trace_span
 except ImportError as e:
     print(f"[ERROR] Failed to import required modules: {e}")
     sys.exit(1)
 
 
+# Answer cache consumed by the native fast path in luaconfig.c.
+# Bump the version whenever the file layout below changes.
+ANSWER_CACHE_VERSION = "2"
+ANSWER_CACHE_MAGIC = f"LUAENV-PKGCONFIG {ANSWER_CACHE_VERSION}"
+
+# Installation fields the answers and build files are rendered from. Saves that
+# change other fields (status, benchmarks, timelines, ...) render nothing again.
+RENDERED_FIELDS = ("name", "alias", "lua_version", "luarocks_version", "build_type",
+                   "build_config", "architecture", "installation_path")
+
+
+def rendering_inputs(installation: Optional[Dict]) -> Optional[tuple]:
+    """What the rendered files of an installation depend on, None for no installation."""
+    if installation is None:
+        return None
+    # The headers and libraries the files point at appear when the build leaves "building"
+    return tuple(installation.get(field) for field in RENDERED_FIELDS) + \
+        (installation.get("status") == "building",)
+
+# Query name (as accepted on the command line, without the leading dashes)
+# mapped to the show_info() keyword that produces it
+CACHED_QUERIES = {
+    "cflag": "show_cflag",
+    "lua-include": "show_lua_include",
+    "liblua": "show_liblua",
+    "libdir": "show_libdir",
+    "path": "show_paths",
+}
+
+PATH_STYLES = ("native", "windows", "unix")
+
+# Output formats for multi-field queries (--format)
+OUTPUT_FORMATS = ("cmake", "json", "env")
+
+# Variables emitted by --format, grouped by the query flag that selects them.
+# Groups are always emitted in this order; "info" only when no flag is given.
+FORMAT_GROUPS = {
+    "info": ("LUA_VERSION", "LUA_BUILD_TYPE", "LUA_BUILD_CONFIG", "LUA_ARCHITECTURE"),
+    "cflag": ("LUA_CFLAGS",),
+    "lua-include": ("LUA_INCLUDE_DIR",),
+    "liblua": ("LUA_LIBRARY",),
+    "libdir": ("LUA_LIBRARY_DIR",),
+    "path": ("LUA_PREFIX", "LUA_BIN_DIR", "LUA_EXECUTABLE", "LUA_DLL"),
+}
+
+# Static build files written by --emit and kept current by registry.py:
+# file name -> LuaPkgConfig method that renders it
+BUILD_FILES = {
+    "LuaEnvConfig.cmake": "_render_cmake_config",  # find_package(LuaEnv CONFIG), LuaEnv::Lua target
+    "luaenv.pc": "_render_pc_file",                 # pkg-config --cflags --libs luaenv
+    "luaenv-native.ini": "_render_meson_native",    # meson setup --native-file
+    "LuaEnv.props": "_render_msbuild_props",        # <Import Project="..."/> in a .vcxproj
+}
+BUILD_FILES_HEADER = "LuaEnv build configuration of {name} ({id}); generated by luaenv, do not edit"
+
+
 class LuaPkgConfig:
     """Provides pkg-config style information for Lua installations."""
 
-    def __init__(self):
-        """Initialize pkg-config handler."""
-        self.registry = LuaEnvRegistry()
+    def __init__(self, registry: Optional[LuaEnvRegistry] = None):
+        """Initialize pkg-config handler.
+
+        Args:
+            registry: Registry to query, defaults to the user registry
+        """
+        self.registry = registry if registry is not None else LuaEnvRegistry()
 
     def _normalize_path(self, path: Optional[str], style: str) -> str:
         """Normalize path separators for the given style."""
@@ -106,7 +203,7 @@ class LuaPkgConfig:
             "lua_version": installation["lua_version"],
             "luarocks_version": installation["luarocks_version"],
             "build_type": installation["build_type"],  # "dll" or "static"
-            "build_config": installation["build_config"],  # "debug" or "release"
+            "build_config": installation["build_config"],  # "debug", "release" or "pgo"
             "architecture": installation["architecture"],  # "x86" or "x64"
             "installation_path": str(install_path),
             "paths": self._analyze_paths(install_path),
@@ -324,37 +421,388 @@ class LuaPkgConfig:
             print(json.dumps(json_info, indent=2))
             return True
 
-        # Show specific information if requested
-        if show_cflag:
+        # Show specific information if requested, in a fixed order
+        requested = [query for query, selected in (
+            ("cflag", show_cflag), ("lua-include", show_lua_include),
+            ("liblua", show_liblua), ("libdir", show_libdir), ("path", show_paths)
+        ) if selected]
+
+        if not requested:
+            # Show all information (default)
+            self._show_all_info(info, path_style)
+            return True
+
+        for query in requested:
+            if not self._show_query(info, query, path_style):
+                return False
+        return True
+
+    def _show_query(self, info: Dict, query: str, path_style: str) -> bool:
+        """Print the answer to a single query flag.
+
+        Args:
+            info: Installation info from get_installation_info()
+            query: One of the CACHED_QUERIES keys
+            path_style: Path style for output ('windows', 'unix', 'native')
+
+        Returns:
+            True if successful, False if error
+        """
+        if query == "cflag":
             include_dir = info["flags"].get("_include_dir")
             if include_dir:
                 print(f'/I"{self._normalize_path(include_dir, path_style)}"')
-            return True
-
-        if show_lua_include:
+        elif query == "lua-include":
             print(self._normalize_path(info["paths"]["include"], path_style))
-            return True
+        elif query == "liblua":
+            if not info["paths"]["lua_lib"]:
+                print_error("[ERROR] lua54.lib not found in installation")
+                return False
+            print(self._normalize_path(info["paths"]["lua_lib"], path_style))
+        elif query == "libdir":
+            print(self._normalize_path(info["paths"]["lib"], path_style))
+        elif query == "path":
+            self._show_paths(info, path_style)
+        return True
 
-        if show_liblua:
-            if info["paths"]["lua_lib"]:
-                print(self._normalize_path(info["paths"]["lua_lib"], path_style))
-            else:
+    def _collect_variables(self, info: Dict, path_style: str) -> Dict[str, Optional[str]]:
+        """Collect the build-system variables emitted by --format.
+
+        Args:
+            info: Installation info from get_installation_info()
+            path_style: Path style for output ('windows', 'unix', 'native')
+
+        Returns:
+            Variable name to value; None marks a required file that is missing
+        """
+        include_dir = info["flags"].get("_include_dir")
+        lua_lib = info["paths"]["lua_lib"]
+        return {
+            "LUA_VERSION": info["lua_version"],
+            "LUA_BUILD_TYPE": info["build_type"],
+            "LUA_BUILD_CONFIG": info["build_config"],
+            "LUA_ARCHITECTURE": info["architecture"],
+            "LUA_CFLAGS": f'/I"{self._normalize_path(include_dir, path_style)}"' if include_dir else "",
+            "LUA_INCLUDE_DIR": self._normalize_path(info["paths"]["include"], path_style),
+            "LUA_LIBRARY": self._normalize_path(lua_lib, path_style) if lua_lib else None,
+            "LUA_LIBRARY_DIR": self._normalize_path(info["paths"]["lib"], path_style),
+            "LUA_PREFIX": self._normalize_path(info["paths"]["prefix"], path_style),
+            "LUA_BIN_DIR": self._normalize_path(info["paths"]["bin"], path_style),
+            "LUA_EXECUTABLE": self._normalize_path(info["paths"]["lua_exe"], path_style),
+            "LUA_DLL": self._normalize_path(info["paths"]["lua_dll"], path_style),
+        }
+
+    def _render_group(self, variables: Dict[str, Optional[str]], group: str,
+                      output_format: str) -> Optional[str]:
+        """Render one FORMAT_GROUPS entry.
+
+        cmake and env groups are complete lines. json groups are object members
+        joined by ",\n", so groups can be concatenated the same way luaconfig
+        does it when answering from the cache.
+
+        Returns:
+            Rendered text, or None if the group has a missing required value
+        """
+        names = FORMAT_GROUPS[group]
+        if any(variables[name] is None for name in names):
+            return None
+
+        if output_format == "cmake":
+            return "".join(f'set({name} "{_cmake_escape(variables[name])}")\n' for name in names)
+        if output_format == "env":
+            return "".join(f"{name}={variables[name]}\n" for name in names)
+        return ",\n".join(f"  {json.dumps(name)}: {json.dumps(variables[name], ensure_ascii=False)}"
+                           for name in names)
+
+    def show_variables(self, id_or_alias: str, queries: List[str], output_format: str,
+                       path_style: str = 'native') -> bool:
+        """Print several fields at once in a build-system friendly format.
+
+        Args:
+            id_or_alias: Installation ID or alias
+            queries: CACHED_QUERIES keys to emit; empty emits every variable
+            output_format: 'cmake', 'json' or 'env'
+            path_style: Path style for output ('windows', 'unix', 'native')
+
+        Returns:
+            True if successful, False if error
+        """
+        info = self.get_installation_info(id_or_alias)
+        if not info:
+            print_error(f"Installation '{id_or_alias}' not found or invalid")
+            return False
+
+        variables = self._collect_variables(info, path_style)
+        groups = [group for group in FORMAT_GROUPS if group in queries or not queries]
+
+        rendered = []
+        for group in groups:
+            text = self._render_group(variables, group, output_format)
+            if text is None:
                 print_error("[ERROR] lua54.lib not found in installation")
                 return False
-            return True
+            rendered.append(text)
 
-        if show_libdir:
-            print(self._normalize_path(info["paths"]["lib"], path_style))
-            return True
+        if output_format == "json":
+            sys.stdout.write("{\n" + ",\n".join(rendered) + "\n}\n")
+        else:
+            sys.stdout.write("".join(rendered))
+        return True
 
-        if show_paths:
-            self._show_paths(info, path_style)
-            return True
+    def render_answer(self, id_or_alias: str, query: str, path_style: str) -> Optional[str]:
+        """Render the exact stdout of a single-flag query.
+
+        Args:
+            id_or_alias: Installation ID or alias
+            query: One of the CACHED_QUERIES keys
+            path_style: Path style for output ('windows', 'unix', 'native')
+
+        Returns:
+            The text show_info() would print, or None if the query fails
+        """
+        buffer = io.StringIO()
+        with contextlib.redirect_stdout(buffer), contextlib.redirect_stderr(io.StringIO()):
+            success = self.show_info(id_or_alias, path_style=path_style,
+                                     **{CACHED_QUERIES[query]: True})
+        return buffer.getvalue() if success else None
+
+    def write_answer_cache(self, cache_dir: Path, revision: int,
+                           installation_ids: Optional[Iterable[str]] = None,
+                           since_revision: Optional[int] = None) -> None:
+        """Precompute query answers for the installations of the registry.
+
+        Writes one <uuid>.answers file per installation plus an index that maps
+        aliases and full UUIDs to installation IDs. The index is written last and
+        records the registry revision the cache was built from; luaconfig only
+        trusts it while registry.revision holds the same number.
+        Queries that fail (e.g. missing lua54.lib) are left out so luaconfig
+        falls back to the CLI and reports the error itself.
+
+        Args:
+            cache_dir: Directory that holds the answer cache
+            revision: Registry revision the cache is built from
+            installation_ids: Installations to render again (added, changed or
+                removed); None renders every installation
+            since_revision: Revision the other answers are current for; they are
+                all rendered again unless the index was built from it
+        """
+        cache_dir.mkdir(parents=True, exist_ok=True)
+        installations = self.registry.registry["installations"]
+        index_path = cache_dir / "index"
+
+        answered = None if installation_ids is None else _read_cache_index(index_path, since_revision)
+        if answered is None:
+            installation_ids = list(installations)
+            answered = set()
+            # Drop answers for installations that no longer exist
+            for stale in cache_dir.glob("*.answers"):
+                if stale.stem not in installations:
+                    stale.unlink(missing_ok=True)
+
+        for installation_id in installation_ids:
+            answered.discard(installation_id)
+            if installation_id not in installations:
+                (cache_dir / f"{installation_id}.answers").unlink(missing_ok=True)
+                continue
+
+            records = []
+            for query in CACHED_QUERIES:
+                for style in PATH_STYLES:
+                    answer = self.render_answer(installation_id, query, style)
+                    if answer is not None:
+                        records.append(_cache_record(f"{query}.{style}", answer))
+
+            with contextlib.redirect_stdout(io.StringIO()):
+                info = self.get_installation_info(installation_id)
+            for style in PATH_STYLES if info else ():
+                variables = self._collect_variables(info, style)
+                for output_format in OUTPUT_FORMATS:
+                    for group in FORMAT_GROUPS:
+                        text = self._render_group(variables, group, output_format)
+                        if text is not None:
+                            records.append(_cache_record(f"{output_format}.{group}.{style}", text))
+
+            if not records:
+                (cache_dir / f"{installation_id}.answers").unlink(missing_ok=True)
+                continue
+
+            # luaconfig checks that prefix still exists before trusting the answers
+            prefix = installations[installation_id]["installation_path"]
+            header = f"{ANSWER_CACHE_MAGIC}\nid={installation_id}\nprefix={prefix}\n".encode("utf-8")
+            _write_atomic(cache_dir / f"{installation_id}.answers", header + b"".join(records))
+            answered.add(installation_id)
+
+        index_lines = [ANSWER_CACHE_MAGIC, f"revision {revision}"]
+        index_lines += [f"{installation_id}={installation_id}" for installation_id in sorted(answered)]
+        for alias, installation_id in self.registry.registry["aliases"].items():
+            if installation_id in answered:
+                index_lines.append(f"{alias}={installation_id}")
+
+        _write_atomic(index_path, ("\n".join(index_lines) + "\n").encode("utf-8"))
+
+    def _render_cmake_config(self, info: Dict) -> str:
+        """CMake package configuration with the LUA_* variables and a LuaEnv::Lua imported target."""
+        variables = self._collect_variables(info, "unix")
+        lines = [f"# {BUILD_FILES_HEADER.format(**info)}",
+                 "#   find_package(LuaEnv CONFIG REQUIRED PATHS <this directory>)",
+                 "#   target_link_libraries(app PRIVATE LuaEnv::Lua)", ""]
+        lines += [self._render_group(variables, group, "cmake").rstrip("\n") for group in FORMAT_GROUPS]
+        dll = info["build_type"] == "dll" and variables["LUA_DLL"]
+        lines += [
+            'set(LuaEnv_VERSION "${LUA_VERSION}")',
+            "",
+            "if(NOT TARGET LuaEnv::Lua)",
+            f"    add_library(LuaEnv::Lua {'SHARED' if dll else 'STATIC'} IMPORTED)",
+            "    set_target_properties(LuaEnv::Lua PROPERTIES",
+            '        INTERFACE_INCLUDE_DIRECTORIES "${LUA_INCLUDE_DIR}"',
+        ]
+        if dll:
+            lines += ['        IMPORTED_LOCATION "${LUA_DLL}"', '        IMPORTED_IMPLIB "${LUA_LIBRARY}")']
+        else:
+            lines += ['        IMPORTED_LOCATION "${LUA_LIBRARY}")']
+        lines += ["endif()", ""]
+        return "\n".join(lines)
+
+    def _render_pc_file(self, info: Dict) -> str:
+        """pkg-config metadata; paths are quoted because installations may live under spaces."""
+        variables = self._collect_variables(info, "unix")
+        return "\n".join([
+            f"# {BUILD_FILES_HEADER.format(**info)}",
+            f"prefix={variables['LUA_PREFIX']}",
+            f"includedir={variables['LUA_INCLUDE_DIR']}",
+            f"libdir={variables['LUA_LIBRARY_DIR']}",
+            "",
+            "Name: Lua",
+            f"Description: Lua {info['lua_version']} ({info['build_type']} {info['build_config']}, "
+            f"{info['architecture']}) from LuaEnv",
+            f"Version: {info['lua_version']}",
+            'Cflags: -I"${includedir}"',
+            'Libs: -L"${libdir}" -llua54',
+            "",
+        ])
+
+    def _render_meson_native(self, info: Dict) -> str:
+        """Meson native file: lua in [binaries], the paths in [properties]."""
+        variables = self._collect_variables(info, "unix")
+
+        def quote(value: str) -> str:
+            return "'" + value.replace("\\", "\\\\").replace("'", "\\'") + "'"
+
+        properties = [(name.lower(), variables[name])
+                      for group in FORMAT_GROUPS for name in FORMAT_GROUPS[group] if name != "LUA_CFLAGS"]
+        lines = [f"# {BUILD_FILES_HEADER.format(**info)}",
+                 "#   meson setup build --native-file <this file>",
+                 "#   meson.get_external_property('lua_include_dir')", ""]
+        if variables["LUA_EXECUTABLE"]:
+            lines += ["[binaries]", f"lua = {quote(variables['LUA_EXECUTABLE'])}", ""]
+        lines.append("[properties]")
+        lines += [f"{name} = {quote(value)}" for name, value in properties]
+        lines.append("")
+        return "\n".join(lines)
+
+    def _render_msbuild_props(self, info: Dict) -> str:
+        """MSBuild property sheet that adds the include directory and lua54.lib to every project importing it."""
+        variables = self._collect_variables(info, "native")
+        names = (("LuaVersion", "LUA_VERSION"), ("LuaBuildType", "LUA_BUILD_TYPE"),
+                 ("LuaArchitecture", "LUA_ARCHITECTURE"), ("LuaPrefix", "LUA_PREFIX"),
+                 ("LuaIncludeDir", "LUA_INCLUDE_DIR"), ("LuaLibraryDir", "LUA_LIBRARY_DIR"),
+                 ("LuaLibrary", "LUA_LIBRARY"), ("LuaBinDir", "LUA_BIN_DIR"), ("LuaDll", "LUA_DLL"))
+        lines = ['<?xml version="1.0" encoding="utf-8"?>',
+                 f"<!-- {_xml_escape(BUILD_FILES_HEADER.format(**info))} -->",
+                 '<Project xmlns="http://schemas.microsoft.com/developer/msbuild/2003">',
+                 '  <PropertyGroup Label="LuaEnv">']
+        lines += [f"    <{tag}>{_xml_escape(variables[name])}</{tag}>" for tag, name in names]
+        lines += ["  </PropertyGroup>",
+                  "  <ItemDefinitionGroup>",
+                  "    <ClCompile>",
+                  "      <AdditionalIncludeDirectories>$(LuaIncludeDir);%(AdditionalIncludeDirectories)</AdditionalIncludeDirectories>",
+                  "    </ClCompile>",
+                  "    <Link>",
+                  "      <AdditionalDependencies>$(LuaLibrary);%(AdditionalDependencies)</AdditionalDependencies>",
+                  "    </Link>",
+                  "  </ItemDefinitionGroup>",
+                  "</Project>", ""]
+        return "\n".join(lines)
+
+    def render_build_files(self, id_or_alias: str) -> Optional[Dict[str, str]]:
+        """Render every BUILD_FILES entry of an installation.
 
-        # Show all information (default)
-        self._show_all_info(info, path_style)
+        Returns:
+            File name to text, or None when the installation is invalid or has no lua54.lib
+        """
+        info = self.get_installation_info(id_or_alias)
+        if not info or not info["paths"]["lua_lib"]:
+            return None
+        return {name: getattr(self, method)(info) for name, method in BUILD_FILES.items()}
+
+    def emit_build_files(self, id_or_alias: str, out_dir: Path) -> bool:
+        """Write the static build files of an installation to out_dir and list them.
+
+        Returns:
+            True if successful, False if error
+        """
+        files = self.render_build_files(id_or_alias)
+        if files is None:
+            print_error(f"Installation '{id_or_alias}' not found, invalid or without lua54.lib")
+            return False
+        out_dir.mkdir(parents=True, exist_ok=True)
+        for name, text in files.items():
+            _write_if_changed(out_dir / name, text.encode("utf-8"))
+            print(out_dir / name)
         return True
 
+    def write_build_files(self, root: Path, installation_ids: Optional[Iterable[str]] = None,
+                          names_changed: bool = True) -> None:
+        """Keep root/<uuid|alias|default> current for the installations of the registry.
+
+        Names resolve like luaconfig arguments; "default" is skipped when an alias
+        of that name exists. Files are only rewritten when their text changes, so
+        build systems that track them do not reconfigure for nothing, and the
+        directories of removed installations and aliases are deleted.
+
+        Args:
+            root: Directory that holds one directory per name
+            installation_ids: Installations to render again (added, changed or
+                removed); None renders every installation
+            names_changed: Whether aliases or the default installation changed,
+                so the alias and "default" directories are rendered again as well
+        """
+        registry = self.registry.registry
+        names = {installation_id: installation_id for installation_id in registry["installations"]}
+        names.update(registry["aliases"])
+        if registry.get("default_installation") and "default" not in names:
+            names["default"] = registry["default_installation"]
+
+        if installation_ids is None:
+            targets = set(names)
+        else:
+            installation_ids = set(installation_ids)
+            targets = {name for name, installation_id in names.items() if installation_id in installation_ids}
+            if names_changed:
+                targets.update(name for name in names if name not in registry["installations"])
+            for installation_id in installation_ids - set(registry["installations"]):
+                shutil.rmtree(root / installation_id, ignore_errors=True)
+
+        rendered = {}
+        with contextlib.redirect_stdout(io.StringIO()), contextlib.redirect_stderr(io.StringIO()):
+            for installation_id in {names[name] for name in targets}:
+                rendered[installation_id] = self.render_build_files(installation_id)
+
+        for name in targets:
+            files = rendered.get(names[name])
+            directory = root / name
+            if files is None:
+                shutil.rmtree(directory, ignore_errors=True)
+                continue
+            directory.mkdir(parents=True, exist_ok=True)
+            for file_name, text in files.items():
+                _write_if_changed(directory / file_name, text.encode("utf-8"))
+
+        if installation_ids is None or names_changed:
+            for directory in root.glob("*/LuaEnvConfig.cmake"):
+                if directory.parent.name not in names:
+                    shutil.rmtree(directory.parent, ignore_errors=True)
+
     def _show_paths(self, info: Dict, path_style: str) -> None:
         """Show installation paths."""
         print(f"INSTALLATION PATHS")
@@ -449,8 +897,59 @@ class LuaPkgConfig:
             print("  Use DLL builds for better cross-compiler compatibility.")
 
 
-def main():
-    """Main entry point."""
+def _cmake_escape(value: str) -> str:
+    """Escape a value for use inside a quoted CMake argument."""
+    return value.replace("\\", "\\\\").replace('"', '\\"').replace("$", "\\$")
+
+
+def _cache_record(key: str, text: str) -> bytes:
+    """Encode one "@<key> <length>" answer cache record."""
+    data = text.encode("utf-8")
+    return f"@{key} {len(data)}\n".encode("utf-8") + data + b"\n"
+
+
+def _read_cache_index(index_path: Path, revision: Optional[int]) -> Optional[set]:
+    """IDs with answers in an answer cache index built from revision, None if it was not."""
+    try:
+        lines = index_path.read_text(encoding="utf-8").splitlines()
+    except (OSError, UnicodeDecodeError):
+        return None
+    if revision is None or lines[:2] != [ANSWER_CACHE_MAGIC, f"revision {revision}"]:
+        return None
+    answered = set()
+    for line in lines[2:]:
+        name, _, installation_id = line.rpartition("=")
+        if name == installation_id:
+            answered.add(installation_id)
+    return answered
+
+
+def _write_atomic(path: Path, data: bytes) -> None:
+    """Write a file through a temporary sibling so readers never see partial data."""
+    # Unique per writer, so concurrent writers never share a half-written file
+    temp_path = path.with_name(f"{path.name}.{os.getpid()}.{threading.get_ident()}.tmp")
+    with open(temp_path, "wb") as f:
+        f.write(data)
+    os.replace(temp_path, path)
+
+
+def _write_if_changed(path: Path, data: bytes) -> None:
+    """Write a file atomically unless it already holds data, keeping its timestamp."""
+    try:
+        if path.read_bytes() == data:
+            return
+    except OSError:
+        pass
+    _write_atomic(path, data)
+
+
+def main(argv: Optional[List[str]] = None, pkg_config: Optional[LuaPkgConfig] = None):
+    """Main entry point.
+
+    Args:
+        argv: Arguments to parse instead of sys.argv[1:]
+        pkg_config: Already loaded LuaPkgConfig to answer with (worker mode)
+    """
     parser = argparse.ArgumentParser(
         description="Generate pkg-config style information for Lua installations",
         formatter_class=argparse.RawDescriptionHelpFormatter,
@@ -464,6 +963,8 @@ Examples:
   python pkg_config.py 12345678 --path    # Show paths for partial UUID
   python pkg_config.py dev --json         # Output in JSON format
   python pkg_config.py dev --lua-include --path-style unix # Show include path with forward slashes
+  python pkg_config.py dev --lua-include --liblua --format cmake # CMake set() script
+  python pkg_config.py dev --emit build/lua   # Write the static build files to build/lua
         """
     )
 
@@ -508,6 +1009,23 @@ Examples:
         help="Output in JSON format"
     )
 
+    parser.add_argument(
+        "--format",
+        choices=OUTPUT_FORMATS,
+        help="Print the selected fields (all fields if no flag is given) as a "
+             "CMake script, a JSON object or KEY=VALUE lines"
+    )
+
+    parser.add_argument(
+        "--emit",
+        nargs="?",
+        const="",
+        metavar="DIR",
+        help="Write LuaEnvConfig.cmake, luaenv.pc, luaenv-native.ini and LuaEnv.props to DIR "
+             "(default: the directory registry.py keeps current, "
+             "%%USERPROFILE%%\\.luaenv\\buildconfig\\<installation>)"
+    )
+
     parser.add_argument(
         "--path-style",
         choices=['windows', 'unix', 'native'],
@@ -515,26 +1033,44 @@ Examples:
         help="Output path style ('windows', 'unix', or 'native')"
     )
 
-    args = parser.parse_args()
-
-    # Validate arguments
-    flag_count = sum([args.cflag, args.lua_include, args.liblua, args.path, args.libdir])
-    if flag_count > 1:
-        print_error("[ERROR] Only one of --cflag, --lua-include, --liblua, --path, --libdir can be specified")
-        return 1
+    args = parser.parse_args(argv)
 
     try:
-        pkg_config = LuaPkgConfig()
-        success = pkg_config.show_info(
-            args.installation,
-            show_cflag=args.cflag,
-            show_lua_include=args.lua_include,
-            show_liblua=args.liblua,
-            show_paths=args.path,
-            json_output=args.json,
-            path_style=args.path_style,
-            show_libdir=args.libdir
-        )
+        if pkg_config is None:
+            with trace_span("pkg_config.py load registry"):
+                pkg_config = LuaPkgConfig()
+        if args.emit is not None:
+            if args.emit:
+                out_dir = Path(args.emit)
+            else:
+                # The directory registry.py keeps: alias names as given, UUIDs in full
+                registry = pkg_config.registry
+                name = args.installation if args.installation in registry.registry["aliases"] \
+                    else registry.resolve_id(args.installation) or args.installation
+                out_dir = registry.build_config_root / name
+            success = pkg_config.emit_build_files(args.installation, out_dir)
+        elif args.format:
+            queries = [query for query, selected in (
+                ("cflag", args.cflag), ("lua-include", args.lua_include),
+                ("liblua", args.liblua), ("libdir", args.libdir), ("path", args.path)
+            ) if selected]
+            success = pkg_config.show_variables(
+                args.installation,
+                queries,
+                args.format,
+                path_style=args.path_style
+            )
+        else:
+            success = pkg_config.show_info(
+                args.installation,
+                show_cflag=args.cflag,
+                show_lua_include=args.lua_include,
+                show_liblua=args.liblua,
+                show_paths=args.path,
+                json_output=args.json,
+                path_style=args.path_style,
+                show_libdir=args.libdir
+            )
 
         return 0 if success else 1
 
@@ -543,5 +1079,42 @@ Examples:
         return 1
 
 
+def serve() -> int:
+    """Answer pkg-config requests for the resident LuaEnv.CLI server.
+
+    Each stdin line is a JSON list of main() arguments; each reply is a single
+    JSON line with "exit_code", "stdout" and "stderr". The registry is loaded
+    once, the server restarts the worker when the registry revision changes.
+    """
+    with contextlib.redirect_stdout(sys.stderr):
+        pkg_config = LuaPkgConfig()
+
+    for line in sys.stdin:
+        if not line.strip():
+            continue
+
+        stdout, stderr = io.StringIO(), io.StringIO()
+        try:
+            argv = json.loads(line)
+            with contextlib.redirect_stdout(stdout), contextlib.redirect_stderr(stderr):
+                exit_code = main([str(arg) for arg in argv], pkg_config)
+        except SystemExit as e:
+            exit_code = e.code if isinstance(e.code, int) else 1
+        except Exception as e:
+            stderr.write(f"[ERROR] Unexpected error: {e}\n")
+            exit_code = 1
+
+        reply = {"exit_code": exit_code, "stdout": stdout.getvalue(), "stderr": stderr.getvalue()}
+        sys.stdout.write(json.dumps(reply) + "\n")
+        sys.stdout.flush()
+
+    return 0
+
+
 if __name__ == "__main__":
-    sys.exit(main())
+    trace_event("pkg_config.py import", _IMPORT_START_US, trace_now_us() - _IMPORT_START_US)
+    if sys.argv[1:] == ["--serve"]:
+        sys.exit(serve())
+    with trace_span("pkg_config.py main"):
+        exit_code = main()
+    sys.exit(exit_code)
@@ -13,6 +13,10 @@ Usage:
     python pkg_lookup.py status         # Show current JSON status and statistics
     python pkg_lookup.py compatibility  # Check and update test suite compatibility
 
+discover and update read the index pages from the index_cache of the JSON file
+for INDEX_TTL_HOURS; after that, or with --refresh, they ask the server with
+the saved ETag/Last-Modified validators, so an unchanged page costs one 304.
+
 Author: LuaEnv Team
 Date: July 2025
 """
@@ -22,18 +26,29 @@ import sys
 import json
 import re
 import time
-import urllib.request
-import urllib.error
+from concurrent.futures import ThreadPoolExecutor
 from datetime import datetime
 from typing import Dict, List, Set, Tuple, Optional, Union, Any
 from urllib.parse import urljoin
 
+# Add current directory to Python path for local imports
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+try:
+    from .utils import HttpSession, probe_urls
+except ImportError:
+    from utils import HttpSession, probe_urls
+
 
 # Constants
 JSON_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), ".versions.json")
 USER_AGENT = "LuaEnv-Version-Checker/1.0"
 TIMEOUT = 10  # seconds
 MAX_RETRIES = 3
+INDEX_TTL_HOURS = 24  # Index pages younger than this are not fetched again without --refresh
+
+# Archive names on an index page; the version patterns below only ever match these
+ARCHIVE_PATTERN = r'[A-Za-z0-9_.\-]+\.(?:tar\.gz|zip)'
 
 # Lua version test compatibility map
 # Format: lua_version_pattern -> test_pattern_to_use
@@ -48,10 +63,18 @@ LUA_TEST_PATTERNS = [
 
 
 class VersionChecker:
-    def __init__(self, json_file: str):
-        """Initialize the version checker with the path to the JSON file."""
+    def __init__(self, json_file: str, refresh: bool = False):
+        """Initialize the version checker with the path to the JSON file.
+
+        Args:
+            json_file: Path of .versions.json
+            refresh: Revalidate index pages even when their cached copy is recent
+        """
         self.json_file = json_file
+        self.refresh = refresh
+        self.session = HttpSession(timeout=TIMEOUT, user_agent=USER_AGENT)
         self.json_data = self._load_json()
+        self._indexes = {}  # Index pages fetched ahead by prefetch_indexes
         self.sources = self.json_data.get("sources", {})
         self.compatibility = self.json_data.get("compatibility", {})
         self._initialize_json_structure()
@@ -105,44 +128,80 @@ class VersionChecker:
             print(f"Error saving JSON file: {e}")
             sys.exit(1)
 
-    def _fetch_url(self, url: str) -> Optional[str]:
-        """Fetch URL content with retries."""
-        headers = {"User-Agent": USER_AGENT}
-        request = urllib.request.Request(url, headers=headers)
+    def _save_index_cache(self) -> None:
+        """Persist only the index validators, leaving the rest of the file as it is on disk."""
+        try:
+            with open(self.json_file, "r", encoding="utf-8") as f:
+                data = json.load(f)
+            data["index_cache"] = self.json_data.get("index_cache", {})
+            with open(self.json_file, "w", encoding="utf-8") as f:
+                json.dump(data, f, indent=2)
+        except (OSError, json.JSONDecodeError) as e:
+            print(f"Warning: could not save the index cache: {e}")
+
+    def _fetch_index(self, source_name: str, url: str) -> Optional[str]:
+        """Archive names listed on the index page of a source, one per line.
+
+        The names are kept in the index_cache section of the JSON file with the
+        page's ETag and Last-Modified. Within INDEX_TTL_HOURS the cached names are
+        used as they are; later (or with --refresh) a conditional GET revalidates
+        them, and a 304 keeps them.
+        """
+        index_cache = self.json_data.setdefault("index_cache", {})
+        cached = index_cache.get(source_name)
+        if cached and cached.get("url") != url:
+            cached = None
+
+        if cached and not self.refresh:
+            age = datetime.now() - datetime.fromisoformat(cached.get("checked", "1970-01-01T00:00:00"))
+            if age.total_seconds() < INDEX_TTL_HOURS * 3600:
+                print(f"Using the cached index of {source_name} (checked {age.total_seconds() / 3600:.1f} hours ago)")
+                return "\n".join(cached.get("files", []))
+
+        headers = {}
+        if cached and cached.get("etag"):
+            headers["If-None-Match"] = cached["etag"]
+        if cached and cached.get("last_modified"):
+            headers["If-Modified-Since"] = cached["last_modified"]
 
         for attempt in range(MAX_RETRIES):
             try:
-                with urllib.request.urlopen(request, timeout=TIMEOUT) as response:
-                    return response.read().decode('utf-8')
-            except urllib.error.URLError as e:
+                status, response_headers, body = self.session.request("GET", url, headers)
+            except Exception as e:
                 print(f"Attempt {attempt + 1}/{MAX_RETRIES} failed: {e}")
                 if attempt < MAX_RETRIES - 1:
-                    delay = (attempt + 1) * 2
-                    print(f"Retrying in {delay} seconds...")
-                    time.sleep(delay)
-                else:
-                    print(f"Failed to fetch {url} after {MAX_RETRIES} attempts")
-                    return None
-            except Exception as e:
-                print(f"Unexpected error: {e}")
+                    time.sleep((attempt + 1) * 2)
+                continue
+
+            if status == 304 and cached:
+                print(f"Index of {source_name} unchanged since {cached.get('checked', 'the last check')}")
+                cached["checked"] = datetime.now().isoformat()
+                return "\n".join(cached.get("files", []))
+            if status != 200:
+                print(f"Failed to fetch {url}: HTTP {status}")
                 return None
 
-    def _check_url_exists(self, url: str) -> bool:
-        """Check if a URL exists without downloading the full content."""
-        headers = {"User-Agent": USER_AGENT}
-        request = urllib.request.Request(url, headers=headers, method="HEAD")
+            files = sorted(set(re.findall(ARCHIVE_PATTERN, body.decode("utf-8", errors="replace"))))
+            index_cache[source_name] = {
+                "url": url,
+                "etag": response_headers.get("etag"),
+                "last_modified": response_headers.get("last-modified"),
+                "checked": datetime.now().isoformat(),
+                "files": files,
+            }
+            return "\n".join(files)
 
-        try:
-            with urllib.request.urlopen(request, timeout=TIMEOUT) as response:
-                return response.status == 200
-        except:
-            # Try GET if HEAD is not supported
-            try:
-                request = urllib.request.Request(url, headers=headers)
-                with urllib.request.urlopen(request, timeout=TIMEOUT) as response:
-                    return response.status == 200
-            except:
-                return False
+        print(f"Failed to fetch {url} after {MAX_RETRIES} attempts")
+        return None
+
+    def prefetch_indexes(self) -> None:
+        """Fetch the index pages of all sources at the same time."""
+        names = [name for name, source in self.sources.items() if source.get("url")]
+        if not names:
+            return
+        with ThreadPoolExecutor(max_workers=len(names)) as pool:
+            pages = pool.map(lambda name: self._fetch_index(name, self.sources[name]["url"]), names)
+            self._indexes = dict(zip(names, pages))
 
     def _parse_versions(self, html: str, pattern: str) -> List[str]:
         """Parse versions from HTML content using regex pattern."""
@@ -195,7 +254,11 @@ class VersionChecker:
             return f"{version}.tar.gz"
 
     def check_versions(self, source_name: str) -> Tuple[int, int]:
-        """Check if all versions for a given source are accessible."""
+        """Check if all versions for a given source are accessible.
+
+        The URLs are probed in parallel (at most MAX_PARALLEL_PROBES at a time)
+        over kept-alive connections, and reported in order.
+        """
         if source_name not in self.sources:
             print(f"Source '{source_name}' not found in JSON file")
             return 0, 0
@@ -204,52 +267,32 @@ class VersionChecker:
         base_url = source.get("url", "")
         versions = source.get("versions", [])
 
-        available = 0
-        unavailable = 0
+        # (heading, URLs) per group of packages
+        groups = []
 
         # For LuaRocks, we only care about Windows binary packages
         if source_name == "luarocks":
-            # Check Windows 32-bit binary packages
-            win32_versions = source.get("win32", [])
-            if win32_versions:
-                print(f"Checking {len(win32_versions)} Windows 32-bit binary packages for {source_name}...")
-                for version in win32_versions:
-                    filename = self._get_filename_for_version(source_name, version, "win32")
-                    url = urljoin(base_url, filename)
-                    exists = self._check_url_exists(url)
-
-                    status = "✓" if exists else "✗"
-                    print(f"  [{status}] {url}")
-
-                    if exists:
-                        available += 1
-                    else:
-                        unavailable += 1
-
-            # Check Windows 64-bit binary packages
-            win64_versions = source.get("win64", [])
-            if win64_versions:
-                print(f"Checking {len(win64_versions)} Windows 64-bit binary packages for {source_name}...")
-                for version in win64_versions:
-                    filename = self._get_filename_for_version(source_name, version, "win64")
-                    url = urljoin(base_url, filename)
-                    exists = self._check_url_exists(url)
-
-                    status = "✓" if exists else "✗"
-                    print(f"  [{status}] {url}")
-
-                    if exists:
-                        available += 1
-                    else:
-                        unavailable += 1
+            for platform, label in (("win32", "Windows 32-bit"), ("win64", "Windows 64-bit")):
+                platform_versions = source.get(platform, [])
+                if platform_versions:
+                    groups.append((
+                        f"Checking {len(platform_versions)} {label} binary packages for {source_name}...",
+                        [urljoin(base_url, self._get_filename_for_version(source_name, v, platform))
+                         for v in platform_versions]))
         else:
             # For other sources, check all versions
-            print(f"Checking {len(versions)} versions for {source_name} at {base_url}...")
-            for version in versions:
-                filename = self._get_filename_for_version(source_name, version)
-                url = urljoin(base_url, filename)
-                exists = self._check_url_exists(url)
+            groups.append((
+                f"Checking {len(versions)} versions for {source_name} at {base_url}...",
+                [urljoin(base_url, self._get_filename_for_version(source_name, v)) for v in versions]))
+
+        results = probe_urls([url for _, urls in groups for url in urls], self.session)
 
+        available = 0
+        unavailable = 0
+        for heading, urls in groups:
+            print(heading)
+            for url in urls:
+                exists = results[url]
                 status = "✓" if exists else "✗"
                 print(f"  [{status}] {url}")
 
@@ -273,7 +316,10 @@ class VersionChecker:
 
         print(f"Discovering new versions for {source_name} at {base_url}...")
 
-        html = self._fetch_url(base_url)
+        if source_name in self._indexes:
+            html = self._indexes.pop(source_name)
+        else:
+            html = self._fetch_index(source_name, base_url)
         if not html:
             return []
 
@@ -664,9 +710,12 @@ class VersionChecker:
             print("  Discover new versions available from the source URLs.")
             print("  Scans the source URLs for new versions that are not in the JSON file.")
             print("\nUsage:")
-            print("  python pkg_lookup.py discover")
+            print("  python pkg_lookup.py discover [--refresh]")
+            print("\nOptions:")
+            print(f"  --refresh    Revalidate listings checked less than {INDEX_TTL_HOURS} hours ago")
             print("\nThis command will:")
-            print("  1. For each source, fetch the directory listing from its URL")
+            print("  1. For each source, fetch the directory listing from its URL (in parallel, and")
+            print("     with the saved ETag/Last-Modified, so an unchanged listing is a 304)")
             print("  2. Parse the HTML to find all available versions")
             print("  3. Compare with versions in the JSON file to find new ones")
             print("  4. Display any new versions found without updating the JSON file")
@@ -676,7 +725,9 @@ class VersionChecker:
             print("  Discover new versions and automatically update the JSON file.")
             print("  This combines the 'discover' command with automatic JSON updating.")
             print("\nUsage:")
-            print("  python pkg_lookup.py update")
+            print("  python pkg_lookup.py update [--refresh]")
+            print("\nOptions:")
+            print(f"  --refresh    Revalidate listings checked less than {INDEX_TTL_HOURS} hours ago")
             print("\nThis command will:")
             print("  1. Run the discover process to find new versions")
             print("  2. Add any new versions to the JSON file")
@@ -745,7 +796,7 @@ class VersionChecker:
 
 def main() -> None:
     """Main function to parse arguments and execute commands."""
-    checker = VersionChecker(JSON_FILE)
+    checker = VersionChecker(JSON_FILE, refresh="--refresh" in sys.argv[2:])
 
     if len(sys.argv) < 2:
         print("Error: No command specified")
@@ -768,12 +819,15 @@ def main() -> None:
             sys.exit(1)
 
     elif command == "discover":
+        checker.prefetch_indexes()
         for source_name in checker.sources:
             checker.discover_new_versions(source_name)
+        checker._save_index_cache()
 
     elif command == "update":
         updated = False
 
+        checker.prefetch_indexes()
         for source_name in checker.sources:
             new_versions = checker.discover_new_versions(source_name)
             if new_versions:
@@ -789,6 +843,7 @@ def main() -> None:
         if updated:
             checker._save_json()
         else:
+            checker._save_index_cache()
             print("No updates needed, all versions are current")
 
     elif command == "status":
@@ -10,6 +10,8 @@ Manages UUID-based Lua installations in %USERPROFILE%\\.luaenv
 Provides centralized tracking of installations, environments, and aliases.
 """
 
+import bisect
+import copy
 import json
 import uuid
 import shutil
@@ -27,10 +29,18 @@ if __name__ == "__main__" or "backend" not in sys.path:
 
 # Import utilities with dual-context support
 try:
-    from utils import get_backend_dir, print_error
+    from utils import get_backend_dir, print_error, trace_span, format_file_size
+    from shared_store import SharedStore
+    from disk_usage import measure_tree, tree_marker
+    from install_timeline import format_timeline, slowest_phase
+    from registry_store import RegistryStore, diff_registry, exclusive_lock
 except ImportError:
     try:
-        from .utils import get_backend_dir, print_error
+        from .utils import get_backend_dir, print_error, trace_span, format_file_size
+        from .shared_store import SharedStore
+        from .disk_usage import measure_tree, tree_marker
+        from .install_timeline import format_timeline, slowest_phase
+        from .registry_store import RegistryStore, diff_registry, exclusive_lock
     except ImportError as e:
         print(f"Error importing utilities: {e}")
         print("Make sure utils.py is in the same directory as this script.")
@@ -40,6 +50,14 @@ except ImportError:
         sys.exit(1)
 
 
+def _format_age(seconds: float) -> str:
+    """Format a duration as 45s, 12m, 3h or 2d."""
+    for unit, size in (("d", 86400), ("h", 3600), ("m", 60)):
+        if seconds >= size:
+            return f"{int(seconds // size)}{unit}"
+    return f"{int(seconds)}s"
+
+
 class LuaEnvRegistry:
     """Manages the LuaEnv installation registry."""
 
@@ -59,7 +77,17 @@ class LuaEnvRegistry:
         self.luaenv_root = self.registry_path.parent
         self.installations_root = self.luaenv_root / "installations"
         self.environments_root = self.luaenv_root / "environments"
+        # Private sources and build outputs of running install jobs (see setup_lua.py)
+        self.workspaces_root = self.luaenv_root / "workspaces"
         # self.cache_root = self.luaenv_root / "cache"
+        # Precomputed pkg-config answers read by luaconfig.exe (see luaconfig.c)
+        self.pkg_config_cache_root = self.luaenv_root / "cache" / "pkg-config"
+        # Static CMake, pkg-config, Meson and MSBuild files per installation (see pkg_config.py)
+        self.build_config_root = self.luaenv_root / "buildconfig"
+        # Files shared by installations through hardlinks (see shared_store.py)
+        self.store = SharedStore(self.luaenv_root / "store")
+        # Snapshot, journal, lock and revision files (see registry_store.py)
+        self.storage = RegistryStore(self.registry_path)
 
         # Ensure directories exist
         self._ensure_directories()
@@ -74,45 +102,128 @@ class LuaEnvRegistry:
             directory.mkdir(parents=True, exist_ok=True)
 
     def _load_registry(self) -> Dict:
-        """Load registry from file or create new one."""
-        if self.registry_path.exists():
-            try:
-                with open(self.registry_path, 'r', encoding='utf-8') as f:
-                    registry = json.load(f)
-
+        """Load registry (snapshot plus journal) or create new one."""
+        registry = None
+        try:
+            registry = self.storage.load()
+            if registry is not None:
                 # Validate registry version
                 if registry.get("registry_version") != self.REGISTRY_VERSION:
                     print(f"[WARNING] Registry version mismatch. Expected {self.REGISTRY_VERSION}, "
                           f"found {registry.get('registry_version', 'unknown')}")
+        except (json.JSONDecodeError, FileNotFoundError) as e:
+            print(f"[WARNING] Could not load registry: {e}")
+            print("[INFO] Creating new registry")
+
+        if registry is None:
+            # Create new registry
+            registry = {
+                "registry_version": self.REGISTRY_VERSION,
+                "created": datetime.now(timezone.utc).isoformat(),
+                "updated": datetime.now(timezone.utc).isoformat(),
+                "revision": 0,
+                "default_installation": None,
+                "installations": {},
+                "aliases": {}
+            }
 
-                return registry
-            except (json.JSONDecodeError, FileNotFoundError) as e:
-                print(f"[WARNING] Could not load registry: {e}")
-                print("[INFO] Creating new registry")
+        # State on disk, which _save_registry diffs against
+        self._persisted = copy.deepcopy(registry)
+        self._build_index(registry)
+        return registry
 
-        # Create new registry
-        return {
-            "registry_version": self.REGISTRY_VERSION,
-            "created": datetime.now(timezone.utc).isoformat(),
-            "updated": datetime.now(timezone.utc).isoformat(),
-            "default_installation": None,
-            "installations": {},
-            "aliases": {}
-        }
+    def _build_index(self, registry: Dict) -> None:
+        """Index installation IDs (without hyphens, sorted) for prefix lookups."""
+        self._id_index = sorted((installation_id.replace("-", ""), installation_id)
+                                for installation_id in registry["installations"])
+
+    def refresh(self) -> bool:
+        """Reload the registry if another process changed it.
+
+        Unsaved changes to self.registry are discarded.
+
+        Returns:
+            True if the registry was reloaded
+        """
+        if self.storage.read_revision() == self._persisted.get("revision", 0):
+            return False
+        self.registry = self._load_registry()
+        return True
 
     def _save_registry(self) -> None:
-        """Save registry to file with backup."""
-        # Create backup if registry exists
-        if self.registry_path.exists():
-            backup_path = self.registry_path.with_suffix('.json.backup')
-            shutil.copy2(self.registry_path, backup_path)
+        """Journal the changes made to the registry since it was loaded.
+
+        Changes other processes made in the meantime are merged in under the
+        registry lock; where both changed the same installation or alias, the
+        change of this process wins.
+        """
+        with self.storage.lock():
+            latest = self._persisted
+            if self.storage.read_revision() != latest.get("revision", 0):
+                latest = self.storage.load() or latest
+
+            records = diff_registry(self._persisted, self.registry)
+            if records:
+                since_revision = latest.get("revision", 0)
+                previous = {record["key"]: latest["installations"].get(record["key"])
+                            for record in records if record.get("table") == "installations"}
+                self.storage.append(latest, records, datetime.now(timezone.utc).isoformat())
+            elif latest is self._persisted:
+                return
+
+            self.registry = latest
+            self._persisted = copy.deepcopy(latest)
+            self._build_index(latest)
+
+            # Under the lock, so the cache of a later revision is never overwritten
+            if records:
+                names_changed = any(record.get("table") == "aliases" or record["op"] == "default"
+                                    for record in records)
+                self._refresh_pkg_config_cache(since_revision, previous, names_changed)
+
+    def _refresh_pkg_config_cache(self, since_revision: Optional[int] = None,
+                                  previous: Optional[Dict[str, Optional[Dict]]] = None,
+                                  names_changed: bool = True) -> None:
+        """Bring the luaconfig answer cache and the static build files up to the current revision.
+
+        Args:
+            since_revision: Revision before the save that triggers the refresh
+            previous: Installations the save changed, as they were at since_revision;
+                None renders every installation
+            names_changed: Whether the save changed aliases or the default installation
+
+        Runs under the registry lock. Only installations whose rendered fields
+        changed are rendered again; a save that changes nothing rendered just
+        stamps the index with the new revision. The cache is only an accelerator: on failure the stale index
+        is removed so luaconfig falls back to the CLI instead of serving old answers.
+        """
+        try:
+            from pkg_config import LuaPkgConfig, rendering_inputs
+        except ImportError:
+            from .pkg_config import LuaPkgConfig, rendering_inputs
+
+        installations = self.registry["installations"]
+        changed = None
+        if previous is not None:
+            changed = [installation_id for installation_id, before in previous.items()
+                       if rendering_inputs(before) != rendering_inputs(installations.get(installation_id))]
 
-        # Update timestamp
-        self.registry["updated"] = datetime.now(timezone.utc).isoformat()
+        with self.storage.lock():
+            try:
+                with trace_span("registry.py refresh pkg-config cache"):
+                    LuaPkgConfig(registry=self).write_answer_cache(
+                        self.pkg_config_cache_root, self.registry.get("revision", 0), changed, since_revision)
+            except Exception as e:
+                print(f"[WARNING] Could not update pkg-config cache: {e}")
+                (self.pkg_config_cache_root / "index").unlink(missing_ok=True)
 
-        # Save registry
-        with open(self.registry_path, 'w', encoding='utf-8') as f:
-            json.dump(self.registry, f, indent=2, ensure_ascii=False)
+            if changed == [] and not names_changed:
+                return
+            try:
+                with trace_span("registry.py refresh build config files"):
+                    LuaPkgConfig(registry=self).write_build_files(self.build_config_root, changed, names_changed)
+            except Exception as e:
+                print(f"[WARNING] Could not update build config files: {e}")
 
     def generate_installation_id(self) -> str:
         """Generate new UUID4 for installation."""
@@ -121,29 +232,36 @@ class LuaEnvRegistry:
     def create_installation(self, lua_version: str, luarocks_version: str,
                           build_type: str, build_config: str = "release",
                           name: Optional[str] = None, alias: Optional[str] = None,
-                          architecture: str = "x64") -> str:
+                          architecture: str = "x64", build_group: Optional[str] = None,
+                          installation_id: Optional[str] = None) -> str:
         """Create new installation record.
 
         Args:
             lua_version: Lua version (e.g., "5.4.8")
             luarocks_version: LuaRocks version (e.g., "3.12.2")
             build_type: "dll" or "static"
-            build_config: "release" or "debug"
+            build_config: "release", "debug" or "pgo" (profile-guided release build)
             name: Optional descriptive name
             alias: Optional alias for the installation
             architecture: Target architecture - "x64" (default) or "x86"
+            build_group: Matrix build that created the installation together with
+                its siblings from the same sources (see setup_lua.run_matrix)
+            installation_id: ID to register the installation under (default: a
+                new one); install jobs pass the ID whose workspace lock they hold
 
         Returns:
             Installation UUID
         """
-        installation_id = self.generate_installation_id()
+        installation_id = installation_id or self.generate_installation_id()
 
         # Generate default name if not provided
         if not name:
             arch_display = "x86" if architecture == "x86" else "x64"
-            name = f"Lua {lua_version} {build_type.upper()} {build_config.title()} ({arch_display})"
+            config_display = "PGO" if build_config == "pgo" else build_config.title()
+            name = f"Lua {lua_version} {build_type.upper()} {config_display} ({arch_display})"
 
         # VALIDATE ALIAS BEFORE CREATING ANYTHING
+        self.refresh()
         if alias and alias in self.registry["aliases"]:
             print_error(f"[ERROR] Alias '{alias}' already exists")
             raise ValueError(f"Alias '{alias}' already exists")
@@ -177,6 +295,8 @@ class LuaEnvRegistry:
                 },
                 "tags": []
             }
+            if build_group:
+                installation["build_group"] = build_group
 
             # Add to registry
             self.registry["installations"][installation_id] = installation
@@ -268,11 +388,15 @@ class LuaEnvRegistry:
         if not looks_like_uuid:
             return None
 
-        # Find partial matches
+        # Find partial matches in the sorted ID index
+        if len(self._id_index) != len(self.registry["installations"]):
+            self._build_index(self.registry)
+        prefix = uuid_str.replace("-", "").lower()
         matches = []
-        for installation_id in self.registry["installations"]:
-            if installation_id.replace("-", "").startswith(uuid_str.replace("-", "")):
-                matches.append(installation_id)
+        position = bisect.bisect_left(self._id_index, (prefix, ""))
+        while position < len(self._id_index) and self._id_index[position][0].startswith(prefix):
+            matches.append(self._id_index[position][1])
+            position += 1
 
         if len(matches) == 1:
             return self.registry["installations"][matches[0]]
@@ -342,6 +466,12 @@ class LuaEnvRegistry:
 
         installation_id = installation["id"]
 
+        # Its install job still works in the workspace and the installation directory
+        if self.is_building(installation_id):
+            print(f"[ERROR] Installation '{installation['name']}' is still being built, "
+                  "wait for its install to finish")
+            return False
+
         if confirm:
             response = input(f"Remove installation '{installation['name']}' ({installation_id})? [y/N]: ")
             if response.lower() != 'y':
@@ -360,6 +490,9 @@ class LuaEnvRegistry:
             shutil.rmtree(env_path)
             print(f"[OK] Removed environment directory: {env_path}")
 
+        # A workspace left behind by an interrupted install
+        shutil.rmtree(self.get_workspace_dir(installation_id), ignore_errors=True)
+
         # Remove from registry
         del self.registry["installations"][installation_id]
 
@@ -383,6 +516,7 @@ class LuaEnvRegistry:
         self._save_registry()
         print(f"[OK] Removed installation: {installation['name']}")
 
+        self.release_shared_files()
         return True
 
     def set_alias(self, installation_id: str, alias: str) -> bool:
@@ -483,17 +617,186 @@ class LuaEnvRegistry:
             self.registry["installations"][installation_id]["status"] = status
             self._save_registry()
 
+    def record_benchmark(self, installation_id: str, benchmark: Dict) -> None:
+        """Store the latest ``luaenv bench`` results of an installation.
+
+        Args:
+            installation_id: Installation UUID
+            benchmark: Summary written by bench_lua.py (suite_version, updated, runs,
+                total_ms and per-benchmark results)
+        """
+        if installation_id in self.registry["installations"]:
+            self.registry["installations"][installation_id]["benchmark"] = benchmark
+            self._save_registry()
+
+    def record_install_timeline(self, installation_id: str, timeline: Dict) -> None:
+        """Store the per-phase timeline of the install that created an installation.
+
+        Args:
+            installation_id: Installation UUID
+            timeline: Record built by install_timeline.load_timeline (recorded, status,
+                total and phases)
+        """
+        if installation_id in self.registry["installations"]:
+            self.registry["installations"][installation_id]["install_timeline"] = timeline
+            self._save_registry()
+
+    def print_timings(self, installation_ids: List[str], as_json: bool = False) -> None:
+        """Print the install timelines of installations, as tables or as one JSON document."""
+        installations = [self.registry["installations"][i] for i in installation_ids]
+        if as_json:
+            keys = ("id", "name", "lua_version", "luarocks_version", "build_type", "build_config",
+                    "architecture", "build_group", "install_timeline")
+            print(json.dumps([{key: installation.get(key) for key in keys} for installation in installations],
+                             indent=2))
+            return
+
+        for installation in installations:
+            timeline = installation.get("install_timeline")
+            print(f"[INFO] {installation['name']} ({installation['id']})")
+            if not timeline:
+                print("  No install timeline (installed before timelines were recorded)")
+                continue
+            print(f"  Installed {timeline['recorded']}, result: {timeline['status']}")
+            for line in format_timeline(timeline):
+                print(line)
+
+    def is_disk_usage_current(self, installation: Dict) -> bool:
+        """Whether the stored disk usage still matches the markers of both trees."""
+        usage = installation.get("disk_usage")
+        if not usage:
+            return False
+        for tree, path_key in (("installation", "installation_path"), ("environment", "environment_path")):
+            stored = usage.get(tree)
+            marker = tree_marker(Path(installation[path_key]))
+            if (stored["marker"] if stored else None) != marker:
+                return False
+        return True
+
+    def refresh_disk_usage(self, installation_ids: Optional[List[str]] = None, force: bool = False) -> int:
+        """Measure the trees of installations whose markers changed and store the results.
+
+        Args:
+            installation_ids: Installations to check (all when None)
+            force: Measure even when the stored usage is current
+
+        Returns:
+            Number of installations measured
+        """
+        installations = self.registry["installations"]
+        ids = [i for i in (installation_ids or list(installations)) if i in installations]
+        stale = [i for i in ids if force or not self.is_disk_usage_current(installations[i])]
+        for installation_id in stale:
+            installation = installations[installation_id]
+            installation["disk_usage"] = {
+                "installation": measure_tree(Path(installation["installation_path"])),
+                "environment": measure_tree(Path(installation["environment_path"])),
+                "measured": datetime.now(timezone.utc).isoformat(),
+            }
+        if stale:
+            self._save_registry()
+        return len(stale)
+
+    def get_workspace_dir(self, installation_id: str) -> Path:
+        """Private workspace of the install job building an installation."""
+        return self.workspaces_root / installation_id
+
+    def is_building(self, installation_id: str) -> bool:
+        """Whether an install job is still running for this installation.
+
+        The job holds the .lock file of its workspace while it builds.
+        """
+        lock_path = self.get_workspace_dir(installation_id) / ".lock"
+        if not lock_path.exists():
+            return False
+        try:
+            with exclusive_lock(lock_path, timeout=0):
+                return False
+        except (TimeoutError, OSError):
+            return True
+
+    def get_module_index_status(self, installation: Dict) -> Dict:
+        """How current the module index of an installation's environment is.
+
+        The index is written by Update-LuaModuleIndex (luaenv_core.psm1) at
+        activation. It is stale when the rock manifest, or a directory under one of
+        the roots it indexed, changed after it was built.
+
+        Returns:
+            Dict with 'state' ('missing', 'current' or 'stale'), 'path', 'modules',
+            'age' (seconds since it was built) and 'stale_by' (seconds between the
+            build and the newest change, 0 when current)
+        """
+        env_path = Path(installation["environment_path"])
+        index_path = env_path / "module_index.lua"
+        status = {"state": "missing", "path": str(index_path), "modules": None, "age": None, "stale_by": 0}
+        try:
+            built = index_path.stat().st_mtime
+            header = []
+            with open(index_path, "r", encoding="utf-8") as f:
+                for line in f:
+                    if line.startswith("return"):
+                        break
+                    if line.startswith("-- "):
+                        header.append(line.rstrip("\n"))
+        except OSError:
+            return status
+
+        roots = []
+        directories = None
+        for line in header:
+            key, _, value = line[3:].partition(": ")
+            if key == "modules" and value.isdigit():
+                status["modules"] = int(value)
+            elif key == "root":
+                roots.append(Path(value))
+            elif key == "dirs":
+                directories = []
+            elif key == "dir" and directories is not None:
+                directories.append(Path(value))
+
+        # The same directories Test-LuaModuleIndexCurrent compares: the roots and
+        # every directory below them when the index was built
+        newest = built
+        rock_manifest = env_path / "lib" / "luarocks" / "rocks-5.4" / "manifest"
+        candidates = [rock_manifest] + roots
+        if directories is None:
+            # Written before the directories were recorded; walk the roots instead
+            for root in roots:
+                for directory, _, _ in os.walk(root):
+                    candidates.append(Path(directory))
+        else:
+            candidates += directories
+        for candidate in candidates:
+            try:
+                newest = max(newest, candidate.stat().st_mtime)
+            except OSError:
+                continue
+
+        status["age"] = max(0.0, datetime.now().timestamp() - built)
+        status["stale_by"] = newest - built
+        status["state"] = "stale" if newest > built else "current"
+        return status
+
     def validate_installations(self) -> Dict[str, List[str]]:
         """Validate all installations and return issues.
 
+        Installations that a running install job is still building are neither
+        valid nor broken.
+
         Returns:
-            Dict with 'valid', 'broken', and 'missing' lists
+            Dict with 'valid', 'broken', 'missing' and 'building' lists
         """
         valid = []
         broken = []
         missing = []
+        building = []
 
         for installation_id, installation in self.registry["installations"].items():
+            if installation.get("status") == "building" and self.is_building(installation_id):
+                building.append(installation_id)
+                continue
+
             install_path = Path(installation["installation_path"])
             env_path = Path(installation["environment_path"])
 
@@ -515,7 +818,8 @@ class LuaEnvRegistry:
         return {
             "valid": valid,
             "broken": broken,
-            "missing": missing
+            "missing": missing,
+            "building": building
         }
 
     def cleanup_broken(self, confirm: bool = True) -> int:
@@ -600,8 +904,37 @@ class LuaEnvRegistry:
                 print(f"[ERROR] Failed to remove {zombie_path}: {e}")
 
         print(f"[OK] Cleaned up {cleaned} zombie installations")
+        self.release_shared_files()
         return cleaned
 
+    def release_shared_files(self) -> int:
+        """Drop store objects that no installation links to any more.
+
+        Returns:
+            Number of objects removed
+        """
+        removed, freed = self.store.collect_garbage()
+        if removed:
+            print(f"[OK] Released {removed} unused shared files ({format_file_size(freed)})")
+        return removed
+
+    def deduplicate_trees(self) -> int:
+        """Hardlink identical rock files of all LuaRocks trees to shared store objects.
+
+        Returns:
+            Number of files that now share an object with another tree
+        """
+        trees = [Path(installation["environment_path"])
+                 for installation in self.registry["installations"].values()]
+        linked, saved = self.store.deduplicate(trees)
+        if linked:
+            print(f"[OK] Shared {linked} identical rock files ({format_file_size(saved)} saved)")
+            # Linking leaves the tree markers alone but changes the shared bytes
+            for installation in self.registry["installations"].values():
+                installation.pop("disk_usage", None)
+            self._save_registry()
+        return linked
+
     def get_cache_path(self) -> Path:
         """Get cache directory path."""
         return self.cache_root
@@ -820,6 +1153,7 @@ class LuaEnvRegistry:
 
         print(f"[INFO] LuaEnv Registry Status")
         print(f"[INFO] Registry Path: {self.registry_path}")
+        print(f"[INFO] Registry Revision: {self.registry.get('revision', 0)}")
         print(f"[INFO] LuaEnv Root: {self.luaenv_root}")
         print(f"[INFO] Total Installations: {len(installations)}")
 
@@ -857,6 +1191,23 @@ class LuaEnvRegistry:
                 print(f"    Build: {installation['build_type']} {installation['build_config']}")
                 if installation['last_used']:
                     print(f"    Last used: {installation['last_used']}")
+                if installation.get("build_group"):
+                    siblings = sum(1 for other in installations
+                                   if other.get("build_group") == installation["build_group"]) - 1
+                    print(f"    Build group: {installation['build_group']} ({siblings} sibling(s))")
+                timeline = installation.get("install_timeline")
+                if timeline:
+                    slowest = slowest_phase(timeline)
+                    print(f"    Install time: {timeline['total']:.1f}s"
+                          f" (slowest phase: {slowest['name']}, {slowest['duration']:.1f}s)")
+                index = self.get_module_index_status(installation)
+                if index["state"] == "missing":
+                    print("    Module index: not built (run 'luaenv activate')")
+                else:
+                    detail = f"{index['modules']} modules, built {_format_age(index['age'])} ago"
+                    if index["state"] == "stale":
+                        detail += f"; tree changed {_format_age(index['stale_by'])} later, rebuilt on next activation"
+                    print(f"    Module index: {index['state']} ({detail})")
 
     def install_fsharp_cli_with_deps(self, publish_dir_path: Path, force: bool = False) -> bool:
         """Install F# CLI with all dependencies from publish directory.
@@ -894,6 +1245,17 @@ class LuaEnvRegistry:
             print(f"[ERROR] Main executable not found: {exe_file}")
             return False
 
+        # NativeAOT publishes no managed LuaEnv.CLI.dll; self-contained ones carry the runtime
+        if not (publish_dir_path / "LuaEnv.CLI.dll").exists():
+            publish_kind = "native (NativeAOT)"
+        elif (publish_dir_path / "hostfxr.dll").exists():
+            publish_kind = "self-contained"
+        else:
+            publish_kind = "framework-dependent"
+            if not shutil.which("dotnet"):
+                print("[WARNING] This CLI build needs the .NET 8 runtime, which was not found on PATH")
+                print("[INFO] Rebuild with .\\build_cli.ps1 -SelfContained or -Publish ReadyToRun to bundle it")
+
         if cli_dir.exists() and not force:
             print(f"[INFO] F# CLI already installed at: {cli_dir}")
             print("[INFO] Use --force to overwrite")
@@ -913,7 +1275,7 @@ class LuaEnvRegistry:
 
             # Copy entire publish directory
             shutil.copytree(publish_dir_path, cli_dir)
-            print(f"[OK] Installed F# CLI with dependencies: {cli_dir}")
+            print(f"[OK] Installed F# CLI with dependencies ({publish_kind}): {cli_dir}")
 
             return True
 
@@ -938,6 +1300,9 @@ def main():
 
     # Status command
     status_parser = subparsers.add_parser('status', help='Show registry status')
+    status_parser.add_argument('id_or_alias', nargs='*', help='Installations shown by --timings (default: all)')
+    status_parser.add_argument('--timings', action='store_true', help='Show the per-phase install timelines')
+    status_parser.add_argument('--json', action='store_true', help='Print the timelines as JSON (with --timings)')
 
     # Remove command
     remove_parser = subparsers.add_parser('remove', help='Remove installation')
@@ -966,6 +1331,17 @@ def main():
     cleanup_parser = subparsers.add_parser('cleanup', help='Clean up broken installations')
     cleanup_parser.add_argument('--yes', action='store_true', help='Skip confirmation')
 
+    # Disk usage command
+    usage_parser = subparsers.add_parser('usage', help='Measure and show the disk usage of installations')
+    usage_parser.add_argument('id_or_alias', nargs='*', help='Installation IDs or aliases (default: all)')
+    usage_parser.add_argument('--force', action='store_true', help='Measure even when the stored usage is current')
+    usage_parser.add_argument('--quiet', action='store_true', help='Only update the registry')
+
+    # Shared store command
+    store_parser = subparsers.add_parser('store', help='Manage the store of files shared by installations')
+    store_parser.add_argument('action', nargs='?', default='info', choices=['info', 'dedupe', 'gc'],
+                              help='info (default), dedupe (share identical rock files) or gc (drop unused files)')
+
     # Install scripts command
     install_scripts_parser = subparsers.add_parser('install-scripts', help='Install LuaEnv scripts')
     install_scripts_parser.add_argument('--force', action='store_true', help='Force install/overwrite scripts')
@@ -1021,7 +1397,17 @@ def main():
                 print(f"    Build: {installation['build_type']} {installation['build_config']}")
 
     elif args.command == 'status':
-        registry.print_status()
+        if not (args.timings or args.json):
+            registry.print_status()
+            return
+        ids = []
+        for id_or_alias in args.id_or_alias:
+            installation_id = registry.resolve_id(id_or_alias)
+            if not installation_id:
+                print_error(f"Installation not found: {id_or_alias}")
+                return 1
+            ids.append(installation_id)
+        registry.print_timings(ids or list(registry.registry["installations"]), as_json=args.json)
 
     elif args.command == 'remove':
         registry.remove_installation(args.id_or_alias, confirm=not args.yes)
@@ -1043,6 +1429,8 @@ def main():
         print(f"  Valid: {len(validation['valid'])}")
         print(f"  Broken: {len(validation['broken'])}")
         print(f"  Missing: {len(validation['missing'])}")
+        if validation['building']:
+            print(f"  Building: {len(validation['building'])}")
 
         if validation['broken']:
             print("[WARNING] Broken installations:")
@@ -1071,6 +1459,38 @@ def main():
         else:
             print("[OK] No cleanup needed - everything is clean!")
 
+    elif args.command == 'usage':
+        ids = []
+        for id_or_alias in args.id_or_alias:
+            installation_id = registry.resolve_id(id_or_alias)
+            if not installation_id:
+                print_error(f"Installation not found: {id_or_alias}")
+                return 1
+            ids.append(installation_id)
+        measured = registry.refresh_disk_usage(ids or None, force=args.force)
+        if not args.quiet:
+            for installation_id in ids or list(registry.registry["installations"]):
+                installation = registry.registry["installations"][installation_id]
+                usage = installation["disk_usage"]
+                trees = [usage[tree] for tree in ("installation", "environment") if usage[tree]]
+                total = sum(tree["bytes"] for tree in trees)
+                shared = sum(tree["shared"] for tree in trees)
+                print(f"  {installation['name']} ({installation_id[:8]}): {format_file_size(total)}"
+                      f" (unique {format_file_size(total - shared)}, shared {format_file_size(shared)})")
+            print(f"[INFO] Measured {measured} installation(s), the others were current")
+
+    elif args.command == 'store':
+        if args.action == 'dedupe':
+            if not registry.deduplicate_trees():
+                print("[INFO] No new identical rock files found")
+        elif args.action == 'gc':
+            if not registry.release_shared_files():
+                print("[INFO] No unused shared files found")
+        info = registry.store.get_store_info()
+        print(f"[INFO] Shared store: {info['store_dir']}")
+        print(f"  Objects: {info['object_count']} ({info['formatted_size']}), "
+              f"linked {info['link_count']} times from installations")
+
     elif args.command == 'install-scripts':
         print("[INFO] Installing LuaEnv scripts to global bin directory...")
         try:
@@ -0,0 +1,263 @@
+# This is free and unencumbered software released into the public domain.
+# For more details, see the LICENSE file in the project root.
+"""
+On-disk storage of the LuaEnv registry.
+
+The registry is kept as a compacted snapshot (registry.json) plus a journal of
+the changes made since (registry.journal, one JSON record per line):
+
+    {"revision": 12, "updated": "...", "op": "put", "table": "installations", "key": "<uuid>", "value": {...}}
+    {"revision": 13, "updated": "...", "op": "delete", "table": "aliases", "key": "dev"}
+    {"revision": 14, "updated": "...", "op": "default", "value": "<uuid>"}
+
+Every change gets the next revision number. The snapshot records the revision it
+contains ("revision"); journal records up to that revision are left over from an
+interrupted compaction and are skipped. A torn last line (a writer that died
+mid-append) is ignored. registry.revision holds the current revision as plain
+text, so the frontends (registry.py, LuaEnv.CLI and the PowerShell module) can
+check whether their cached copy is current without reading the registry.
+
+Writers hold registry.lock while they append. Readers take no lock: the snapshot
+is only ever replaced atomically, and a reader that sees it replaced while it
+read the journal starts over.
+"""
+
+import contextlib
+import json
+import os
+import shutil
+import time
+from pathlib import Path
+from typing import Dict, Iterable, List, Optional
+
+if os.name == "nt":
+    import msvcrt
+else:
+    import fcntl
+
+
+# The journal is folded into the snapshot once it grows past this size
+COMPACT_JOURNAL_BYTES = 64 * 1024
+# Seconds a writer waits for another process to release the registry lock
+LOCK_TIMEOUT = 60.0
+# Tables of the registry that journal records address by key
+TABLES = ("installations", "aliases")
+
+
+def apply_record(registry: Dict, record: Dict) -> None:
+    """Apply one journal record to a registry dict."""
+    op = record.get("op")
+    if op == "put":
+        registry.setdefault(record["table"], {})[record["key"]] = record["value"]
+    elif op == "delete":
+        registry.setdefault(record["table"], {}).pop(record["key"], None)
+    elif op == "default":
+        registry["default_installation"] = record["value"]
+    registry["revision"] = record["revision"]
+    registry["updated"] = record.get("updated", registry.get("updated"))
+
+
+def diff_registry(base: Dict, current: Dict) -> List[Dict]:
+    """Journal records (without revision) that turn base into current."""
+    records = []
+    for table in TABLES:
+        old, new = base.get(table, {}), current.get(table, {})
+        for key, value in new.items():
+            if key not in old or old[key] != value:
+                records.append({"op": "put", "table": table, "key": key, "value": value})
+        for key in old:
+            if key not in new:
+                records.append({"op": "delete", "table": table, "key": key})
+    if base.get("default_installation") != current.get("default_installation"):
+        records.append({"op": "default", "value": current.get("default_installation")})
+    return records
+
+
+@contextlib.contextmanager
+def exclusive_lock(lock_path: Path, timeout: float = LOCK_TIMEOUT, description: str = "lock"):
+    """Hold an exclusive lock on lock_path, shared with other processes.
+
+    Raises:
+        TimeoutError: Another process held the lock for longer than timeout seconds
+    """
+    lock_path = Path(lock_path)
+    lock_path.parent.mkdir(parents=True, exist_ok=True)
+    fd = os.open(lock_path, os.O_RDWR | os.O_CREAT)
+    deadline = time.monotonic() + timeout
+    try:
+        while True:
+            try:
+                if os.name == "nt":
+                    msvcrt.locking(fd, msvcrt.LK_NBLCK, 1)
+                else:
+                    fcntl.flock(fd, fcntl.LOCK_EX | fcntl.LOCK_NB)
+                break
+            except OSError:
+                if time.monotonic() >= deadline:
+                    raise TimeoutError(f"Timed out waiting for the {description} ({lock_path})")
+                time.sleep(0.05)
+
+        try:
+            yield
+        finally:
+            if os.name == "nt":
+                os.lseek(fd, 0, os.SEEK_SET)
+                msvcrt.locking(fd, msvcrt.LK_UNLCK, 1)
+            else:
+                fcntl.flock(fd, fcntl.LOCK_UN)
+    finally:
+        os.close(fd)
+
+
+def _replace(source: Path, target: Path, attempts: int = 20) -> None:
+    """os.replace, retried while a reader on Windows still has the target open."""
+    for attempt in range(attempts):
+        try:
+            os.replace(source, target)
+            return
+        except PermissionError:
+            if attempt == attempts - 1:
+                raise
+            time.sleep(0.05)
+
+
+class RegistryStore:
+    """Locked, journaled storage of registry.json and its companion files."""
+
+    def __init__(self, snapshot_path: Path):
+        self.snapshot_path = Path(snapshot_path)
+        self.journal_path = self.snapshot_path.with_suffix(".journal")
+        self.revision_path = self.snapshot_path.with_suffix(".revision")
+        self.lock_path = self.snapshot_path.with_suffix(".lock")
+        self.backup_path = self.snapshot_path.with_suffix(".json.backup")
+        self._lock_depth = 0
+
+    @contextlib.contextmanager
+    def lock(self, timeout: float = LOCK_TIMEOUT):
+        """Hold the registry write lock (reentrant within this object)."""
+        if self._lock_depth:
+            self._lock_depth += 1
+            try:
+                yield
+            finally:
+                self._lock_depth -= 1
+            return
+
+        with exclusive_lock(self.lock_path, timeout, "registry lock"):
+            self._lock_depth = 1
+            try:
+                yield
+            finally:
+                self._lock_depth = 0
+
+    def read_revision(self) -> Optional[int]:
+        """Current revision from registry.revision (None when missing or being written)."""
+        try:
+            return int(self.revision_path.read_text(encoding="ascii").strip())
+        except (OSError, ValueError):
+            return None
+
+    def _write_revision(self, revision: int) -> None:
+        # Written in place: a reader that catches it empty just reloads
+        with open(self.revision_path, "w", encoding="ascii") as f:
+            f.write(str(revision))
+
+    def _snapshot_stamp(self):
+        try:
+            stat = self.snapshot_path.stat()
+            return (stat.st_mtime_ns, stat.st_size, stat.st_ino)
+        except FileNotFoundError:
+            return None
+
+    def _read_journal(self, after: int) -> List[Dict]:
+        """Journal records with a revision above after, stopping at a torn line."""
+        records = []
+        try:
+            with open(self.journal_path, "r", encoding="utf-8") as f:
+                lines = f.readlines()
+        except FileNotFoundError:
+            return records
+        for line in lines:
+            if not line.endswith("\n"):
+                break
+            try:
+                record = json.loads(line)
+            except json.JSONDecodeError:
+                break
+            if record.get("revision", 0) > after:
+                records.append(record)
+        return records
+
+    def load(self) -> Optional[Dict]:
+        """Read the snapshot and replay the journal on top of it.
+
+        Returns:
+            The registry dict, or None when there is no registry yet
+
+        Raises:
+            json.JSONDecodeError: The snapshot is corrupt
+        """
+        for _ in range(10):
+            stamp = self._snapshot_stamp()
+            if stamp is None and not self.journal_path.exists():
+                return None
+            registry = {}
+            if stamp is not None:
+                with open(self.snapshot_path, "r", encoding="utf-8") as f:
+                    registry = json.load(f)
+            registry.setdefault("revision", 0)
+
+            for record in self._read_journal(registry["revision"]):
+                if record["revision"] != registry["revision"] + 1:
+                    break
+                apply_record(registry, record)
+
+            # A compaction replaced the snapshot while the journal was read
+            if self._snapshot_stamp() == stamp:
+                return registry
+        return registry
+
+    def append(self, registry: Dict, records: Iterable[Dict], updated: str) -> int:
+        """Number records from registry's revision on, journal them and apply them to registry.
+
+        The caller holds the lock and registry is the current on-disk state.
+
+        Returns:
+            The new revision
+        """
+        lines = []
+        for record in records:
+            record = dict(record, revision=registry.get("revision", 0) + 1, updated=updated)
+            apply_record(registry, record)
+            lines.append(json.dumps(record, ensure_ascii=False) + "\n")
+
+        if not self.snapshot_path.exists():
+            self.compact(registry)
+            return registry["revision"]
+
+        with open(self.journal_path, "a", encoding="utf-8") as f:
+            f.writelines(lines)
+            f.flush()
+            os.fsync(f.fileno())
+        self._write_revision(registry["revision"])
+
+        if self.journal_path.stat().st_size > COMPACT_JOURNAL_BYTES:
+            self.compact(registry)
+        return registry["revision"]
+
+    def compact(self, registry: Dict) -> None:
+        """Write registry as the new snapshot and empty the journal (caller holds the lock)."""
+        if self.snapshot_path.exists():
+            shutil.copy2(self.snapshot_path, self.backup_path)
+
+        temp = self.snapshot_path.with_name(f"{self.snapshot_path.name}.{os.getpid()}.tmp")
+        with open(temp, "w", encoding="utf-8") as f:
+            json.dump(registry, f, indent=2, ensure_ascii=False)
+            f.flush()
+            os.fsync(f.fileno())
+        _replace(temp, self.snapshot_path)
+
+        # Records up to the snapshot's revision are skipped if this is interrupted
+        with open(self.journal_path, "w", encoding="utf-8"):
+            pass
+        self._write_revision(registry.get("revision", 0))
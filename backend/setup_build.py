@@ -111,6 +111,14 @@ def copy_build_scripts():
             shutil.copy(os.path.join(build_scripts_dir, "build-static.bat"), str(lua_dir))
             print(f"  build-static.bat -> {lua_dir}")
 
+        # Shared by every build script: parallel, incremental compilation
+        shutil.copy(os.path.join(build_scripts_dir, "compile-lua.bat"), str(lua_dir))
+        print(f"  compile-lua.bat -> {lua_dir}")
+
+        # Training workload for build.py --optimize pgo
+        shutil.copy(os.path.join(build_scripts_dir, "pgo-training.lua"), str(lua_dir))
+        print(f"  pgo-training.lua -> {lua_dir}")
+
         print("Copying LuaRocks setup script...")
         shutil.copy(os.path.join(build_scripts_dir, "setup-luarocks.bat"), str(luarocks_dir))
         print(f"  setup-luarocks.bat -> {luarocks_dir}")
@@ -11,8 +11,13 @@ Each installation gets a unique UUID and is tracked in the central registry.
 """
 
 import os
+import shutil
 import subprocess
 import sys
+import time
+import itertools
+from concurrent.futures import ThreadPoolExecutor, as_completed
+from datetime import datetime
 from pathlib import Path
 import argparse
 
@@ -27,7 +32,11 @@ try:
         LUA_VERSION, LUAROCKS_VERSION
     )
     from .registry import LuaEnvRegistry
+    from .registry_store import exclusive_lock
+    from . import lua_tests
     from .utils import info, warning, error, debug, log_with_location
+    from . import vs_env_cache
+    from . import install_timeline
 
 except ImportError:
     from config import (
@@ -35,8 +44,15 @@ except ImportError:
         LUA_VERSION, LUAROCKS_VERSION
     )
     from registry import LuaEnvRegistry
+    from registry_store import exclusive_lock
+    import lua_tests
     from utils import info, warning, error, debug, log_with_location
-    from utils import info, warning, error, debug, log_with_location
+    import vs_env_cache
+    import install_timeline
+
+
+# Seconds an install job waits for another job to finish downloading
+DOWNLOAD_LOCK_TIMEOUT = 1800.0
 
 
 def try_powershell_setenv(architecture="x64"):
@@ -139,6 +155,13 @@ def python_setenv_enhanced(architecture="x64"):
 
     # Helper function to run vcvars and capture environment
     def run_vcvars_and_capture_env(vcvars_path, original_cwd, arch_display):
+        # <install>\VC\Auxiliary\Build\vcvarsXX.bat: reuse or fill the persistent cache
+        install_path = Path(vcvars_path).parents[3]
+        if vs_env_cache.import_environment(install_path, architecture):
+            log_with_location(f"Applied Visual Studio environment of {install_path}", "OK")
+            info(f"Target architecture: {arch_display}")
+            return True
+
         try:
             import tempfile
             with tempfile.NamedTemporaryFile(mode='w', suffix='.bat', delete=False) as f:
@@ -293,6 +316,13 @@ def setenv(architecture="x64"):
     """Set Visual Studio environment with PowerShell fallback to Python methods."""
     info(f"Setting up Visual Studio environment for {architecture}...")
 
+    # An environment cached by an earlier session (Python or PowerShell) needs no vcvars run
+    cached = vs_env_cache.load(architecture)
+    if cached:
+        vs_env_cache.apply(cached)
+        log_with_location(f"Using cached Visual Studio environment: {cached['install_path']}", "OK")
+        return True
+
     # Try PowerShell method first
     info("Attempting to use PowerShell setenv.ps1 script...")
     if try_powershell_setenv(architecture):
@@ -399,18 +429,23 @@ def call_check_env_bat_script():
         return True
 
 
-def download_sources():
-    """Download and extract Lua and LuaRocks sources."""
+def download_sources(env=None):
+    """Download and extract Lua and LuaRocks sources.
+
+    The download cache is shared by all install jobs, so one job downloads at a
+    time; the archives are extracted into the job's own workspace.
+    """
     current_dir = os.path.dirname(os.path.abspath(__file__))
     download_script = os.path.join(current_dir, "download_lua_luarocks.py")
 
     print("[PROGRESS] Starting download process...")
     info("Downloading sources...")
-    subprocess.run([sys.executable, download_script], check=True, env=os.environ.copy())
+    with exclusive_lock(Path("downloads") / ".lock", DOWNLOAD_LOCK_TIMEOUT, "downloads lock"):
+        subprocess.run([sys.executable, download_script], check=True, env=env or os.environ.copy())
     print("[PROGRESS] Download completed successfully")
 
 
-def setup_build_scripts(with_dll=False, with_debug=False):
+def setup_build_scripts(with_dll=False, with_debug=False, env=None):
     """Copy build scripts to extracted directories."""
     current_dir = os.path.dirname(os.path.abspath(__file__))
     setup_build_script = os.path.join(current_dir, "setup_build.py")
@@ -422,11 +457,11 @@ def setup_build_scripts(with_dll=False, with_debug=False):
         setup_build_args.append("--dll")
     if with_debug:
         setup_build_args.append("--debug")
-    subprocess.run(setup_build_args, check=True, env=os.environ.copy())
+    subprocess.run(setup_build_args, check=True, env=env or os.environ.copy())
     print("[PROGRESS] Build scripts setup completed")
 
 
-def build_lua(installation_path, with_dll=False, with_debug=False):
+def build_lua(installation_path, with_dll=False, with_debug=False, optimize=None, env=None):
     """Build and install Lua to the specified path."""
     current_dir = os.path.dirname(os.path.abspath(__file__))
     build_script = os.path.join(current_dir, "build.py")
@@ -452,12 +487,94 @@ def build_lua(installation_path, with_dll=False, with_debug=False):
         build_args.append("--dll")
     if with_debug:
         build_args.append("--debug")
-    subprocess.run(build_args, check=True, env=os.environ.copy())
+    if optimize:
+        build_args.extend(["--optimize", optimize])
+    subprocess.run(build_args, check=True, env=env or os.environ.copy())
     print("[PROGRESS] Lua build completed successfully")
 
 
-def test_lua_build(installation_path, lua_version, run_tests=True):
-    """Test the Lua build by running basic commands and test suite."""
+def write_build_config(config_file, lua_version, luarocks_version, architecture="x64"):
+    """Write the private build_config.txt of one install job."""
+    parts = lua_version.split('.')
+    major_minor = f"{parts[0]}.{parts[1]}" if len(parts) >= 2 else lua_version
+    platform = "windows-32" if architecture == "x86" else "windows-64"
+    with open(config_file, 'w', encoding='utf-8') as f:
+        f.write("# Configuration of one install job (generated by setup_lua.py)\n")
+        f.write("\n")
+        f.write(f"LUA_VERSION={lua_version}\n")
+        f.write(f"LUA_MAJOR_MINOR={major_minor}\n")
+        f.write(f"LUAROCKS_VERSION={luarocks_version}\n")
+        f.write(f"LUAROCKS_PLATFORM={platform}\n")
+
+
+def prepare_shared_sources(sources_dir, lua_version, luarocks_version, architecture, build_types, build_config):
+    """Download and extract the sources of a matrix build once, with the build scripts of every build type.
+
+    The jobs of the matrix link this tree into their workspaces (see link_shared_sources)
+    instead of downloading and extracting the same archives each.
+    """
+    sources_dir = Path(sources_dir)
+    sources_dir.mkdir(parents=True, exist_ok=True)
+    config_file = sources_dir / "build_config.txt"
+    write_build_config(config_file, lua_version, luarocks_version, architecture)
+    env = dict(os.environ, LUAENV_WORKSPACE=str(sources_dir), LUAENV_BUILD_CONFIG=str(config_file))
+    download_sources(env=env)
+    for build_type in build_types:
+        setup_build_scripts(with_dll=(build_type == "dll"), with_debug=(build_config == "debug"), env=env)
+
+
+def link_shared_sources(sources_dir, workspace):
+    """Hardlink the extracted tree of prepared sources into a job workspace.
+
+    The build only adds files (objects and outputs go to Release or Debug below
+    the job's own tree), so jobs never write to a shared file and each variant
+    has its own output directories. Files are copied where linking fails.
+
+    Returns:
+        Number of files placed in the workspace
+    """
+    source = Path(sources_dir) / "extracted"
+    target = Path(workspace) / "extracted"
+    count = 0
+    for root, _, files in os.walk(source):
+        destination = target / Path(root).relative_to(source)
+        destination.mkdir(parents=True, exist_ok=True)
+        for name in files:
+            try:
+                os.link(os.path.join(root, name), destination / name)
+            except OSError:
+                shutil.copy2(os.path.join(root, name), destination / name)
+            count += 1
+    return count
+
+
+def prepare_toolchains(architectures):
+    """Import the Visual Studio environment of each architecture once, so matrix jobs start from the cache."""
+    for architecture in architectures:
+        if vs_env_cache.load(architecture):
+            continue
+        print(f"[PROGRESS] Importing the Visual Studio environment for {architecture}...")
+        # setenv applies the environment to this process; the jobs only need the cache it fills
+        saved = dict(os.environ)
+        try:
+            if not setenv(architecture):
+                warning(f"No Visual Studio environment for {architecture}, its jobs will try again")
+        finally:
+            os.environ.clear()
+            os.environ.update(saved)
+
+
+def test_lua_build(installation_path, lua_version, run_tests=True, tests_dir=None,
+                   suite="full", jobs=None):
+    """Test the Lua build by running basic commands and test suite.
+
+    The test files run concurrently, one process each (see lua_tests.py).
+
+    Args:
+        tests_dir: Extracted Lua test suite (backend/extracted by default)
+        suite: "full" or "smoke" (a short subset for CI)
+        jobs: Test files run at a time (default: one per CPU)
+    """
     lua_exe = Path(installation_path) / "bin" / "lua.exe"
 
     if not lua_exe.exists():
@@ -482,46 +599,36 @@ def test_lua_build(installation_path, lua_version, run_tests=True):
         # Test 3: Run test suite if requested
         if run_tests:
             print("[PROGRESS] Running comprehensive test suite...")
-            current_dir = os.path.dirname(os.path.abspath(__file__))
-            tests_dir = Path(current_dir) / "extracted" / get_lua_tests_dir_name()
-            if tests_dir.exists():
-                log_with_location(f"Running Lua {lua_version} basic test suite...", "INFO")
+            if tests_dir is None:
+                current_dir = os.path.dirname(os.path.abspath(__file__))
+                tests_dir = Path(current_dir) / "extracted" / get_lua_tests_dir_name()
+            tests_dir = Path(tests_dir)
+            files = lua_tests.select_tests(lua_tests.discover_test_files(tests_dir), suite)
+            if files:
+                jobs = jobs or lua_tests.default_jobs()
+                log_with_location(f"Running Lua {lua_version} {suite} test suite ({len(files)} files, {jobs} parallel)...", "INFO")
                 info("Running basic tests (_U=true flag) - some warnings are normal.")
 
-                original_cwd = os.getcwd()
-                abs_lua_exe = os.path.abspath(lua_exe)
-
+                started = time.monotonic()
                 try:
-                    os.chdir(tests_dir)
-                    info("Running: lua.exe -e \"_U=true\" all.lua (Basic Test Suite)")
-                    result = subprocess.run([abs_lua_exe, "-e", "_U=true", "all.lua"],
-                                          capture_output=True, text=True, timeout=300)
-
-                    if result.returncode == 0:
-                        log_with_location("Basic test suite completed successfully!", "OK")
-                        lines = result.stdout.split('\n')
-                        for line in lines[-10:]:
-                            if line.strip():
-                                print(f"  {line}")
-                    else:
-                        info("Basic test suite completed with issues:")
-                        # print("  STDOUT:")
-                        # for line in result.stdout.split('\n')[-20:]:
-                        #     if line.strip():
-                        #         print(f"    {line}")
-                        # print("  STDERR:")
-                        # for line in result.stderr.split('\n')[-10:]:
-                        #     if line.strip():
-                        #         print(f"    {line}")
-
-                        print(f"\n[TIP] Some test failures are common on Windows for Lua {lua_version}.")
-                        print("  These are common for x86 builds and builds with --debug flag.")
-                        print("  Your Lua build is likely fine for normal use.")
-                        return False
-
+                    with install_timeline.phase("tests", files=len(files)) as counters:
+                        results = lua_tests.run_suite(lua_exe, tests_dir, files, jobs=jobs)
+                        passed = lua_tests.print_report(results)
+                        counters["passed"] = passed
                 finally:
-                    os.chdir(original_cwd)
-                    print("[PROGRESS] Test suite completed")
+                    print(f"[PROGRESS] Test suite completed ({time.monotonic() - started:.1f}s)")
+
+                if passed:
+                    log_with_location("Basic test suite completed successfully!", "OK")
+                else:
+                    info("Basic test suite completed with issues.")
+                    print(f"\n[TIP] Some test failures are common on Windows for Lua {lua_version}.")
+                    print("  These are common for x86 builds and builds with --debug flag.")
+                    print("  Your Lua build is likely fine for normal use.")
+                    return False
+            elif tests_dir.exists():
+                warning(f"No test files found in {tests_dir / 'all.lua'}.")
+                return False
             else:
                 warning(f"Tests directory {tests_dir} not found.")
                 return False
@@ -545,16 +652,29 @@ def test_lua_build(installation_path, lua_version, run_tests=True):
 
 
 def create_installation(lua_version, luarocks_version, build_type, build_config,
-                       name=None, alias=None, architecture="x64", skip_env_check=False, skip_tests=False):
-    """Create a new Lua installation in the LuaEnv system."""
+                       name=None, alias=None, architecture="x64", skip_env_check=False, skip_tests=False,
+                       test_suite="full", test_jobs=None, shared_sources=None, build_group=None):
+    """Create a new Lua installation in the LuaEnv system.
+
+    The phases of the install are timed (see install_timeline.py) and stored
+    with the installation record.
+
+    Args:
+        shared_sources: Sources prepared by prepare_shared_sources; used instead of
+            downloading and extracting them (matrix builds)
+        build_group: Name shared by the installations of one matrix build
+    """
+    origin = time.monotonic()
 
     # Initialize registry
     registry = LuaEnvRegistry()
 
     # Check environment unless explicitly skipped
+    vcvars_duration = None
     if not skip_env_check:
         print("[PROGRESS] Setting up Visual Studio environment...")
         env_set = setenv(architecture)
+        vcvars_duration = time.monotonic() - origin
         if not env_set:
             error("Environment setup failed. Build cannot proceed.")
             print("[INFO] To fix this issue:")
@@ -567,42 +687,107 @@ def create_installation(lua_version, luarocks_version, build_type, build_config,
             error("Installation cancelled due to environment setup failure.")
             return None
 
-    # Create installation record in registry
     info(f"Creating new installation: Lua {lua_version}, LuaRocks {luarocks_version}")
     info(f"Build: {build_type} {build_config}")
 
-    installation_id = registry.create_installation(
-        lua_version=lua_version,
-        luarocks_version=luarocks_version,
-        build_type=build_type,
-        build_config=build_config,
-        architecture=architecture,
-        name=name,
-        alias=alias
-    )
-
-    installation = registry.get_installation(installation_id)
-    installation_path = Path(installation["installation_path"])
+    # Private workspace: sources, build outputs and build config of this job only.
+    # Its lock tells other jobs (and cleanup) that the installation is still building,
+    # so it is taken before the installation is registered as "building".
+    installation_id = registry.generate_installation_id()
+    workspace = registry.get_workspace_dir(installation_id)
+    workspace.mkdir(parents=True, exist_ok=True)
+
+    # Every step, in this process or a child, appends its phases to the workspace timeline
+    timeline_file = workspace / "timeline.jsonl"
+    os.environ[install_timeline.TIMELINE_ENV] = str(timeline_file)
+    install_timeline.record_launch(origin)
+    if vcvars_duration is not None:
+        install_timeline.record_phase("vcvars", origin, vcvars_duration)
+    try:
+        with exclusive_lock(workspace / ".lock", description="workspace lock"):
+            # Create installation record in registry
+            registry.create_installation(
+                lua_version=lua_version,
+                luarocks_version=luarocks_version,
+                build_type=build_type,
+                build_config=build_config,
+                architecture=architecture,
+                name=name,
+                alias=alias,
+                build_group=build_group,
+                installation_id=installation_id
+            )
+            installation_path = Path(registry.get_installation(installation_id)["installation_path"])
+            return _build_installation(registry, installation_id, installation_path, workspace,
+                                       lua_version, luarocks_version, build_type, build_config,
+                                       alias, architecture, skip_tests, test_suite, test_jobs,
+                                       shared_sources)
+    finally:
+        os.environ.pop(install_timeline.TIMELINE_ENV, None)
+        _store_timeline(registry, installation_id, timeline_file, origin)
+        if os.environ.get("LUAENV_KEEP_WORKSPACE") != "1":
+            shutil.rmtree(workspace, ignore_errors=True)
+
+
+def _store_timeline(registry, installation_id, timeline_file, origin):
+    """Print the timeline of an install and keep it with the installation, if it still exists."""
+    installation = registry.get_installation_by_id(installation_id, allow_partial=False)
+    status = installation["status"] if installation else "removed"
+    timeline = install_timeline.load_timeline(timeline_file, origin, status)
+    if timeline is None:
+        return
+    print("[INFO] Install timeline:")
+    for line in install_timeline.format_timeline(timeline):
+        print(line)
+    if installation:
+        try:
+            registry.record_install_timeline(installation_id, timeline)
+        except OSError as e:
+            warning(f"Could not store the install timeline: {e}")
+
+
+def _build_installation(registry, installation_id, installation_path, workspace,
+                        lua_version, luarocks_version, build_type, build_config,
+                        alias, architecture, skip_tests, test_suite="full", test_jobs=None,
+                        shared_sources=None):
+    """Download, build and test an installation inside its workspace (lock held)."""
+    config_file = workspace / "build_config.txt"
+    write_build_config(config_file, lua_version, luarocks_version, architecture)
+    # Passed explicitly to every build step instead of editing the shared build_config.txt
+    env = dict(os.environ, LUAENV_WORKSPACE=str(workspace), LUAENV_BUILD_CONFIG=str(config_file))
+    tests_dir = workspace / "extracted" / f"lua-{lua_version}-tests"
 
     try:
-        # Step 1: Download sources
-        print("[PROGRESS] Downloading Lua sources...")
-        download_sources()
-
-        # Step 2: Setup build scripts
-        print("[PROGRESS] Setting up build scripts...")
-        setup_build_scripts(
-            with_dll=(build_type == "dll"),
-            with_debug=(build_config == "debug")
-        )
+        if shared_sources:
+            # Steps 1 and 2: sources and build scripts were prepared once for the whole matrix
+            print("[PROGRESS] Linking prepared sources...")
+            with install_timeline.phase("link-sources") as counters:
+                counters["files"] = link_shared_sources(shared_sources, workspace)
+        else:
+            # Step 1: Download sources
+            print("[PROGRESS] Downloading Lua sources...")
+            with install_timeline.phase("download"):
+                download_sources(env=env)
+
+            # Step 2: Setup build scripts
+            print("[PROGRESS] Setting up build scripts...")
+            with install_timeline.phase("build-scripts"):
+                setup_build_scripts(
+                    with_dll=(build_type == "dll"),
+                    with_debug=(build_config == "debug"),
+                    env=env
+                )
 
         # Step 3: Build and install
         print("[PROGRESS] Building Lua with MSVC...")
-        build_lua(
-            installation_path,
-            with_dll=(build_type == "dll"),
-            with_debug=(build_config == "debug")
-        )
+        with install_timeline.phase("build"):
+            build_lua(
+                installation_path,
+                with_dll=(build_type == "dll"),
+                with_debug=(build_config == "debug"),
+                optimize=("pgo" if build_config == "pgo" else None),
+                env=env
+            )
 
         # Step 4: Test installation
         if not skip_tests:
@@ -610,7 +795,8 @@ def create_installation(lua_version, luarocks_version, build_type, build_config,
             print("\n" + "="*60)
             print("TESTING INSTALLATION")
             print("="*60)
-            test_success = test_lua_build(installation_path, lua_version, run_tests=True)
+            test_success = test_lua_build(installation_path, lua_version, run_tests=True, tests_dir=tests_dir,
+                                          suite=test_suite, jobs=test_jobs)
             if not test_success:
                 print("Some tests did not pass, but installation may still be usable.")
             else:
@@ -618,7 +804,8 @@ def create_installation(lua_version, luarocks_version, build_type, build_config,
         else:
             # Run minimal test even when tests are skipped
             print("[PROGRESS] Running basic validation...")
-            test_success = test_lua_build(installation_path, lua_version, run_tests=False)
+            with install_timeline.phase("validate"):
+                test_success = test_lua_build(installation_path, lua_version, run_tests=False)
             if not test_success:
                 info("Basic functionality test failed.")
                 registry.update_status(installation_id, "broken")
@@ -627,6 +814,14 @@ def create_installation(lua_version, luarocks_version, build_type, build_config,
         # Mark installation as active
         registry.update_status(installation_id, "active")
 
+        # Share rock files that other trees gained since the last install
+        with install_timeline.phase("finalize"):
+            try:
+                registry.deduplicate_trees()
+            except OSError as e:
+                warning(f"Could not deduplicate rock trees: {e}")
+            registry.refresh_disk_usage([installation_id])
+
         print("[PROGRESS] Installation completed successfully!")
         log_with_location("Installation completed!", "OK")
         info(f"Installation ID: {installation_id}")
@@ -686,95 +881,113 @@ def list_installations():
         print()
 
 
-def backup_config():
-    """Backup the current config file."""
-    config_file = Path(__file__).parent / "build_config.txt"
-    backup_file = Path(__file__).parent / "build_config.txt.backup"
+def run_matrix(lua_versions, luarocks_version, architectures, build_types, build_config,
+               jobs, skip_env_check=False, skip_tests=False, test_suite="full", test_jobs=None):
+    """Build every version/architecture/build type combination with up to jobs at a time.
 
-    if config_file.exists():
-        import shutil
-        shutil.copy2(str(config_file), str(backup_file))
-        return True
-    return False
+    Each combination is a separate setup_lua.py process, so every job has its own
+    Visual Studio environment and workspace. Their output goes to log files.
 
+    The sources of each Lua version and LuaRocks platform are downloaded and
+    extracted once, and the Visual Studio environment of each architecture is
+    imported once; the jobs link the prepared sources into their workspaces and
+    compile into their own output directories. The installations are registered
+    with the name of the matrix as their build group.
 
-def restore_config():
-    """Restore the backed up config file."""
-    config_file = Path(__file__).parent / "build_config.txt"
-    backup_file = Path(__file__).parent / "build_config.txt.backup"
+    Returns:
+        Process exit code (0 when every job succeeded)
+    """
+    combinations = list(itertools.product(lua_versions, architectures, build_types))
+    log_dir = Path.home() / ".luaenv" / "workspaces" / f"matrix-{datetime.now().strftime('%Y%m%d-%H%M%S')}"
+    log_dir.mkdir(parents=True, exist_ok=True)
 
-    if backup_file.exists():
-        import shutil
-        shutil.copy2(str(backup_file), str(config_file))
-        backup_file.unlink()  # Remove backup file
-        return True
-    return False
-
-
-def create_temp_config(lua_version=None, luarocks_version=None, architecture=None):
-    """Create a temporary config with specified versions and architecture."""
-    config_file = Path(__file__).parent / "build_config.txt"
-
-    # Read current config or use defaults
-    current_config = {}
-    if config_file.exists():
-        try:
-            with open(config_file, 'r', encoding='utf-8') as f:
-                for line in f:
-                    line = line.strip()
-                    if line and not line.startswith('#') and '=' in line:
-                        key, value = line.split('=', 1)
-                        current_config[key.strip()] = value.strip()
-        except Exception as e:
-            print(f"[WARNING] Failed to read current config: {e}")
-
-    # Set defaults if missing
-    if 'LUA_VERSION' not in current_config:
-        current_config['LUA_VERSION'] = '5.4.8'
-    if 'LUA_MAJOR_MINOR' not in current_config:
-        current_config['LUA_MAJOR_MINOR'] = '5.4'
-    if 'LUAROCKS_VERSION' not in current_config:
-        current_config['LUAROCKS_VERSION'] = '3.12.2'
-    if 'LUAROCKS_PLATFORM' not in current_config:
-        current_config['LUAROCKS_PLATFORM'] = 'windows-64'
-
-    # Override with provided versions
-    if lua_version:
-        current_config['LUA_VERSION'] = lua_version
-        # Extract major.minor from version (e.g., "5.4.7" -> "5.4")
-        try:
-            parts = lua_version.split('.')
-            if len(parts) >= 2:
-                current_config['LUA_MAJOR_MINOR'] = f"{parts[0]}.{parts[1]}"
-        except:
-            pass
-
-    if luarocks_version:
-        current_config['LUAROCKS_VERSION'] = luarocks_version
+    info(f"Building {len(combinations)} installations with {jobs} parallel jobs")
+    info(f"Job logs: {log_dir}")
 
-    # Set LUAROCKS_PLATFORM based on architecture
-    if architecture:
+    if not skip_env_check:
+        prepare_toolchains(architectures)
+
+    # LuaRocks ships one archive per platform, Lua one per version
+    shared_sources = {}
+    for lua_version in lua_versions:
+        for platform, platform_architectures in (("windows-32", ["x86"]), ("windows-64", ["x64"])):
+            if not any(a in architectures for a in platform_architectures):
+                continue
+            sources_dir = log_dir / "sources" / f"lua-{lua_version}-{platform}"
+            print(f"[PROGRESS] Preparing sources for Lua {lua_version} ({platform})...")
+            try:
+                prepare_shared_sources(sources_dir, lua_version, luarocks_version or LUAROCKS_VERSION,
+                                       platform_architectures[0], build_types, build_config)
+            except (subprocess.CalledProcessError, OSError) as e:
+                warning(f"Could not prepare sources for Lua {lua_version} ({platform}), its jobs download them: {e}")
+                continue
+            for architecture in platform_architectures:
+                shared_sources[(lua_version, architecture)] = sources_dir
+
+    def run_job(lua_version, architecture, build_type):
+        label = f"lua-{lua_version}-{architecture}-{build_type}-{build_config}"
+        command = [sys.executable, os.path.abspath(__file__), "--lua-version", lua_version]
+        if luarocks_version:
+            command += ["--luarocks-version", luarocks_version]
         if architecture == "x86":
-            current_config['LUAROCKS_PLATFORM'] = 'windows-32'
-            print(f"[INFO] Architecture x86 detected: Setting LUAROCKS_PLATFORM to windows-32")
-        elif architecture == "x64":
-            current_config['LUAROCKS_PLATFORM'] = 'windows-64'
-            print(f"[INFO] Architecture x64 detected: Setting LUAROCKS_PLATFORM to windows-64")
-        else:
-            print(f"[WARNING] Unknown architecture '{architecture}', keeping default LUAROCKS_PLATFORM")
+            command.append("--x86")
+        if build_type == "dll":
+            command.append("--dll")
+        if build_config == "debug":
+            command.append("--debug")
+        elif build_config == "pgo":
+            command += ["--optimize", "pgo"]
+        if skip_env_check:
+            command.append("--skip-env-check")
+        if skip_tests:
+            command.append("--skip-tests")
+        command += ["--test-suite", test_suite]
+        if test_jobs:
+            command += ["--test-jobs", str(test_jobs)]
+        if (lua_version, architecture) in shared_sources:
+            command += ["--sources", str(shared_sources[(lua_version, architecture)])]
+        command += ["--build-group", log_dir.name]
+
+        log_file = log_dir / f"{label}.log"
+        started = time.monotonic()
+        # Time spent waiting for a free job slot is not part of the job's launch
+        env = {k: v for k, v in os.environ.items() if k != install_timeline.STARTED_ENV}
+        with open(log_file, "w", encoding="utf-8", errors="replace") as log:
+            result = subprocess.run(command, stdout=log, stderr=subprocess.STDOUT,
+                                    stdin=subprocess.DEVNULL, cwd=str(current_dir), env=env)
+
+        installation_id = None
+        for line in log_file.read_text(encoding="utf-8", errors="replace").splitlines():
+            if "Installation created with ID:" in line:
+                installation_id = line.rsplit(":", 1)[1].strip()
+        return label, result.returncode, installation_id, time.monotonic() - started, log_file
+
+    results = []
+    with ThreadPoolExecutor(max_workers=jobs) as executor:
+        futures = [executor.submit(run_job, *combination) for combination in combinations]
+        for future in as_completed(futures):
+            label, returncode, installation_id, elapsed, log_file = future.result()
+            results.append((label, returncode, installation_id, elapsed, log_file))
+            status = "OK" if returncode == 0 else "FAILED"
+            print(f"[PROGRESS] {len(results)}/{len(combinations)} {label}: {status} ({elapsed:.0f}s)")
+
+    if os.environ.get("LUAENV_KEEP_WORKSPACE") != "1":
+        shutil.rmtree(log_dir / "sources", ignore_errors=True)
 
-    # Write temporary config
-    try:
-        with open(config_file, 'w', encoding='utf-8') as f:
-            f.write("# Temporary configuration file for per-installation versions\n")
-            f.write("# This file was automatically generated - do not edit manually\n")
-            f.write("\n")
-            for key, value in current_config.items():
-                f.write(f"{key}={value}\n")
-        return True
-    except Exception as e:
-        print(f"[ERROR] Failed to create temporary config: {e}")
-        return False
+    print()
+    print(f"Matrix summary (build group {log_dir.name}):")
+    failed = 0
+    for label, returncode, installation_id, elapsed, log_file in sorted(results):
+        if returncode == 0:
+            print(f"  [OK]     {label}  {installation_id or ''}")
+        else:
+            failed += 1
+            print(f"  [FAILED] {label}  (see {log_file})")
+    if failed:
+        error(f"{failed} of {len(results)} installations failed")
+        return 1
+    log_with_location(f"All {len(results)} installations created", "OK")
+    return 0
 
 
 def remove_installation(id_or_alias):
@@ -795,11 +1008,15 @@ Examples:
   python setup_lua.py --debug                            # Create debug build
   python setup_lua.py --x86                              # Create x86 (32-bit) build
   python setup_lua.py --dll --debug                      # Create DLL debug build
+  python setup_lua.py --optimize pgo                     # Create PGO-optimized static build
   python setup_lua.py --x86 --dll                        # Create x86 DLL build
   python setup_lua.py --name "Development" --alias dev   # Create with custom name and alias
   python setup_lua.py --lua-version 5.4.7 --alias dev   # Use specific Lua version
   python setup_lua.py --luarocks-version 3.11.1          # Use specific LuaRocks version
   python setup_lua.py --list                             # List all installations
+  python setup_lua.py --matrix --lua-version 5.4.8,5.4.7 --arch x86,x64 --build-type static,dll --jobs 4
+                                                         # Build all 8 combinations, 4 at a time
+                                                         # (sources prepared once per version)
   python setup_lua.py --remove dev                       # Remove installation by alias
   python setup_lua.py --remove a1b2c3d4                  # Remove by partial UUID
 
@@ -823,6 +1040,8 @@ Build Types:
   DLL Release:     Optimized DLL build (--dll)
   Static Debug:    Unoptimized static build with debug symbols (--debug)
   DLL Debug:       Unoptimized DLL build with debug symbols (--dll --debug)
+  Static/DLL PGO:  Release build with /GL, /LTCG and profile-guided optimization,
+                   trained on the Lua test suite (--optimize pgo, optionally --dll)
 
 Architectures:
   x64:             64-bit build (default) - uses vcvars64.bat
@@ -846,6 +1065,8 @@ Each installation gets a unique UUID for identification.
                        help="Create debug build with debug symbols")
     parser.add_argument("--x86", action="store_true",
                        help="Create x86 (32-bit) build")
+    parser.add_argument("--optimize", choices=["pgo"],
+                       help="Create a profile-guided optimized (PGO/LTCG) release build")
 
     # Version configuration
     parser.add_argument("--lua-version", metavar="VERSION",
@@ -862,9 +1083,53 @@ Each installation gets a unique UUID for identification.
                        help="Skip Visual Studio environment check")
     parser.add_argument("--skip-tests", action="store_true",
                        help="Skip test suite after building")
+    parser.add_argument("--test-suite", choices=lua_tests.SUITES,
+                       default=os.environ.get("LUAENV_TEST_SUITE") or "full",
+                       help="Lua tests to run: full, or smoke for a short CI subset (default: $LUAENV_TEST_SUITE or full)")
+    parser.add_argument("--test-jobs", type=int, metavar="N",
+                       help="Test files run in parallel (default: one per CPU)")
+
+    # Matrix builds
+    parser.add_argument("--matrix", action="store_true",
+                       help="Build every combination of --lua-version, --arch and --build-type concurrently")
+    parser.add_argument("--arch", metavar="LIST", default=None,
+                       help="Architectures of a matrix build (comma separated: x86,x64)")
+    parser.add_argument("--build-type", metavar="LIST", default=None,
+                       help="Build types of a matrix build (comma separated: static,dll)")
+    parser.add_argument("--jobs", type=int, default=max(1, (os.cpu_count() or 2) // 2),
+                       help="Parallel jobs of a matrix build (default: half the CPU count)")
+    # Set by --matrix for its jobs
+    parser.add_argument("--sources", metavar="DIR", help=argparse.SUPPRESS)
+    parser.add_argument("--build-group", metavar="NAME", help=argparse.SUPPRESS)
 
     args = parser.parse_args()
 
+    if args.optimize and args.debug:
+        parser.error("--optimize cannot be combined with --debug")
+    if args.test_jobs is not None and args.test_jobs < 1:
+        parser.error("--test-jobs must be at least 1")
+
+    if args.matrix:
+        if args.alias or args.name:
+            parser.error("--alias and --name cannot be used with --matrix")
+        if args.jobs < 1:
+            parser.error("--jobs must be at least 1")
+        lua_versions = [v.strip() for v in (args.lua_version or LUA_VERSION).split(",") if v.strip()]
+        architectures = [a.strip() for a in (args.arch or ("x86" if args.x86 else "x64")).split(",") if a.strip()]
+        build_types = [t.strip() for t in (args.build_type or ("dll" if args.dll else "static")).split(",") if t.strip()]
+        for architecture in architectures:
+            if architecture not in ("x86", "x64"):
+                parser.error(f"unknown architecture '{architecture}' (expected x86 or x64)")
+        for build_type in build_types:
+            if build_type not in ("static", "dll"):
+                parser.error(f"unknown build type '{build_type}' (expected static or dll)")
+        build_config = "debug" if args.debug else ("pgo" if args.optimize == "pgo" else "release")
+        sys.exit(run_matrix(lua_versions, args.luarocks_version, architectures, build_types,
+                            build_config, args.jobs, args.skip_env_check, args.skip_tests,
+                            args.test_suite, args.test_jobs))
+    if args.arch or args.build_type:
+        parser.error("--arch and --build-type are only used with --matrix (use --x86 and --dll)")
+
     # # Show current configuration from build_config.txt
     # print(f"Current Configuration (from build_config.txt):")
     # print(f"  Lua: {LUA_VERSION}")
@@ -885,68 +1150,23 @@ Each installation gets a unique UUID for identification.
     print("LuaEnv Setup - Creating New Installation")
     print("="*50)
 
-    # Handle version parameters
-    config_modified = False
-
-    # Determine architecture early for potential config modification
+    # Versions not given on the command line come from build_config.txt; each
+    # installation gets its own copy of the config (see create_installation)
     architecture = "x86" if args.x86 else "x64"
-
-    if args.lua_version or args.luarocks_version or args.x86:
-        # # print("[INFO] Using custom configuration for this installation")
-        # if args.lua_version:
-        #     print(f"  Lua version: {args.lua_version}")
-        # if args.luarocks_version:
-        #     print(f"  LuaRocks version: {args.luarocks_version}")
-        # if args.x86:
-        #     print(f"  Architecture: x86 (32-bit) - will use windows-32 platform")
-
-        # Backup current config and create temporary config
-        if backup_config():
-            # print("[INFO] Current config backed up")
-            pass
-
-        if create_temp_config(args.lua_version, args.luarocks_version, architecture):
-            # print("[INFO] Temporary config created")
-            config_modified = True
-
-            # Reload config module to pick up new values
-            import importlib
-            try:
-                from . import config
-                importlib.reload(config)
-            except ImportError:
-                import config
-                importlib.reload(config)
-        else:
-            print("[ERROR] Failed to create temporary config")
-            sys.exit(1)
-
-    # Use the final versions (either from temp config or original)
-    if config_modified:
-        # If we reloaded config, get values from the config module
-        try:
-            from . import config
-            final_lua_version = args.lua_version or config.LUA_VERSION
-            final_luarocks_version = args.luarocks_version or config.LUAROCKS_VERSION
-        except ImportError:
-            import config
-            final_lua_version = args.lua_version or config.LUA_VERSION
-            final_luarocks_version = args.luarocks_version or config.LUAROCKS_VERSION
-    else:
-        # Use original imported values
-        final_lua_version = args.lua_version or LUA_VERSION
-        final_luarocks_version = args.luarocks_version or LUAROCKS_VERSION
+    final_lua_version = args.lua_version or LUA_VERSION
+    final_luarocks_version = args.luarocks_version or LUAROCKS_VERSION
 
     print(f"Configuration: Lua {final_lua_version}, LuaRocks {final_luarocks_version}")
 
     # Determine build type (architecture already determined above)
     build_type = "dll" if args.dll else "static"
-    build_config = "debug" if args.debug else "release"
+    build_config = "debug" if args.debug else ("pgo" if args.optimize == "pgo" else "release")
 
     # Generate default name if not provided
     if not args.name:
         arch_display = "x86" if args.x86 else "x64"
-        args.name = f"Lua {final_lua_version} {build_type.upper()} {build_config.title()} ({arch_display})"
+        config_display = "PGO" if build_config == "pgo" else build_config.title()
+        args.name = f"Lua {final_lua_version} {build_type.upper()} {config_display} ({arch_display})"
 
     print(f"Build type: {build_type} {build_config}")
     print(f"Architecture: {architecture}")
@@ -960,6 +1180,8 @@ Each installation gets a unique UUID for identification.
         print(f"  Architecture match: setenv.ps1 -Arch {arch_param} setup_lua.py {'--x86' if args.x86 else '(default x64)'}")
     if args.skip_tests:
         print("Test suite: Skipped")
+    elif args.test_suite != "full":
+        print(f"Test suite: {args.test_suite}")
     print()
 
     try:
@@ -973,7 +1195,11 @@ Each installation gets a unique UUID for identification.
             name=args.name,
             alias=args.alias,
             skip_env_check=args.skip_env_check,
-            skip_tests=args.skip_tests
+            skip_tests=args.skip_tests,
+            test_suite=args.test_suite,
+            test_jobs=args.test_jobs,
+            shared_sources=args.sources,
+            build_group=args.build_group
         )
 
         if installation_id:
@@ -1004,13 +1230,6 @@ Each installation gets a unique UUID for identification.
         except Exception:
             warning("Final cleanup failed, you may need to run cleanup manually")
             pass  # Silent failure - don't let cleanup errors affect the main operation
-        # Restore original config if we modified it
-        if config_modified:
-            if restore_config():
-                pass
-                # print("[INFO] Original config restored")
-            else:
-                warning("Failed to restore original config")
     sys.exit(exit_code)
 
 if __name__ == "__main__":
@@ -0,0 +1,185 @@
+# This is free and unencumbered software released into the public domain.
+# For more details, see the LICENSE file in the project root.
+"""
+Content-addressed store shared by LuaEnv installations.
+
+Identical files of different installations (the LuaRocks executables, and the
+files of rocks installed in several trees) are kept once under
+~/.luaenv/store/objects/<xx>/<sha256> and hardlinked into each installation.
+The hardlink count of a store object is its reference count: an object that is
+only linked from the store belongs to no installation and is collected.
+"""
+
+import os
+import shutil
+import sys
+import threading
+from pathlib import Path
+from typing import Dict, Iterable, Optional, Tuple
+
+# Add current directory to Python path for local imports
+current_dir = Path(__file__).parent
+sys.path.insert(0, str(current_dir))
+
+# Import utilities with dual-context support
+try:
+    from .utils import sha256_file, format_file_size
+except ImportError:
+    from utils import sha256_file, format_file_size
+
+
+# Files of the LuaRocks distribution that are linked rather than copied. LuaRocks
+# rewrites its configuration files in place, which would show through a hardlink,
+# but never its own binaries.
+LINKED_SUFFIXES = (".exe", ".dll")
+
+
+def is_immutable_tree_file(relative: Path) -> bool:
+    """Whether a file of a rock tree is safe to share.
+
+    LuaRocks moves deployed modules into place and unpacks each rock version into a
+    fresh directory, so those files are replaced rather than rewritten. Files it
+    does rewrite in place, such as the tree manifest, are left alone.
+    """
+    parts = relative.parts
+    if len(parts) >= 3 and parts[0] in ("share", "lib") and parts[1] == "lua":
+        return True
+    # lib/luarocks/rocks-5.4/<rock>/<version>/...
+    return (len(parts) >= 6 and parts[:2] == ("lib", "luarocks") and parts[2].startswith("rocks-"))
+
+
+class SharedStore:
+    """Deduplicates installation files by hardlinking them to shared objects."""
+
+    def __init__(self, root: Optional[Path] = None):
+        self.root = Path(root) if root else Path.home() / ".luaenv" / "store"
+        self.objects_dir = self.root / "objects"
+
+    def object_path(self, digest: str) -> Path:
+        """Path of the object holding the content with this SHA-256 digest."""
+        return self.objects_dir / digest[:2] / digest
+
+    def _temp_path(self, target: Path) -> Path:
+        return target.with_name(f"{target.name}.{os.getpid()}.{threading.get_ident()}.tmp")
+
+    def _intern(self, file_path: Path, digest: Optional[str] = None) -> Path:
+        """Make sure the content of file_path is in the store and return its object.
+
+        The store always gets its own copy, so a file being rewritten while it is
+        interned cannot end up as the object. An object whose content no longer
+        matches its name (written in place through one of its links) is replaced;
+        the installations linked to it keep the changed file.
+        """
+        digest = digest or sha256_file(file_path)
+        obj = self.object_path(digest)
+        if obj.exists() and sha256_file(obj) != digest:
+            print(f"[WARNING] Store object {obj.name[:12]} was modified in place, replacing it")
+            obj.unlink()
+        if not obj.exists():
+            obj.parent.mkdir(parents=True, exist_ok=True)
+            temp = self._temp_path(obj)
+            shutil.copy2(file_path, temp)
+            os.replace(temp, obj)
+        return obj
+
+    def _link_into(self, obj: Path, target: Path) -> None:
+        """Replace target with a hardlink to obj."""
+        temp = self._temp_path(target)
+        os.link(obj, temp)
+        os.replace(temp, target)
+
+    def copy_tree(self, source_dir: Path, dest_dir: Path, suffixes: Tuple[str, ...] = LINKED_SUFFIXES) -> Tuple[int, int]:
+        """Copy source_dir to dest_dir, hardlinking files with these suffixes from the store.
+
+        Other files are copied. Falls back to copying when the store is on another
+        volume (where hardlinks are not possible).
+
+        Returns:
+            Tuple of (files linked, files copied)
+        """
+        source_dir, dest_dir = Path(source_dir), Path(dest_dir)
+        linked = copied = 0
+        for source in source_dir.rglob("*"):
+            target = dest_dir / source.relative_to(source_dir)
+            if source.is_dir():
+                target.mkdir(parents=True, exist_ok=True)
+                continue
+            target.parent.mkdir(parents=True, exist_ok=True)
+            if source.suffix.lower() in suffixes:
+                try:
+                    self._link_into(self._intern(source), target)
+                    linked += 1
+                    continue
+                except OSError:
+                    pass
+            shutil.copy2(source, target)
+            copied += 1
+        return linked, copied
+
+    def deduplicate(self, roots: Iterable[Path], include=is_immutable_tree_file) -> Tuple[int, int]:
+        """Hardlink the shareable files under roots to store objects.
+
+        Files that already have more than one link are taken to be shared already
+        and are not hashed again, which keeps repeated runs cheap.
+
+        Returns:
+            Tuple of (files linked to an existing object, bytes saved)
+        """
+        linked = saved = 0
+        for root in roots:
+            root = Path(root)
+            if not root.is_dir():
+                continue
+            for file_path in root.rglob("*"):
+                try:
+                    stat = file_path.lstat()
+                    if (not file_path.is_file() or file_path.is_symlink() or stat.st_nlink > 1
+                            or stat.st_size == 0 or not include(file_path.relative_to(root))):
+                        continue
+                    digest = sha256_file(file_path)
+                    shared = self.object_path(digest).exists()
+                    self._link_into(self._intern(file_path, digest), file_path)
+                    if shared:
+                        linked += 1
+                        saved += stat.st_size
+                except OSError as e:
+                    print(f"[WARNING] Could not share {file_path}: {e}")
+        return linked, saved
+
+    def collect_garbage(self) -> Tuple[int, int]:
+        """Remove objects that no installation links to any more.
+
+        Returns:
+            Tuple of (objects removed, bytes freed)
+        """
+        removed = freed = 0
+        if not self.objects_dir.exists():
+            return removed, freed
+        for obj in self.objects_dir.glob("*/*"):
+            try:
+                stat = obj.stat()
+                if stat.st_nlink <= 1:
+                    obj.unlink()
+                    removed += 1
+                    freed += stat.st_size
+            except OSError:
+                pass
+        return removed, freed
+
+    def get_store_info(self) -> Dict:
+        """Get information about the store."""
+        count = size = 0
+        links = 0
+        if self.objects_dir.exists():
+            for obj in self.objects_dir.glob("*/*"):
+                stat = obj.stat()
+                count += 1
+                size += stat.st_size
+                links += stat.st_nlink - 1
+        return {
+            "store_dir": str(self.root),
+            "object_count": count,
+            "total_size": size,
+            "formatted_size": format_file_size(size),
+            "link_count": links,
+        }
@@ -8,6 +8,12 @@ This module contains general-purpose utility functions that don't depend on
 specific configurations and can be reused across different scripts.
 """
 
+import base64
+import hashlib
+import http.client
+import io
+import urllib.error
+import urllib.parse
 import urllib.request
 import shutil
 import tarfile
@@ -16,8 +22,12 @@ import os
 import zipfile
 import json
 import inspect
+import contextlib
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
-from typing import Tuple, Optional, Dict, Any
+from typing import Tuple, Optional, Dict, Any, Iterable
 
 def log_with_location(message: str, level: str = "INFO", include_file: bool = True, include_line: bool = True) -> None:
     """
@@ -108,21 +118,472 @@ def log(message, level: str = "INFO", location: str = ".") -> None:
     prefix = levels.get(level, "[INFO]")
     print(f"{location}: {prefix} {message}")
 
+def trace_now_us() -> int:
+    """Microseconds since the Unix epoch, the clock shared by all trace spans."""
+    return time.time_ns() // 1000
+
+def trace_event(name: str, start_us: int, duration_us: int) -> None:
+    """
+    Append one span to the LUAENV_TRACE file, if tracing is enabled.
+
+    Spans are JSON lines in Chrome trace "complete" event form, shared with
+    luaconfig.exe and LuaEnv.CLI (see luaconfig.c). LUAENV_TRACE_ID, set by
+    the caller, links the spans of one call. Tracing errors are ignored.
+    """
+    trace_path = os.environ.get("LUAENV_TRACE")
+    if not trace_path:
+        return
+
+    event = {
+        "name": name,
+        "cat": "python",
+        "ph": "X",
+        "ts": start_us,
+        "dur": duration_us,
+        "pid": os.getpid(),
+        "tid": threading.get_native_id(),
+        "args": {"trace_id": os.environ.get("LUAENV_TRACE_ID", "")},
+    }
+    try:
+        # A single write per line keeps concurrent writers from interleaving
+        with open(trace_path, "a", encoding="utf-8") as trace_file:
+            trace_file.write(json.dumps(event, separators=(",", ":")) + "\n")
+    except OSError:
+        pass
+
+@contextlib.contextmanager
+def trace_span(name: str):
+    """Record the enclosed block as a trace span (no-op unless LUAENV_TRACE is set)."""
+    if not os.environ.get("LUAENV_TRACE"):
+        yield
+        return
+
+    start_us = trace_now_us()
+    try:
+        yield
+    finally:
+        trace_event(name, start_us, trace_now_us() - start_us)
+
 def get_backend_dir() -> Path:
     """Get the backend directory path."""
     # Assuming the backend directory is in the same location as this script
     return Path(__file__).resolve().parent
 
-def download_file(url, dest):
-    """Download a file from a URL to a specified destination."""
+# Downloads: retries of transient failures, with exponential backoff (1s, 2s, 4s, ...)
+DOWNLOAD_RETRIES = 4
+DOWNLOAD_TIMEOUT = 60  # Seconds without data before a connection is given up
+DOWNLOAD_CHUNK_SIZE = 256 * 1024
+RETRYABLE_HTTP_CODES = {408, 425, 429, 500, 502, 503, 504}
+RETRYABLE_ERRORS = (urllib.error.URLError, ConnectionError, TimeoutError, http.client.HTTPException)
+
+class DownloadError(Exception):
+    """Raised when a download fails for good or completes with the wrong content."""
+
+class _RestartDownload(Exception):
+    """The partial file cannot be continued; the download has to start from zero."""
+
+def sha256_file(file_path) -> str:
+    """SHA-256 hex digest of a file."""
+    hasher = hashlib.sha256()
+    with open(file_path, "rb") as f:
+        for chunk in iter(lambda: f.read(DOWNLOAD_CHUNK_SIZE), b""):
+            hasher.update(chunk)
+    return hasher.hexdigest()
+
+def _discard_partial(part: Path) -> None:
+    """Remove a partial download and its resume metadata."""
+    for path in (part, part.with_name(part.name + ".json")):
+        with contextlib.suppress(FileNotFoundError):
+            path.unlink()
+
+class _ResumableStream(io.RawIOBase):
+    """
+    Readable body of a download that survives dropped connections.
+
+    Everything read is appended to the partial file and hashed on the way. A partial
+    file left by an earlier attempt is resumed with an HTTP Range request guarded by
+    If-Range, using the ETag or Last-Modified validator saved next to it
+    (<part>.json); its bytes are replayed first, so readers always see the whole
+    file. A dropped connection is reopened at the current offset after a backoff.
+    """
+
+    def __init__(self, url: str, part: Path, retries: int, timeout: float):
+        super().__init__()
+        self.url = url
+        self.part = part
+        self.meta_path = part.with_name(part.name + ".json")
+        self.retries = retries
+        self.timeout = timeout
+        self.attempt = 0
+        self.hasher = hashlib.sha256()
+        self.resumed = False
+        self.written = 0     # Bytes in the partial file
+        self.size = None     # Size of the complete file, when the server says
+        self.validator = None
+        self._replay = None
+        self._output = None
+        self._response = None
+        self._start()
+
+    def readable(self) -> bool:
+        return True
+
+    def _backoff(self, reason: str) -> None:
+        """Wait before the next attempt, or give up when the retries are used up."""
+        if self.attempt >= self.retries:
+            raise DownloadError(f"Download of {self.url} failed after {self.retries} retries ({reason})")
+        delay = 2 ** self.attempt
+        self.attempt += 1
+        print(f"[WARNING] Download of {self.part.stem} interrupted ({reason}), "
+              f"retry {self.attempt}/{self.retries} in {delay}s...")
+        time.sleep(delay)
+
+    def _connect(self, offset: int):
+        """Open the URL from offset on, retrying transient failures."""
+        request = urllib.request.Request(self.url, headers={"User-Agent": "LuaEnv"})
+        if offset:
+            request.add_header("Range", f"bytes={offset}-")
+            request.add_header("If-Range", self.validator)
+        while True:
+            try:
+                return urllib.request.urlopen(request, timeout=self.timeout)
+            except urllib.error.HTTPError as e:
+                if e.code == 416:
+                    # The partial file does not fit the remote file any more
+                    raise _RestartDownload("HTTP 416")
+                if e.code not in RETRYABLE_HTTP_CODES:
+                    raise
+                self._backoff(f"HTTP {e.code}")
+            except RETRYABLE_ERRORS as e:
+                self._backoff(str(getattr(e, "reason", e)))
+
+    def _start(self) -> None:
+        """Connect for the first time, resuming the partial file if the server allows it."""
+        offset = self.part.stat().st_size if self.part.exists() else 0
+        if offset:
+            with contextlib.suppress(OSError, ValueError):
+                meta = json.loads(self.meta_path.read_text(encoding="utf-8"))
+                if meta.get("url") == self.url:
+                    self.validator = meta.get("etag") or meta.get("last_modified")
+        if not self.validator:
+            offset = 0
+
+        self._response = self._connect(offset)
+        length = self._response.headers.get("Content-Length")
+        if offset and self._response.status == 206:
+            print(f"  Resuming {self.part.stem} at {format_file_size(offset)}")
+            self.resumed = True
+            self.written = offset
+            self._replay = open(self.part, "rb")
+            self._output = open(self.part, "ab")
+        else:
+            offset = 0
+            # Weak ETags cannot be used with If-Range
+            etag = self._response.headers.get("ETag")
+            last_modified = self._response.headers.get("Last-Modified")
+            self.validator = etag if etag and not etag.startswith("W/") else last_modified
+            self.meta_path.write_text(json.dumps({"url": self.url, "etag": etag, "last_modified": last_modified}),
+                                      encoding="utf-8")
+            self._output = open(self.part, "wb")
+        self.size = offset + int(length) if length is not None else None
+
+    def _reconnect(self, reason: str) -> None:
+        """Continue the download at the end of the partial file."""
+        self._response.close()
+        self._backoff(reason)
+        if not self.validator:
+            raise _RestartDownload("the server gave no validator to resume with")
+        self._response = self._connect(self.written)
+        if self._response.status != 206:
+            raise _RestartDownload("the file changed or the server does not support resuming")
+
+    def readinto(self, buffer) -> int:
+        # Bytes of an earlier attempt come first
+        if self._replay:
+            count = self._replay.readinto(buffer)
+            if count:
+                self.hasher.update(memoryview(buffer)[:count])
+                return count
+            self._replay.close()
+            self._replay = None
+
+        while True:
+            try:
+                count = self._response.readinto(buffer)
+            except RETRYABLE_ERRORS as e:
+                self._reconnect(str(getattr(e, "reason", e)))
+                continue
+            if count == 0 and self.size is not None and self.written < self.size:
+                self._reconnect(f"connection closed after {self.written} of {self.size} bytes")
+                continue
+            if count:
+                data = memoryview(buffer)[:count]
+                self.hasher.update(data)
+                self._output.write(data)
+                self.written += count
+            return count
+
+    def finish(self) -> str:
+        """Read whatever the consumer left, complete the partial file and return its digest."""
+        buffer = bytearray(DOWNLOAD_CHUNK_SIZE)
+        while self.readinto(buffer):
+            pass
+        self._output.close()
+        with contextlib.suppress(FileNotFoundError):
+            self.meta_path.unlink()
+        return self.hasher.hexdigest()
+
+    def close(self) -> None:
+        for handle in (self._replay, self._output, self._response):
+            if handle:
+                handle.close()
+        super().close()
+
+def _fetch(url, dest, expected_sha256: Optional[str], retries: int, timeout: float, consume=None) -> str:
+    """
+    Download url to dest through <dest>.part, passing the stream to consume on the way.
+
+    consume(stream) may read the stream (for example to extract it); whatever it
+    leaves is read afterwards. If the partial file cannot be continued, or a file
+    resumed from an earlier run comes out with the wrong digest, the download (and
+    consume) starts once more from zero.
+    """
+    dest = Path(dest)
+    part = dest.with_name(dest.name + ".part")
     print(f"Downloading {url} to {dest}...")
-    urllib.request.urlretrieve(url, dest)
+
+    restarted = False
+    while True:
+        try:
+            with _ResumableStream(url, part, retries, timeout) as stream:
+                if consume:
+                    consume(stream)
+                digest = stream.finish()
+                resumed = stream.resumed
+        except _RestartDownload as e:
+            _discard_partial(part)
+            if restarted:
+                raise DownloadError(f"Download of {url} cannot be completed ({e})")
+            print(f"[WARNING] Restarting download of {dest.name} from the beginning ({e})")
+            restarted = True
+            continue
+
+        if expected_sha256 and digest != expected_sha256.lower():
+            _discard_partial(part)
+            if resumed and not restarted:
+                print(f"[WARNING] Resumed {dest.name} has the wrong checksum, downloading it again")
+                restarted = True
+                continue
+            raise DownloadError(f"Checksum mismatch for {dest.name}: expected {expected_sha256}, got {digest}")
+        break
+
+    os.replace(part, dest)
     print(f"Downloaded {dest}")
+    return digest
+
+PROBE_TIMEOUT = 10
+MAX_PARALLEL_PROBES = 6  # Requests in flight at once; lua.org and GitHub Pages are shared hosts
+REDIRECT_CODES = {301, 302, 303, 307, 308}
+
+class HttpSession:
+    """
+    Keep-alive HTTP(S) connections for many small requests to the same hosts.
+
+    Every thread keeps one connection per host, so the requests of a probe pool
+    reuse their TLS sessions instead of connecting once per URL. Redirects are
+    followed, and a request on a connection the server dropped while idle is
+    sent again on a new one. Proxies are taken from the environment like urllib
+    does (HTTP(S)_PROXY, NO_PROXY): HTTPS goes through a CONNECT tunnel and
+    HTTP requests are sent to the proxy with the absolute URL.
+    """
+
+    def __init__(self, timeout: float = PROBE_TIMEOUT, user_agent: str = "LuaEnv"):
+        self.timeout = timeout
+        self.user_agent = user_agent
+        self._local = threading.local()
+        self._lock = threading.Lock()
+        self._opened = []
+
+    @staticmethod
+    def _proxy(scheme: str, host: str) -> Optional[Tuple[str, Dict[str, str]]]:
+        """Proxy address and headers for a host, or None for a direct connection."""
+        proxy = urllib.request.getproxies().get(scheme)
+        if not proxy or urllib.request.proxy_bypass(host):
+            return None
+        if "://" not in proxy:
+            proxy = "http://" + proxy
+        parts = urllib.parse.urlsplit(proxy)
+        headers = {}
+        if parts.username:
+            credentials = f"{urllib.parse.unquote(parts.username)}:{urllib.parse.unquote(parts.password or '')}"
+            headers["Proxy-Authorization"] = "Basic " + base64.b64encode(credentials.encode()).decode("ascii")
+        return parts.hostname + (f":{parts.port}" if parts.port else ""), headers
+
+    def _connection(self, scheme: str, host: str,
+                    fresh: bool = False) -> Tuple[http.client.HTTPConnection, Optional[Dict[str, str]]]:
+        """Connection for a host, and the proxy headers when HTTP goes through a proxy (else None)."""
+        connections = getattr(self._local, "connections", None)
+        if connections is None:
+            connections = self._local.connections = {}
+        key = (scheme, host)
+        if fresh or key not in connections:
+            if key in connections:
+                connections[key][0].close()
+            proxy = self._proxy(scheme, host)
+            if scheme == "https":
+                if proxy:
+                    connection = http.client.HTTPSConnection(proxy[0], timeout=self.timeout)
+                    connection.set_tunnel(host, headers=proxy[1])
+                else:
+                    connection = http.client.HTTPSConnection(host, timeout=self.timeout)
+                proxied = None
+            else:
+                connection = http.client.HTTPConnection(proxy[0] if proxy else host, timeout=self.timeout)
+                proxied = proxy[1] if proxy else None
+            connections[key] = (connection, proxied)
+            with self._lock:
+                self._opened.append(connection)
+        return connections[key]
+
+    def request(self, method: str, url: str, headers: Optional[Dict[str, str]] = None,
+                max_redirects: int = 5) -> Tuple[int, Dict[str, str], bytes]:
+        """Send a request; returns the status, headers (lowercase names) and body of the final response."""
+        for _ in range(max_redirects + 1):
+            parts = urllib.parse.urlsplit(url)
+            target = (parts.path or "/") + (f"?{parts.query}" if parts.query else "")
+            sent = {"User-Agent": self.user_agent, **(headers or {})}
+            for attempt in range(2):
+                connection, proxied = self._connection(parts.scheme, parts.netloc, fresh=attempt > 0)
+                try:
+                    if proxied is None:
+                        connection.request(method, target, headers=sent)
+                    else:
+                        connection.request(method, urllib.parse.urlunsplit(parts._replace(fragment="")),
+                                           headers={**proxied, **sent})
+                    response = connection.getresponse()
+                    body = response.read()
+                    break
+                except (http.client.HTTPException, OSError):
+                    connection.close()
+                    if attempt:
+                        raise
+            if response.will_close:
+                connection.close()
+            received = {name.lower(): value for name, value in response.getheaders()}
+            if response.status in REDIRECT_CODES and "location" in received:
+                url = urllib.parse.urljoin(url, received["location"])
+                if response.status == 303:
+                    method = "GET"
+                continue
+            return response.status, received, body
+        raise http.client.HTTPException(f"Too many redirects for {url}")
+
+    def exists(self, url: str) -> bool:
+        """Whether a URL answers 200, without downloading it."""
+        try:
+            status, _, _ = self.request("HEAD", url)
+            if status in (405, 501):
+                # No HEAD support: ask for the first byte only
+                status, _, _ = self.request("GET", url, {"Range": "bytes=0-0"})
+            return status in (200, 206)
+        except (http.client.HTTPException, OSError):
+            return False
+
+    def close(self) -> None:
+        """Close the connections of all threads."""
+        with self._lock:
+            for connection in self._opened:
+                connection.close()
+            self._opened.clear()
+
+def probe_urls(urls: Iterable[str], session: Optional[HttpSession] = None,
+               jobs: int = MAX_PARALLEL_PROBES) -> Dict[str, bool]:
+    """Check which URLs exist, at most jobs at a time over reused connections."""
+    unique = list(dict.fromkeys(urls))
+    if not unique:
+        return {}
+    own_session = session is None
+    session = session or HttpSession()
+    try:
+        with ThreadPoolExecutor(max_workers=max(1, min(jobs, len(unique)))) as pool:
+            return dict(zip(unique, pool.map(session.exists, unique)))
+    finally:
+        if own_session:
+            session.close()
+
+def download_file(url, dest, expected_sha256: Optional[str] = None,
+                  retries: int = DOWNLOAD_RETRIES, timeout: float = DOWNLOAD_TIMEOUT) -> str:
+    """
+    Download a file from a URL to a specified destination.
+
+    The data goes to <dest>.part, which is resumed on retry (and by a later call
+    after an aborted run) and only renamed to dest once complete and verified.
+    Connection errors, timeouts and HTTP 408/425/429/5xx are retried with backoff.
+
+    Args:
+        url: URL to download
+        dest: Destination file path
+        expected_sha256: Digest the file must have
+        retries: Number of retries of transient failures
+        timeout: Socket timeout in seconds
+
+    Returns:
+        SHA-256 hex digest of the downloaded file
+    """
+    return _fetch(url, dest, expected_sha256, retries, timeout)
+
+def download_and_extract(url, dest, extract_to=None, move_callback=None, expected_sha256: Optional[str] = None,
+                         retries: int = DOWNLOAD_RETRIES, timeout: float = DOWNLOAD_TIMEOUT) -> str:
+    """
+    Download an archive and extract it in the same pass.
+
+    A .tar.gz is decompressed while it downloads into a staging sibling of each
+    final path (<path>.extracting), which replaces the final path only once the
+    archive digest is verified; the archive itself is still kept at dest. A .zip
+    has its index at the end, so it is extracted (straight to the final paths)
+    once the download is complete and verified. Arguments are those of
+    download_file and extract_file.
+
+    Returns:
+        SHA-256 hex digest of the downloaded archive
+    """
+    dest = Path(dest)
+    extract_to = Path(extract_to or dest.parent)
+
+    if dest.name.endswith(".tar.gz"):
+        layouts = []
+
+        def consume(stream):
+            layout = _ArchiveLayout(extract_to, move_callback, staged=True)
+            layouts.append(layout)
+            with tarfile.open(fileobj=stream, mode="r|gz") as tar:
+                _extract_tar_members(tar, layout, dest)
+
+        try:
+            digest = _fetch(url, dest, expected_sha256, retries, timeout, consume)
+        except BaseException:
+            # Nothing of an unverified archive is left behind
+            for layout in layouts:
+                layout.discard()
+            raise
+        layouts[-1].commit(dest)
+        # Staging trees of restarted attempts that the last one did not reuse
+        for layout in layouts[:-1]:
+            layout.discard()
+        return digest
+
+    digest = _fetch(url, dest, expected_sha256, retries, timeout)
+    extract_file(dest, extract_to, move_callback)
+    return digest
 
 def extract_file(file_path, extract_to=None, move_callback=None):
     """
     Extract a file and optionally move the extracted contents.
 
+    Entries are written directly to their final location: move_callback is applied
+    to each top-level item as it is met, instead of extracting everything and
+    moving it afterwards.
+
     Args:
         file_path: Path to the file to extract
         extract_to: Directory to extract to (defaults to parent of file_path)
@@ -130,7 +591,7 @@ def extract_file(file_path, extract_to=None, move_callback=None):
                       Should accept (source_path, original_name) and return target_path or None.
     """
     file_path = Path(file_path)
-    extract_to = extract_to or file_path.parent
+    extract_to = Path(extract_to or file_path.parent)
 
     if file_path.suffix == ".gz" and file_path.stem.endswith(".tar"):
         _extract_tar_gz(file_path, extract_to, move_callback)
@@ -139,65 +600,118 @@ def extract_file(file_path, extract_to=None, move_callback=None):
     else:
         print(f"Unsupported file format: {file_path}")
 
+STAGING_SUFFIX = ".extracting"
+
+class _ArchiveLayout:
+    """
+    Maps archive entry names to final paths, applying move_callback per top-level item.
+
+    A staged layout writes each top-level item to <final path>.extracting instead;
+    commit() moves the staged items into place and discard() removes them.
+    """
+
+    def __init__(self, extract_to: Path, move_callback=None, staged: bool = False):
+        self.extract_to = Path(extract_to)
+        self.move_callback = move_callback
+        self.staged = staged
+        self.roots = {}
+        self.staging = {}
+
+    def target(self, name: str) -> Optional[Path]:
+        """Path an entry is written to, or None for entries without a name."""
+        parts = [part for part in name.replace("\\", "/").split("/") if part and part != "."]
+        if not parts:
+            return None
+        if ".." in parts or name.startswith(("/", "\\")) or ":" in parts[0]:
+            raise ValueError(f"Unsafe path in archive: {name}")
+
+        top = parts[0]
+        if top not in self.roots:
+            root = source = self.extract_to / top
+            if self.move_callback:
+                dest = self.move_callback(source, top)
+                if dest and Path(dest) != source:
+                    root = Path(dest)
+                    # Replace what an earlier extraction left there
+                    if not self.staged:
+                        _remove_path(root)
+            if self.staged:
+                staging = root.with_name(root.name + STAGING_SUFFIX)
+                _remove_path(staging)
+                self.staging[top] = staging
+            self.roots[top] = root
+        return self.staging.get(top, self.roots[top]).joinpath(*parts[1:])
+
+    def commit(self, archive) -> None:
+        """Replace the final paths with the staged items."""
+        for top, staging in self.staging.items():
+            root = self.roots[top]
+            _remove_path(root)
+            root.parent.mkdir(parents=True, exist_ok=True)
+            os.replace(staging, root)
+        self.staging.clear()
+        self.staged = False
+        self.report(archive)
+
+    def discard(self) -> None:
+        """Remove the staged items."""
+        for staging in self.staging.values():
+            _remove_path(staging)
+        self.staging.clear()
+
+    def report(self, archive) -> None:
+        if self.staged:
+            return
+        for root in self.roots.values():
+            print(f"Extracted {Path(archive).name} to {root}")
+
+def _remove_path(path: Path) -> None:
+    """Remove a file or directory if it exists."""
+    if path.is_dir():
+        shutil.rmtree(path)
+    elif path.exists():
+        path.unlink()
+
+def _write_entry(source, target: Path) -> None:
+    """Copy an archive entry to its final path."""
+    target.parent.mkdir(parents=True, exist_ok=True)
+    with open(target, "wb") as out:
+        shutil.copyfileobj(source, out, DOWNLOAD_CHUNK_SIZE)
+
+def _extract_tar_members(tar, layout: "_ArchiveLayout", archive) -> None:
+    """Extract the members of an open tar file, in archive order."""
+    for member in tar:
+        target = layout.target(member.name)
+        if target is None:
+            continue
+        if member.isdir():
+            target.mkdir(parents=True, exist_ok=True)
+        elif member.isfile():
+            with tar.extractfile(member) as source:
+                _write_entry(source, target)
+            os.utime(target, (member.mtime, member.mtime))
+        # Links and devices do not occur in the Lua and LuaRocks archives
+    layout.report(archive)
+
 def _extract_tar_gz(file_path, extract_to, move_callback=None):
     """Extract a .tar.gz file."""
-    with tarfile.open(file_path, "r:gz") as tar:
-        # Extract to specified directory first
-        tar.extractall(path=extract_to)
-        print(f"Extracted {file_path} to {extract_to}")
-
-        # Get all top-level directories from tar archive
-        top_level_dirs = set()
-        for member in tar.getnames():
-            # Get the first component of the path (top-level directory)
-            top_dir = member.split('/')[0]
-            if top_dir:  # Make sure it's not empty
-                top_level_dirs.add(top_dir)
-
-        # Move extracted folders if callback is provided
-        if move_callback:
-            for dir_name in top_level_dirs:
-                source = extract_to / dir_name
-                if source.exists() and source.is_dir():
-                    dest = move_callback(source, dir_name)
-                    if dest and dest != source:
-                        _safe_move(source, dest)
+    with tarfile.open(file_path, "r|gz") as tar:
+        _extract_tar_members(tar, _ArchiveLayout(extract_to, move_callback), file_path)
 
 def _extract_zip(file_path, extract_to, move_callback=None):
     """Extract a .zip file."""
+    layout = _ArchiveLayout(extract_to, move_callback)
     with zipfile.ZipFile(file_path, 'r') as zip_ref:
-        # Extract to specified directory first
-        zip_ref.extractall(path=extract_to)
-        print(f"Extracted {file_path} to {extract_to}")
-
-        # Get top-level items
-        extracted_items = set()
-        for name in zip_ref.namelist():
-            if '/' in name:
-                top_dir = name.split('/')[0]
-                extracted_items.add(top_dir)
+        for info in zip_ref.infolist():
+            target = layout.target(info.filename)
+            if target is None:
+                continue
+            if info.is_dir():
+                target.mkdir(parents=True, exist_ok=True)
             else:
-                extracted_items.add(name)
-
-        # Move extracted items if callback is provided
-        if move_callback:
-            for item in extracted_items:
-                source = extract_to / item
-                if source.exists():
-                    dest = move_callback(source, item)
-                    if dest and dest != source:
-                        _safe_move(source, dest)
-
-def _safe_move(source, dest):
-    """Safely move a file or directory, removing destination if it exists."""
-    dest = Path(dest)
-    if dest.exists():
-        if dest.is_dir():
-            shutil.rmtree(dest)
-        else:
-            dest.unlink()
-    shutil.move(str(source), str(dest))
-    print(f"Moved {source} to {dest}")
+                with zip_ref.open(info) as source:
+                    _write_entry(source, target)
+    layout.report(file_path)
 
 def create_directory_structure(base_path, structure):
     """
@@ -344,6 +858,21 @@ def read_build_config(config_file="build_config.txt"):
         print(f"Error reading config file: {e}")
         return {}
 
+def get_workspace_dir(base_path="."):
+    """
+    Directory that holds the extracted folder.
+
+    An install job sets LUAENV_WORKSPACE to its private workspace (see setup_lua.py),
+    so that concurrent installs never share sources or build outputs.
+
+    Args:
+        base_path: Base directory path used without LUAENV_WORKSPACE
+
+    Returns:
+        Path: The workspace directory
+    """
+    return Path(os.environ.get("LUAENV_WORKSPACE") or base_path)
+
 def ensure_extracted_folder(base_path="."):
     """
     Ensure the extracted folder exists.
@@ -354,8 +883,8 @@ def ensure_extracted_folder(base_path="."):
     Returns:
         Path: Path to the extracted folder
     """
-    extracted_path = Path(base_path) / "extracted"
-    extracted_path.mkdir(exist_ok=True)
+    extracted_path = get_workspace_dir(base_path) / "extracted"
+    extracted_path.mkdir(parents=True, exist_ok=True)
     return extracted_path
 
 def clean_extracted_folder(base_path=".", confirm=True):
@@ -369,7 +898,7 @@ def clean_extracted_folder(base_path=".", confirm=True):
     Returns:
         bool: True if successful, False otherwise
     """
-    extracted_path = Path(base_path) / "extracted"
+    extracted_path = get_workspace_dir(base_path) / "extracted"
 
     if not extracted_path.exists():
         print("Extracted folder doesn't exist - nothing to clean")
@@ -412,7 +941,7 @@ def list_extracted_contents(base_path="."):
     Returns:
         list: List of paths in the extracted folder
     """
-    extracted_path = Path(base_path) / "extracted"
+    extracted_path = get_workspace_dir(base_path) / "extracted"
 
     if not extracted_path.exists():
         print("Extracted folder doesn't exist")
@@ -453,7 +982,7 @@ def get_extracted_path(item_name, base_path="."):
     Returns:
         Path or None: Path to the item if it exists, None otherwise
     """
-    extracted_path = Path(base_path) / "extracted" / item_name
+    extracted_path = get_workspace_dir(base_path) / "extracted" / item_name
     return extracted_path if extracted_path.exists() else None
 
 def get_luarocks_package_count() -> Optional[int]:
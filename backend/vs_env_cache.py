@@ -0,0 +1,227 @@
+# This is free and unencumbered software released into the public domain.
+# For more details, see the LICENSE file in the project root.
+"""
+Persistent cache of the Visual Studio build environment.
+
+Running vcvarsall.bat and diffing the environment takes one to three seconds. The
+resulting delta (entries prepended to PATH, INCLUDE, LIB, LIBPATH and
+EXTERNAL_INCLUDE, and the other variables vcvars sets) is stored per architecture
+in ~/.luaenv/cache/vs-env/<arch>.json and reused by setup_lua.py and by the
+PowerShell module (luaenv_vs.psm1, which reads and writes the same files).
+
+A cache entry is only used while its key still matches: the architecture, the
+Visual Studio installation path, instance ID and version, the default MSVC
+toolset, the installed Windows SDK versions and the timestamps of vcvarsall.bat
+and VsDevCmd.bat. Both frontends build the key string the same way.
+"""
+
+import json
+import os
+import subprocess
+import tempfile
+from datetime import datetime, timezone
+from pathlib import Path
+from typing import Dict, Optional
+
+CACHE_FORMAT = 1
+
+# Variables whose vcvars entries are prepended to the current value
+LIST_VARIABLES = ("PATH", "INCLUDE", "LIB", "LIBPATH", "EXTERNAL_INCLUDE")
+# Variables that describe the calling shell rather than the toolchain
+IGNORED_VARIABLES = {"PROMPT", "PSMODULEPATH", "PYTHONPATH", "PYTHONHOME", "ERRORLEVEL"}
+
+_MARKER = "__LUAENV_VCVARS__"
+
+
+def normalize_architecture(architecture: str) -> str:
+    """vcvarsall.bat architecture name (amd64, x86 or arm64)."""
+    architecture = architecture.lower()
+    return {"x64": "amd64", "amd64": "amd64", "x86": "x86", "arm64": "arm64"}.get(architecture, "amd64")
+
+
+def get_cache_dir() -> Path:
+    return Path.home() / ".luaenv" / "cache" / "vs-env"
+
+
+def _mtime(path: Path) -> str:
+    try:
+        return str(int(path.stat().st_mtime))
+    except OSError:
+        return ""
+
+
+def compute_key(install_path, architecture: str) -> str:
+    """Key of the environment vcvars produces for this installation (see module docstring)."""
+    install_path = Path(install_path)
+    instance_id = version = ""
+    try:
+        for line in (install_path / "Common7" / "IDE" / "devenv.isolation.ini").read_text(encoding="utf-8", errors="replace").splitlines():
+            name, _, value = line.partition("=")
+            if name.strip() == "InstallationID":
+                instance_id = value.strip()
+            elif name.strip() == "InstallationVersion":
+                version = value.strip()
+    except OSError:
+        pass
+
+    build_dir = install_path / "VC" / "Auxiliary" / "Build"
+    try:
+        toolset = (build_dir / "Microsoft.VCToolsVersion.default.txt").read_text(encoding="utf-8-sig").strip()
+    except OSError:
+        toolset = ""
+
+    sdk_include = Path(os.environ.get("ProgramFiles(x86)", r"C:\Program Files (x86)")) / "Windows Kits" / "10" / "Include"
+    try:
+        sdks = ",".join(sorted(entry.name for entry in sdk_include.iterdir() if entry.is_dir()))
+    except OSError:
+        sdks = ""
+
+    fields = [
+        ("arch", normalize_architecture(architecture)),
+        ("path", str(install_path).rstrip("\\/").lower()),
+        ("instance", instance_id),
+        ("version", version),
+        ("toolset", toolset),
+        ("sdk", sdks),
+        ("vcvarsall", _mtime(build_dir / "vcvarsall.bat")),
+        ("vsdevcmd", _mtime(install_path / "Common7" / "Tools" / "VsDevCmd.bat")),
+    ]
+    return "\n".join(f"{name}={value}" for name, value in fields)
+
+
+def get_cache_path(architecture: str) -> Path:
+    return get_cache_dir() / f"{normalize_architecture(architecture)}.json"
+
+
+def load(architecture: str, install_path=None) -> Optional[Dict]:
+    """Cached environment delta for architecture, or None when missing or out of date.
+
+    Args:
+        architecture: Target architecture
+        install_path: Required Visual Studio installation (any when None)
+    """
+    try:
+        with open(get_cache_path(architecture), "r", encoding="utf-8-sig") as f:
+            entry = json.load(f)
+    except (OSError, json.JSONDecodeError):
+        return None
+
+    if entry.get("format") != CACHE_FORMAT or not entry.get("install_path"):
+        return None
+    cached_path = entry["install_path"].rstrip("\\/").lower()
+    if install_path is not None and cached_path != str(install_path).rstrip("\\/").lower():
+        return None
+    if entry.get("key") != compute_key(entry["install_path"], architecture):
+        return None
+    return entry
+
+
+def _split(value: str):
+    return [item for item in value.split(";") if item]
+
+
+def capture(install_path, architecture: str) -> Optional[Dict]:
+    """Run vcvarsall.bat and return the environment delta it produces (None on failure)."""
+    vcvarsall = Path(install_path) / "VC" / "Auxiliary" / "Build" / "vcvarsall.bat"
+    if not vcvarsall.exists():
+        return None
+
+    arch = normalize_architecture(architecture)
+    with tempfile.NamedTemporaryFile(mode="w", suffix=".bat", delete=False) as f:
+        f.write(f'''@echo off
+set
+echo {_MARKER}
+call "{vcvarsall}" {arch} >nul 2>&1
+if errorlevel 1 exit /b 1
+echo {_MARKER}
+set
+''')
+        temp_file = f.name
+
+    try:
+        result = subprocess.run(["cmd", "/d", "/c", temp_file], capture_output=True, text=True)
+    finally:
+        try:
+            os.unlink(temp_file)
+        except OSError:
+            pass
+
+    sections = result.stdout.split(_MARKER)
+    if result.returncode != 0 or len(sections) != 3:
+        return None
+
+    def parse(text):
+        variables = {}
+        for line in text.splitlines():
+            name, sep, value = line.partition("=")
+            if sep and name:
+                variables[name] = value
+        return variables
+
+    before, after = parse(sections[0]), parse(sections[2])
+    before_upper = {name.upper(): value for name, value in before.items()}
+
+    variables, prepend = {}, {}
+    for name, value in after.items():
+        upper = name.upper()
+        if upper in IGNORED_VARIABLES:
+            continue
+        if upper in LIST_VARIABLES:
+            existing = set(item.lower() for item in _split(before_upper.get(upper, "")))
+            added = [item for item in _split(value) if item.lower() not in existing]
+            if added:
+                prepend[upper] = added
+        elif before_upper.get(upper) != value:
+            variables[name] = value
+
+    return {
+        "format": CACHE_FORMAT,
+        "key": compute_key(install_path, architecture),
+        "architecture": arch,
+        "install_path": str(install_path),
+        "created": datetime.now(timezone.utc).isoformat(),
+        "variables": variables,
+        "prepend": prepend,
+        # A shell that already had a VS environment hides part of the delta
+        "complete": not any(name in before_upper for name in ("VSCMD_VER", "VCINSTALLDIR")),
+    }
+
+
+def save(entry: Dict) -> None:
+    """Store a captured delta for later sessions (only complete captures are kept)."""
+    if not entry.get("complete"):
+        return
+    path = get_cache_path(entry["architecture"])
+    path.parent.mkdir(parents=True, exist_ok=True)
+    temp = path.with_name(f"{path.name}.{os.getpid()}.tmp")
+    with open(temp, "w", encoding="utf-8") as f:
+        json.dump(entry, f, indent=2)
+    os.replace(temp, path)
+
+
+def apply(entry: Dict, environ=None) -> int:
+    """Apply a delta to environ (os.environ by default).
+
+    Returns:
+        Number of variables set
+    """
+    environ = os.environ if environ is None else environ
+    for name, value in entry.get("variables", {}).items():
+        environ[name] = value
+    for name, added in entry.get("prepend", {}).items():
+        lowered = set(item.lower() for item in added)
+        rest = [item for item in _split(environ.get(name, "")) if item.lower() not in lowered]
+        environ[name] = ";".join(list(added) + rest)
+    return len(entry.get("variables", {})) + len(entry.get("prepend", {}))
+
+
+def import_environment(install_path, architecture: str) -> bool:
+    """Apply the cached environment of an installation, capturing and caching it on a miss."""
+    entry = load(architecture, install_path)
+    if entry is None:
+        entry = capture(install_path, architecture)
+        if entry is None:
+            return False
+        save(entry)
+    apply(entry)
+    return True
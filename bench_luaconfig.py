@@ -0,0 +1,346 @@
+#!/usr/bin/env python3
+# This is free and unencumbered software released into the public domain.
+# For more details, see the LICENSE file in the project root.
+
+"""
+Latency benchmark for luaconfig.exe and the pkg-config chain behind it.
+
+Each query type is run N times against synthetic registries holding 1, 10 and
+100 installations, in two modes:
+
+    cold  - the answer cache is missing, so every call goes through
+            luaconfig -> LuaEnv.CLI -> pkg_config.py
+    warm  - the answer cache is current, so luaconfig answers by itself
+
+Wall-clock latency is reported as p50/p95/p99. The per-stage breakdown (path
+resolution, file validation, command line construction, process creation,
+CLI execution, and the CLI/Python spans beneath them) comes from the
+LUAENV_TRACE events that luaconfig, the CLI and the backend write.
+
+Results are written as JSON with a stable layout, so two runs (e.g. two
+releases) can be diffed directly or compared with --compare.
+
+Usage:
+    python bench_luaconfig.py                          # ~/.luaenv/bin/luaconfig.exe
+    python bench_luaconfig.py --runs 50 --sizes 1,100
+    python bench_luaconfig.py --output new.json --compare old.json
+
+The synthetic registries live in a temporary USERPROFILE. USERNAME is replaced
+as well, so a running "luaenv server" for the real user is not consulted.
+"""
+
+import argparse
+import contextlib
+import io
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from datetime import datetime, timezone
+from pathlib import Path
+
+BACKEND_DIR = Path(__file__).parent.absolute() / "backend"
+if str(BACKEND_DIR) not in sys.path:
+    sys.path.insert(0, str(BACKEND_DIR))
+
+RESULTS_FORMAT = "luaenv-bench 1"
+DEFAULT_SIZES = [1, 10, 100]
+DEFAULT_RUNS = 20
+MODES = ["cold", "warm"]
+PERCENTILES = [50, 95, 99]
+
+# Query types, in report order
+QUERIES = {
+    "cflag": ["--cflag"],
+    "lua-include": ["--lua-include"],
+    "liblua": ["--liblua"],
+    "libdir": ["--libdir"],
+    "path": ["--path"],
+    "batch": ["--cflag", "--lua-include", "--liblua", "--libdir", "--path"],
+    "format-cmake": ["--format", "cmake"],
+}
+
+BENCH_USERNAME = "luaenv-bench"
+
+
+class BenchmarkError(Exception):
+    """Raised when luaconfig fails or the synthetic environment cannot be built."""
+
+
+def default_luaconfig() -> Path:
+    """The installed luaconfig.exe, which sits next to cli\\ and backend.config."""
+    return Path(os.environ.get("USERPROFILE", str(Path.home()))) / ".luaenv" / "bin" / "luaconfig.exe"
+
+
+def percentile(sorted_values, p):
+    """Linear-interpolated percentile of an already sorted list."""
+    if not sorted_values:
+        return 0.0
+    rank = (len(sorted_values) - 1) * p / 100.0
+    low = int(rank)
+    high = min(low + 1, len(sorted_values) - 1)
+    return sorted_values[low] + (sorted_values[high] - sorted_values[low]) * (rank - low)
+
+
+def summarize(values_ms):
+    """p50/p95/p99, min and max of a sample, rounded for stable diffs."""
+    values = sorted(values_ms)
+    summary = {f"p{p}": round(percentile(values, p), 3) for p in PERCENTILES}
+    summary["min"] = round(values[0], 3) if values else 0.0
+    summary["max"] = round(values[-1], 3) if values else 0.0
+    return summary
+
+
+def create_synthetic_home(home: Path, count: int) -> str:
+    """Create a registry with `count` active installations under home/.luaenv.
+
+    Returns the alias of the last installation, which is the one queried.
+    """
+    from registry import LuaEnvRegistry
+
+    registry = LuaEnvRegistry(home / ".luaenv" / "registry.json")
+
+    # Rebuild the answer cache once at the end instead of on every save
+    registry._refresh_pkg_config_cache = lambda *args: None
+    alias = None
+    with contextlib.redirect_stdout(io.StringIO()):
+        for n in range(count):
+            build_type = "dll" if n % 2 else "static"
+            alias = f"bench{n + 1}"
+            installation_id = registry.create_installation("5.4.8", "3.12.2", build_type, alias=alias)
+            install_path = Path(registry.registry["installations"][installation_id]["installation_path"])
+            for sub_dir in ("include", "lib", "bin"):
+                (install_path / sub_dir).mkdir(exist_ok=True)
+            (install_path / "include" / "lua.h").write_text("")
+            (install_path / "lib" / "lua54.lib").write_text("")
+            (install_path / "bin" / "lua.exe").write_text("")
+            if build_type == "dll":
+                (install_path / "bin" / "lua54.dll").write_text("")
+            registry.update_status(installation_id, "active")
+
+        del registry._refresh_pkg_config_cache
+        registry._refresh_pkg_config_cache()
+
+    if not (registry.pkg_config_cache_root / "index").exists():
+        raise BenchmarkError("Could not build the pkg-config answer cache for the synthetic registry")
+    return alias
+
+
+def read_trace(trace_path: Path):
+    """Group trace events by trace_id: {trace_id: {span name: (start us, duration ms)}}."""
+    stages = {}
+    if not trace_path.exists():
+        return stages
+    with open(trace_path, "r", encoding="utf-8") as f:
+        for line in f:
+            try:
+                event = json.loads(line)
+                trace_id = event["args"]["trace_id"]
+                name = event["name"]
+                start_us = event["ts"]
+                duration_ms = event["dur"] / 1000.0
+            except (ValueError, KeyError, TypeError):
+                continue  # Partial line from an interrupted writer
+            run = stages.setdefault(trace_id, {})
+            if name in run:
+                start_us = min(start_us, run[name][0])
+                duration_ms += run[name][1]
+            run[name] = (start_us, duration_ms)
+    return stages
+
+
+class Benchmark:
+    """Runs luaconfig against one synthetic home and collects samples."""
+
+    def __init__(self, luaconfig: Path, home: Path, trace: bool = True):
+        self.luaconfig = luaconfig
+        self.home = home
+        self.trace_path = home / "trace.jsonl" if trace else None
+        self.counter = 0
+        self.env = dict(os.environ)
+        self.env.update({"USERPROFILE": str(home), "HOME": str(home), "USERNAME": BENCH_USERNAME})
+        self.env.pop("LUAENV_TRACE", None)
+        self.env.pop("LUAENV_TRACE_ID", None)
+        if self.trace_path:
+            self.env["LUAENV_TRACE"] = str(self.trace_path)
+
+    @property
+    def cache_index(self) -> Path:
+        return self.home / ".luaenv" / "cache" / "pkg-config" / "index"
+
+    def invoke(self, args):
+        """Run luaconfig once; returns (trace id, wall ms)."""
+        self.counter += 1
+        trace_id = f"bench-{self.counter}"
+        env = dict(self.env, LUAENV_TRACE_ID=trace_id)
+
+        start = time.perf_counter_ns()
+        result = subprocess.run([str(self.luaconfig)] + args, env=env,
+                                stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        elapsed_ms = (time.perf_counter_ns() - start) / 1e6
+
+        if result.returncode != 0 or not result.stdout.strip():
+            stderr = result.stderr.decode("utf-8", errors="replace").strip()
+            raise BenchmarkError(f"luaconfig {' '.join(args)} failed with exit code {result.returncode}: {stderr}")
+        return trace_id, elapsed_ms
+
+    def measure(self, args, runs):
+        """Warm up once, then time `runs` invocations."""
+        self.invoke(args)
+        return [self.invoke(args) for _ in range(runs)]
+
+
+def run_benchmark(luaconfig: Path, sizes=None, runs=DEFAULT_RUNS, queries=None, trace=True, progress=None):
+    """Run every (size, mode, query) combination and return the results document."""
+    sizes = sizes or DEFAULT_SIZES
+    queries = queries or list(QUERIES)
+    luaconfig = Path(luaconfig).absolute()
+    if not luaconfig.exists():
+        raise BenchmarkError(f"luaconfig not found: {luaconfig}")
+
+    results = []
+    for size in sizes:
+        home = Path(tempfile.mkdtemp(prefix=f"luaenv-bench-{size}-"))
+        try:
+            alias = create_synthetic_home(home, size)
+            bench = Benchmark(luaconfig, home, trace)
+            samples = {}
+
+            for mode in MODES:
+                index = bench.cache_index
+                parked = index.with_name("index.bench")
+                if mode == "cold":
+                    index.replace(parked)
+                try:
+                    for query in queries:
+                        if progress:
+                            progress(f"{size:>4} installations  {mode:<5} {query}")
+                        samples[(mode, query)] = bench.measure([alias] + QUERIES[query], runs)
+                finally:
+                    if mode == "cold":
+                        parked.replace(index)
+
+            stages = read_trace(bench.trace_path) if bench.trace_path else {}
+            for mode in MODES:
+                for query in queries:
+                    runs_list = samples[(mode, query)]
+                    per_stage = {}
+                    offsets = {}
+                    for trace_id, _ in runs_list:
+                        run = stages.get(trace_id, {})
+                        origin = min((start for start, _ in run.values()), default=0)
+                        for name, (start_us, duration_ms) in run.items():
+                            per_stage.setdefault(name, []).append(duration_ms)
+                            offsets.setdefault(name, []).append(start_us - origin)
+                    # Stages in the order they happen (parents before the phases they contain)
+                    order = sorted(per_stage, key=lambda name: (percentile(sorted(offsets[name]), 50), name))
+                    results.append({
+                        "installations": size,
+                        "mode": mode,
+                        "query": query,
+                        "wall_ms": summarize([ms for _, ms in runs_list]),
+                        "stages_ms": [dict(name=name, **summarize(per_stage[name])) for name in order],
+                    })
+        finally:
+            shutil.rmtree(home, ignore_errors=True)
+
+    return {
+        "format": RESULTS_FORMAT,
+        "created": datetime.now(timezone.utc).isoformat(),
+        "host": {
+            "platform": platform.platform(),
+            "python": platform.python_version(),
+            "cpu_count": os.cpu_count(),
+        },
+        "luaconfig": str(luaconfig),
+        "runs": runs,
+        "results": results,
+    }
+
+
+def result_key(row):
+    return (row["installations"], row["mode"], row["query"])
+
+
+def compare_results(old, new):
+    """Pair rows of two results documents: [(key, old p50, new p50, old p95, new p95)]."""
+    old_rows = {result_key(row): row for row in old.get("results", [])}
+    pairs = []
+    for row in new.get("results", []):
+        previous = old_rows.get(result_key(row))
+        if previous:
+            pairs.append((result_key(row),
+                          previous["wall_ms"]["p50"], row["wall_ms"]["p50"],
+                          previous["wall_ms"]["p95"], row["wall_ms"]["p95"]))
+    return pairs
+
+
+def print_report(document):
+    print(f"{'size':>5} {'mode':<5} {'query':<13} {'p50 ms':>9} {'p95 ms':>9} {'p99 ms':>9}")
+    print("-" * 55)
+    for row in document["results"]:
+        wall = row["wall_ms"]
+        print(f"{row['installations']:>5} {row['mode']:<5} {row['query']:<13} "
+              f"{wall['p50']:>9.2f} {wall['p95']:>9.2f} {wall['p99']:>9.2f}")
+        for stage in row["stages_ms"]:
+            print(f"{'':>25}{stage['name']:<40} p50 {stage['p50']:>8.2f}")
+
+
+def print_comparison(pairs):
+    print(f"{'size':>5} {'mode':<5} {'query':<13} {'old p50':>9} {'new p50':>9} {'delta':>8} {'old p95':>9} {'new p95':>9}")
+    print("-" * 75)
+    for (size, mode, query), old50, new50, old95, new95 in pairs:
+        delta = f"{(new50 - old50) / old50 * 100:+.1f}%" if old50 else "n/a"
+        print(f"{size:>5} {mode:<5} {query:<13} {old50:>9.2f} {new50:>9.2f} {delta:>8} {old95:>9.2f} {new95:>9.2f}")
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="Benchmark luaconfig and the pkg-config chain")
+    parser.add_argument("--luaconfig", type=Path, default=default_luaconfig(),
+                        help="luaconfig.exe to measure (default: ~/.luaenv/bin/luaconfig.exe)")
+    parser.add_argument("--runs", type=int, default=DEFAULT_RUNS,
+                        help=f"Timed invocations per query and mode (default: {DEFAULT_RUNS})")
+    parser.add_argument("--sizes", default=",".join(map(str, DEFAULT_SIZES)),
+                        help="Comma separated installation counts (default: 1,10,100)")
+    parser.add_argument("--queries", default=",".join(QUERIES),
+                        help="Comma separated query types (default: all)")
+    parser.add_argument("--no-stages", action="store_true",
+                        help="Do not set LUAENV_TRACE (no per-stage breakdown)")
+    parser.add_argument("--output", "-o", type=Path, default=Path("luaconfig-bench.json"),
+                        help="Results file (default: luaconfig-bench.json)")
+    parser.add_argument("--compare", type=Path, help="Previous results file to compare against")
+    args = parser.parse_args(argv)
+
+    try:
+        sizes = [int(size) for size in args.sizes.split(",") if size]
+        queries = [query for query in args.queries.split(",") if query]
+        unknown = [query for query in queries if query not in QUERIES]
+        if unknown or not sizes or min(sizes) < 1 or args.runs < 1:
+            parser.error(f"invalid --sizes, --queries or --runs (query types: {', '.join(QUERIES)})")
+
+        document = run_benchmark(args.luaconfig, sizes, args.runs, queries, not args.no_stages,
+                                 progress=lambda message: print(f"[INFO] {message}", file=sys.stderr))
+    except (BenchmarkError, ValueError, OSError) as e:
+        print(f"[ERROR] {e}", file=sys.stderr)
+        return 1
+
+    with open(args.output, "w", encoding="utf-8") as f:
+        json.dump(document, f, indent=2, sort_keys=True)
+        f.write("\n")
+
+    print_report(document)
+    print(f"\n[OK] Results written to {args.output}")
+
+    if args.compare:
+        with open(args.compare, "r", encoding="utf-8") as f:
+            print()
+            print_comparison(compare_results(json.load(f), document))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -8,6 +8,8 @@
 param(
     [string]$Target = "auto",  # auto, win64, win-x86, win-arm64, all, or clean
     [switch]$SelfContained = $false,
+    [ValidateSet("Jit", "ReadyToRun", "NativeAot")]
+    [string]$Publish = "Jit",  # Jit, ReadyToRun (trimmed, self-contained) or NativeAot
     [switch]$WarmUp = $false,
     [switch]$Clean = $false,
     [switch]$Help = $false
@@ -27,6 +29,19 @@ function Get-HostArchitecture {
     }
 }
 
+# Function to build the dotnet publish arguments for a runtime and the -Publish mode
+function Get-PublishArguments {
+    param([string]$Runtime)
+
+    switch ($Publish) {
+        # Precompiled: no JIT at startup (see cli/LuaEnv.CLI/LuaEnv.CLI.fsproj)
+        "ReadyToRun" { return @("--runtime", $Runtime, "-p:LuaEnvPublish=ReadyToRun") }
+        # NativeAOT also needs the MSVC linker (Desktop development with C++)
+        "NativeAot"  { return @("--runtime", $Runtime, "-p:LuaEnvPublish=NativeAot") }
+        default      { return @("--runtime", $Runtime, "--self-contained", $SelfContained) }
+    }
+}
+
 # Function to clean all intermediate build files
 function Invoke-Clean {
     param([switch]$Verbose = $false)
@@ -129,7 +144,7 @@ if ($Help) {
     Write-Host "  Supports Windows x64, x86 (32-bit), and ARM64 targets."
     Write-Host ""
     Write-Host "USAGE:" -ForegroundColor Yellow
-    Write-Host "  .\build_cli.ps1 [-Target <platform>] [-SelfContained] [-Clean] [-WarmUp] [-Help]"
+    Write-Host "  .\build_cli.ps1 [-Target <platform>] [-SelfContained] [-Publish <mode>] [-Clean] [-WarmUp] [-Help]"
     Write-Host ""
     Write-Host "PARAMETERS:" -ForegroundColor Yellow
     Write-Host "  -Target <platform>     Target platform to build for"
@@ -141,6 +156,12 @@ if ($Help) {
     Write-Host "                         Makes the app portable but increases size"
     Write-Host "                         Default: false (requires .NET runtime on target)"
     Write-Host ""
+    Write-Host "  -Publish <mode>        How the CLI is compiled"
+    Write-Host "                         Jit: IL compiled at run time (default)"
+    Write-Host "                         ReadyToRun: precompiled, trimmed and self-contained"
+    Write-Host "                         NativeAot: single native executable, fastest start"
+    Write-Host "                         (NativeAot requires the MSVC C++ build tools)"
+    Write-Host ""
     Write-Host "  -Clean                 Clean all intermediate build files before building"
     Write-Host "                         Removes bin, obj folders and build outputs"
     Write-Host "                         Ensures a clean build environment"
@@ -159,6 +180,8 @@ if ($Help) {
     Write-Host "  .\build_cli.ps1 -Target win64"                      # Force build for Windows x64
     Write-Host "  .\build_cli.ps1 -Target win-x86"                    # Build for Windows x86 (32-bit)
     Write-Host "  .\build_cli.ps1 -Target win-arm64 -SelfContained"   # Self-contained Windows ARM64
+    Write-Host "  .\build_cli.ps1 -Publish ReadyToRun"                # Precompiled, trimmed build
+    Write-Host "  .\build_cli.ps1 -Publish NativeAot"                 # Native executable
     Write-Host "  .\build_cli.ps1 -Target all -Clean -WarmUp"         # Clean and build all platforms and warm up
     Write-Host "  .\build_cli.ps1 -Help"                              # Show this help
     Write-Host ""
@@ -193,11 +216,11 @@ if ($Target -eq "auto") {
     Write-Host "Auto-detected architecture: $Target" -ForegroundColor Cyan
 }
 
-# Standard JIT build (fast startup after first run)
+# JIT build by default, precompiled with -Publish ReadyToRun or NativeAot
 if ($Target -eq "win64" -or $Target -eq "all") {
-    Write-Host "Building for Windows x64..." -ForegroundColor Green
-    & dotnet publish cli/LuaEnv.CLI -c Release -o ./win64 `
-      --self-contained $SelfContained `
+    Write-Host "Building for Windows x64 ($Publish)..." -ForegroundColor Green
+    $publishArgs = Get-PublishArguments -Runtime "win-x64"
+    & dotnet publish cli/LuaEnv.CLI -c Release -o ./win64 @publishArgs `
       -p:PublishSingleFile=false `
       -p:IncludeNativeLibrariesForSelfExtract=true `
       -p:SatelliteResourceLanguages=en
@@ -213,10 +236,9 @@ if ($Target -eq "win64" -or $Target -eq "all") {
 }
 
 if ($Target -eq "win-x86" -or $Target -eq "all") {
-    Write-Host "Building for Windows x86 (32-bit)..." -ForegroundColor Green
-    & dotnet publish cli/LuaEnv.CLI -c Release -o ./win-x86 `
-      --runtime win-x86 `
-      --self-contained $SelfContained `
+    Write-Host "Building for Windows x86 (32-bit, $Publish)..." -ForegroundColor Green
+    $publishArgs = Get-PublishArguments -Runtime "win-x86"
+    & dotnet publish cli/LuaEnv.CLI -c Release -o ./win-x86 @publishArgs `
       -p:PublishSingleFile=false `
       -p:IncludeNativeLibrariesForSelfExtract=true `
       -p:SatelliteResourceLanguages=en
@@ -232,10 +254,9 @@ if ($Target -eq "win-x86" -or $Target -eq "all") {
 }
 
 if ($Target -eq "win-arm64" -or $Target -eq "all") {
-    Write-Host "Building for Windows ARM64..." -ForegroundColor Green
-    & dotnet publish cli/LuaEnv.CLI -c Release -o ./win-arm64 `
-      --runtime win-arm64 `
-      --self-contained $SelfContained `
+    Write-Host "Building for Windows ARM64 ($Publish)..." -ForegroundColor Green
+    $publishArgs = Get-PublishArguments -Runtime "win-arm64"
+    & dotnet publish cli/LuaEnv.CLI -c Release -o ./win-arm64 @publishArgs `
       -p:PublishSingleFile=false `
       -p:IncludeNativeLibrariesForSelfExtract=true `
       -p:SatelliteResourceLanguages=en
@@ -22,6 +22,10 @@ let showHelp () =
     printfn "    luaenv-pkg-config.cmd    Helper batch script for pkg-config integration"
     printfn "    luaconfig.exe            Standalone executable for pkg-config information"
     printfn ""
+    printfn "RESIDENT MODE:"
+    printfn "    luaenv server start      Answer pkg-config queries from a background server"
+    printfn "                             (see luaenv server --help)"
+    printfn ""
     printfn "CLI ARGUMENTS:"
     printfn "    --config <path>          Path to the backend configuration file (required)"
     printfn "                             (Automatically provided by wrapper scripts)"
@@ -46,10 +50,19 @@ let showInstallHelp () =
     printfn "    --name <display-name>          Set display name for the installation"
     printfn "    --dll                          Build as DLL instead of static library"
     printfn "    --debug                        Include debug symbols"
+    printfn "    --optimize pgo                 Profile-guided optimized (PGO/LTCG) release build,"
+    printfn "                                   trained on the Lua test suite (slower to install)"
     printfn "    --x86                          Build for x86 (32-bit) architecture"
     printfn "    --x64                          Build for x64 (64-bit) architecture (default)"
     printfn "    --skip-env-check               Skip Visual Studio environment check"
     printfn "    --skip-tests                   Skip test suite after building"
+    printfn "    --test-suite <full|smoke>      Lua tests to run (smoke: short subset for CI)"
+    printfn "    --test-jobs <n>                Lua test files run in parallel (default: one per CPU)"
+    printfn "    --matrix                       Build every combination of --lua-version (comma"
+    printfn "                                   separated), --arch and --build-type concurrently"
+    printfn "    --arch <x86,x64>               Architectures of a matrix build"
+    printfn "    --build-type <static,dll>      Build types of a matrix build"
+    printfn "    --jobs <n>                     Parallel jobs of a matrix build (default: half the CPUs)"
     printfn "    --help, -h                     Show this help message"
     printfn "\n"
     printfn "ARCHITECTURE:"
@@ -60,9 +73,11 @@ let showInstallHelp () =
     printfn "EXAMPLES:"
     printfn "    luaenv install"
     printfn "    luaenv install --alias dev --dll"
+    printfn "    luaenv install --alias fast --optimize pgo"
     printfn "    luaenv install --x86 --alias legacy"
     printfn "    luaenv install --lua-version 5.3.6 --alias old"
     printfn "    luaenv install --luarocks-version 3.11.1 --alias stable"
+    printfn "    luaenv install --matrix --lua-version 5.4.8,5.4.7 --arch x86,x64 --build-type static,dll --jobs 4"
 
 /// Display uninstall-specific help
 let showUninstallHelp () =
@@ -110,11 +125,17 @@ let showStatusHelp () =
     printfn ""
     printfn "USAGE:"
     printfn "    luaenv status"
+    printfn "    luaenv status [alias|uuid...] --timings [--json]"
     printfn ""
     printfn "DESCRIPTION:"
     printfn "    Show comprehensive system status and registry information."
+    printfn "    With --timings, show how long each phase of the install took (launch,"
+    printfn "    vcvars, download, extraction, compilation, linking, tests, LuaRocks setup)."
     printfn ""
     printfn "OPTIONS:"
+    printfn "    --timings                      Show the per-phase install timelines (all installations"
+    printfn "                                   unless some are named)"
+    printfn "    --json                         Print the timelines as JSON, for aggregation"
     printfn "    --help, -h                     Show this help message"
     printfn ""
     printfn "STATUS EXPLANATIONS:"
@@ -133,6 +154,8 @@ let showStatusHelp () =
     printfn ""
     printfn "EXAMPLES:"
     printfn "    luaenv status"
+    printfn "    luaenv status dev --timings"
+    printfn "    luaenv status --timings --json > timings.json"
 
 /// Display set-alias-specific help
 let showSetAliasHelp () =
@@ -234,6 +257,15 @@ let showPkgConfigHelp () =
     printfn "    --libdir                       Show lib directory path only"
     printfn "    --path                         Show installation paths only"
     printfn "    --path-style <style>           Output path style ('windows', 'unix', or 'native')"
+    printfn "    --format <format>              Print the selected fields (all if none) as 'cmake' set() calls,"
+    printfn "                                   a 'json' object or 'env' KEY=VALUE lines"
+    printfn "    --emit [dir]                   Write LuaEnvConfig.cmake, luaenv.pc, luaenv-native.ini and"
+    printfn "                                   LuaEnv.props to dir. Without dir they go to"
+    printfn "                                   %%USERPROFILE%%\\.luaenv\\buildconfig\\<alias|uuid>, which is"
+    printfn "                                   kept current on every registry change (also for 'default')"
+    printfn ""
+    printfn "    Several flags can be combined in one call; answers are printed in the order"
+    printfn "    --cflag, --lua-include, --liblua, --libdir, --path."
     printfn ""
     printfn "EXAMPLES:"
     printfn "    luaconfig.exe <alias|uuid>                     # Show all pkg-config information"
@@ -243,6 +275,9 @@ let showPkgConfigHelp () =
     printfn "    luaconfig.exe <alias|uuid> --libdir            # Show lib directory path"
     printfn "    luaconfig.exe <alias|uuid> --path              # Show paths for installation"
     printfn "    luaconfig.exe <alias|uuid> --path-style unix   # Different path style output (unix /, windows \\\\, native \\)"
+    printfn "    luaconfig.exe <alias|uuid> --lua-include --liblua --format cmake  # CMake set() script"
+    printfn "    luaconfig.exe <alias|uuid> --format json       # Every field as a JSON object"
+    printfn "    luaconfig.exe <alias|uuid> --emit build\\lua    # Static build files, no luaconfig call at configure time"
     printfn ""
     printfn "EXAMPLES FOR BUILD SYSTEMS:"
     printfn "    luaconfig <alias|uuid> --cflag                     # Use the standalone executable (recommended)"
@@ -259,6 +294,65 @@ let showPkgConfigHelp () =
     printfn ""
 
 
+/// Display server-specific help
+let showServerHelp () =
+    printfn "LuaEnv CLI - Server Command"
+    printfn ""
+    printfn "USAGE:"
+    printfn "    luaenv server <start|stop|status|run> [options]"
+    printfn ""
+    printfn "DESCRIPTION:"
+    printfn "    Opt-in resident mode. The server keeps the configuration, the registry and a"
+    printfn "    Python worker loaded and answers pkg-config queries from luaconfig.exe and"
+    printfn "    luaenv.ps1 over a per-user named pipe (\\\\.\\pipe\\luaenv-cli-<user>)."
+    printfn "    Clients fall back to starting the CLI when no server is running."
+    printfn "    The server reloads when the registry revision changes and exits when idle."
+    printfn ""
+    printfn "ACTIONS:"
+    printfn "    start                          Start the server in the background"
+    printfn "    stop                           Stop the running server"
+    printfn "    status                         Show whether the server is running"
+    printfn "    run                            Run the server in the foreground"
+    printfn ""
+    printfn "OPTIONS:"
+    printfn "    --idle-timeout <seconds>       Exit after this much inactivity (default: %.0f)" Server.defaultIdleTimeout.TotalSeconds
+    printfn "    --help, -h                     Show this help message"
+    printfn ""
+    printfn "EXAMPLES:"
+    printfn "    luaenv server start                       # Before a parallel build"
+    printfn "    luaenv server start --idle-timeout 3600   # Keep it for an hour of inactivity"
+    printfn "    luaenv server stop"
+    printfn ""
+
+/// Display bench-specific help
+let showBenchHelp () =
+    printfn "LuaEnv CLI - Bench Command"
+    printfn ""
+    printfn "USAGE:"
+    printfn "    luaenv bench [<alias|uuid> ...] [options]"
+    printfn ""
+    printfn "DESCRIPTION:"
+    printfn "    Run a fixed interpreter benchmark suite (calls, tables, strings, closures,"
+    printfn "    GC churn, coroutines, JSON) against one or more installations and report"
+    printfn "    wall time (median, mean, stdev) and peak working set per benchmark."
+    printfn "    With several installations the runs are interleaved and compared against"
+    printfn "    the first one. Results are saved and shown by 'luaenv list --detailed'."
+    printfn ""
+    printfn "ARGUMENTS:"
+    printfn "    <alias|uuid>                   Installations to benchmark (default: the default installation)"
+    printfn ""
+    printfn "OPTIONS:"
+    printfn "    --runs <n>                     Timed runs per benchmark (default: 5, after a warm-up)"
+    printfn "    --only <a,b,...>               Run only these benchmarks"
+    printfn "    --no-save                      Do not store the results in the registry"
+    printfn "    --help, -h                     Show this help message"
+    printfn ""
+    printfn "EXAMPLES:"
+    printfn "    luaenv bench                   # Benchmark the default installation"
+    printfn "    luaenv bench dev fast          # Compare 'fast' (e.g. --optimize pgo) against 'dev'"
+    printfn "    luaenv bench dev --only calls,json --runs 10"
+    printfn ""
+
 /// Command line argument parsing
 type CliArgs = {
     ConfigPath: string option
@@ -267,7 +361,7 @@ type CliArgs = {
 
 /// Parse command line arguments
 let parseArgs (args: string array) : CliArgs =
-    let rec parseArgsRec args acc =
+    let rec parseArgsRec args (acc: CliArgs) =
         match args with
         | [] -> acc
         | "--config" :: configPath :: rest ->
@@ -342,6 +436,22 @@ let parseArgs (args: string array) : CliArgs =
             printfn "[ERROR] Missing required argument: <alias|uuid>"
             printfn "Use 'luaenv pkg-config --help' for usage information"
             exit 1
+        | "server" :: "--help" :: rest ->
+            showServerHelp ()
+            exit 0
+        | "server" :: "-h" :: rest ->
+            showServerHelp ()
+            exit 0
+        | "server" :: action :: rest when List.contains action ["start"; "stop"; "status"; "run"] ->
+            let serverOptions = parseServerOptions action (acc.ConfigPath |> Option.defaultValue "") rest
+            { acc with Command = Some (Server serverOptions) }
+        | "server" :: rest ->
+            printfn "[ERROR] Missing or unknown server action. Must be one of: start, stop, status, run"
+            printfn "Use 'luaenv server --help' for usage information"
+            exit 1
+        | "bench" :: rest ->
+            let benchOptions = parseBenchOptions rest
+            { acc with Command = Some (Bench benchOptions) }
         | "set-alias" :: "--help" :: rest ->
             showSetAliasHelp ()
             exit 0
@@ -463,6 +573,12 @@ let parseArgs (args: string array) : CliArgs =
                 parseInstallRec rest ({ acc with UseDll = true } : InstallOptions)
             | "--debug" :: rest ->
                 parseInstallRec rest ({ acc with UseDebug = true } : InstallOptions)
+            | "--optimize" :: mode :: rest ->
+                parseInstallRec rest ({ acc with Optimize = Some mode } : InstallOptions)
+            | "--optimize" :: [] ->
+                printfn "[ERROR] Missing value for option: --optimize"
+                printfn "Use 'luaenv install --help' for available options"
+                exit 1
             | "--x86" :: rest ->
                 parseInstallRec rest ({ acc with UseX86 = true } : InstallOptions)
             | "--x64" :: rest ->
@@ -471,6 +587,48 @@ let parseArgs (args: string array) : CliArgs =
                 parseInstallRec rest ({ acc with SkipEnvCheck = true } : InstallOptions)
             | "--skip-tests" :: rest ->
                 parseInstallRec rest ({ acc with SkipTests = true } : InstallOptions)
+            | "--test-suite" :: suite :: rest ->
+                parseInstallRec rest ({ acc with TestSuite = Some suite } : InstallOptions)
+            | "--test-suite" :: [] ->
+                printfn "[ERROR] Missing value for option: --test-suite"
+                printfn "Use 'luaenv install --help' for available options"
+                exit 1
+            | "--test-jobs" :: jobs :: rest ->
+                match Int32.TryParse jobs with
+                | true, value when value > 0 ->
+                    parseInstallRec rest ({ acc with TestJobs = Some value } : InstallOptions)
+                | _ ->
+                    printfn "[ERROR] Invalid test job count: %s. Must be a positive number" jobs
+                    exit 1
+            | "--test-jobs" :: [] ->
+                printfn "[ERROR] Missing value for option: --test-jobs"
+                printfn "Use 'luaenv install --help' for available options"
+                exit 1
+            | "--matrix" :: rest ->
+                parseInstallRec rest ({ acc with Matrix = true } : InstallOptions)
+            | "--arch" :: archs :: rest ->
+                parseInstallRec rest ({ acc with Architectures = Some archs } : InstallOptions)
+            | "--arch" :: [] ->
+                printfn "[ERROR] Missing value for option: --arch"
+                printfn "Use 'luaenv install --help' for available options"
+                exit 1
+            | "--build-type" :: types :: rest ->
+                parseInstallRec rest ({ acc with BuildTypes = Some types } : InstallOptions)
+            | "--build-type" :: [] ->
+                printfn "[ERROR] Missing value for option: --build-type"
+                printfn "Use 'luaenv install --help' for available options"
+                exit 1
+            | "--jobs" :: jobs :: rest ->
+                match Int32.TryParse jobs with
+                | true, value when value > 0 ->
+                    parseInstallRec rest ({ acc with Jobs = Some value } : InstallOptions)
+                | _ ->
+                    printfn "[ERROR] Invalid job count: %s. Must be a positive number" jobs
+                    exit 1
+            | "--jobs" :: [] ->
+                printfn "[ERROR] Missing value for option: --jobs"
+                printfn "Use 'luaenv install --help' for available options"
+                exit 1
             | arg :: rest ->
                 printfn "[ERROR] Unknown install option: %s" arg
                 printfn "Use 'luaenv install --help' for available options"
@@ -484,9 +642,16 @@ let parseArgs (args: string array) : CliArgs =
                 Name = None
                 UseDll = false
                 UseDebug = false
+                Optimize = None
                 UseX86 = false
                 SkipEnvCheck = false
                 SkipTests = false
+                TestSuite = None
+                TestJobs = None
+                Matrix = false
+                Architectures = None
+                BuildTypes = None
+                Jobs = None
             } : InstallOptions)
         with
         | Failure "HELP_REQUESTED" ->
@@ -562,13 +727,24 @@ let parseArgs (args: string array) : CliArgs =
                 // Return Help command for status help
                 showStatusHelp ()
                 exit 0
+            | "--timings" :: rest ->
+                parseStatusRec rest { acc with Timings = true }
+            | "--json" :: rest ->
+                parseStatusRec rest { acc with Json = true }
+            | arg :: rest when not (arg.StartsWith "-") ->
+                parseStatusRec rest { acc with Targets = acc.Targets @ [arg] }
             | arg :: rest ->
                 printfn "[ERROR] Unknown status option: %s" arg
                 printfn "Use 'luaenv status --help' for available options"
                 exit 1
 
         try
-            parseStatusRec args ()
+            let options = parseStatusRec args { Targets = []; Timings = false; Json = false }
+            if not options.Targets.IsEmpty && not (options.Timings || options.Json) then
+                printfn "[ERROR] Installations can only be named together with --timings"
+                printfn "Use 'luaenv status --help' for available options"
+                exit 1
+            options
         with
         | Failure "HELP_REQUESTED" ->
             // This will cause the parent parser to return Help command
@@ -635,6 +811,20 @@ let parseArgs (args: string array) : CliArgs =
                 printfn "[ERROR] Missing value for option: --path-style"
                 printfn "Use 'luaenv pkg-config --help' for available options"
                 exit 1
+            | "--format" :: fmt :: rest when List.contains fmt ["cmake"; "json"; "env"] ->
+                parsePkgConfigRec rest { acc with Format = Some fmt }
+            | "--format" :: fmt :: rest ->
+                printfn "[ERROR] Invalid output format: %s. Must be one of: 'cmake', 'json', 'env'" fmt
+                printfn "Use 'luaenv pkg-config --help' for available options"
+                exit 1
+            | "--format" :: [] ->
+                printfn "[ERROR] Missing value for option: --format"
+                printfn "Use 'luaenv pkg-config --help' for available options"
+                exit 1
+            | "--emit" :: dir :: rest when not (dir.StartsWith "--") ->
+                parsePkgConfigRec rest { acc with Emit = Some dir }
+            | "--emit" :: rest ->
+                parsePkgConfigRec rest { acc with Emit = Some "" }
             | arg :: rest ->
                 printfn "[ERROR] Unknown pkg-config option: %s" arg
                 printfn "Use 'luaconfig --help' for available options"
@@ -647,7 +837,9 @@ let parseArgs (args: string array) : CliArgs =
             ShowLibLua = false;
             ShowLibDir = false;
             ShowPaths = false;
-            PathStyle = None
+            PathStyle = None;
+            Format = None;
+            Emit = None
             }
 
         with
@@ -655,6 +847,68 @@ let parseArgs (args: string array) : CliArgs =
             // This will cause the parent parser to return Help command
             failwith "HELP_REQUESTED"
 
+    and parseServerOptions action configPath args =
+        let rec parseServerRec args acc =
+            match args with
+            | [] -> acc
+            | "--help" :: rest ->
+                showServerHelp ()
+                exit 0
+            | "-h" :: rest ->
+                showServerHelp ()
+                exit 0
+            | "--idle-timeout" :: seconds :: rest ->
+                match Int32.TryParse seconds with
+                | true, value when value > 0 ->
+                    parseServerRec rest { acc with IdleTimeout = Some value }
+                | _ ->
+                    printfn "[ERROR] Invalid idle timeout: %s. Must be a positive number of seconds" seconds
+                    exit 1
+            | "--idle-timeout" :: [] ->
+                printfn "[ERROR] Missing value for option: --idle-timeout"
+                printfn "Use 'luaenv server --help' for available options"
+                exit 1
+            | "--background" :: rest ->
+                parseServerRec rest { acc with Background = true }
+            | arg :: rest ->
+                printfn "[ERROR] Unknown server option: %s" arg
+                printfn "Use 'luaenv server --help' for available options"
+                exit 1
+
+        parseServerRec args { Action = action; ConfigPath = configPath; IdleTimeout = None; Background = false }
+
+    and parseBenchOptions args =
+        let rec parseBenchRec args acc =
+            match args with
+            | [] -> { acc with Installations = List.rev acc.Installations }
+            | "--help" :: rest
+            | "-h" :: rest ->
+                showBenchHelp ()
+                exit 0
+            | "--runs" :: runs :: rest ->
+                match Int32.TryParse runs with
+                | true, value when value > 0 ->
+                    parseBenchRec rest { acc with Runs = Some value }
+                | _ ->
+                    printfn "[ERROR] Invalid number of runs: %s. Must be a positive number" runs
+                    exit 1
+            | "--only" :: names :: rest when not (names.StartsWith "--") ->
+                parseBenchRec rest { acc with Only = Some names }
+            | "--no-save" :: rest ->
+                parseBenchRec rest { acc with Save = false }
+            | ("--runs" | "--only") as option :: _ ->
+                printfn "[ERROR] Missing value for option: %s" option
+                printfn "Use 'luaenv bench --help' for available options"
+                exit 1
+            | arg :: rest when arg.StartsWith "-" ->
+                printfn "[ERROR] Unknown bench option: %s" arg
+                printfn "Use 'luaenv bench --help' for available options"
+                exit 1
+            | idOrAlias :: rest ->
+                parseBenchRec rest { acc with Installations = idOrAlias :: acc.Installations }
+
+        parseBenchRec args { Installations = []; Runs = None; Only = None; Save = true }
+
     parseArgsRec (Array.toList args) { ConfigPath = None; Command = None }
 
 /// Display configuration information
@@ -698,6 +952,14 @@ let executeCommand (config: BackendConfig) (command: Command) : int =
             printfn "%s" errorMsg
             1
 
+    | Status options when options.Timings || options.Json ->
+        // No banner or epilog, so --json output can be redirected as is
+        match executeStatus config options with
+        | Ok exitCode -> exitCode
+        | Error errorMsg ->
+            printfn "%s" errorMsg
+            1
+
     | Status options ->
         printfn "[INFO] Checking system status..."
         match executeStatus config options with
@@ -738,7 +1000,44 @@ let executeCommand (config: BackendConfig) (command: Command) : int =
             1
 
     | PkgConfig options ->
-        match executePkgConfig config options.Installation options.ShowCFlag options.ShowLuaInclude options.ShowLibLua options.ShowLibDir options.ShowPaths options.PathStyle with
+        match executePkgConfig config options.Installation options.ShowCFlag options.ShowLuaInclude options.ShowLibLua options.ShowLibDir options.ShowPaths options.PathStyle options.Format options.Emit with
+        | Ok exitCode -> exitCode
+        | Error errorMsg ->
+            printfn "%s" errorMsg
+            1
+
+    | Server options ->
+        let idleTimeout =
+            options.IdleTimeout
+            |> Option.map (fun seconds -> TimeSpan.FromSeconds(float seconds))
+            |> Option.defaultValue Server.defaultIdleTimeout
+
+        let result =
+            match options.Action with
+            | "start" -> Server.start options.ConfigPath idleTimeout
+            | "run" ->
+                // Detached servers have no console to write to
+                if options.Background then
+                    Console.SetOut(IO.TextWriter.Null)
+                    Console.SetError(IO.TextWriter.Null)
+                Server.run config idleTimeout Environment.ProcessorCount
+            | action ->
+                match Server.request ["server"; action] 1000 with
+                | Some (exitCode, text) ->
+                    printf "%s" text
+                    Ok exitCode
+                | None ->
+                    printfn "[INFO] LuaEnv server is not running"
+                    Ok (if action = "status" then 1 else 0)
+
+        match result with
+        | Ok exitCode -> exitCode
+        | Error errorMsg ->
+            printfn "%s" errorMsg
+            1
+
+    | Bench options ->
+        match executeBench config options with
         | Ok exitCode -> exitCode
         | Error errorMsg ->
             printfn "%s" errorMsg
@@ -788,8 +1087,12 @@ let executeCommand (config: BackendConfig) (command: Command) : int =
 /// Main entry point
 [<EntryPoint>]
 let main args =
+    // .NET runtime startup, from process creation to this entry point
+    if Trace.enabled then
+        Trace.since "cli startup" (Diagnostics.Process.GetCurrentProcess().StartTime)
+
     try
-        let cliArgs = parseArgs args
+        let cliArgs = Trace.span "cli parseArgs" (fun () -> parseArgs args)
 
         match cliArgs.Command with
         | Some Help ->
@@ -803,10 +1106,10 @@ let main args =
                 showHelp ()
                 1
             | Some configPath ->
-                match loadConfig configPath with
+                match Trace.span "cli loadConfig" (fun () -> loadConfig configPath) with
                 | Ok config ->
                     match cliArgs.Command with
-                    | Some command -> executeCommand config command
+                    | Some command -> Trace.span "cli executeCommand" (fun () -> executeCommand config command)
                     | None ->
                         printfn "[ERROR] No command specified"
                         printfn ""
@@ -0,0 +1,294 @@
+// This is free and unencumbered software released into the public domain.
+// For more details, see the LICENSE file in the project root.
+
+namespace LuaEnv.Core
+
+open System
+open System.IO
+open System.Text
+
+/// Native pkg-config answers, a port of LuaPkgConfig in backend/pkg_config.py.
+///
+/// Produces exactly the text pkg_config.py prints (with "\n" line ends) for the
+/// query flags, --path-style, --format and the full report. Anything that would
+/// make pkg_config.py report an error (unknown or ambiguous installation, missing
+/// directory, missing lua54.lib), and paths pathlib would rewrite, returns None
+/// so the caller can fall back to the Python script. Keep both in sync.
+module PkgConfig =
+
+    /// Query flags in the fixed order pkg_config.py answers them
+    let queryOrder = [ "cflag"; "lua-include"; "liblua"; "libdir"; "path" ]
+
+    /// --format variables, grouped by the query that selects them (FORMAT_GROUPS)
+    let private formatGroups = [
+        "info", [ "LUA_VERSION"; "LUA_BUILD_TYPE"; "LUA_BUILD_CONFIG"; "LUA_ARCHITECTURE" ]
+        "cflag", [ "LUA_CFLAGS" ]
+        "lua-include", [ "LUA_INCLUDE_DIR" ]
+        "liblua", [ "LUA_LIBRARY" ]
+        "libdir", [ "LUA_LIBRARY_DIR" ]
+        "path", [ "LUA_PREFIX"; "LUA_BIN_DIR"; "LUA_EXECUTABLE"; "LUA_DLL" ]
+    ]
+
+    type private InstallationPaths = {
+        Prefix: string
+        Bin: string
+        Include: string
+        Lib: string
+        Share: string
+        Doc: string
+        LuaExe: string option
+        LuacExe: string option
+        LuaDll: string option
+        LuaLib: string option
+        LuaH: string option
+        /// Directory behind the /I flag, "" when there are no headers
+        IncludeDir: string
+    }
+
+    let private sep = Path.DirectorySeparatorChar
+
+    /// True when str(Path(path)) would print path unchanged, so the joins below
+    /// match pathlib without reimplementing its normalisation
+    let private isCanonical (path: string) =
+        let doubled = String(sep, 2)
+        let body = if sep = '\\' && path.StartsWith doubled then path.Substring 2 else path
+        not (String.IsNullOrEmpty path)
+        && (sep = Path.AltDirectorySeparatorChar || not (path.Contains Path.AltDirectorySeparatorChar))
+        && not (body.Contains doubled)
+        && not (path.EndsWith(string sep) || path.EndsWith(string sep + "."))
+        && not (path.Contains(string sep + "." + string sep))
+
+    let private join (basePath: string) (relative: string) =
+        basePath + string sep + relative.Replace('/', sep)
+
+    let private exists (path: string) = File.Exists path || Directory.Exists path
+
+    let private findFile (basePath: string) (candidates: string list) =
+        candidates |> List.map (join basePath) |> List.tryFind exists
+
+    let private analyzePaths (prefix: string) : InstallationPaths =
+        {
+            Prefix = prefix
+            Bin = join prefix "bin"
+            Include = join prefix "include"
+            Lib = join prefix "lib"
+            Share = join prefix "share"
+            Doc = join prefix "doc"
+            LuaExe = findFile prefix [ "bin/lua.exe"; "lua.exe" ]
+            LuacExe = findFile prefix [ "bin/luac.exe"; "luac.exe" ]
+            LuaDll = findFile prefix [ "bin/lua54.dll"; "lib/lua54.dll"; "lua54.dll" ]
+            LuaLib = findFile prefix [ "lib/lua54.lib"; "lua54.lib" ]
+            LuaH = findFile prefix [ "include/lua.h"; "lua.h" ]
+            IncludeDir =
+                if exists (join prefix "include") then join prefix "include"
+                elif exists (join prefix "lua.h") then prefix
+                else ""
+        }
+
+    /// _normalize_path: "unix" uses forward slashes, "windows" escapes backslashes
+    let normalizePath (path: string) (style: string) : string =
+        match style with
+        | _ when String.IsNullOrEmpty path -> ""
+        | "unix" -> if sep = '\\' then path.Replace('\\', '/') else path
+        | "native" -> path
+        | _ -> path.Replace("\\", "\\\\")
+
+    /// registry.get_installation: alias, exact UUID, then a unique partial UUID
+    let findInstallation (registry: RegistryData) (idOrAlias: string) : Installation option =
+        let byAlias =
+            registry.aliases
+            |> Map.tryFind idOrAlias
+            |> Option.bind (fun id -> Map.tryFind id registry.installations)
+
+        match byAlias with
+        | Some installation -> Some installation
+        | None ->
+            match Map.tryFind idOrAlias registry.installations with
+            | Some installation -> Some installation
+            | None ->
+                let looksLikeUuid =
+                    idOrAlias.Contains "-" || idOrAlias.ToLowerInvariant() |> Seq.forall (fun c -> "0123456789abcdef".Contains c)
+                if idOrAlias.Length < 4 || not looksLikeUuid then
+                    None
+                else
+                    let prefix = idOrAlias.Replace("-", "")
+                    // More than one match is an error pkg_config.py reports itself
+                    match registry.installations |> Map.filter (fun id _ -> id.Replace("-", "").StartsWith(prefix, StringComparison.Ordinal)) |> Map.toList with
+                    | [ (_, installation) ] -> Some installation
+                    | _ -> None
+
+    let private jsonString (value: string) =
+        let builder = StringBuilder("\"")
+        for c in value do
+            match c with
+            | '"' -> builder.Append("\\\"") |> ignore
+            | '\\' -> builder.Append("\\\\") |> ignore
+            | '\n' -> builder.Append("\\n") |> ignore
+            | '\r' -> builder.Append("\\r") |> ignore
+            | '\t' -> builder.Append("\\t") |> ignore
+            | '\b' -> builder.Append("\\b") |> ignore
+            | '\f' -> builder.Append("\\f") |> ignore
+            | c when c < ' ' -> builder.AppendFormat("\\u{0:x4}", int c) |> ignore
+            | c -> builder.Append(c) |> ignore
+        builder.Append('"').ToString()
+
+    let private cmakeEscape (value: string) =
+        value.Replace("\\", "\\\\").Replace("\"", "\\\"").Replace("$", "\\$")
+
+    let private cflag (paths: InstallationPaths) (style: string) =
+        if paths.IncludeDir = "" then "" else sprintf "/I\"%s\"" (normalizePath paths.IncludeDir style)
+
+    let private showPaths (installation: Installation) (paths: InstallationPaths) (style: string) =
+        let norm path = normalizePath path style
+        let important label (file: string option) =
+            match file with
+            | Some path -> sprintf "%s%s\n" label (norm path)
+            | None -> sprintf "%s[NOT FOUND]\n" label
+
+        String.concat "" [
+            "INSTALLATION PATHS\n"
+            sprintf "Prefix:      %s\n" (norm paths.Prefix)
+            sprintf "Binaries:    %s\n" (norm paths.Bin)
+            sprintf "Headers:     %s\n" (norm paths.Include)
+            sprintf "Libraries:   %s\n" (norm paths.Lib)
+            sprintf "Share:       %s\n" (norm paths.Share)
+            sprintf "Documentation: %s\n" (norm paths.Doc)
+            "\n"
+            "IMPORTANT FILES\n"
+            important "lua.exe:     " paths.LuaExe
+            important "luac.exe:    " paths.LuacExe
+            important "lua.h:       " paths.LuaH
+            (if installation.build_type = "dll" then important "lua54.dll:   " paths.LuaDll else "")
+            important "lua54.lib:   " paths.LuaLib
+        ]
+
+    let private showAllInfo (installation: Installation) (paths: InstallationPaths) (style: string) =
+        let includeDir = normalizePath paths.Include style
+        let libDir = normalizePath paths.Lib style
+        let isDll = installation.build_type = "dll"
+
+        String.concat "" [
+            "PKG-CONFIG INFORMATION\n"
+            sprintf "Installation: %s\n" installation.name
+            (match installation.alias with
+             | Some alias when alias <> "" -> sprintf "Alias:        %s\n" alias
+             | _ -> "")
+            sprintf "ID:           %s\n" installation.id
+            sprintf "Lua Version:  %s\n" installation.lua_version
+            sprintf "LuaRocks:     %s\n" installation.luarocks_version
+            sprintf "Build Type:   %s %s\n" installation.build_type installation.build_config
+            sprintf "Architecture: %s\n" installation.architecture
+            "\n"
+            "COMPILER FLAGS\n"
+            sprintf "CFLAGS:   %s\n" (if includeDir = "" then "" else sprintf "/I\"%s\"" includeDir)
+            "\n"
+            "LINKER FLAGS\n"
+            "LIBS:     lua54.lib\n"
+            sprintf "LDFLAGS:  %s\n" (if libDir = "" then "" else sprintf "/LIBPATH:\"%s\"" libDir)
+            "\n"
+            (if not isDll then ""
+             else
+                match paths.LuaDll with
+                | Some dll ->
+                    String.concat "" [
+                        "DLL RUNTIME REQUIREMENTS\n"
+                        sprintf "Runtime DLL: %s\n" (normalizePath dll style)
+                        "IMPORTANT: Ensure lua54.dll is available at runtime by:\n"
+                        "  - Copying lua54.dll to your application directory, or\n"
+                        "  - Adding the DLL directory to your system PATH, or\n"
+                        "  - Using SetDllDirectory() in your application\n"
+                        "\n"
+                    ]
+                | None -> "DLL RUNTIME REQUIREMENTS\nRuntime DLL: [NOT FOUND - Installation may be incomplete]\n\n")
+            "COMPATIBILITY WARNING:\n"
+            "  These libraries were built with MSVC and are NOT compatible with:\n"
+            "  - MinGW/GCC\n"
+            "  - Clang (when using MinGW runtime)\n"
+            "  - Other non-MSVC toolchains\n"
+            (if isDll then "  DLL builds may work with other compilers if they can use MSVC import libraries.\n"
+             else "  Use DLL builds for better cross-compiler compatibility.\n")
+        ]
+
+    let private showQuery (installation: Installation) (paths: InstallationPaths) (style: string) (query: string) =
+        match query with
+        | "cflag" -> Some (match cflag paths style with "" -> "" | flag -> flag + "\n")
+        | "lua-include" -> Some (normalizePath paths.Include style + "\n")
+        | "liblua" -> paths.LuaLib |> Option.map (fun lib -> normalizePath lib style + "\n")
+        | "libdir" -> Some (normalizePath paths.Lib style + "\n")
+        | "path" -> Some (showPaths installation paths style)
+        | _ -> None
+
+    let private showVariables (installation: Installation) (paths: InstallationPaths) (style: string) (queries: string list) (format: string) =
+        let norm path = normalizePath path style
+        let variable name : string option =
+            match name with
+            | "LUA_VERSION" -> Some installation.lua_version
+            | "LUA_BUILD_TYPE" -> Some installation.build_type
+            | "LUA_BUILD_CONFIG" -> Some installation.build_config
+            | "LUA_ARCHITECTURE" -> Some installation.architecture
+            | "LUA_CFLAGS" -> Some (cflag paths style)
+            | "LUA_INCLUDE_DIR" -> Some (norm paths.Include)
+            | "LUA_LIBRARY" -> paths.LuaLib |> Option.map norm
+            | "LUA_LIBRARY_DIR" -> Some (norm paths.Lib)
+            | "LUA_PREFIX" -> Some (norm paths.Prefix)
+            | "LUA_BIN_DIR" -> Some (norm paths.Bin)
+            | "LUA_EXECUTABLE" -> Some (paths.LuaExe |> Option.map norm |> Option.defaultValue "")
+            | "LUA_DLL" -> Some (paths.LuaDll |> Option.map norm |> Option.defaultValue "")
+            | _ -> None
+
+        let renderGroup (names: string list) =
+            let values = names |> List.map (fun name -> name, variable name)
+            if values |> List.exists (fun (_, value) -> value.IsNone) then
+                None
+            else
+                let values = values |> List.map (fun (name, value) -> name, value.Value)
+                match format with
+                | "cmake" -> Some (values |> List.map (fun (name, value) -> sprintf "set(%s \"%s\")\n" name (cmakeEscape value)) |> String.concat "")
+                | "env" -> Some (values |> List.map (fun (name, value) -> sprintf "%s=%s\n" name value) |> String.concat "")
+                | _ -> Some (values |> List.map (fun (name, value) -> sprintf "  %s: %s" (jsonString name) (jsonString value)) |> String.concat ",\n")
+
+        let rendered =
+            formatGroups
+            |> List.filter (fun (group, _) -> List.isEmpty queries || List.contains group queries)
+            |> List.map (snd >> renderGroup)
+
+        if rendered |> List.exists Option.isNone then
+            None // Missing lua54.lib, reported by pkg_config.py
+        else
+            let groups = rendered |> List.choose id
+            if format = "json" then Some ("{\n" + String.Join(",\n", groups) + "\n}\n")
+            else Some (String.concat "" groups)
+
+    /// The stdout of `pkg_config.py <installation> [flags] [--path-style] [--format]`,
+    /// or None when pkg_config.py has to answer (errors, unusual paths)
+    let render (registry: RegistryData) (idOrAlias: string) (queries: string list) (pathStyle: string) (format: string option) : string option =
+        match findInstallation registry idOrAlias with
+        | Some installation when isCanonical installation.installation_path && Directory.Exists installation.installation_path ->
+            let paths = analyzePaths installation.installation_path
+            let requested = queryOrder |> List.filter (fun query -> List.contains query queries)
+            match format with
+            | Some fmt -> showVariables installation paths pathStyle requested fmt
+            | None when List.isEmpty requested -> Some (showAllInfo installation paths pathStyle)
+            | None ->
+                let answers = requested |> List.map (showQuery installation paths pathStyle)
+                if answers |> List.exists Option.isNone then None
+                else Some (answers |> List.choose id |> String.concat "")
+        | _ -> None
+
+    /// render for raw pkg-config arguments (as accepted by Server.isServablePkgConfig);
+    /// later --path-style and --format values win, like argparse
+    let renderArgs (registry: RegistryData) (args: string list) : string option =
+        let rec parse args queries style format =
+            match args with
+            | [] -> Some (queries, style, format)
+            | "--path-style" :: value :: rest -> parse rest queries value format
+            | "--format" :: value :: rest -> parse rest queries style (Some value)
+            | flag :: rest when flag.StartsWith "--" && List.contains (flag.Substring 2) queryOrder ->
+                parse rest (flag.Substring 2 :: queries) style format
+            | _ -> None
+
+        match args with
+        | installation :: rest ->
+            parse rest [] "native" None
+            |> Option.bind (fun (queries, style, format) -> render registry installation queries style format)
+        | [] -> None
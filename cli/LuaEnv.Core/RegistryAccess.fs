@@ -5,7 +5,10 @@ namespace LuaEnv.Core
 
 open System
 open System.IO
+open System.Runtime.InteropServices
 open System.Text.Json
+open System.Text.Json.Nodes
+open Microsoft.Win32.SafeHandles
 
 /// Package information from registry
 type PackageInfo = {
@@ -13,6 +16,40 @@ type PackageInfo = {
     last_updated: string option
 }
 
+/// Timing of one interpreter benchmark (luaenv bench)
+type BenchmarkResult = {
+    median_ms: float
+    mean_ms: float
+    stdev_ms: float
+    cv_percent: float
+    min_ms: float
+    peak_working_set_kb: int64
+}
+
+/// Last benchmark run of an installation, as stored by bench_lua.py
+type BenchmarkSummary = {
+    suite_version: int
+    updated: string
+    runs: int
+    total_ms: float
+    results: Map<string, BenchmarkResult>
+}
+
+/// Measured size of one tree, with the marker it was measured at
+/// (see backend/disk_usage.py)
+type TreeUsage = {
+    bytes: int64
+    shared: int64
+    marker: int64
+}
+
+/// Disk usage of an installation as stored by registry.py (None for a missing tree)
+type DiskUsage = {
+    installation: TreeUsage option
+    environment: TreeUsage option
+    measured: string
+}
+
 /// Complete installation record from registry
 type Installation = {
     id: string
@@ -30,6 +67,8 @@ type Installation = {
     environment_path: string
     packages: PackageInfo
     tags: string list
+    benchmark: BenchmarkSummary option
+    disk_usage: DiskUsage option
 }
 
 /// Registry data structure
@@ -37,31 +76,248 @@ type RegistryData = {
     registry_version: string
     created: string
     updated: string
+    revision: int64
     default_installation: string option
     installations: Map<string, Installation>
     aliases: Map<string, string>
 }
 
+/// Hardlink counts, which tell files shared through the LuaEnv store (and the
+/// build cache) apart from the files only one installation uses
+module internal FileLinks =
+
+    [<DllImport("kernel32.dll", SetLastError = true)>]
+    extern bool GetFileInformationByHandle(SafeFileHandle hFile, uint32[] lpFileInformation)
+
+    /// Whether the LuaEnv store may have hardlinked the file at this path within a tree:
+    /// its .exe and .dll files and the files LuaRocks never rewrites in place (the
+    /// same rules as LINKED_SUFFIXES and is_immutable_tree_file in backend/shared_store.py)
+    let mayBeLinked (relative: string) : bool =
+        let parts = relative.Split([| '\\'; '/' |], StringSplitOptions.RemoveEmptyEntries)
+        let extension = Path.GetExtension(relative).ToLowerInvariant()
+        extension = ".exe" || extension = ".dll"
+        || (parts.Length >= 3 && (parts.[0] = "share" || parts.[0] = "lib") && parts.[1] = "lua")
+        || (parts.Length >= 6 && parts.[0] = "lib" && parts.[1] = "luarocks" && parts.[2].StartsWith "rocks-")
+
+    /// Number of hardlinks of a file (1 when it cannot be determined)
+    let linkCount (path: string) : uint32 =
+        if not (OperatingSystem.IsWindows()) then
+            1u
+        else
+            try
+                use handle = File.OpenHandle(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite ||| FileShare.Delete)
+                // BY_HANDLE_FILE_INFORMATION is 13 DWORDs; nNumberOfLinks is the 11th
+                let info = Array.zeroCreate<uint32> 13
+                if GetFileInformationByHandle(handle, info) then info.[10] else 1u
+            with
+            | _ -> 1u
+
+/// Reflection-free reading and writing of JSON values.
+///
+/// The records of this library are decoded field by field from a JsonDocument
+/// instead of through JsonSerializer, which needs reflection over the F# types
+/// and so does not survive trimming or NativeAOT (see build_cli.ps1 -Publish).
+/// Property names match case-insensitively; missing or null options are None,
+/// missing collections are empty and missing scalars get their default value.
+module internal JsonCodec =
+
+    /// Property of an object by name, None when it is missing or null
+    let property (element: JsonElement) (name: string) : JsonElement option =
+        if element.ValueKind <> JsonValueKind.Object then
+            None
+        else
+            let found =
+                match element.TryGetProperty name with
+                | true, value -> Some value
+                | _ ->
+                    element.EnumerateObject()
+                    |> Seq.tryFind (fun p -> String.Equals(p.Name, name, StringComparison.OrdinalIgnoreCase))
+                    |> Option.map (fun p -> p.Value)
+            found |> Option.filter (fun value -> value.ValueKind <> JsonValueKind.Null)
+
+    let stringOption element name = property element name |> Option.map (fun v -> v.GetString())
+    let string element name = stringOption element name |> Option.toObj
+    let bool element name = property element name |> Option.exists (fun v -> v.GetBoolean())
+    let int element name = property element name |> Option.map (fun v -> v.GetInt32()) |> Option.defaultValue 0
+    let int64 element name = property element name |> Option.map (fun v -> v.GetInt64()) |> Option.defaultValue 0L
+    let float element name = property element name |> Option.map (fun v -> v.GetDouble()) |> Option.defaultValue 0.0
+    let floatOption element name = property element name |> Option.map (fun v -> v.GetDouble())
+
+    let array (decode: JsonElement -> 'T) element name : 'T array =
+        match property element name with
+        | Some value when value.ValueKind = JsonValueKind.Array -> value.EnumerateArray() |> Seq.map decode |> Seq.toArray
+        | _ -> [||]
+
+    let strings element name = array (fun v -> v.GetString()) element name
+
+    let map (decode: JsonElement -> 'T) element name : Map<string, 'T> =
+        match property element name with
+        | Some value when value.ValueKind = JsonValueKind.Object ->
+            value.EnumerateObject() |> Seq.map (fun p -> p.Name, decode p.Value) |> Map.ofSeq
+        | _ -> Map.empty
+
+    /// Parse text and decode its root value
+    let parse (decode: JsonElement -> 'T) (json: string) : 'T =
+        use document = JsonDocument.Parse json
+        decode document.RootElement
+
+    /// A string as a JSON string literal
+    let quote (value: string) : string =
+        "\"" + JsonEncodedText.Encode(value).ToString() + "\""
+
 /// Registry access module for direct JSON operations
 module RegistryAccess =
 
-    /// Get the default registry path in user's home directory
+    /// Get the default registry path in user's home directory.
+    /// %USERPROFILE% wins when set, as for registry.py (Path.home()) and luaconfig.exe.
     let getDefaultRegistryPath () : string =
-        let homeDir = Environment.GetFolderPath(Environment.SpecialFolder.UserProfile)
+        let homeDir =
+            match Environment.GetEnvironmentVariable "USERPROFILE" with
+            | profile when OperatingSystem.IsWindows() && not (String.IsNullOrEmpty profile) -> profile
+            | _ -> Environment.GetFolderPath(Environment.SpecialFolder.UserProfile)
         Path.Combine(homeDir, ".luaenv", "registry.json")
 
-    /// Parse registry JSON with custom JSON options
+    let private decodeBenchmarkResult (e: JsonElement) : BenchmarkResult =
+        { median_ms = JsonCodec.float e "median_ms"
+          mean_ms = JsonCodec.float e "mean_ms"
+          stdev_ms = JsonCodec.float e "stdev_ms"
+          cv_percent = JsonCodec.float e "cv_percent"
+          min_ms = JsonCodec.float e "min_ms"
+          peak_working_set_kb = JsonCodec.int64 e "peak_working_set_kb" }
+
+    let private decodeBenchmarkSummary (e: JsonElement) : BenchmarkSummary =
+        { suite_version = JsonCodec.int e "suite_version"
+          updated = JsonCodec.string e "updated"
+          runs = JsonCodec.int e "runs"
+          total_ms = JsonCodec.float e "total_ms"
+          results = JsonCodec.map decodeBenchmarkResult e "results" }
+
+    let private decodeTreeUsage (e: JsonElement) : TreeUsage =
+        { bytes = JsonCodec.int64 e "bytes"
+          shared = JsonCodec.int64 e "shared"
+          marker = JsonCodec.int64 e "marker" }
+
+    let private decodeDiskUsage (e: JsonElement) : DiskUsage =
+        { installation = JsonCodec.property e "installation" |> Option.map decodeTreeUsage
+          environment = JsonCodec.property e "environment" |> Option.map decodeTreeUsage
+          measured = JsonCodec.string e "measured" }
+
+    let private decodeInstallation (e: JsonElement) : Installation =
+        { id = JsonCodec.string e "id"
+          name = JsonCodec.string e "name"
+          alias = JsonCodec.stringOption e "alias"
+          lua_version = JsonCodec.string e "lua_version"
+          luarocks_version = JsonCodec.string e "luarocks_version"
+          build_type = JsonCodec.string e "build_type"
+          build_config = JsonCodec.string e "build_config"
+          architecture = JsonCodec.string e "architecture"
+          created = JsonCodec.string e "created"
+          last_used = JsonCodec.stringOption e "last_used"
+          status = JsonCodec.string e "status"
+          installation_path = JsonCodec.string e "installation_path"
+          environment_path = JsonCodec.string e "environment_path"
+          packages =
+            match JsonCodec.property e "packages" with
+            | Some p -> { count = JsonCodec.int p "count"; last_updated = JsonCodec.stringOption p "last_updated" }
+            | None -> { count = 0; last_updated = None }
+          tags = JsonCodec.strings e "tags" |> List.ofArray
+          benchmark = JsonCodec.property e "benchmark" |> Option.map decodeBenchmarkSummary
+          disk_usage = JsonCodec.property e "disk_usage" |> Option.map decodeDiskUsage }
+
+    let private decodeRegistry (e: JsonElement) : RegistryData =
+        { registry_version = JsonCodec.string e "registry_version"
+          created = JsonCodec.string e "created"
+          updated = JsonCodec.string e "updated"
+          revision = JsonCodec.int64 e "revision"
+          default_installation = JsonCodec.stringOption e "default_installation"
+          installations = JsonCodec.map decodeInstallation e "installations"
+          aliases = JsonCodec.map (fun v -> v.GetString()) e "aliases" }
+
+    /// Parse registry JSON
     let private parseRegistryJson (json: string) : Result<RegistryData, string> =
         try
-            let options = JsonSerializerOptions()
-            options.PropertyNameCaseInsensitive <- true
-            options.PropertyNamingPolicy <- JsonNamingPolicy.SnakeCaseLower
-
-            let registryData = JsonSerializer.Deserialize<RegistryData>(json, options)
-            Ok registryData
+            Ok (JsonCodec.parse decodeRegistry json)
         with
         | ex -> Error (sprintf "Failed to parse registry JSON: %s" ex.Message)
 
+    /// Read a file registry.py may be appending to or replacing at the same time
+    let private readShared (path: string) : string =
+        use stream = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.ReadWrite ||| FileShare.Delete)
+        use reader = new StreamReader(stream)
+        reader.ReadToEnd()
+
+    /// Current registry revision from registry.revision, None when it is missing or
+    /// being written. A cached registry with this revision is current.
+    let readRegistryRevision (registryPath: string option) : int64 option =
+        let path = Path.ChangeExtension(registryPath |> Option.defaultValue (getDefaultRegistryPath()), ".revision")
+        try
+            match Int64.TryParse((readShared path).Trim()) with
+            | true, revision -> Some revision
+            | _ -> None
+        with
+        | _ -> None
+
+    /// Apply one registry.journal record (see backend/registry_store.py)
+    let private applyJournalRecord (registry: JsonObject) (record: JsonObject) =
+        let table (name: string) =
+            match registry.[name] with
+            | :? JsonObject as t -> t
+            | _ ->
+                let t = JsonObject()
+                registry.[name] <- t
+                t
+        let value () =
+            match record.["value"] with
+            | null -> null
+            | node -> node.DeepClone()
+
+        match record.["op"].GetValue<string>() with
+        | "put" -> (table (record.["table"].GetValue<string>())).[record.["key"].GetValue<string>()] <- value ()
+        | "delete" -> (table (record.["table"].GetValue<string>())).Remove(record.["key"].GetValue<string>()) |> ignore
+        | "default" -> registry.["default_installation"] <- value ()
+        | _ -> ()
+        registry.["revision"] <- JsonValue.Create(record.["revision"].GetValue<int64>())
+        registry.["updated"] <- record.["updated"].DeepClone()
+
+    /// Replay the journal records past the snapshot's revision, stopping at a gap or
+    /// at a torn last line
+    let private replayJournal (registry: JsonObject) (journalPath: string) =
+        let lines =
+            try (readShared journalPath).Split('\n')
+            with
+            | :? FileNotFoundException
+            | :? DirectoryNotFoundException -> [| "" |]
+        let mutable revision =
+            match registry.["revision"] with
+            | null -> 0L
+            | node -> node.GetValue<int64>()
+        let mutable stop = false
+        // The text after the last newline is empty or an unfinished record
+        for line in lines |> Array.take (lines.Length - 1) do
+            if not stop then
+                match (try JsonNode.Parse line with _ -> null) with
+                | :? JsonObject as record ->
+                    let recordRevision = record.["revision"].GetValue<int64>()
+                    if recordRevision = revision + 1L then
+                        applyJournalRecord registry record
+                        revision <- recordRevision
+                    elif recordRevision > revision then
+                        stop <- true
+                | _ -> stop <- true
+
+    /// Read registry.json with the journal applied, as JSON text
+    let readRegistryJson (path: string) : string =
+        let journalPath = Path.ChangeExtension(path, ".journal")
+        let stamp () = File.GetLastWriteTimeUtc path, FileInfo(path).Length
+        let rec read attempt =
+            let before = stamp ()
+            let registry = JsonNode.Parse(readShared path).AsObject()
+            replayJournal registry journalPath
+            // registry.py compacted the journal into a new snapshot meanwhile
+            if stamp () <> before && attempt < 10 then read (attempt + 1)
+            else registry.ToJsonString()
+        read 0
+
     /// Load registry from file
     let loadRegistry (registryPath: string option) : Result<RegistryData, string> =
         let path = registryPath |> Option.defaultValue (getDefaultRegistryPath())
@@ -70,7 +326,7 @@ module RegistryAccess =
             if not (File.Exists path) then
                 Error (sprintf "Registry file not found: %s" path)
             else
-                let json = File.ReadAllText path
+                let json = readRegistryJson path
                 parseRegistryJson json
         with
         | ex -> Error (sprintf "Failed to read registry file: %s" ex.Message)
@@ -151,24 +407,74 @@ module RegistryAccess =
 
         sprintf "%.1f %s" size units.[unitIndex]
 
-    /// Get directory size recursively
-    let private getDirectorySize (path: string) : int64 option =
+    /// Get directory size recursively, with the bytes in hardlinked (shared) files.
+    /// Sizes come with the directory listing; a file is only opened for its link
+    /// count when the store may have linked it (FileLinks.mayBeLinked).
+    let private getDirectoryUsage (path: string) : (int64 * int64) option =
         try
             if Directory.Exists path then
-                let dirInfo = DirectoryInfo(path)
-                let totalSize =
-                    dirInfo.GetFiles("*", SearchOption.AllDirectories)
-                    |> Array.sumBy (fun f -> f.Length)
-                Some totalSize
+                let mutable totalSize = 0L
+                let mutable sharedSize = 0L
+                let options = EnumerationOptions(RecurseSubdirectories = true, IgnoreInaccessible = true,
+                                                 AttributesToSkip = FileAttributes.ReparsePoint)
+                for file in DirectoryInfo(path).EnumerateFiles("*", options) do
+                    totalSize <- totalSize + file.Length
+                    if FileLinks.mayBeLinked (Path.GetRelativePath(path, file.FullName))
+                       && FileLinks.linkCount file.FullName > 1u then
+                        sharedSize <- sharedSize + file.Length
+                Some (totalSize, sharedSize)
             else
                 None
         with
         | _ -> None
 
-    /// Get installation size information
-    let getInstallationSize (installation: Installation) : {| InstallationSize: string; EnvironmentSize: string; TotalSize: string |} =
-        let installSize = getDirectorySize installation.installation_path
-        let envSize = getDirectorySize installation.environment_path
+    /// Last-modified marker of a tree, as computed by backend/disk_usage.py: the newest
+    /// write time, in milliseconds since the epoch, of the root, its direct
+    /// subdirectories and the rock manifest. None when the tree is missing.
+    let treeMarker (path: string) : int64 option =
+        let millis (time: DateTime) = (time - DateTime.UnixEpoch).Ticks / TimeSpan.TicksPerMillisecond
+        try
+            if not (Directory.Exists path) then
+                None
+            else
+                let directories =
+                    DirectoryInfo(path).EnumerateDirectories()
+                    |> Seq.map (fun d -> millis d.LastWriteTimeUtc)
+                let manifest = Path.Combine(path, "lib", "luarocks", "rocks-5.4", "manifest")
+                let manifestTime = if File.Exists manifest then [ millis (File.GetLastWriteTimeUtc manifest) ] else []
+                Some (Seq.max (Seq.concat [ Seq.singleton (millis (Directory.GetLastWriteTimeUtc path)); directories; Seq.ofList manifestTime ]))
+        with
+        | _ -> None
+
+    /// Whether the stored disk usage of an installation matches the markers of both trees
+    let isDiskUsageCurrent (installation: Installation) : bool =
+        let current (stored: TreeUsage option) (path: string) =
+            match stored, treeMarker path with
+            | Some usage, Some marker -> usage.marker = marker
+            | None, None -> true
+            | _ -> false
+        match installation.disk_usage with
+        | Some usage ->
+            current usage.installation installation.installation_path
+            && current usage.environment installation.environment_path
+        | None -> false
+
+    /// Get installation size information.
+    /// Shared bytes are in files hardlinked with the store or other installations;
+    /// unique bytes would be freed by removing the installation. The usage stored by
+    /// registry.py is used when usageCurrent (isDiskUsageCurrent, checked by the
+    /// caller); otherwise both trees are walked.
+    let getInstallationSize (installation: Installation) (usageCurrent: bool) : {| InstallationSize: string; EnvironmentSize: string; TotalSize: string; SharedSize: string; UniqueSize: string |} =
+        let installUsage, envUsage =
+            match installation.disk_usage with
+            | Some usage when usageCurrent ->
+                let pair = Option.map (fun (tree: TreeUsage) -> tree.bytes, tree.shared)
+                pair usage.installation, pair usage.environment
+            | _ -> getDirectoryUsage installation.installation_path, getDirectoryUsage installation.environment_path
+        let installSize = installUsage |> Option.map fst
+        let envSize = envUsage |> Option.map fst
+        let sharedSize =
+            [ installUsage; envUsage ] |> List.choose id |> List.sumBy snd
 
         let installSizeStr =
             match installSize with
@@ -187,4 +493,10 @@ module RegistryAccess =
             | None, Some eSize -> formatFileSize eSize
             | None, None -> "Unknown"
 
-        {| InstallationSize = installSizeStr; EnvironmentSize = envSizeStr; TotalSize = totalSizeStr |}
+        let uniqueSizeStr =
+            match installSize, envSize with
+            | None, None -> "Unknown"
+            | _ -> formatFileSize ((Option.defaultValue 0L installSize) + (Option.defaultValue 0L envSize) - sharedSize)
+
+        {| InstallationSize = installSizeStr; EnvironmentSize = envSizeStr; TotalSize = totalSizeStr
+           SharedSize = formatFileSize sharedSize; UniqueSize = uniqueSizeStr |}
@@ -0,0 +1,349 @@
+// This is free and unencumbered software released into the public domain.
+// For more details, see the LICENSE file in the project root.
+
+namespace LuaEnv.Core
+
+open System
+open System.Diagnostics
+open System.IO
+open System.IO.Pipes
+open System.Text
+open System.Text.Json
+open System.Threading
+open System.Threading.Tasks
+
+/// Resident server mode of the CLI.
+///
+/// `luaenv server start` keeps the backend configuration and the parsed registry in
+/// memory and answers pkg-config queries from luaconfig.exe and luaenv.ps1 over a
+/// per-user named pipe, natively (PkgConfig) or through a warm
+/// `pkg_config.py --serve` worker for the cases PkgConfig leaves to Python. Clients fall back to
+/// spawning the CLI whenever the pipe is absent or the reply is "-".
+///
+/// Protocol (message-mode pipe, UTF-8):
+///   request - the CLI arguments after --config, one per line
+///   reply   - "<exit code>\n" followed by the text to print, or "-\n" when the
+///             client has to run the CLI itself
+module Server =
+
+    /// Pipe name shared with luaconfig.c and luaenv.ps1 (\\.\pipe\luaenv-cli-<user>)
+    let pipeName () = "luaenv-cli-" + Environment.UserName.ToLowerInvariant()
+
+    /// Idle time after which `server run` exits when --idle-timeout is not given
+    let defaultIdleTimeout = TimeSpan.FromMinutes 15.0
+
+    let private unsupportedReply = "-\n"
+
+    let private queryFlags = set [ "--cflag"; "--lua-include"; "--liblua"; "--libdir"; "--path" ]
+
+    /// True for pkg-config arguments the worker can answer exactly like a spawned CLI:
+    /// an installation followed by query flags, --path-style and --format with valid values.
+    /// Help, --json and invalid values are left to the CLI and its error messages.
+    let isServablePkgConfig (args: string list) : bool =
+        let rec check args =
+            match args with
+            | [] -> true
+            | flag :: rest when queryFlags.Contains flag -> check rest
+            | "--path-style" :: style :: rest when List.contains style [ "windows"; "unix"; "native" ] -> check rest
+            | "--format" :: fmt :: rest when List.contains fmt [ "cmake"; "json"; "env" ] -> check rest
+            | _ -> false
+
+        match args with
+        | installation :: rest when not (String.IsNullOrWhiteSpace installation) && not (installation.StartsWith "-") ->
+            check rest
+        | _ -> false
+
+    /// A long-running `pkg_config.py --serve` process, one JSON line per request
+    type private PythonWorker(config: BackendConfig) =
+        let proc =
+            let startInfo = ProcessStartInfo()
+            startInfo.FileName <- config.EmbeddedPython.PythonExe
+            startInfo.Arguments <- sprintf "\"%s\" --serve" (Path.Combine(config.BackendDir, "pkg_config.py"))
+            startInfo.WorkingDirectory <- config.BackendDir
+            startInfo.UseShellExecute <- false
+            startInfo.CreateNoWindow <- true
+            startInfo.RedirectStandardInput <- true
+            startInfo.RedirectStandardOutput <- true
+            startInfo.RedirectStandardError <- true
+            startInfo.StandardInputEncoding <- UTF8Encoding(false)
+            startInfo.StandardOutputEncoding <- UTF8Encoding(false)
+            startInfo.EnvironmentVariables.["PYTHONIOENCODING"] <- "utf-8"
+
+            let p = Process.Start startInfo
+            // Drain diagnostics so the worker never blocks on a full stderr pipe
+            p.ErrorDataReceived.Add ignore
+            p.BeginErrorReadLine()
+            p
+
+        member _.HasExited = proc.HasExited
+
+        /// Run pkg_config.main() with args; None if the worker died
+        member _.Call(args: string list) : (int * string * string) option =
+            try
+                proc.StandardInput.WriteLine("[" + (args |> List.map JsonCodec.quote |> String.concat ",") + "]")
+                proc.StandardInput.Flush()
+
+                match proc.StandardOutput.ReadLine() with
+                | null -> None
+                | line ->
+                    use reply = JsonDocument.Parse line
+                    let root = reply.RootElement
+                    Some (root.GetProperty("exit_code").GetInt32(),
+                          root.GetProperty("stdout").GetString(),
+                          root.GetProperty("stderr").GetString())
+            with
+            | _ -> None
+
+        interface IDisposable with
+            member _.Dispose() =
+                try
+                    proc.StandardInput.Close()
+                    if not (proc.WaitForExit 2000) then
+                        proc.Kill()
+                with
+                | _ -> ()
+                proc.Dispose()
+
+    /// State shared by the pipe listeners; the worker is used by one request at a time
+    type private ServerState(config: BackendConfig) =
+        let sync = obj ()
+        let startedAt = DateTime.Now
+        let mutable worker: PythonWorker option = None
+        let mutable registry = RegistryAccess.loadRegistry None
+        let mutable revision = RegistryAccess.readRegistryRevision None
+        let mutable requests = 0L
+        let mutable lastActivity = DateTime.UtcNow
+
+        let stopWorker () =
+            worker |> Option.iter (fun w -> (w :> IDisposable).Dispose())
+            worker <- None
+
+        member _.LastActivity = lastActivity
+
+        member _.Touch() = lastActivity <- DateTime.UtcNow
+
+        /// A registry file changed: when the revision moved on (or cannot be read), re-read
+        /// the registry and let the next request start a fresh worker
+        member _.Reload() =
+            lock sync (fun () ->
+                let current = RegistryAccess.readRegistryRevision None
+                if current.IsNone || current <> revision then
+                    stopWorker ()
+                    revision <- current
+                    registry <- RegistryAccess.loadRegistry None)
+
+        member _.PkgConfig(args: string list) : (int * string * string) option =
+            let nativeAnswer =
+                match registry with
+                | Ok data -> PkgConfig.renderArgs data args
+                | Error _ -> None
+
+            match nativeAnswer with
+            | Some text ->
+                lock sync (fun () -> requests <- requests + 1L)
+                Some (0, text, "")
+            | None ->
+                lock sync (fun () ->
+                    requests <- requests + 1L
+                    let current =
+                        match worker with
+                        | Some w when not w.HasExited -> w
+                        | _ ->
+                            stopWorker ()
+                            let w = new PythonWorker(config)
+                            worker <- Some w
+                            w
+
+                    match current.Call args with
+                    | Some reply -> Some reply
+                    | None ->
+                        stopWorker ()
+                        None)
+
+        member _.Status() : string =
+            lock sync (fun () ->
+                let installations =
+                    match registry with
+                    | Ok data -> sprintf "%d" data.installations.Count
+                    | Error _ -> "unavailable"
+
+                let lines = [
+                    "[INFO] LuaEnv server is running"
+                    sprintf "  Pipe: \\\\.\\pipe\\%s" (pipeName ())
+                    sprintf "  Process ID: %d" Environment.ProcessId
+                    sprintf "  Started: %s" (startedAt.ToString("yyyy-MM-dd HH:mm:ss"))
+                    sprintf "  Requests served: %d" requests
+                    sprintf "  Installations: %s" installations
+                    sprintf "  Python worker: %s" (if worker.IsSome then "running" else "stopped")
+                ]
+                String.Join("\n", lines) + "\n")
+
+        interface IDisposable with
+            member _.Dispose() = lock sync stopWorker
+
+    let private createPipe (firstInstance: bool) =
+        let options = PipeOptions.Asynchronous ||| PipeOptions.CurrentUserOnly
+        let options = if firstInstance then options ||| PipeOptions.FirstPipeInstance else options
+        new NamedPipeServerStream(pipeName (), PipeDirection.InOut, NamedPipeServerStream.MaxAllowedServerInstances,
+                                  PipeTransmissionMode.Message, options)
+
+    let private readMessage (pipe: PipeStream) : string =
+        use buffer = new MemoryStream()
+        let chunk = Array.zeroCreate<byte> 4096
+        let mutable complete = false
+        while not complete do
+            let count = pipe.Read(chunk, 0, chunk.Length)
+            buffer.Write(chunk, 0, count)
+            complete <- count = 0 || pipe.IsMessageComplete
+        Encoding.UTF8.GetString(buffer.ToArray())
+
+    let private writeMessage (pipe: PipeStream) (text: string) =
+        let bytes = Encoding.UTF8.GetBytes text
+        pipe.Write(bytes, 0, bytes.Length)
+        pipe.Flush()
+
+    let private splitRequest (request: string) : string list =
+        if request = "" then []
+        else request.Split('\n') |> Array.map (fun line -> line.TrimEnd('\r')) |> List.ofArray
+
+    let private handleRequest (state: ServerState) (stop: CancellationTokenSource) (request: string list) : string =
+        match request with
+        | "pkg-config" :: args when isServablePkgConfig args ->
+            match state.PkgConfig args with
+            | None -> unsupportedReply
+            | Some (exitCode, output, errorOutput) ->
+                match Backend.pkgConfigResult exitCode output errorOutput with
+                | Ok text -> "0\n" + text
+                | Error message -> "1\n" + message + "\n"
+        | [ "server"; "status" ] -> "0\n" + state.Status()
+        | [ "server"; "stop" ] ->
+            stop.Cancel()
+            "0\n[INFO] LuaEnv server stopped\n"
+        | _ -> unsupportedReply
+
+    /// Accept connections one at a time until the server is stopped
+    let private serveConnections (state: ServerState) (stop: CancellationTokenSource) (initial: NamedPipeServerStream) : Task =
+        task {
+            let mutable next = Some initial
+            while not stop.IsCancellationRequested do
+                let pipe = match next with Some p -> p | None -> createPipe false
+                next <- None
+                try
+                    try
+                        do! pipe.WaitForConnectionAsync(stop.Token)
+                        // Listen again before answering so clients never find the pipe missing
+                        next <- Some (createPipe false)
+                        state.Touch()
+                        let reply = handleRequest state stop (splitRequest (readMessage pipe))
+                        writeMessage pipe reply
+                        pipe.WaitForPipeDrain()
+                        state.Touch()
+                    with
+                    | :? OperationCanceledException -> ()
+                    | _ -> () // A client that gave up or sent garbage must not stop the server
+                finally
+                    pipe.Dispose()
+            next |> Option.iter (fun p -> p.Dispose())
+        }
+
+    /// Send one request to a running server; None when no server answers within timeoutMs
+    let request (lines: string list) (timeoutMs: int) : (int * string) option =
+        try
+            use pipe = new NamedPipeClientStream(".", pipeName (), PipeDirection.InOut, PipeOptions.CurrentUserOnly)
+            pipe.Connect timeoutMs
+            pipe.ReadMode <- PipeTransmissionMode.Message
+            writeMessage pipe (String.Join("\n", lines))
+            let reply = readMessage pipe
+            let newline = reply.IndexOf '\n'
+            if newline < 0 || reply.StartsWith "-" then
+                None
+            else
+                match Int32.TryParse(reply.Substring(0, newline)) with
+                | true, exitCode -> Some (exitCode, reply.Substring(newline + 1))
+                | _ -> None
+        with
+        | :? TimeoutException
+        | :? IOException -> None
+
+    /// Run the server in the foreground until it is stopped or idle for idleTimeout
+    let run (config: BackendConfig) (idleTimeout: TimeSpan) (listeners: int) : Result<int, string> =
+        let first =
+            try
+                Some (createPipe true)
+            with
+            | :? IOException
+            | :? UnauthorizedAccessException -> None
+
+        match first with
+        | None ->
+            printfn "[INFO] LuaEnv server is already running"
+            Ok 0
+        | Some firstPipe ->
+            try
+                use state = new ServerState(config)
+                use stop = new CancellationTokenSource()
+
+                // Any registry write (install, alias, default...) invalidates the warm state
+                let registryPath = RegistryAccess.getDefaultRegistryPath ()
+                let registryDir = Path.GetDirectoryName registryPath
+                use watcher =
+                    if Directory.Exists registryDir then
+                        // registry.json, registry.journal and registry.revision
+                        let w = new FileSystemWatcher(registryDir, Path.GetFileNameWithoutExtension registryPath + ".*")
+                        w.NotifyFilter <- NotifyFilters.LastWrite ||| NotifyFilters.FileName ||| NotifyFilters.Size
+                        w.Changed.Add(fun _ -> state.Reload())
+                        w.Created.Add(fun _ -> state.Reload())
+                        w.Deleted.Add(fun _ -> state.Reload())
+                        w.Renamed.Add(fun _ -> state.Reload())
+                        w.EnableRaisingEvents <- true
+                        w
+                    else
+                        null
+
+                let checkInterval = TimeSpan.FromSeconds(min 5.0 idleTimeout.TotalSeconds)
+                use idleTimer =
+                    new Timer((fun _ ->
+                                  if DateTime.UtcNow - state.LastActivity > idleTimeout then
+                                      stop.Cancel()),
+                              null, checkInterval, checkInterval)
+
+                printfn "[INFO] LuaEnv server listening on \\\\.\\pipe\\%s (idle timeout: %.0f s)"
+                    (pipeName ()) idleTimeout.TotalSeconds
+
+                let tasks = [|
+                    yield serveConnections state stop firstPipe
+                    for _ in 2 .. max 1 listeners do
+                        yield serveConnections state stop (createPipe false)
+                |]
+                Task.WaitAll tasks
+
+                printfn "[INFO] LuaEnv server stopped"
+                Ok 0
+            with
+            | ex -> Error (sprintf "[ERROR] LuaEnv server failed: %s" ex.Message)
+
+    /// Start `server run` as a background process that outlives the caller
+    let start (configPath: string) (idleTimeout: TimeSpan) : Result<int, string> =
+        match request [ "server"; "status" ] 200 with
+        | Some _ ->
+            printfn "[INFO] LuaEnv server is already running"
+            Ok 0
+        | None ->
+            try
+                let startInfo = ProcessStartInfo(Environment.ProcessPath)
+                startInfo.Arguments <-
+                    sprintf "--config \"%s\" server run --background --idle-timeout %.0f"
+                        (Path.GetFullPath configPath) idleTimeout.TotalSeconds
+                startInfo.UseShellExecute <- false
+                startInfo.CreateNoWindow <- true
+                // Own pipes instead of the caller's console, so build tools that
+                // capture our output are not kept waiting by the server
+                startInfo.RedirectStandardInput <- true
+                startInfo.RedirectStandardOutput <- true
+                startInfo.RedirectStandardError <- true
+
+                use proc = Process.Start startInfo
+                printfn "[OK] LuaEnv server started (PID %d, pipe \\\\.\\pipe\\%s)" proc.Id (pipeName ())
+                Ok 0
+            with
+            | ex -> Error (sprintf "[ERROR] Failed to start LuaEnv server: %s" ex.Message)
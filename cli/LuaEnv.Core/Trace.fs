@@ -0,0 +1,65 @@
+// This is free and unencumbered software released into the public domain.
+// For more details, see the LICENSE file in the project root.
+
+namespace LuaEnv.Core
+
+open System
+open System.IO
+open System.Text
+
+/// Runtime tracing shared with luaconfig.c and backend/utils.py.
+///
+/// With LUAENV_TRACE=<file> every span is appended to <file> as one JSON line (a Chrome
+/// trace "complete" event, microseconds since the Unix epoch). LUAENV_TRACE_ID ties the
+/// spans of one call together; it is created here when luaconfig did not set it and is
+/// inherited by the Python processes started by Backend.
+module Trace =
+
+    let private tracePath = Environment.GetEnvironmentVariable "LUAENV_TRACE"
+
+    /// True when LUAENV_TRACE names a trace file
+    let enabled = not (String.IsNullOrEmpty tracePath)
+
+    let private toUnixMicroseconds (time: DateTime) =
+        (time.ToUniversalTime() - DateTime.UnixEpoch).Ticks / 10L
+
+    let private traceId =
+        if not enabled then
+            ""
+        else
+            match Environment.GetEnvironmentVariable "LUAENV_TRACE_ID" with
+            | id when not (String.IsNullOrEmpty id) -> id
+            | _ ->
+                let id = sprintf "%08x%012x" Environment.ProcessId (toUnixMicroseconds DateTime.UtcNow)
+                Environment.SetEnvironmentVariable("LUAENV_TRACE_ID", id)
+                id
+
+    let private write (name: string) (startUs: int64) (durationUs: int64) =
+        let event =
+            sprintf """{"name":%s,"cat":"cli","ph":"X","ts":%d,"dur":%d,"pid":%d,"tid":%d,"args":{"trace_id":%s}}"""
+                (JsonCodec.quote name) startUs durationUs Environment.ProcessId
+                Environment.CurrentManagedThreadId (JsonCodec.quote traceId)
+        try
+            // luaconfig.exe keeps the file open for appending while the CLI runs
+            use stream = new FileStream(tracePath, FileMode.Append, FileAccess.Write, FileShare.ReadWrite ||| FileShare.Delete)
+            let bytes = Encoding.UTF8.GetBytes(event + "\n")
+            stream.Write(bytes, 0, bytes.Length)
+        with
+        | _ -> () // Tracing must never fail a command
+
+    /// Run f and record it as a span called name
+    let span (name: string) (f: unit -> 'T) : 'T =
+        if not enabled then
+            f ()
+        else
+            let startUs = toUnixMicroseconds DateTime.UtcNow
+            try
+                f ()
+            finally
+                write name startUs (toUnixMicroseconds DateTime.UtcNow - startUs)
+
+    /// Record a span that started before tracing could observe it (e.g. process start)
+    let since (name: string) (start: DateTime) =
+        if enabled then
+            let startUs = toUnixMicroseconds start
+            write name startUs (toUnixMicroseconds DateTime.UtcNow - startUs)
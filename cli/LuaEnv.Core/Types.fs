@@ -91,6 +91,31 @@ type BackendDiscoveryResponse = {
     ConfigInfo: ConfigInfo
 }
 
+/// Running backend processes
+///
+/// Children inherit the CLI's environment and, unless output has to be parsed,
+/// its standard handles, so their output streams straight to the caller
+/// without being buffered or re-encoded here.
+module ProcessExecution =
+
+    /// Run with the standard handles inherited and return the exit code
+    let runInherited (startInfo: ProcessStartInfo) : int =
+        use proc = Process.Start startInfo
+        proc.WaitForExit()
+        proc.ExitCode
+
+    /// Run with stdout and stderr captured; returns (exit code, stdout, stderr).
+    /// stderr is drained concurrently so a child that fills it cannot block
+    /// while stdout is being read.
+    let runCaptured (startInfo: ProcessStartInfo) : int * string * string =
+        startInfo.RedirectStandardOutput <- true
+        startInfo.RedirectStandardError <- true
+        use proc = Process.Start startInfo
+        let errorOutput = proc.StandardError.ReadToEndAsync()
+        let output = proc.StandardOutput.ReadToEnd()
+        proc.WaitForExit()
+        proc.ExitCode, output, errorOutput.Result
+
 /// Configuration module for reading and parsing backend.config
 module Config =
 
@@ -101,11 +126,19 @@ module Config =
                 Error (sprintf "[ERROR] Config file not found: %s" configPath)
             else
                 let json = File.ReadAllText configPath
-                let options = JsonSerializerOptions()
-                options.PropertyNameCaseInsensitive <- true
-                options.PropertyNamingPolicy <- JsonNamingPolicy.SnakeCaseLower
-
-                let config = JsonSerializer.Deserialize<BackendConfig>(json, options)
+                let config =
+                    json |> JsonCodec.parse (fun e ->
+                        { BackendDir = JsonCodec.string e "backend_dir"
+                          EmbeddedPython =
+                            match JsonCodec.property e "embedded_python" with
+                            | Some p ->
+                                { PythonDir = JsonCodec.string p "python_dir"
+                                  PythonExe = JsonCodec.string p "python_exe"
+                                  Available = JsonCodec.bool p "available" }
+                            | None -> { PythonDir = null; PythonExe = null; Available = false }
+                          ProjectRoot = JsonCodec.string e "project_root"
+                          ConfigVersion = JsonCodec.string e "config_version"
+                          Created = JsonCodec.string e "created" })
                 Ok config
         with
         | ex -> Error (sprintf "[ERROR] Failed to parse config file: %s" ex.Message)
@@ -133,6 +166,38 @@ module Config =
         parseConfig configPath
         |> Result.bind validateConfig
 
+    /// Decode the output of config.py --discover --json (field names as in JsonPropertyName)
+    let private decodeDiscoveryResponse (e: JsonElement) : BackendDiscoveryResponse =
+        // A missing section decodes like an empty object
+        let section name decode =
+            decode (JsonCodec.property e name |> Option.defaultValue (Unchecked.defaultof<JsonElement>))
+        { CurrentConfig =
+            section "current_config" (fun c ->
+                { LuaVersion = JsonCodec.string c "lua_version"
+                  LuaMajorMinor = JsonCodec.string c "lua_major_minor"
+                  LuaRocksVersion = JsonCodec.string c "luarocks_version"
+                  LuaRocksPlatform = JsonCodec.string c "luarocks_platform" })
+          CacheInfo =
+            section "cache_info" (fun c ->
+                { UsedCache = JsonCodec.bool c "used_cache"
+                  CacheAgeHours = JsonCodec.floatOption c "cache_age_hours"
+                  CacheFile = JsonCodec.stringOption c "cache_file"
+                  ForcedRefresh = JsonCodec.property c "forced_refresh" |> Option.map (fun v -> v.GetBoolean()) })
+          AvailableVersions =
+            section "available_versions" (fun a ->
+                { Lua = JsonCodec.strings a "lua"
+                  LuaRocks = JsonCodec.map (fun v -> v.EnumerateArray() |> Seq.map (fun s -> s.GetString()) |> Seq.toArray) a "luarocks" })
+          DiscoveryTimestamp = JsonCodec.string e "discovery_timestamp"
+          Urls =
+            section "urls" (fun u ->
+                { Lua = JsonCodec.string u "lua"
+                  LuaTests = JsonCodec.string u "lua_tests"
+                  LuaRocks = JsonCodec.string u "luarocks" })
+          ConfigInfo =
+            section "config_info" (fun c ->
+                { ConfigFile = JsonCodec.string c "config_file"
+                  BackendDir = JsonCodec.string c "backend_dir" }) }
+
     /// Call backend to discover available versions
     let discoverVersions (config: BackendConfig) (refresh: bool) : Result<BackendDiscoveryResponse, string> =
         try
@@ -149,30 +214,19 @@ module Config =
             startInfo.FileName <- pythonExe
             startInfo.Arguments <- sprintf "\"%s\" %s" configScript args
             startInfo.WorkingDirectory <- config.BackendDir
-            startInfo.RedirectStandardOutput <- true
-            startInfo.RedirectStandardError <- true
             startInfo.UseShellExecute <- false
             startInfo.CreateNoWindow <- true
+            // The environment (including VS variables) is inherited as is
 
-            // Explicitly copy current environment to ensure VS variables are passed
-            startInfo.EnvironmentVariables.Clear()
-            for envVar in System.Environment.GetEnvironmentVariables() do
-                let entry = envVar :?> System.Collections.DictionaryEntry
-                startInfo.EnvironmentVariables.[entry.Key.ToString()] <- entry.Value.ToString()
+            let exitCode, output, error =
+                Trace.span "python config.py --discover" (fun () ->
+                    ProcessExecution.runCaptured startInfo)
 
-            use proc = Process.Start(startInfo)
-            let output = proc.StandardOutput.ReadToEnd()
-            let error = proc.StandardError.ReadToEnd()
-            proc.WaitForExit()
-
-            if proc.ExitCode <> 0 then
-                Error (sprintf "[ERROR] Backend command failed (exit code %d):\n%s" proc.ExitCode error)
+            if exitCode <> 0 then
+                Error (sprintf "[ERROR] Backend command failed (exit code %d):\n%s" exitCode error)
             else
-                let options = JsonSerializerOptions()
-                options.PropertyNameCaseInsensitive <- true
-
                 try
-                    let response = JsonSerializer.Deserialize<BackendDiscoveryResponse>(output, options)
+                    let response = output |> JsonCodec.parse decodeDiscoveryResponse
                     Ok response
                 with
                 | ex -> Error (sprintf "[ERROR] Failed to parse backend response: %s\nOutput: %s" ex.Message output)
@@ -187,9 +241,23 @@ type InstallOptions = {
     Name: string option
     UseDll: bool
     UseDebug: bool
+    /// Whole-program optimisation profile: Some "pgo" for a PGO/LTCG release build
+    Optimize: string option
     UseX86: bool
     SkipEnvCheck: bool
     SkipTests: bool
+    /// Lua test suite to run after building: Some "smoke" for the short CI subset
+    TestSuite: string option
+    /// Lua test files run in parallel
+    TestJobs: int option
+    /// Build every combination of the Lua versions, architectures and build types
+    Matrix: bool
+    /// Comma-separated architectures of a matrix build (x86,x64)
+    Architectures: string option
+    /// Comma-separated build types of a matrix build (static,dll)
+    BuildTypes: string option
+    /// Parallel jobs of a matrix build
+    Jobs: int option
 }
 
 /// Uninstall command options
@@ -220,8 +288,15 @@ type ListOptions = {
     Detailed: bool
 }
 
-/// Status command options (simplified - no additional options needed)
-type StatusOptions = unit
+/// Status command options
+type StatusOptions = {
+    /// Installations whose timelines are shown (all when empty)
+    Targets: string list
+    /// Show the per-phase install timelines instead of the registry status
+    Timings: bool
+    /// Print the timelines as JSON
+    Json: bool
+}
 
 /// Versions command options
 type VersionsOptions = {
@@ -238,6 +313,25 @@ type PkgConfigOptions = {
     ShowLibLua: bool
     ShowPaths: bool
     PathStyle: string option
+    Format: string option
+    /// Write the static build files instead of printing: Some "" for the default directory
+    Emit: string option
+}
+
+/// Options for bench command
+type BenchOptions = {
+    Installations: string list // Aliases or IDs; empty for the default installation
+    Runs: int option
+    Only: string option // Comma-separated benchmark names
+    Save: bool
+}
+
+/// Options for server command
+type ServerOptions = {
+    Action: string // "start", "stop", "status" or "run"
+    ConfigPath: string
+    IdleTimeout: int option // Seconds
+    Background: bool
 }
 
 /// CLI Commands
@@ -248,6 +342,8 @@ type Command =
     | Status of StatusOptions
     | Versions of VersionsOptions
     | PkgConfig of PkgConfigOptions
+    | Server of ServerOptions
+    | Bench of BenchOptions
     | SetAlias of SetAliasOptions
     | RemoveAlias of RemoveAliasOptions
     | Default of DefaultOptions
@@ -381,26 +477,20 @@ module Backend =
             if not (File.Exists scriptPath) then
                 Error (sprintf "[ERROR] Backend script not found: %s" scriptPath)
             else
-                // Use relative script name and set working directory to backend folder
-                let arguments = String.Join(" ", scriptName :: args)
+                // Use relative script name and set working directory to backend folder.
+                // -u keeps long listings progressive when stdout is a pipe
+                let arguments = String.Join(" ", "-u" :: scriptName :: args)
 
                 let startInfo = ProcessStartInfo()
                 startInfo.FileName <- pythonExe
                 startInfo.Arguments <- arguments
                 startInfo.WorkingDirectory <- config.BackendDir
                 startInfo.UseShellExecute <- false
-                // Let scripts print directly to console - no I/O redirection
-
-                // Explicitly copy current environment to ensure VS variables are passed
-                startInfo.EnvironmentVariables.Clear()
-                for envVar in System.Environment.GetEnvironmentVariables() do
-                    let entry = envVar :?> System.Collections.DictionaryEntry
-                    startInfo.EnvironmentVariables.[entry.Key.ToString()] <- entry.Value.ToString()
+                // Let scripts print directly to console - no I/O redirection,
+                // and the environment (including VS variables) is inherited as is
 
-                use proc = Process.Start startInfo
-                proc.WaitForExit()
-
-                Ok proc.ExitCode
+                Trace.span (sprintf "python %s" scriptName) (fun () ->
+                    Ok (ProcessExecution.runInherited startInfo))
         with
         | ex -> Error (sprintf "[ERROR] Failed to execute backend script: %s" ex.Message)
 
@@ -450,12 +540,11 @@ module Backend =
                     startInfo.RedirectStandardOutput <- true
                     startInfo.RedirectStandardError <- true
                     startInfo.CreateNoWindow <- true
-
-                    // Explicitly copy current environment to ensure VS variables are passed
-                    startInfo.EnvironmentVariables.Clear()
-                    for envVar in System.Environment.GetEnvironmentVariables() do
-                        let entry = envVar :?> Collections.DictionaryEntry
-                        startInfo.EnvironmentVariables.[entry.Key.ToString()] <- entry.Value.ToString()
+                    // The environment (including VS variables) is inherited as is.
+                    // The start time lets setup_lua.py record the launch as the first
+                    // phase of the install timeline (see install_timeline.py)
+                    startInfo.Environment.["LUAENV_INSTALL_STARTED"] <-
+                        string (DateTimeOffset.UtcNow.ToUnixTimeMilliseconds())
 
                     use proc = Process.Start startInfo
                     // Simple helper function to append to log
@@ -624,6 +713,30 @@ module Backend =
                 validationErrors.Add("Installation name cannot be empty when specified")
             | _ -> ()
 
+            // Check optimisation profile if provided
+            match options.Optimize with
+            | Some "pgo" when options.UseDebug ->
+                validationErrors.Add("--optimize pgo cannot be combined with --debug")
+            | Some "pgo" | None -> ()
+            | Some mode ->
+                validationErrors.Add(sprintf "Unknown optimization profile '%s' (supported: pgo)" mode)
+
+            // Check test suite options
+            match options.TestSuite with
+            | Some "full" | Some "smoke" | None -> ()
+            | Some suite ->
+                validationErrors.Add(sprintf "Unknown test suite '%s' (supported: full, smoke)" suite)
+
+            // Check matrix options
+            if options.Matrix then
+                if options.Alias.IsSome || options.Name.IsSome then
+                    validationErrors.Add("--alias and --name cannot be used with --matrix")
+                match options.Jobs with
+                | Some jobs when jobs < 1 -> validationErrors.Add("--jobs must be at least 1")
+                | _ -> ()
+            elif options.Architectures.IsSome || options.BuildTypes.IsSome || options.Jobs.IsSome then
+                validationErrors.Add("--arch, --build-type and --jobs are only used with --matrix")
+
             // If there are any validation errors, return them
             if validationErrors.Count > 0 then
                 Error (sprintf "[ERROR] Invalid parameters: %s" (String.Join(", ", validationErrors)))
@@ -643,9 +756,30 @@ module Backend =
                 // Add build options
                 if options.UseDll then args.Add("--dll")
                 if options.UseDebug then args.Add("--debug")
+                match options.Optimize with
+                | Some mode -> args.Add("--optimize"); args.Add(mode)
+                | None -> ()
                 if options.UseX86 then args.Add("--x86")
                 if options.SkipEnvCheck then args.Add("--skip-env-check")
                 if options.SkipTests then args.Add("--skip-tests")
+                match options.TestSuite with
+                | Some suite -> args.Add("--test-suite"); args.Add(suite)
+                | None -> ()
+                match options.TestJobs with
+                | Some jobs -> args.Add("--test-jobs"); args.Add(string jobs)
+                | None -> ()
+
+                // Add matrix options
+                if options.Matrix then args.Add("--matrix")
+                match options.Architectures with
+                | Some archs -> args.Add("--arch"); args.Add(archs)
+                | None -> ()
+                match options.BuildTypes with
+                | Some types -> args.Add("--build-type"); args.Add(types)
+                | None -> ()
+                match options.Jobs with
+                | Some jobs -> args.Add("--jobs"); args.Add(string jobs)
+                | None -> ()
 
                 // Add metadata options
                 match options.Name with
@@ -657,7 +791,7 @@ module Backend =
                 | None -> ()
 
                 // Use the new progress-enabled execution
-                executePythonWithProgress config "setup_lua.py" (List.ofSeq args)
+                Trace.span "python setup_lua.py" (fun () -> executePythonWithProgress config "setup_lua.py" (List.ofSeq args))
         with
         | ex -> Error (sprintf "[ERROR] Failed to execute install command: %s" ex.Message)
 
@@ -680,8 +814,26 @@ module Backend =
         if options.Detailed then
             // Use direct registry access for detailed mode
             try
-                match RegistryAccess.loadRegistry None with
-                | Ok registry ->
+                // Sizes come from the registry; trees changed since they were measured
+                // (a rock installed or removed) are measured again by registry.py first
+                // Each tree marker is checked once; installations registry.py measured are current
+                let registryResult =
+                    match RegistryAccess.loadRegistry None with
+                    | Ok registry ->
+                        let stale =
+                            RegistryAccess.getInstallations registry
+                            |> List.filter (RegistryAccess.isDiskUsageCurrent >> not)
+                            |> List.map (fun i -> i.id)
+                        match stale with
+                        | [] -> Ok (registry, Set.empty)
+                        | ids ->
+                            match executePython config "registry.py" ("usage" :: "--quiet" :: ids) with
+                            | Ok 0 -> RegistryAccess.loadRegistry None |> Result.map (fun reloaded -> reloaded, Set.empty)
+                            | _ -> Ok (registry, Set.ofList ids)
+                    | Error errorMsg -> Error errorMsg
+
+                match registryResult with
+                | Ok (registry, staleUsage) ->
                     let installations = RegistryAccess.getInstallations registry
                     let defaultInstallation = RegistryAccess.getDefaultInstallation registry
 
@@ -716,10 +868,22 @@ module Backend =
                                 let tagsStr = String.Join(", ", installation.tags)
                                 printfn "    Tags: %s" tagsStr
 
+                            match installation.benchmark with
+                            | Some bench ->
+                                let medians =
+                                    bench.results
+                                    |> Map.toList
+                                    |> List.map (fun (name, result) -> sprintf "%s %.1fms" name result.median_ms)
+                                printfn "    Benchmark: %.1fms total (%d runs, %s)" bench.total_ms bench.runs bench.updated
+                                printfn "      %s" (String.Join(", ", medians))
+                            | None -> ()
+
                             // Get size information
-                            let sizeInfo = RegistryAccess.getInstallationSize installation
+                            let sizeInfo = RegistryAccess.getInstallationSize installation (not (staleUsage.Contains installation.id))
                             printfn "    Disk Usage: %s (Installation: %s, Environment: %s)"
                                 sizeInfo.TotalSize sizeInfo.InstallationSize sizeInfo.EnvironmentSize
+                            printfn "    Unique: %s, Shared: %s (hardlinked with the LuaEnv store or build cache)"
+                                sizeInfo.UniqueSize sizeInfo.SharedSize
 
                             // Validate installation
                             let validation = RegistryAccess.validateInstallation installation
@@ -747,8 +911,12 @@ module Backend =
 
     /// Execute status command via registry.py (backend)
     let executeStatus (config: BackendConfig) (options: StatusOptions) : Result<int, string> =
-        // For now, always use backend - detailed mode can be added later
-        let args = ["status"]
+        // The registry status and the install timelines both come from the backend
+        let args =
+            if options.Timings || options.Json then
+                ["status"] @ options.Targets @ ["--timings"] @ (if options.Json then ["--json"] else [])
+            else
+                ["status"]
         executePython config "registry.py" args
 
     /// Execute installed versions command using direct registry access
@@ -761,8 +929,9 @@ module Backend =
                 printfn "[INFO] Make sure you have installed at least one Lua environment"
                 Ok 1
             else
-                let jsonContent = File.ReadAllText registryPath
-                let registryData = JsonSerializer.Deserialize<JsonElement>(jsonContent)
+                let jsonContent = RegistryAccess.readRegistryJson registryPath
+                use registryDocument = JsonDocument.Parse jsonContent
+                let registryData = registryDocument.RootElement
 
                 printfn "INSTALLED VERSIONS:"
                 printfn "%-20s | %-8s | %-10s | %-4s" "Alias" "Lua" "LuaRocks" "Arch"
@@ -948,6 +1117,22 @@ module Backend =
         with
         | ex -> Error (sprintf "[ERROR] Failed to execute remove-alias command: %s" ex.Message)
 
+    /// Execute bench command via bench_lua.py (backend)
+    let executeBench (config: BackendConfig) (options: BenchOptions) : Result<int, string> =
+        match options.Runs with
+        | Some runs when runs < 1 -> Error "[ERROR] --runs must be at least 1"
+        | _ ->
+            let args =
+                [ yield! options.Installations
+                  match options.Runs with
+                  | Some runs -> yield! ["--runs"; string runs]
+                  | None -> ()
+                  match options.Only with
+                  | Some only -> yield! ["--only"; only]
+                  | None -> ()
+                  if not options.Save then yield "--no-save" ]
+            executePython config "bench_lua.py" args
+
     /// Execute 'default' command to set the default Lua installation
     let executeDefault (config: BackendConfig) (options: DefaultOptions) : Result<int, string> =
         try
@@ -960,10 +1145,22 @@ module Backend =
         with
         | ex -> Error $"[ERROR] Failed to set default installation: {ex.Message}"
 
+    /// Turn the exit code and captured streams of pkg_config.py into the CLI result:
+    /// Ok with the text to print, or Error with the message to report.
+    /// Used by the resident server, which has to capture the worker's output.
+    let pkgConfigResult (exitCode: int) (output: string) (errorOutput: string) : Result<string, string> =
+        if exitCode <> 0 then
+            if not (String.IsNullOrWhiteSpace errorOutput) then
+                Error (errorOutput.Trim())
+            else
+                Error (sprintf "[ERROR] Pkg-config command failed with exit code %d.\n%s" exitCode output)
+        else
+            Ok output
+
     /// Execute pkg-config command for specific installation
 // Fix the executePkgConfig function to properly display all output from pkg_config.py
 
-    let executePkgConfig (config: BackendConfig) (installation: string) (showCFlag: bool) (showLuaInclude: bool) (showLibLua: bool) (showLibDir: bool) (showPaths: bool) (pathStyle: string option) : Result<int, string> =
+    let executePkgConfig (config: BackendConfig) (installation: string) (showCFlag: bool) (showLuaInclude: bool) (showLibLua: bool) (showLibDir: bool) (showPaths: bool) (pathStyle: string option) (format: string option) (emit: string option) : Result<int, string> =
         try
             // Validate required parameters
             if String.IsNullOrWhiteSpace(installation) then
@@ -975,63 +1172,75 @@ module Backend =
                     Error "[ERROR] Path style cannot be empty when specified"
                 | Some style when not (List.contains style ["windows"; "unix"; "native"]) ->
                     Error (sprintf "[ERROR] Invalid path style: %s. Must be one of: 'windows', 'unix', 'native'" style)
+                | _ when format.IsSome && not (List.contains format.Value ["cmake"; "json"; "env"]) ->
+                    Error (sprintf "[ERROR] Invalid output format: %s. Must be one of: 'cmake', 'json', 'env'" format.Value)
                 | _ ->
-                    // All parameters are valid, proceed with execution
-                    let pythonExe = config.EmbeddedPython.PythonExe
-                    let pkgConfigScript = Path.Combine(config.BackendDir, "pkg_config.py")
-
-                    // Build arguments based on options
-                    let mutable args = $"\"{pkgConfigScript}\" \"{installation}\""
-
-                    if showCFlag then
-                        args <- args + " --cflag"
-                    elif showLuaInclude then
-                        args <- args + " --lua-include"
-                    elif showLibLua then
-                        args <- args + " --liblua"
-                    elif showLibDir then
-                        args <- args + " --libdir"
-                    elif showPaths then
-                        args <- args + " --path"
-                    // No --json flag for full output format
-                    // This will let pkg_config.py handle the formatting
-                    // and show all information including DLL requirements
-
-                    // Add path style if specified
-                    match pathStyle with
-                    | Some style -> args <- args + $" --path-style {style}"
-                    | None -> ()
-
-                    let startInfo = ProcessStartInfo()
-                    startInfo.FileName <- pythonExe
-                    startInfo.Arguments <- args
-                    startInfo.WorkingDirectory <- config.BackendDir
-                    startInfo.RedirectStandardOutput <- true
-                    startInfo.RedirectStandardError <- true
-                    startInfo.UseShellExecute <- false
-                    startInfo.CreateNoWindow <- true
-
-                    // Explicitly copy current environment to ensure VS variables are passed
-                    startInfo.EnvironmentVariables.Clear()
-                    for envVar in System.Environment.GetEnvironmentVariables() do
-                        let entry = envVar :?> System.Collections.DictionaryEntry
-                        startInfo.EnvironmentVariables.[entry.Key.ToString()] <- entry.Value.ToString()
-
-                    use proc = Process.Start(startInfo)
-                    let output = proc.StandardOutput.ReadToEnd()
-                    let errorOutput = proc.StandardError.ReadToEnd()
-
-                    proc.WaitForExit()
-
-                    if proc.ExitCode <> 0 then
-                        if not (String.IsNullOrWhiteSpace errorOutput) then
-                            Error (errorOutput.Trim())
+                    let queries =
+                        [ "cflag", showCFlag; "lua-include", showLuaInclude; "liblua", showLibLua
+                          "libdir", showLibDir; "path", showPaths ]
+                        |> List.filter snd
+                        |> List.map fst
+
+                    // Answer natively when possible. Python prints text-mode output in the
+                    // ANSI code page, so only ASCII answers are guaranteed to match it.
+                    let nativeAnswer =
+                        if Environment.GetEnvironmentVariable "LUAENV_PKGCONFIG_PYTHON" = "1" || emit.IsSome then
+                            None
                         else
-                            Error (sprintf "[ERROR] Pkg-config command failed with exit code %d.\n%s" proc.ExitCode output)
-                    else
-                        // Always print the output directly
-                        printf "%s" output
+                            Trace.span "cli native pkg-config" (fun () ->
+                                match RegistryAccess.loadRegistry None with
+                                | Ok registry ->
+                                    PkgConfig.render registry installation queries (defaultArg pathStyle "native") format
+                                    |> Option.filter (fun text -> text |> Seq.forall (fun c -> c < '\u0080'))
+                                | Error _ -> None)
+
+                    match nativeAnswer with
+                    | Some text ->
+                        Console.Out.Write(text.Replace("\n", Environment.NewLine))
                         Ok 0
+                    | None ->
+                        // Fall back to pkg_config.py, which also reports every error
+                        let pythonExe = config.EmbeddedPython.PythonExe
+                        let pkgConfigScript = Path.Combine(config.BackendDir, "pkg_config.py")
+
+                        // Build arguments based on options
+                        let mutable args = $"\"{pkgConfigScript}\" \"{installation}\""
+
+                        // Forward every requested flag; pkg_config.py answers them
+                        // in a fixed order or combines them when --format is given
+                        for query in queries do
+                            args <- args + " --" + query
+                        // No --json flag for full output format
+                        // This will let pkg_config.py handle the formatting
+                        // and show all information including DLL requirements
+
+                        // Add path style if specified
+                        match pathStyle with
+                        | Some style -> args <- args + $" --path-style {style}"
+                        | None -> ()
+
+                        // Add output format if specified
+                        match format with
+                        | Some fmt -> args <- args + $" --format {fmt}"
+                        | None -> ()
+
+                        // The build files are written by pkg_config.py
+                        match emit with
+                        | Some "" -> args <- args + " --emit"
+                        | Some dir -> args <- args + $" --emit \"{dir.TrimEnd('\\')}\""
+                        | None -> ()
+
+                        let startInfo = ProcessStartInfo()
+                        startInfo.FileName <- pythonExe
+                        startInfo.Arguments <- args
+                        startInfo.WorkingDirectory <- config.BackendDir
+                        startInfo.UseShellExecute <- false
+
+                        // Pass-through: pkg_config.py writes its answers and errors straight
+                        // to our (luaconfig's) standard handles, so they are not copied here
+                        Console.Out.Flush()
+                        Trace.span "python pkg_config.py" (fun () ->
+                            Ok (ProcessExecution.runInherited startInfo))
         with
         | ex ->
             Error (sprintf "[ERROR] Failed to execute pkg-config command: %s" ex.Message)
\ No newline at end of file
@@ -0,0 +1,226 @@
+/*
+ * alloc_bench.c - compare the default Lua allocator with luaenv_alloc
+ *
+ * Runs two workloads with each allocator, optionally on several threads at once
+ * (which is where the shared CRT heap starts to contend):
+ *
+ *   cycle   create a state, open the libraries, run a short script, close it
+ *   tables  build and drop many small tables in one long-lived state
+ *
+ * Usage: alloc_bench [--cycles N] [--iterations N] [--threads N]
+ *
+ * This is free and unencumbered software released into the public domain.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+#include "luaenv_alloc.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+static const char *cycle_script =
+    "local t = {}\n"
+    "for i = 1, 200 do t[i] = { id = i, name = 'item' .. i } end\n"
+    "return #t\n";
+
+static const char *tables_script =
+    "local rows = {}\n"
+    "for i = 1, 20000 do\n"
+    "  rows[i] = { id = i, name = 'row' .. i, tags = { 'a', 'b', i % 7 } }\n"
+    "end\n"
+    "local sum = 0\n"
+    "for i = 1, #rows, 3 do sum = sum + rows[i].id; rows[i] = nil end\n"
+    "return sum\n";
+
+enum allocator { ALLOC_CRT, ALLOC_POOL, ALLOC_POOL_CACHE };
+static const char *allocator_names[] = { "crt", "pool", "pool+cache" };
+
+typedef struct job {
+    enum allocator allocator;
+    int tables;     /* 0: cycle workload, 1: tables workload */
+    int count;
+    int failed;
+    luaenv_alloc_stats stats;
+} job;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+static lua_State *new_state(enum allocator allocator) {
+    switch (allocator) {
+    case ALLOC_POOL: return luaenv_newstate(0);
+    case ALLOC_POOL_CACHE: return luaenv_newstate(LUAENV_ALLOC_THREAD_CACHE);
+    default: return luaL_newstate();
+    }
+}
+
+static void close_state(lua_State *L, enum allocator allocator, job *j) {
+    if (allocator == ALLOC_CRT) {
+        lua_close(L);
+    } else {
+        luaenv_alloc_get_stats(luaenv_getalloc(L), &j->stats);
+        luaenv_close(L);
+    }
+}
+
+static int run_script(lua_State *L, const char *script) {
+    if (luaL_dostring(L, script)) {
+        fprintf(stderr, "Lua error: %s\n", lua_tostring(L, -1));
+        return 0;
+    }
+    lua_settop(L, 0);
+    return 1;
+}
+
+static void run_job(job *j) {
+    int i;
+    if (!j->tables) {
+        for (i = 0; i < j->count && !j->failed; i++) {
+            lua_State *L = new_state(j->allocator);
+            if (!L) { j->failed = 1; break; }
+            luaL_openlibs(L);
+            if (!run_script(L, cycle_script)) j->failed = 1;
+            close_state(L, j->allocator, j);
+        }
+    } else {
+        lua_State *L = new_state(j->allocator);
+        if (!L) { j->failed = 1; return; }
+        luaL_openlibs(L);
+        for (i = 0; i < j->count && !j->failed; i++) {
+            if (!run_script(L, tables_script)) j->failed = 1;
+        }
+        close_state(L, j->allocator, j);
+    }
+    if (j->allocator == ALLOC_POOL_CACHE) luaenv_alloc_trim_thread_cache();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg) { run_job((job *)arg); return 0; }
+#else
+static void *thread_main(void *arg) { run_job((job *)arg); return NULL; }
+#endif
+
+/* Run the workload on nthreads threads at once; returns the wall time or -1 */
+static double run_parallel(enum allocator allocator, int tables, int count, int nthreads, job *first) {
+    job *jobs = (job *)calloc((size_t)nthreads, sizeof(job));
+    double started, elapsed;
+    int i, failed = 0;
+#ifdef _WIN32
+    HANDLE *threads = (HANDLE *)calloc((size_t)nthreads, sizeof(HANDLE));
+#else
+    pthread_t *threads = (pthread_t *)calloc((size_t)nthreads, sizeof(pthread_t));
+#endif
+    if (!jobs || !threads) { free(jobs); free(threads); return -1; }
+
+    for (i = 0; i < nthreads; i++) {
+        jobs[i].allocator = allocator;
+        jobs[i].tables = tables;
+        jobs[i].count = count;
+    }
+
+    started = now_seconds();
+    if (nthreads == 1) {
+        run_job(&jobs[0]);
+    } else {
+#ifdef _WIN32
+        for (i = 0; i < nthreads; i++)
+            threads[i] = CreateThread(NULL, 0, thread_main, &jobs[i], 0, NULL);
+        WaitForMultipleObjects((DWORD)nthreads, threads, TRUE, INFINITE);
+        for (i = 0; i < nthreads; i++) CloseHandle(threads[i]);
+#else
+        for (i = 0; i < nthreads; i++)
+            pthread_create(&threads[i], NULL, thread_main, &jobs[i]);
+        for (i = 0; i < nthreads; i++)
+            pthread_join(threads[i], NULL);
+#endif
+    }
+    elapsed = now_seconds() - started;
+
+    for (i = 0; i < nthreads; i++) failed |= jobs[i].failed;
+    *first = jobs[0];
+    free(jobs);
+    free(threads);
+    return failed ? -1 : elapsed;
+}
+
+static int parse_count(const char *value, const char *option) {
+    int n = atoi(value);
+    if (n < 1) {
+        fprintf(stderr, "%s must be a positive number\n", option);
+        exit(2);
+    }
+    return n;
+}
+
+int main(int argc, char **argv) {
+    int cycles = 2000, iterations = 50, nthreads = 1;
+    int i, tables;
+    job stats[2][3];
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = parse_count(argv[++i], "--cycles");
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = parse_count(argv[++i], "--iterations");
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            nthreads = parse_count(argv[++i], "--threads");
+        } else {
+            fprintf(stderr, "Usage: %s [--cycles N] [--iterations N] [--threads N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("%s, %d thread(s)\n\n", LUA_RELEASE, nthreads);
+    printf("%-8s %-11s %10s %14s %9s\n", "workload", "allocator", "seconds", "runs/s", "speedup");
+
+    for (tables = 0; tables <= 1; tables++) {
+        int count = tables ? iterations : cycles;
+        double baseline = 0;
+        int a;
+        for (a = ALLOC_CRT; a <= ALLOC_POOL_CACHE; a++) {
+            double seconds = run_parallel((enum allocator)a, tables, count, nthreads, &stats[tables][a]);
+            if (seconds < 0) {
+                fprintf(stderr, "%s workload failed with the %s allocator\n",
+                        tables ? "tables" : "cycle", allocator_names[a]);
+                return 1;
+            }
+            if (a == ALLOC_CRT) baseline = seconds;
+            printf("%-8s %-11s %10.3f %14.0f %8.2fx\n", tables ? "tables" : "cycle",
+                   allocator_names[a], seconds, (double)count * nthreads / seconds,
+                   seconds > 0 ? baseline / seconds : 0.0);
+        }
+    }
+
+    printf("\npool allocator, last state of the first thread:\n");
+    for (tables = 0; tables <= 1; tables++) {
+        const luaenv_alloc_stats *s = &stats[tables][ALLOC_POOL_CACHE].stats;
+        printf("  %-6s allocations %zu, in-place resizes %zu, large %zu, peak %zu KB,"
+               " arenas %zu KB (%zu reused, %zu new)\n",
+               tables ? "tables" : "cycle", s->allocations, s->in_place, s->large,
+               s->peak_bytes / 1024, s->arena_bytes / 1024, s->arenas_reused, s->arenas_allocated);
+    }
+    return 0;
+}
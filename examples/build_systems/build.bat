@@ -10,11 +10,11 @@ rem This script assumes that you have an installation of lua made with luaenv wi
 
 echo [INFO] Setting up environment variables from luaenv...
 
-rem Capture the compiler flags
-for /f "delims=" %%i in ('luaconfig dev --cflag --path-style windows') do set CFLAGS=%%i
-
-rem Capture the library path
-for /f "delims=" %%i in ('luaconfig dev --liblua --path-style windows') do set LUA_LIB=%%i
+rem Capture the compiler flags and the library path in a single call
+rem (--format env prints LUA_CFLAGS=... and LUA_LIBRARY=... lines)
+for /f "tokens=1,* delims==" %%a in ('luaconfig dev --cflag --liblua --format env --path-style windows') do set "%%a=%%b"
+set "CFLAGS=%LUA_CFLAGS%"
+set "LUA_LIB=%LUA_LIBRARY%"
 
 echo [DEBUG] CFLAGS: %CFLAGS%
 echo [DEBUG] LUA_LIB: %LUA_LIB%
@@ -13,8 +13,14 @@
 Write-Host "[build.ps1] Starting PowerShell build..."
 
 # Ensure we're using the Windows path style for cl.exe
-$cflags = luaconfig dev --cflag --path-style windows
-$lua_lib = luaconfig dev --liblua --path-style windows
+# A single call returns both values as NAME=value lines
+$luaConfig = @{}
+luaconfig dev --cflag --liblua --format env --path-style windows | ForEach-Object {
+    $name, $value = $_ -split '=', 2
+    $luaConfig[$name] = $value
+}
+$cflags = $luaConfig["LUA_CFLAGS"]
+$lua_lib = $luaConfig["LUA_LIBRARY"]
 
 if ($LASTEXITCODE -ne 0) {
     Write-Host "[build.ps1] ERROR: Failed to get pkg-config data from luaenv." -ForegroundColor Red
@@ -27,6 +33,8 @@ Write-Host "[build.ps1] LUA_LIB: $lua_lib"
 # Clean previous build artifact
 if (Test-Path "main_ps.exe") { Remove-Item "main_ps.exe" }
 if (Test-Path "main_ps.obj") { Remove-Item "main_ps.obj" }
+if (Test-Path "alloc_bench_ps.exe") { Remove-Item "alloc_bench_ps.exe" }
+if (Test-Path "pool_bench_ps.exe") { Remove-Item "pool_bench_ps.exe" }
 
 
 # Compile the application
@@ -42,6 +50,28 @@ Write-Host "[build.ps1] Executing: $command"
 
 Invoke-Expression $command
 
+if ($LASTEXITCODE -ne 0) {
+    Write-Host "[build.ps1] ERROR: Build failed with exit code $LASTEXITCODE." -ForegroundColor Red
+    exit 1
+}
+
+# Embedding kit: pool allocator for lua_newstate and its benchmark (see luaenv_alloc.h)
+$command = "cl.exe /Fe:alloc_bench_ps.exe /O2 alloc_bench.c luaenv_alloc.c $cflags /TC /W4 -D_CRT_SECURE_NO_WARNINGS /link `"$lua_lib`""
+Write-Host "[build.ps1] Executing: $command"
+
+Invoke-Expression $command
+
+if ($LASTEXITCODE -ne 0) {
+    Write-Host "[build.ps1] ERROR: Build failed with exit code $LASTEXITCODE." -ForegroundColor Red
+    exit 1
+}
+
+# Embedding kit: pre-warmed lua_State pool and its benchmark (see luaenv_pool.h)
+$command = "cl.exe /Fe:pool_bench_ps.exe /O2 pool_bench.c luaenv_pool.c $cflags /TC /W4 -D_CRT_SECURE_NO_WARNINGS /link `"$lua_lib`""
+Write-Host "[build.ps1] Executing: $command"
+
+Invoke-Expression $command
+
 if ($LASTEXITCODE -eq 0) {
     Write-Host "[build.ps1] Build successful!" -ForegroundColor Green
     exit 0
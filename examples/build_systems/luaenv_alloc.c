@@ -0,0 +1,258 @@
+/*
+ * luaenv_alloc.c - size-class pool allocator for embedding Lua
+ *
+ * See luaenv_alloc.h. Small blocks carry no header: Lua passes the old size of
+ * every block it frees or resizes, which is enough to find its size class.
+ *
+ * This is free and unencumbered software released into the public domain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lua.h>
+#include "luaenv_alloc.h"
+
+#define NUM_CLASSES 16
+
+/* Block sizes of the classes; all multiples of 16 so blocks stay 16-byte aligned */
+static const unsigned short class_size[NUM_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+
+/* Class of a request of n bytes, indexed by (n + 15) / 16 */
+static const unsigned char class_of[LUAENV_ALLOC_MAX_SMALL / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+    12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15
+};
+
+#define CLASS_OF(n) (class_of[((n) + 15) >> 4])
+
+/* Header of an arena, padded so that the blocks after it are 16-byte aligned */
+typedef union arena {
+    union arena *next;
+    double align[2];
+} arena;
+
+struct luaenv_alloc {
+    void *free_list[NUM_CLASSES];
+    char *bump;
+    char *bump_end;
+    arena *arenas;
+    unsigned flags;
+    luaenv_alloc_stats stats;
+};
+
+#if defined(_MSC_VER)
+#define LUAENV_TLS __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define LUAENV_TLS __thread
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define LUAENV_TLS _Thread_local
+#endif
+
+#ifdef LUAENV_TLS
+/* Arenas of closed states, kept for the next state created on this thread */
+static LUAENV_TLS arena *cache_head;
+static LUAENV_TLS unsigned cache_count;
+#endif
+
+static arena *arena_take(luaenv_alloc *a) {
+    arena *ar = NULL;
+#ifdef LUAENV_TLS
+    if ((a->flags & LUAENV_ALLOC_THREAD_CACHE) && cache_head) {
+        ar = cache_head;
+        cache_head = ar->next;
+        cache_count--;
+        a->stats.arenas_reused++;
+    }
+#endif
+    if (!ar) {
+        ar = (arena *)malloc(LUAENV_ALLOC_ARENA_SIZE);
+        if (!ar) return NULL;
+        a->stats.arenas_allocated++;
+    }
+    ar->next = a->arenas;
+    a->arenas = ar;
+    a->stats.arena_bytes += LUAENV_ALLOC_ARENA_SIZE;
+    return ar;
+}
+
+static void arena_release(const luaenv_alloc *a, arena *ar) {
+#ifdef LUAENV_TLS
+    if ((a->flags & LUAENV_ALLOC_THREAD_CACHE) && cache_count < LUAENV_ALLOC_CACHE_ARENAS) {
+        ar->next = cache_head;
+        cache_head = ar;
+        cache_count++;
+        return;
+    }
+#else
+    (void)a;
+#endif
+    free(ar);
+}
+
+static void push_free(luaenv_alloc *a, int cls, void *block) {
+    *(void **)block = a->free_list[cls];
+    a->free_list[cls] = block;
+}
+
+/* Start a new arena, giving the tail of the current one to the free lists */
+static int refill(luaenv_alloc *a) {
+    arena *ar;
+    size_t left = (size_t)(a->bump_end - a->bump);
+    int cls = NUM_CLASSES - 1;
+    while (left >= class_size[0]) {
+        while (class_size[cls] > left) cls--;
+        push_free(a, cls, a->bump);
+        a->bump += class_size[cls];
+        left -= class_size[cls];
+    }
+
+    ar = arena_take(a);
+    if (!ar) return 0;
+    a->bump = (char *)(ar + 1);
+    a->bump_end = (char *)ar + LUAENV_ALLOC_ARENA_SIZE;
+    return 1;
+}
+
+static void *alloc_small(luaenv_alloc *a, int cls) {
+    void *block = a->free_list[cls];
+    if (block) {
+        a->free_list[cls] = *(void **)block;
+        return block;
+    }
+    if ((size_t)(a->bump_end - a->bump) < class_size[cls] && !refill(a))
+        return NULL;
+    block = a->bump;
+    a->bump += class_size[cls];
+    return block;
+}
+
+static void *alloc_block(luaenv_alloc *a, size_t n) {
+    void *block;
+    if (n <= LUAENV_ALLOC_MAX_SMALL) {
+        block = alloc_small(a, CLASS_OF(n));
+    } else {
+        block = malloc(n);
+        if (block) a->stats.large++;
+    }
+    if (block) {
+        a->stats.allocations++;
+        a->stats.bytes_in_use += n;
+        if (a->stats.bytes_in_use > a->stats.peak_bytes)
+            a->stats.peak_bytes = a->stats.bytes_in_use;
+    }
+    return block;
+}
+
+static void free_block(luaenv_alloc *a, void *block, size_t n) {
+    if (n <= LUAENV_ALLOC_MAX_SMALL)
+        push_free(a, CLASS_OF(n), block);
+    else
+        free(block);
+    a->stats.frees++;
+    a->stats.bytes_in_use -= n;
+}
+
+void *luaenv_alloc_fn(void *ud, void *ptr, size_t osize, size_t nsize) {
+    luaenv_alloc *a = (luaenv_alloc *)ud;
+    void *block;
+
+    if (nsize == 0) {
+        if (ptr) free_block(a, ptr, osize);
+        return NULL;
+    }
+    /* For a new block, osize is the type of object being created */
+    if (!ptr) return alloc_block(a, nsize);
+
+    a->stats.reallocations++;
+    if (osize <= LUAENV_ALLOC_MAX_SMALL && nsize <= LUAENV_ALLOC_MAX_SMALL) {
+        if (CLASS_OF(osize) == CLASS_OF(nsize)) {
+            a->stats.in_place++;
+            a->stats.bytes_in_use = a->stats.bytes_in_use - osize + nsize;
+            if (a->stats.bytes_in_use > a->stats.peak_bytes)
+                a->stats.peak_bytes = a->stats.bytes_in_use;
+            return ptr;
+        }
+    } else if (osize > LUAENV_ALLOC_MAX_SMALL && nsize > LUAENV_ALLOC_MAX_SMALL) {
+        block = realloc(ptr, nsize);
+        if (!block) return NULL;
+        a->stats.bytes_in_use = a->stats.bytes_in_use - osize + nsize;
+        if (a->stats.bytes_in_use > a->stats.peak_bytes)
+            a->stats.peak_bytes = a->stats.bytes_in_use;
+        return block;
+    }
+
+    /* Moving between classes, or between the classes and the CRT */
+    block = alloc_block(a, nsize);
+    if (!block) return NULL;  /* Lua keeps the old block */
+    memcpy(block, ptr, osize < nsize ? osize : nsize);
+    free_block(a, ptr, osize);
+    return block;
+}
+
+luaenv_alloc *luaenv_alloc_create(unsigned flags) {
+    luaenv_alloc *a = (luaenv_alloc *)calloc(1, sizeof(luaenv_alloc));
+    if (a) a->flags = flags;
+    return a;
+}
+
+void luaenv_alloc_destroy(luaenv_alloc *a) {
+    arena *ar, *next;
+    if (!a) return;
+    for (ar = a->arenas; ar; ar = next) {
+        next = ar->next;
+        arena_release(a, ar);
+    }
+    free(a);
+}
+
+void luaenv_alloc_get_stats(const luaenv_alloc *a, luaenv_alloc_stats *stats) {
+    *stats = a->stats;
+}
+
+void luaenv_alloc_trim_thread_cache(void) {
+#ifdef LUAENV_TLS
+    while (cache_head) {
+        arena *next = cache_head->next;
+        free(cache_head);
+        cache_head = next;
+    }
+    cache_count = 0;
+#endif
+}
+
+/* Same message as the panic function of luaL_newstate */
+static int panic(lua_State *L) {
+    const char *msg = lua_tostring(L, -1);
+    if (msg == NULL) msg = "error object is not a string";
+    fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", msg);
+    fflush(stderr);
+    return 0;
+}
+
+lua_State *luaenv_newstate(unsigned flags) {
+    lua_State *L;
+    luaenv_alloc *a = luaenv_alloc_create(flags);
+    if (!a) return NULL;
+    L = lua_newstate(luaenv_alloc_fn, a);
+    if (!L) {
+        luaenv_alloc_destroy(a);
+        return NULL;
+    }
+    lua_atpanic(L, panic);
+    return L;
+}
+
+luaenv_alloc *luaenv_getalloc(lua_State *L) {
+    void *ud = NULL;
+    lua_getallocf(L, &ud);
+    return (luaenv_alloc *)ud;
+}
+
+void luaenv_close(lua_State *L) {
+    luaenv_alloc *a = luaenv_getalloc(L);
+    lua_close(L);
+    luaenv_alloc_destroy(a);
+}
@@ -0,0 +1,87 @@
+/*
+ * luaenv_alloc.h - size-class pool allocator for embedding Lua
+ *
+ * A lua_Alloc implementation for hosts that create and close many short-lived
+ * Lua states. Each state gets its own allocator: small blocks (up to
+ * LUAENV_ALLOC_MAX_SMALL bytes) come from per-class free lists refilled from
+ * bump arenas, larger ones from the CRT. Because a lua_State is only used by
+ * one thread at a time, none of this needs a lock, and closing a state frees
+ * its arenas in one pass instead of block by block.
+ *
+ * With LUAENV_ALLOC_THREAD_CACHE, the arenas of a closed state are kept in a
+ * cache of the closing thread and handed to the next state created on it, so
+ * a create/run/close cycle does not touch the CRT heap for its small blocks.
+ *
+ * Usage:
+ *     lua_State *L = luaenv_newstate(LUAENV_ALLOC_THREAD_CACHE);
+ *     luaL_openlibs(L);
+ *     ...
+ *     luaenv_close(L);
+ *
+ * This is free and unencumbered software released into the public domain.
+ */
+
+#ifndef LUAENV_ALLOC_H
+#define LUAENV_ALLOC_H
+
+#include <stddef.h>
+#include <lua.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest block served from the size classes; larger blocks use realloc/free */
+#define LUAENV_ALLOC_MAX_SMALL 512
+/* Bytes of one bump arena */
+#define LUAENV_ALLOC_ARENA_SIZE (64 * 1024)
+/* Arenas a thread keeps for the next state it creates */
+#define LUAENV_ALLOC_CACHE_ARENAS 32
+
+/* Flags of luaenv_alloc_create and luaenv_newstate */
+#define LUAENV_ALLOC_THREAD_CACHE 0x1u
+
+typedef struct luaenv_alloc luaenv_alloc;
+
+typedef struct luaenv_alloc_stats {
+    size_t allocations;      /* blocks allocated (including moving reallocations) */
+    size_t frees;            /* blocks freed */
+    size_t reallocations;    /* resize requests */
+    size_t in_place;         /* resizes that stayed in the same size class */
+    size_t large;            /* allocations above LUAENV_ALLOC_MAX_SMALL */
+    size_t bytes_in_use;     /* bytes Lua currently holds */
+    size_t peak_bytes;       /* largest bytes_in_use so far */
+    size_t arena_bytes;      /* bytes of the arenas this allocator owns */
+    size_t arenas_reused;    /* arenas taken from the thread cache */
+    size_t arenas_allocated; /* arenas taken from the CRT heap */
+} luaenv_alloc_stats;
+
+/* Create an allocator (NULL when out of memory) */
+luaenv_alloc *luaenv_alloc_create(unsigned flags);
+
+/* Release an allocator and its arenas (after lua_close of the state using it) */
+void luaenv_alloc_destroy(luaenv_alloc *a);
+
+/* lua_Alloc entry point; ud is the luaenv_alloc */
+void *luaenv_alloc_fn(void *ud, void *ptr, size_t osize, size_t nsize);
+
+/* Copy the statistics of an allocator into stats */
+void luaenv_alloc_get_stats(const luaenv_alloc *a, luaenv_alloc_stats *stats);
+
+/* Free the arenas cached by the calling thread (call before the thread exits) */
+void luaenv_alloc_trim_thread_cache(void);
+
+/* lua_newstate with a new allocator; a replacement for luaL_newstate (NULL on error) */
+lua_State *luaenv_newstate(unsigned flags);
+
+/* lua_close a state made by luaenv_newstate and destroy its allocator */
+void luaenv_close(lua_State *L);
+
+/* The allocator of a state made by luaenv_newstate */
+luaenv_alloc *luaenv_getalloc(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LUAENV_ALLOC_H */
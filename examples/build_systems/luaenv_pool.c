@@ -0,0 +1,528 @@
+/*
+ * luaenv_pool.c - pool of pre-warmed lua_States for multithreaded hosts
+ *
+ * See luaenv_pool.h. Each shard is a lock and a stack of idle states; a
+ * thread's home shard is picked round-robin the first time it uses a pool.
+ * The reset works from a snapshot taken right after initialisation and kept
+ * in the state's registry: a shallow copy of every table it covers, and the
+ * metatables of those tables.
+ *
+ * This is free and unencumbered software released into the public domain.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+#include "luaenv_pool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef SRWLOCK pool_mutex;
+typedef CONDITION_VARIABLE pool_cond;
+typedef HANDLE pool_thread;
+typedef volatile LONG pool_atomic;
+
+#define mutex_init(m) InitializeSRWLock(m)
+#define mutex_destroy(m) ((void)(m))
+#define mutex_lock(m) AcquireSRWLockExclusive(m)
+#define mutex_trylock(m) (TryAcquireSRWLockExclusive(m) != 0)
+#define mutex_unlock(m) ReleaseSRWLockExclusive(m)
+#define cond_init(c) InitializeConditionVariable(c)
+#define cond_destroy(c) ((void)(c))
+#define cond_wait(c, m) SleepConditionVariableSRW((c), (m), INFINITE, 0)
+#define cond_signal(c) WakeConditionVariable(c)
+#define atomic_add(p, n) (InterlockedExchangeAdd((p), (n)) + (n))
+#define atomic_get(p) InterlockedCompareExchange((p), 0, 0)
+#define atomic_cas(p, old, new) (InterlockedCompareExchange((p), (new), (old)) == (old))
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_mutex_t pool_mutex;
+typedef pthread_cond_t pool_cond;
+typedef pthread_t pool_thread;
+typedef int pool_atomic;
+
+#define mutex_init(m) pthread_mutex_init((m), NULL)
+#define mutex_destroy(m) pthread_mutex_destroy(m)
+#define mutex_lock(m) pthread_mutex_lock(m)
+#define mutex_trylock(m) (pthread_mutex_trylock(m) == 0)
+#define mutex_unlock(m) pthread_mutex_unlock(m)
+#define cond_init(c) pthread_cond_init((c), NULL)
+#define cond_destroy(c) pthread_cond_destroy(c)
+#define cond_wait(c, m) pthread_cond_wait((c), (m))
+#define cond_signal(c) pthread_cond_signal(c)
+#define atomic_add(p, n) __atomic_add_fetch((p), (n), __ATOMIC_SEQ_CST)
+#define atomic_get(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define atomic_cas(p, old, new) \
+    __atomic_compare_exchange_n((p), &(pool_atomic){old}, (new), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#endif
+
+#if defined(_MSC_VER)
+#define LUAENV_TLS __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define LUAENV_TLS __thread
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define LUAENV_TLS _Thread_local
+#endif
+
+/* Registry tables of the libraries (lauxlib.h names them since Lua 5.4) */
+#ifndef LUA_LOADED_TABLE
+#define LUA_LOADED_TABLE "_LOADED"
+#endif
+#ifndef LUA_PRELOAD_TABLE
+#define LUA_PRELOAD_TABLE "_PRELOAD"
+#endif
+
+#define DEFAULT_HIGH_WATERMARK 64
+
+/* Registry keys of the snapshot: {[table] = copy} and {[table] = metatable}.
+   Not const: identical read-only constants may be folded to one address. */
+static char snapshot_key;
+static char metatables_key;
+
+typedef struct shard {
+    pool_mutex lock;
+    lua_State **states;
+    int count, capacity;
+    size_t checkouts, local_hits, steals, resets;
+    char pad[64];  /* keep neighbouring shard locks off one cache line */
+} shard;
+
+struct luaenv_pool {
+    luaenv_pool_config config;
+    shard *shards;
+    pool_atomic idle;
+    pool_atomic created, misses, discarded, trimmed;
+    pool_atomic next_refill;
+
+    /* Maintenance thread keeping low_watermark states ready */
+    pool_mutex maint_lock;
+    pool_cond maint_wake;
+    pool_thread maint_thread;
+    int maint_running;
+    int stopping;
+};
+
+static pool_atomic next_thread_slot;
+#ifdef LUAENV_TLS
+static LUAENV_TLS int thread_slot = -1;
+#endif
+
+static shard *home_shard(luaenv_pool *pool) {
+#ifdef LUAENV_TLS
+    if (thread_slot < 0) thread_slot = (int)atomic_add(&next_thread_slot, 1) & 0x7fffffff;
+    return &pool->shards[thread_slot % pool->config.shards];
+#else
+    return &pool->shards[0];  /* no thread-local storage: one shared shard */
+#endif
+}
+
+/* ---- snapshot and reset ---- */
+
+/* Record table at idx: shallow copy in snapshot[t], metatable in metatables[t] */
+static void record_table(lua_State *L, int idx, int snapshot, int metatables) {
+    idx = lua_absindex(L, idx);
+    lua_pushvalue(L, idx);
+    lua_rawget(L, snapshot);
+    if (!lua_isnil(L, -1)) { lua_pop(L, 1); return; }  /* already recorded */
+    lua_pop(L, 1);
+
+    lua_pushvalue(L, idx);
+    lua_newtable(L);
+    lua_pushnil(L);
+    while (lua_next(L, idx)) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -4);
+    }
+    lua_rawset(L, snapshot);
+
+    if (lua_getmetatable(L, idx)) {
+        lua_pushvalue(L, idx);
+        lua_insert(L, -2);
+        lua_rawset(L, metatables);
+    }
+}
+
+static int take_snapshot(lua_State *L) {
+    int snapshot, metatables, globals;
+    lua_newtable(L);
+    snapshot = lua_gettop(L);
+    lua_newtable(L);
+    metatables = lua_gettop(L);
+
+    /* The globals and the tables they hold (the libraries) */
+    lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+    globals = lua_gettop(L);
+    record_table(L, globals, snapshot, metatables);
+    lua_pushnil(L);
+    while (lua_next(L, globals)) {
+        if (lua_type(L, -1) == LUA_TTABLE) record_table(L, -1, snapshot, metatables);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    /* package.loaded and package.preload, and the string metatable */
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    if (lua_type(L, -1) == LUA_TTABLE) record_table(L, -1, snapshot, metatables);
+    lua_pop(L, 1);
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+    if (lua_type(L, -1) == LUA_TTABLE) record_table(L, -1, snapshot, metatables);
+    lua_pop(L, 1);
+    lua_pushliteral(L, "");
+    if (lua_getmetatable(L, -1)) record_table(L, -1, snapshot, metatables);
+    lua_settop(L, metatables);
+
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &metatables_key);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &snapshot_key);
+    return 0;
+}
+
+/* Make table t (at t) hold exactly the entries of copy (at copy) again */
+static void restore_table(lua_State *L, int t, int copy) {
+    /* Existing fields may be changed or cleared while traversing */
+    lua_pushnil(L);
+    while (lua_next(L, t)) {
+        lua_pushvalue(L, -2);
+        lua_rawget(L, copy);
+        if (!lua_rawequal(L, -1, -2)) {
+            lua_pushvalue(L, -3);
+            lua_insert(L, -2);
+            lua_rawset(L, t);
+        } else {
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+    }
+    /* Fields that were removed */
+    lua_pushnil(L);
+    while (lua_next(L, copy)) {
+        lua_pushvalue(L, -2);
+        lua_rawget(L, t);
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            lua_pushvalue(L, -2);
+            lua_insert(L, -2);
+            lua_rawset(L, t);
+        } else {
+            lua_pop(L, 2);
+        }
+    }
+}
+
+static int reset_state(lua_State *L) {
+    int snapshot, metatables;
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &snapshot_key);
+    snapshot = lua_gettop(L);
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &metatables_key);
+    metatables = lua_gettop(L);
+    if (!lua_istable(L, snapshot) || !lua_istable(L, metatables))
+        return luaL_error(L, "state has no pool snapshot");
+
+    lua_pushnil(L);
+    while (lua_next(L, snapshot)) {
+        int t = lua_gettop(L) - 1, copy = lua_gettop(L);
+        restore_table(L, t, copy);
+        lua_pushvalue(L, t);
+        lua_rawget(L, metatables);
+        lua_setmetatable(L, t);
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+/* ---- states ---- */
+
+static int run_init(lua_State *L) {
+    luaenv_pool *pool = (luaenv_pool *)lua_touserdata(L, 1);
+    lua_settop(L, 0);
+    luaL_openlibs(L);
+    if (pool->config.init && pool->config.init(L, pool->config.init_ud) != 0)
+        return luaL_error(L, "pool initialiser failed");
+    lua_settop(L, 0);
+    return take_snapshot(L);
+}
+
+static lua_State *new_state(luaenv_pool *pool) {
+    lua_State *L = luaL_newstate();
+    if (!L) return NULL;
+    lua_pushcfunction(L, run_init);
+    lua_pushlightuserdata(L, pool);
+    if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+        lua_close(L);
+        return NULL;
+    }
+    atomic_add(&pool->created, 1);
+    return L;
+}
+
+/* Take one of the high_watermark idle slots; 0 when the pool is full */
+static int reserve_idle(luaenv_pool *pool) {
+    pool_atomic idle;
+    do {
+        idle = atomic_get(&pool->idle);
+        if (idle >= pool->config.high_watermark) return 0;
+    } while (!atomic_cas(&pool->idle, idle, idle + 1));
+    return 1;
+}
+
+/* Store a state in a shard under its lock; 0 when the shard is full */
+static int store_state(shard *s, lua_State *L) {
+    if (s->count >= s->capacity) return 0;
+    s->states[s->count++] = L;
+    return 1;
+}
+
+/* Close a state that has a reserved idle slot but no room in its shard */
+static void trim_state(luaenv_pool *pool, lua_State *L) {
+    atomic_add(&pool->idle, -1);
+    atomic_add(&pool->trimmed, 1);
+    lua_close(L);
+}
+
+static lua_State *pop_state(shard *s) {
+    return s->count ? s->states[--s->count] : NULL;
+}
+
+/* Add a new idle state (pre-warming and refills); 0 when none could be made */
+static int add_idle_state(luaenv_pool *pool) {
+    lua_State *L;
+    shard *target;
+    int stored;
+    /* A checkin may have filled the pool since the caller looked: nothing to add */
+    if (!reserve_idle(pool)) return 1;
+    L = new_state(pool);
+    if (!L) {
+        atomic_add(&pool->idle, -1);
+        return 0;
+    }
+    target = &pool->shards[(int)(atomic_add(&pool->next_refill, 1) & 0x7fffffff) % pool->config.shards];
+    mutex_lock(&target->lock);
+    stored = store_state(target, L);
+    mutex_unlock(&target->lock);
+    if (!stored) trim_state(pool, L);
+    return 1;
+}
+
+/* ---- maintenance thread ---- */
+
+static void maintain(luaenv_pool *pool) {
+    mutex_lock(&pool->maint_lock);
+    for (;;) {
+        while (!pool->stopping && atomic_get(&pool->idle) >= pool->config.low_watermark)
+            cond_wait(&pool->maint_wake, &pool->maint_lock);
+        if (pool->stopping) break;
+        mutex_unlock(&pool->maint_lock);
+        if (!add_idle_state(pool)) {
+            /* Out of memory or a failing initialiser: wait for the next checkout */
+            mutex_lock(&pool->maint_lock);
+            if (!pool->stopping) cond_wait(&pool->maint_wake, &pool->maint_lock);
+            continue;
+        }
+        mutex_lock(&pool->maint_lock);
+    }
+    mutex_unlock(&pool->maint_lock);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI maint_main(LPVOID arg) { maintain((luaenv_pool *)arg); return 0; }
+#else
+static void *maint_main(void *arg) { maintain((luaenv_pool *)arg); return NULL; }
+#endif
+
+static void wake_maintenance(luaenv_pool *pool) {
+    mutex_lock(&pool->maint_lock);
+    cond_signal(&pool->maint_wake);
+    mutex_unlock(&pool->maint_lock);
+}
+
+static int default_shards(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+/* ---- public API ---- */
+
+luaenv_pool *luaenv_pool_create(const luaenv_pool_config *config) {
+    luaenv_pool *pool = (luaenv_pool *)calloc(1, sizeof(luaenv_pool));
+    int i;
+    if (!pool) return NULL;
+    if (config) pool->config = *config;
+    if (pool->config.low_watermark < 0) pool->config.low_watermark = 0;
+    if (pool->config.high_watermark <= 0) pool->config.high_watermark = DEFAULT_HIGH_WATERMARK;
+    if (pool->config.high_watermark < pool->config.low_watermark)
+        pool->config.high_watermark = pool->config.low_watermark;
+    if (pool->config.shards <= 0) pool->config.shards = default_shards();
+
+    pool->shards = (shard *)calloc((size_t)pool->config.shards, sizeof(shard));
+    if (!pool->shards) { free(pool); return NULL; }
+    for (i = 0; i < pool->config.shards; i++) {
+        mutex_init(&pool->shards[i].lock);
+        /* Any shard may end up holding every idle state */
+        pool->shards[i].states = (lua_State **)calloc((size_t)pool->config.high_watermark, sizeof(lua_State *));
+        if (!pool->shards[i].states) {
+            pool->config.shards = i + 1;
+            luaenv_pool_destroy(pool);
+            return NULL;
+        }
+        pool->shards[i].capacity = pool->config.high_watermark;
+    }
+    mutex_init(&pool->maint_lock);
+    cond_init(&pool->maint_wake);
+
+    for (i = 0; i < pool->config.low_watermark; i++) {
+        if (!add_idle_state(pool)) {
+            luaenv_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    if (pool->config.low_watermark > 0) {
+#ifdef _WIN32
+        pool->maint_thread = CreateThread(NULL, 0, maint_main, pool, 0, NULL);
+        pool->maint_running = pool->maint_thread != NULL;
+#else
+        pool->maint_running = pthread_create(&pool->maint_thread, NULL, maint_main, pool) == 0;
+#endif
+    }
+    return pool;
+}
+
+void luaenv_pool_destroy(luaenv_pool *pool) {
+    int i;
+    lua_State *L;
+    if (!pool) return;
+
+    if (pool->maint_running) {
+        mutex_lock(&pool->maint_lock);
+        pool->stopping = 1;
+        cond_signal(&pool->maint_wake);
+        mutex_unlock(&pool->maint_lock);
+#ifdef _WIN32
+        WaitForSingleObject(pool->maint_thread, INFINITE);
+        CloseHandle(pool->maint_thread);
+#else
+        pthread_join(pool->maint_thread, NULL);
+#endif
+    }
+
+    for (i = 0; i < pool->config.shards; i++) {
+        shard *s = &pool->shards[i];
+        if (s->states) {
+            while ((L = pop_state(s)) != NULL) lua_close(L);
+            free(s->states);
+        }
+        mutex_destroy(&s->lock);
+    }
+    mutex_destroy(&pool->maint_lock);
+    cond_destroy(&pool->maint_wake);
+    free(pool->shards);
+    free(pool);
+}
+
+lua_State *luaenv_pool_checkout(luaenv_pool *pool) {
+    shard *home = home_shard(pool);
+    int shards = pool->config.shards;
+    int start = (int)(home - pool->shards);
+    lua_State *L;
+    int pass, i;
+
+    mutex_lock(&home->lock);
+    L = pop_state(home);
+    if (L) {
+        home->checkouts++;
+        home->local_hits++;
+    }
+    mutex_unlock(&home->lock);
+
+    /* Steal: first without waiting on busy shards, then waiting while states are idle */
+    for (pass = 0; !L && pass < 2 && atomic_get(&pool->idle) > 0; pass++) {
+        for (i = 1; i < shards && !L; i++) {
+            shard *victim = &pool->shards[(start + i) % shards];
+            if (pass == 0) {
+                if (!mutex_trylock(&victim->lock)) continue;
+            } else {
+                mutex_lock(&victim->lock);
+            }
+            L = pop_state(victim);
+            if (L) {
+                victim->checkouts++;
+                victim->steals++;
+            }
+            mutex_unlock(&victim->lock);
+        }
+    }
+
+    if (L) {
+        if (atomic_add(&pool->idle, -1) < pool->config.low_watermark && pool->maint_running)
+            wake_maintenance(pool);
+        return L;
+    }
+
+    atomic_add(&pool->misses, 1);
+    if (pool->maint_running) wake_maintenance(pool);
+    return new_state(pool);
+}
+
+int luaenv_pool_checkin(luaenv_pool *pool, lua_State *L) {
+    shard *home;
+    int stored;
+    lua_settop(L, 0);
+    lua_pushcfunction(L, reset_state);
+    if (lua_status(L) != LUA_OK || lua_pcall(L, 0, 0, 0) != LUA_OK) {
+        luaenv_pool_discard(pool, L);
+        return 0;
+    }
+
+    if (!reserve_idle(pool)) {
+        atomic_add(&pool->trimmed, 1);
+        lua_close(L);
+        return 1;
+    }
+    home = home_shard(pool);
+    mutex_lock(&home->lock);
+    stored = store_state(home, L);
+    if (stored) home->resets++;
+    mutex_unlock(&home->lock);
+    if (!stored) trim_state(pool, L);
+    return 1;
+}
+
+void luaenv_pool_discard(luaenv_pool *pool, lua_State *L) {
+    atomic_add(&pool->discarded, 1);
+    lua_close(L);
+}
+
+void luaenv_pool_get_stats(luaenv_pool *pool, luaenv_pool_stats *stats) {
+    int i;
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < pool->config.shards; i++) {
+        shard *s = &pool->shards[i];
+        mutex_lock(&s->lock);
+        stats->checkouts += s->checkouts;
+        stats->local_hits += s->local_hits;
+        stats->steals += s->steals;
+        stats->resets += s->resets;
+        stats->idle += (size_t)s->count;
+        mutex_unlock(&s->lock);
+    }
+    stats->created = (size_t)atomic_get(&pool->created);
+    stats->misses = (size_t)atomic_get(&pool->misses);
+    stats->checkouts += stats->misses;
+    stats->discarded = (size_t)atomic_get(&pool->discarded);
+    stats->trimmed = (size_t)atomic_get(&pool->trimmed);
+}
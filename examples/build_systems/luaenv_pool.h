@@ -0,0 +1,85 @@
+/*
+ * luaenv_pool.h - pool of pre-warmed lua_States for multithreaded hosts
+ *
+ * Creating a state, opening the libraries and loading a prelude usually costs
+ * more than the request the state is created for. The pool keeps initialised
+ * states and recycles them:
+ *
+ *   - luaenv_pool_checkout hands out an idle state. Each thread has a home
+ *     shard (its own lock and stack of states); when the home shard is empty
+ *     the thread steals from the others before creating a new state.
+ *   - luaenv_pool_checkin resets the state and returns it to the caller's home
+ *     shard. The reset only restores what initialisation left behind: the
+ *     globals, the library tables they hold (one level deep), their
+ *     metatables and package.loaded. Remaining garbage is left to the GC.
+ *   - At most high_watermark states are kept idle; extra ones are closed. A
+ *     maintenance thread keeps at least low_watermark states ready.
+ *
+ * A state must be checked in by a thread of the same process, but not
+ * necessarily the one that checked it out. States the reset cannot vouch for
+ * (for instance after a memory error) should be discarded instead.
+ *
+ * This is free and unencumbered software released into the public domain.
+ */
+
+#ifndef LUAENV_POOL_H
+#define LUAENV_POOL_H
+
+#include <stddef.h>
+#include <lua.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Initialiser run once per new state after luaL_openlibs, for instance to load
+ * a prelude. Returns 0 on success; the state is discarded otherwise.
+ */
+typedef int (*luaenv_pool_init_fn)(lua_State *L, void *ud);
+
+typedef struct luaenv_pool_config {
+    int low_watermark;        /* idle states kept ready (default 0) */
+    int high_watermark;       /* most idle states kept (default 64) */
+    int shards;               /* per-thread stacks (default: number of CPUs) */
+    luaenv_pool_init_fn init; /* optional prelude loader */
+    void *init_ud;            /* passed to init */
+} luaenv_pool_config;
+
+typedef struct luaenv_pool_stats {
+    size_t checkouts;     /* states handed out */
+    size_t local_hits;    /* ... taken from the caller's home shard */
+    size_t steals;        /* ... taken from another shard */
+    size_t created;       /* states created (pre-warming, refills and misses) */
+    size_t misses;        /* checkouts that had to create a state */
+    size_t resets;        /* successful check-ins */
+    size_t discarded;     /* states closed by discard or a failed reset */
+    size_t trimmed;       /* states closed above the high watermark */
+    size_t idle;          /* states currently idle */
+} luaenv_pool_stats;
+
+typedef struct luaenv_pool luaenv_pool;
+
+/* Create a pool and pre-warm low_watermark states (NULL on failure; config may be NULL) */
+luaenv_pool *luaenv_pool_create(const luaenv_pool_config *config);
+
+/* Close every idle state and free the pool (all states must be checked in) */
+void luaenv_pool_destroy(luaenv_pool *pool);
+
+/* An initialised state for the calling thread (NULL when a new one cannot be created) */
+lua_State *luaenv_pool_checkout(luaenv_pool *pool);
+
+/* Reset a state and make it available again; returns 0 if it had to be discarded */
+int luaenv_pool_checkin(luaenv_pool *pool, lua_State *L);
+
+/* Close a checked-out state instead of recycling it */
+void luaenv_pool_discard(luaenv_pool *pool, lua_State *L);
+
+/* Copy the counters of the pool into stats */
+void luaenv_pool_get_stats(luaenv_pool *pool, luaenv_pool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LUAENV_POOL_H */
@@ -0,0 +1,245 @@
+/*
+ * pool_bench.c - request throughput with fresh states vs luaenv_pool
+ *
+ * A "request" runs a short script in a state whose prelude defines a handler.
+ * Two ways of getting that state are compared at 1, 2, 4, ... up to --threads
+ * threads:
+ *
+ *   fresh  luaL_newstate, luaL_openlibs, prelude, request, lua_close
+ *   pool   luaenv_pool_checkout, request, luaenv_pool_checkin
+ *
+ * The request leaves a global and a field in the string library behind and
+ * asserts they are gone, so a broken reset fails the run. Build it against a
+ * static and a DLL installation (see pool_bench.ps1) to compare /MT and /MD.
+ *
+ * Usage: pool_bench [--requests N] [--threads N] [--label TEXT] [--csv]
+ *
+ * This is free and unencumbered software released into the public domain.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+#include "luaenv_pool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+static const char *prelude =
+    "local cache = {}\n"
+    "function handle(n)\n"
+    "  local parts = {}\n"
+    "  for i = 1, n do parts[#parts + 1] = string.format('%d:%s', i, cache[i % 8] or 'x') end\n"
+    "  return #table.concat(parts, ',')\n"
+    "end\n"
+    "for i = 0, 7 do cache[i] = string.rep('v', i) end\n";
+
+static const char *request =
+    "assert(leaked == nil and string.leaked == nil, 'state was not reset')\n"
+    "leaked, string.leaked = true, true\n"
+    "return handle(50)\n";
+
+enum mode { MODE_FRESH, MODE_POOL };
+static const char *mode_names[] = { "fresh", "pool" };
+
+typedef struct job {
+    enum mode mode;
+    luaenv_pool *pool;
+    int count;
+    int failed;
+} job;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+static int run_script(lua_State *L, const char *script) {
+    if (luaL_dostring(L, script)) {
+        fprintf(stderr, "Lua error: %s\n", lua_tostring(L, -1));
+        return 0;
+    }
+    lua_settop(L, 0);
+    return 1;
+}
+
+static int load_prelude(lua_State *L, void *ud) {
+    (void)ud;
+    return run_script(L, prelude) ? 0 : 1;
+}
+
+static void run_job(job *j) {
+    int i;
+    for (i = 0; i < j->count && !j->failed; i++) {
+        lua_State *L;
+        if (j->mode == MODE_FRESH) {
+            L = luaL_newstate();
+            if (!L) { j->failed = 1; break; }
+            luaL_openlibs(L);
+            if (load_prelude(L, NULL) != 0 || !run_script(L, request)) j->failed = 1;
+            lua_close(L);
+        } else {
+            L = luaenv_pool_checkout(j->pool);
+            if (!L) { j->failed = 1; break; }
+            if (!run_script(L, request)) {
+                j->failed = 1;
+                luaenv_pool_discard(j->pool, L);
+            } else {
+                luaenv_pool_checkin(j->pool, L);
+            }
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg) { run_job((job *)arg); return 0; }
+#else
+static void *thread_main(void *arg) { run_job((job *)arg); return NULL; }
+#endif
+
+/* Run count requests on each of nthreads threads; returns the wall time or -1 */
+static double run_parallel(enum mode mode, luaenv_pool *pool, int count, int nthreads) {
+    job *jobs = (job *)calloc((size_t)nthreads, sizeof(job));
+    double started, elapsed;
+    int i, failed = 0;
+#ifdef _WIN32
+    HANDLE *threads = (HANDLE *)calloc((size_t)nthreads, sizeof(HANDLE));
+#else
+    pthread_t *threads = (pthread_t *)calloc((size_t)nthreads, sizeof(pthread_t));
+#endif
+    if (!jobs || !threads) { free(jobs); free(threads); return -1; }
+
+    for (i = 0; i < nthreads; i++) {
+        jobs[i].mode = mode;
+        jobs[i].pool = pool;
+        jobs[i].count = count;
+    }
+
+    started = now_seconds();
+#ifdef _WIN32
+    for (i = 0; i < nthreads; i++)
+        threads[i] = CreateThread(NULL, 0, thread_main, &jobs[i], 0, NULL);
+    WaitForMultipleObjects((DWORD)nthreads, threads, TRUE, INFINITE);
+    for (i = 0; i < nthreads; i++) CloseHandle(threads[i]);
+#else
+    for (i = 0; i < nthreads; i++)
+        pthread_create(&threads[i], NULL, thread_main, &jobs[i]);
+    for (i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+#endif
+    elapsed = now_seconds() - started;
+
+    for (i = 0; i < nthreads; i++) failed |= jobs[i].failed;
+    free(jobs);
+    free(threads);
+    return failed ? -1 : elapsed;
+}
+
+static int parse_count(const char *value, const char *option) {
+    int n = atoi(value);
+    if (n < 1) {
+        fprintf(stderr, "%s must be a positive number\n", option);
+        exit(2);
+    }
+    return n;
+}
+
+static int next_count(int n, int max) {
+    return n < max && n * 2 > max ? max : n * 2;
+}
+
+int main(int argc, char **argv) {
+    int requests = 5000, max_threads = 8, csv = 0;
+    const char *label = "";
+    luaenv_pool_stats stats;
+    int i, nthreads;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            requests = parse_count(argv[++i], "--requests");
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            max_threads = parse_count(argv[++i], "--threads");
+        } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--requests N] [--threads N] [--label TEXT] [--csv]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (csv) {
+        printf("label,threads,mode,seconds,requests_per_second\n");
+    } else {
+        printf("%s%s%s, %d request(s) per thread\n\n", LUA_RELEASE, *label ? ", " : "", label, requests);
+        printf("%-8s %-6s %10s %14s %9s\n", "threads", "mode", "seconds", "requests/s", "speedup");
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    /* 1, 2, 4, ... and max_threads itself */
+    for (nthreads = 1; nthreads <= max_threads; nthreads = next_count(nthreads, max_threads)) {
+        double baseline = 0;
+        int m;
+        for (m = MODE_FRESH; m <= MODE_POOL; m++) {
+            luaenv_pool *pool = NULL;
+            double seconds;
+            if (m == MODE_POOL) {
+                luaenv_pool_config config;
+                memset(&config, 0, sizeof(config));
+                config.low_watermark = nthreads;
+                config.high_watermark = nthreads * 2;
+                config.init = load_prelude;
+                pool = luaenv_pool_create(&config);
+                if (!pool) {
+                    fprintf(stderr, "could not create the pool\n");
+                    return 1;
+                }
+            }
+            seconds = run_parallel((enum mode)m, pool, requests, nthreads);
+            if (pool) {
+                luaenv_pool_get_stats(pool, &stats);
+                luaenv_pool_destroy(pool);
+            }
+            if (seconds < 0) {
+                fprintf(stderr, "%s requests failed on %d thread(s)\n", mode_names[m], nthreads);
+                return 1;
+            }
+            if (m == MODE_FRESH) baseline = seconds;
+            if (csv) {
+                printf("%s,%d,%s,%.4f,%.0f\n", label, nthreads, mode_names[m], seconds,
+                       (double)requests * nthreads / seconds);
+            } else {
+                printf("%-8d %-6s %10.3f %14.0f %8.2fx\n", nthreads, mode_names[m], seconds,
+                       (double)requests * nthreads / seconds, seconds > 0 ? baseline / seconds : 0.0);
+            }
+        }
+    }
+
+    if (!csv) {
+        printf("\npool at %d thread(s): checkouts %zu (%zu local, %zu stolen, %zu misses),"
+               " created %zu, resets %zu, discarded %zu, trimmed %zu\n",
+               max_threads, stats.checkouts, stats.local_hits, stats.steals, stats.misses,
+               stats.created, stats.resets, stats.discarded, stats.trimmed);
+    }
+    return 0;
+}
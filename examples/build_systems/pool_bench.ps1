@@ -0,0 +1,89 @@
+#!/usr/bin/env pwsh
+# Build pool_bench against a static and a DLL installation of luaenv and
+# compare their request throughput side by side.
+#
+# Static installations compile the Lua library with the static CRT (/MT), DLL
+# installations with the DLL CRT (/MD); each benchmark is built with the CRT
+# of its installation, so the comparison includes the cost of the CRT heap.
+# Run from a Developer PowerShell (cl.exe on the PATH).
+#
+# Usage: .\pool_bench.ps1 -StaticAlias lua-static -DllAlias lua-dll [-Threads 8] [-Requests 5000]
+
+param(
+    [Parameter(Mandatory = $true)][string]$StaticAlias,
+    [Parameter(Mandatory = $true)][string]$DllAlias,
+    [int]$Threads = 8,
+    [int]$Requests = 5000
+)
+
+Write-Host "[pool_bench.ps1] Comparing '$StaticAlias' (static) with '$DllAlias' (DLL)..."
+
+function Get-LuaConfig([string]$alias) {
+    $config = @{}
+    luaconfig $alias --info --cflag --liblua --path --format env --path-style windows | ForEach-Object {
+        $name, $value = $_ -split '=', 2
+        $config[$name] = $value
+    }
+    if ($LASTEXITCODE -ne 0) {
+        Write-Host "[pool_bench.ps1] ERROR: luaconfig failed for '$alias'." -ForegroundColor Red
+        exit 1
+    }
+    return $config
+}
+
+# Build and run the benchmark for one installation; returns its CSV rows
+function Invoke-PoolBench([string]$alias, [string]$expectedType) {
+    $config = Get-LuaConfig $alias
+    if ($config["LUA_BUILD_TYPE"] -ne $expectedType) {
+        Write-Host "[pool_bench.ps1] ERROR: '$alias' is a $($config["LUA_BUILD_TYPE"]) installation, expected $expectedType." -ForegroundColor Red
+        exit 1
+    }
+
+    $crt = if ($expectedType -eq "dll") { "/MD" } else { "/MT" }
+    $outDir = Join-Path $PSScriptRoot "pool_bench_$expectedType"
+    New-Item -ItemType Directory -Force -Path $outDir | Out-Null
+    $exe = Join-Path $outDir "pool_bench.exe"
+
+    # Compile in the output directory so the object files of the two builds stay apart
+    $sources = "`"$PSScriptRoot\pool_bench.c`" `"$PSScriptRoot\luaenv_pool.c`""
+    $command = "cl.exe /nologo /Fe:pool_bench.exe /O2 $crt /I`"$PSScriptRoot`" $sources $($config["LUA_CFLAGS"]) /TC /W4 -D_CRT_SECURE_NO_WARNINGS /link `"$($config["LUA_LIBRARY"])`""
+    Write-Host "[pool_bench.ps1] Executing: $command"
+    Push-Location $outDir
+    Invoke-Expression $command | Out-Host
+    Pop-Location
+    if ($LASTEXITCODE -ne 0) {
+        Write-Host "[pool_bench.ps1] ERROR: Build failed for '$alias' with exit code $LASTEXITCODE." -ForegroundColor Red
+        exit 1
+    }
+
+    # DLL builds load lua54.dll from next to the executable
+    if ($expectedType -eq "dll" -and $config["LUA_DLL"]) {
+        Copy-Item $config["LUA_DLL"] $outDir -Force
+    }
+
+    $label = "$expectedType $crt $($config["LUA_VERSION"])"
+    $output = & $exe --threads $Threads --requests $Requests --label $label --csv
+    if ($LASTEXITCODE -ne 0) {
+        Write-Host "[pool_bench.ps1] ERROR: pool_bench failed for '$alias'." -ForegroundColor Red
+        exit 1
+    }
+    return $output | ConvertFrom-Csv
+}
+
+$static = Invoke-PoolBench $StaticAlias "static"
+$dll = Invoke-PoolBench $DllAlias "dll"
+
+$rows = foreach ($s in $static) {
+    $d = $dll | Where-Object { $_.threads -eq $s.threads -and $_.mode -eq $s.mode }
+    [PSCustomObject]@{
+        Threads        = [int]$s.threads
+        Mode           = $s.mode
+        "Static req/s" = [double]$s.requests_per_second
+        "DLL req/s"    = [double]$d.requests_per_second
+        "Static/DLL"   = "{0:N2}x" -f ([double]$s.requests_per_second / [double]$d.requests_per_second)
+    }
+}
+
+Write-Host ""
+Write-Host "$Requests request(s) per thread; static: $($static[0].label), DLL: $($dll[0].label)"
+$rows | Format-Table -AutoSize
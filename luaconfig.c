@@ -23,9 +23,31 @@
  * - CLI execution time (the main bottleneck)
  * - Cleanup operations time
  *
+ * RUNTIME TRACING:
+ * Release builds record the same phases when LUAENV_TRACE names a file:
+ *   set LUAENV_TRACE=%TEMP%\luaenv-trace.jsonl
+ * Each phase is appended as one JSON line (a Chrome trace "complete" event with
+ * microsecond timestamps since the Unix epoch). LUAENV_TRACE_ID is generated
+ * when unset and inherited by the CLI and the Python backend, which append
+ * their own spans to the same file, so one call can be followed across all
+ * three processes.
+ *
+ * FAST PATH:
+ * Queries made of --cflag, --lua-include, --liblua, --libdir and --path (any
+ * combination, with optional --path-style and --format) are answered from the
+ * answer cache that registry.py writes to %USERPROFILE%\.luaenv\cache\pkg-config
+ * on every registry change. The CLI is only spawned when the cache is missing, was
+ * built from another revision than registry.revision holds, or has no answer for the query.
+ *
+ * RESIDENT SERVER:
+ * On a cache miss the query is sent to a running "luaenv server" over the
+ * per-user pipe \\.\pipe\luaenv-cli-<user> before falling back to spawning
+ * the CLI. See cli\LuaEnv.Core\Server.fs for the protocol.
+ *
  * This code is part of the LuaEnv project, which provides a Lua environment for Windows.
  */
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,50 +56,201 @@
 #include <errno.h>
 
 
-#define CMD_BUFFER_SIZE 260
+// CreateProcess limit for lpCommandLine, including the terminating null
+#define CMD_MAX_LENGTH 32767
 
 #define CLI_RELATIVE_PATH "cli\\LuaEnv.CLI.exe"
 #define CONFIG_RELATIVE_PATH "backend.config"
 
+// Answer cache locations, relative to %USERPROFILE% (must match registry.py)
+#define REGISTRY_REVISION_RELATIVE_PATH ".luaenv\\registry.revision"
+#define ANSWER_CACHE_RELATIVE_PATH ".luaenv\\cache\\pkg-config"
+#define ANSWER_CACHE_MAGIC "LUAENV-PKGCONFIG 2"
+#define REVISION_SIZE 32
+#define ANSWER_KEY_SIZE 64
+
+// Resident server pipe, suffixed with the lower-case user name (must match Server.fs)
+#define SERVER_PIPE_PREFIX "\\\\.\\pipe\\luaenv-cli-"
+#define SERVER_REPLY_SIZE 65536
+#define SERVER_TIMEOUT_MS 100
+
+// Phase timing: TIMING_START/TIMING_END nest like a stack. Phases are written to
+// the LUAENV_TRACE file when tracing is enabled and printed to stderr in _DEBUG builds.
+#define TRACE_MAX_DEPTH 8
+#define TRACE_ID_SIZE 64
+#define TRACE_LINE_SIZE 512
+
+typedef struct {
+    const char *name;
+    long long startUs;
+} TimingSpan;
+
+static TimingSpan timingStack[TRACE_MAX_DEPTH];
+static int timingDepth = 0;
+static HANDLE traceFile = INVALID_HANDLE_VALUE;
+static char traceId[TRACE_ID_SIZE];
+
+// Microseconds since the Unix epoch, the clock shared with the CLI and Python spans
+static long long timing_now_us(void) {
+    FILETIME now;
+    ULARGE_INTEGER ticks;
+
+    GetSystemTimePreciseAsFileTime(&now);
+    ticks.LowPart = now.dwLowDateTime;
+    ticks.HighPart = now.dwHighDateTime;
+    return (long long)((ticks.QuadPart - 116444736000000000ULL) / 10);
+}
+
+// Trace IDs end up in JSON and file names, keep them to a safe alphabet
+static int is_valid_trace_id(const char *id) {
+    if (id[0] == '\0') return 0;
+    for (; *id != '\0'; id++) {
+        if (!isalnum((unsigned char)*id) && *id != '-' && *id != '_' && *id != '.') return 0;
+    }
+    return 1;
+}
+
+static void timing_init(void) {
+    char tracePath[MAX_PATH];
+    DWORD length;
+
+    length = GetEnvironmentVariableA("LUAENV_TRACE", tracePath, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return;
+    }
+
+    // Shared append handle: the CLI and Python append to the same file while we run
+    traceFile = CreateFileA(tracePath, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (traceFile == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    length = GetEnvironmentVariableA("LUAENV_TRACE_ID", traceId, TRACE_ID_SIZE);
+    if (length == 0 || length >= TRACE_ID_SIZE || !is_valid_trace_id(traceId)) {
+        _snprintf_s(traceId, TRACE_ID_SIZE, _TRUNCATE, "%08lx%012llx", GetCurrentProcessId(), timing_now_us());
+        SetEnvironmentVariableA("LUAENV_TRACE_ID", traceId); // Inherited by the CLI
+    }
+}
+
+static void timing_start(const char *name) {
+    if (timingDepth < TRACE_MAX_DEPTH) {
+        timingStack[timingDepth].name = name;
+        timingStack[timingDepth].startUs = timing_now_us();
+    }
+    timingDepth++;
 #ifdef _DEBUG
-// Timing diagnostic macros - only active when _DEBUG is defined
-#define TIMING_DECLARE_VARS() \
-    LARGE_INTEGER timing_freq, timing_start, timing_current; \
-    QueryPerformanceFrequency(&timing_freq);
+    fprintf(stderr, "[TIMING] Starting %s...\n", name);
+#endif
+}
 
-#define TIMING_START(name) \
-    do { \
-        QueryPerformanceCounter(&timing_start); \
-        fprintf(stderr, "[TIMING] Starting %s...\n", name); \
-    } while(0)
+static void timing_end(void) {
+    TimingSpan *span;
+    long long durationUs;
 
-#define TIMING_END(name) \
-    do { \
-        QueryPerformanceCounter(&timing_current); \
-        double elapsed = (double)(timing_current.QuadPart - timing_start.QuadPart) / timing_freq.QuadPart * 1000.0; \
-        fprintf(stderr, "[TIMING] %s completed in %.2f ms\n", name, elapsed); \
-    } while(0)
+    if (timingDepth == 0) return;
+    timingDepth--;
+    if (timingDepth >= TRACE_MAX_DEPTH) return;
 
-#define TIMING_POINT(description) \
-    do { \
-        QueryPerformanceCounter(&timing_current); \
-        double elapsed = (double)(timing_current.QuadPart - timing_start.QuadPart) / timing_freq.QuadPart * 1000.0; \
-        fprintf(stderr, "[TIMING] %s: %.2f ms elapsed\n", description, elapsed); \
-    } while(0)
+    span = &timingStack[timingDepth];
+    durationUs = timing_now_us() - span->startUs;
+
+#ifdef _DEBUG
+    fprintf(stderr, "[TIMING] %s completed in %.2f ms\n", span->name, durationUs / 1000.0);
+#endif
 
-#define TIMING_RESET() \
+    if (traceFile != INVALID_HANDLE_VALUE) {
+        char line[TRACE_LINE_SIZE];
+        DWORD written;
+        int length = _snprintf_s(line, sizeof(line), _TRUNCATE,
+            "{\"name\":\"%s\",\"cat\":\"luaconfig\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,"
+            "\"pid\":%lu,\"tid\":%lu,\"args\":{\"trace_id\":\"%s\"}}\n",
+            span->name, span->startUs, durationUs, GetCurrentProcessId(), GetCurrentThreadId(), traceId);
+        if (length > 0) {
+            // One WriteFile per event; FILE_APPEND_DATA keeps concurrent writers line-atomic
+            WriteFile(traceFile, line, (DWORD)length, &written, NULL);
+        }
+    }
+}
+
+#define TIMING_DECLARE_VARS() timing_init()
+#define TIMING_START(name) timing_start(name)
+#define TIMING_END(name) timing_end()
+
+#ifdef _DEBUG
+#define TIMING_POINT(description) \
     do { \
-        QueryPerformanceCounter(&timing_start); \
+        if (timingDepth > 0 && timingDepth <= TRACE_MAX_DEPTH) \
+            fprintf(stderr, "[TIMING] %s: %.2f ms elapsed\n", description, \
+                    (timing_now_us() - timingStack[timingDepth - 1].startUs) / 1000.0); \
     } while(0)
 #else
-// Empty macros when not in debug mode
-#define TIMING_DECLARE_VARS() do {} while(0)
-#define TIMING_START(name) do {} while(0)
-#define TIMING_END(name) do {} while(0)
 #define TIMING_POINT(description) do {} while(0)
-#define TIMING_RESET() do {} while(0)
 #endif
 
+// Hand our standard handles to the CLI so its output streams straight to our caller.
+// handles receives the distinct standard handles and must outlive CreateProcess;
+// *listOut restricts inheritance to them (PROC_THREAD_ATTRIBUTE_HANDLE_LIST) and
+// is freed with free_inherited_handles. Should the list not be built, *listOut is
+// NULL and every inheritable handle is passed on. Returns the number of handles.
+static int inherit_standard_handles(STARTUPINFOEXA *si, HANDLE handles[3], LPPROC_THREAD_ATTRIBUTE_LIST *listOut) {
+    HANDLE *targets[3];
+    const DWORD ids[3] = { STD_INPUT_HANDLE, STD_OUTPUT_HANDLE, STD_ERROR_HANDLE };
+    LPPROC_THREAD_ATTRIBUTE_LIST attributes;
+    SIZE_T attributesSize = 0;
+    int i, j, count = 0;
+
+    targets[0] = &si->StartupInfo.hStdInput;
+    targets[1] = &si->StartupInfo.hStdOutput;
+    targets[2] = &si->StartupInfo.hStdError;
+
+    for (i = 0; i < 3; i++) {
+        HANDLE handle = GetStdHandle(ids[i]);
+        if (handle == INVALID_HANDLE_VALUE) handle = NULL;
+        if (handle != NULL) {
+            // Handles redirected by our parent are not necessarily inheritable
+            SetHandleInformation(handle, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
+            // stdout and stderr are often the same handle; the list rejects duplicates
+            for (j = 0; j < count && handles[j] != handle; j++);
+            if (j == count) handles[count++] = handle;
+        }
+        *targets[i] = handle;
+    }
+
+    si->StartupInfo.cb = sizeof(*si);
+    si->StartupInfo.dwFlags |= STARTF_USESTDHANDLES;
+
+    *listOut = NULL;
+    if (count == 0) {
+        return 0;
+    }
+    InitializeProcThreadAttributeList(NULL, 1, 0, &attributesSize);
+    attributes = (LPPROC_THREAD_ATTRIBUTE_LIST)malloc(attributesSize);
+    if (attributes == NULL) {
+        return count;
+    }
+    if (!InitializeProcThreadAttributeList(attributes, 1, 0, &attributesSize)) {
+        free(attributes);
+        return count;
+    }
+    if (!UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
+                                   handles, count * sizeof(HANDLE), NULL, NULL)) {
+        DeleteProcThreadAttributeList(attributes);
+        free(attributes);
+        return count;
+    }
+    si->lpAttributeList = attributes;
+    *listOut = attributes;
+    return count;
+}
+
+static void free_inherited_handles(LPPROC_THREAD_ATTRIBUTE_LIST attributes) {
+    if (attributes != NULL) {
+        DeleteProcThreadAttributeList(attributes);
+        free(attributes);
+    }
+}
+
 // Simplified cleanup function for handles only
 void cleanup_handles(HANDLE hProcess, HANDLE hThread, HANDLE hCliFile, HANDLE hConfigFile) {
     if (hProcess) CloseHandle(hProcess);
@@ -86,6 +259,464 @@ void cleanup_handles(HANDLE hProcess, HANDLE hThread, HANDLE hCliFile, HANDLE hC
     if (hConfigFile && hConfigFile != INVALID_HANDLE_VALUE) CloseHandle(hConfigFile);
 }
 
+// Read a whole file into a NUL-terminated heap buffer; caller frees
+static char *read_whole_file(const char *path, size_t *size) {
+    HANDLE hFile;
+    LARGE_INTEGER fileSize;
+    DWORD bytesRead;
+    char *buffer;
+
+    hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart > 16 * 1024 * 1024) {
+        CloseHandle(hFile);
+        return NULL;
+    }
+
+    buffer = (char *)malloc((size_t)fileSize.QuadPart + 1);
+    if (buffer == NULL) {
+        CloseHandle(hFile);
+        return NULL;
+    }
+
+    if (!ReadFile(hFile, buffer, (DWORD)fileSize.QuadPart, &bytesRead, NULL) || bytesRead != (DWORD)fileSize.QuadPart) {
+        free(buffer);
+        CloseHandle(hFile);
+        return NULL;
+    }
+    CloseHandle(hFile);
+
+    buffer[bytesRead] = '\0';
+    *size = bytesRead;
+    return buffer;
+}
+
+// Return the start of the line after `line`, or NULL at end of buffer
+static char *next_line(char *line, const char *end) {
+    char *newline = (char *)memchr(line, '\n', (size_t)(end - line));
+    return (newline != NULL && newline + 1 < end) ? newline + 1 : NULL;
+}
+
+// Check that a cache file starts with the expected magic header line
+static int has_cache_magic(const char *buffer, size_t size) {
+    size_t magicLength = strlen(ANSWER_CACHE_MAGIC);
+    return size > magicLength && strncmp(buffer, ANSWER_CACHE_MAGIC, magicLength) == 0 &&
+           (buffer[magicLength] == '\n' || buffer[magicLength] == '\r');
+}
+
+// Read the current registry revision ("revision <n>") from registry.revision
+static int read_registry_revision(const char *revisionPath, char *lineOut, size_t lineSize) {
+    size_t size, length;
+    char *buffer = read_whole_file(revisionPath, &size);
+
+    if (buffer == NULL) {
+        return 0;
+    }
+    for (length = size; length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == '\r' ||
+                                        buffer[length - 1] == ' '); length--);
+    // Empty while a writer rewrites it: let the CLI answer
+    if (length == 0 || _snprintf_s(lineOut, lineSize, _TRUNCATE, "revision %.*s", (int)length, buffer) < 0) {
+        free(buffer);
+        return 0;
+    }
+    free(buffer);
+    return 1;
+}
+
+// Map "<alias|uuid>" to a full installation ID using the cache index, which must
+// have been built from the revision in revisionLine
+static int resolve_cached_installation(const char *indexPath, const char *revisionLine, const char *installation,
+                                       char *idOut, size_t idSize) {
+    size_t size, nameLength = strlen(installation), revisionLength = strlen(revisionLine);
+    char *buffer, *line, *end;
+    int found = 0;
+
+    buffer = read_whole_file(indexPath, &size);
+    if (buffer == NULL) {
+        return 0;
+    }
+
+    end = buffer + size;
+    line = has_cache_magic(buffer, size) ? next_line(buffer, end) : NULL;
+    if (line != NULL && (size_t)(end - line) > revisionLength && strncmp(line, revisionLine, revisionLength) == 0 &&
+        (line[revisionLength] == '\n' || line[revisionLength] == '\r')) {
+        // Lines are "<name>=<uuid>"; aliases may contain '=' so split on the last one
+        for (line = next_line(line, end); line != NULL && !found; line = next_line(line, end)) {
+            char *lineEnd = (char *)memchr(line, '\n', (size_t)(end - line));
+            char *separator;
+            if (lineEnd == NULL) lineEnd = end;
+            if (lineEnd > line && lineEnd[-1] == '\r') lineEnd--;
+
+            for (separator = lineEnd - 1; separator > line && *separator != '='; separator--);
+            if (separator <= line || (size_t)(separator - line) != nameLength ||
+                strncmp(line, installation, nameLength) != 0) {
+                continue;
+            }
+
+            if ((size_t)(lineEnd - separator - 1) < idSize) {
+                memcpy(idOut, separator + 1, (size_t)(lineEnd - separator - 1));
+                idOut[lineEnd - separator - 1] = '\0';
+                found = 1;
+            }
+        }
+    }
+
+    free(buffer);
+    return found;
+}
+
+// Load an answers file and return a pointer to its first "@<key> <length>" record
+static char *load_cached_answers(const char *answersPath, size_t *size, char **records) {
+    char *buffer, *line, *end;
+
+    buffer = read_whole_file(answersPath, size);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    end = buffer + *size;
+
+    // Header lines: magic, id=<uuid>, prefix=<installation path>
+    line = has_cache_magic(buffer, *size) ? next_line(buffer, end) : NULL;
+    while (line != NULL && line[0] != '@') {
+        if (strncmp(line, "prefix=", 7) == 0) {
+            char prefix[MAX_PATH];
+            char *lineEnd = (char *)memchr(line, '\n', (size_t)(end - line));
+            size_t prefixLength = (lineEnd != NULL ? (size_t)(lineEnd - line) : (size_t)(end - line)) - 7;
+            DWORD attributes;
+
+            if (prefixLength > 0 && line[7 + prefixLength - 1] == '\r') prefixLength--;
+            if (prefixLength >= sizeof(prefix)) {
+                line = NULL;
+                break;
+            }
+            memcpy(prefix, line + 7, prefixLength);
+            prefix[prefixLength] = '\0';
+
+            // Installation removed behind the registry's back: the CLI reports it
+            attributes = GetFileAttributesA(prefix);
+            if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                line = NULL;
+                break;
+            }
+        }
+        line = next_line(line, end);
+    }
+
+    if (line == NULL) {
+        free(buffer);
+        return NULL;
+    }
+
+    *records = line;
+    return buffer;
+}
+
+// Find the payload of the record named key; records must point into a loaded answers file
+static int find_cached_record(char *records, const char *end, const char *key, const char **payloadOut, size_t *lengthOut) {
+    size_t keyLength = strlen(key);
+    char *line = records;
+
+    while (line != NULL && line < end && line[0] == '@') {
+        char *headerEnd = (char *)memchr(line, '\n', (size_t)(end - line));
+        char *separator, *payload;
+        unsigned long length;
+
+        if (headerEnd == NULL) break;
+        separator = (char *)memchr(line, ' ', (size_t)(headerEnd - line));
+        if (separator == NULL) break;
+
+        length = strtoul(separator + 1, NULL, 10);
+        payload = headerEnd + 1;
+        if ((size_t)(end - payload) < length) {
+            break; // Truncated file, let the CLI answer
+        }
+
+        if ((size_t)(separator - line - 1) == keyLength && strncmp(line + 1, key, keyLength) == 0) {
+            *payloadOut = payload;
+            *lengthOut = length;
+            return 1;
+        }
+
+        // Skip the payload and the newline that terminates the record
+        line = payload + length + 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Answer a query from the answer cache. Any combination of the query flags is
+ * supported, printed in the same fixed order as pkg_config.py, optionally as a
+ * --format cmake|json|env block. Every record is looked up before anything is
+ * printed so a partial answer never reaches stdout.
+ * Returns the process exit code, or -1 when the CLI has to handle the request.
+ */
+static int try_cached_answer(int argc, char *argv[]) {
+    // Canonical output order (mirrors FORMAT_GROUPS in pkg_config.py)
+    static const char *queries[] = { "cflag", "lua-include", "liblua", "libdir", "path" };
+    const int queryCount = (int)(sizeof(queries) / sizeof(queries[0]));
+    const char *installation = NULL;
+    const char *pathStyle = "native";
+    const char *format = NULL;
+    const char *payloads[6];
+    size_t lengths[6];
+    char homeDir[MAX_PATH];
+    char revisionPath[MAX_PATH];
+    char revisionLine[REVISION_SIZE];
+    char indexPath[MAX_PATH];
+    char answersPath[MAX_PATH];
+    char installationId[MAX_PATH];
+    char key[ANSWER_KEY_SIZE];
+    char *buffer, *records;
+    size_t size;
+    unsigned int selected = 0;
+    int recordCount = 0;
+    DWORD homeLength;
+    int i, q;
+
+    for (i = 1; i < argc; i++) {
+        for (q = 0; q < queryCount; q++) {
+            if (argv[i][0] == '-' && argv[i][1] == '-' && strcmp(argv[i] + 2, queries[q]) == 0) break;
+        }
+
+        if (q < queryCount) {
+            selected |= 1u << q;
+        } else if (strcmp(argv[i], "--path-style") == 0 && i + 1 < argc) {
+            pathStyle = argv[++i];
+            if (strcmp(pathStyle, "native") != 0 && strcmp(pathStyle, "windows") != 0 &&
+                strcmp(pathStyle, "unix") != 0) {
+                return -1; // Let the CLI report the invalid style
+            }
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = argv[++i];
+            if (strcmp(format, "cmake") != 0 && strcmp(format, "json") != 0 &&
+                strcmp(format, "env") != 0) {
+                return -1; // Let the CLI report the invalid format
+            }
+        } else if (argv[i][0] != '-' && installation == NULL) {
+            installation = argv[i];
+        } else {
+            return -1;
+        }
+    }
+
+    // Without a flag or a format the CLI prints the full report
+    if (installation == NULL || (selected == 0 && format == NULL)) {
+        return -1;
+    }
+
+    homeLength = GetEnvironmentVariableA("USERPROFILE", homeDir, MAX_PATH);
+    if (homeLength == 0 || homeLength >= MAX_PATH) {
+        return -1;
+    }
+
+    if (_snprintf_s(revisionPath, MAX_PATH, _TRUNCATE, "%s\\%s", homeDir, REGISTRY_REVISION_RELATIVE_PATH) < 0 ||
+        _snprintf_s(indexPath, MAX_PATH, _TRUNCATE, "%s\\%s\\index", homeDir, ANSWER_CACHE_RELATIVE_PATH) < 0) {
+        return -1;
+    }
+
+    if (!read_registry_revision(revisionPath, revisionLine, sizeof(revisionLine))) {
+        return -1;
+    }
+
+    if (!resolve_cached_installation(indexPath, revisionLine, installation, installationId, sizeof(installationId))) {
+        return -1; // Partial UUIDs and unknown names go through the CLI
+    }
+
+    if (_snprintf_s(answersPath, MAX_PATH, _TRUNCATE, "%s\\%s\\%s.answers", homeDir, ANSWER_CACHE_RELATIVE_PATH, installationId) < 0) {
+        return -1;
+    }
+
+    buffer = load_cached_answers(answersPath, &size, &records);
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    // The "info" group only appears when every variable is requested
+    for (q = (format != NULL && selected == 0) ? -1 : 0; q < queryCount; q++) {
+        int found;
+
+        if (q >= 0 && selected != 0 && !(selected & (1u << q))) continue;
+
+        if (format != NULL) {
+            found = _snprintf_s(key, sizeof(key), _TRUNCATE, "%s.%s.%s", format, q < 0 ? "info" : queries[q], pathStyle) >= 0;
+        } else {
+            found = _snprintf_s(key, sizeof(key), _TRUNCATE, "%s.%s", queries[q], pathStyle) >= 0;
+        }
+
+        if (!found || !find_cached_record(records, buffer + size, key, &payloads[recordCount], &lengths[recordCount])) {
+            free(buffer);
+            return -1;
+        }
+        recordCount++;
+    }
+
+    // stdout is in text mode, so "\n" is expanded exactly as Python's print() does
+    if (format != NULL && strcmp(format, "json") == 0) fputs("{\n", stdout);
+    for (i = 0; i < recordCount; i++) {
+        if (i > 0 && format != NULL && strcmp(format, "json") == 0) fputs(",\n", stdout);
+        fwrite(payloads[i], 1, lengths[i], stdout);
+    }
+    if (format != NULL && strcmp(format, "json") == 0) fputs("\n}\n", stdout);
+    fflush(stdout);
+
+    free(buffer);
+    return 0;
+}
+
+/*
+ * Forward the query to a resident "luaenv server", if one is listening.
+ * Request: "pkg-config" and the arguments, one per line.
+ * Reply: "<exit code>\n<output>", or "-\n" when the CLI has to be spawned.
+ * Returns the process exit code, or -1 to fall back to spawning the CLI.
+ */
+static int try_server_answer(int argc, char *argv[]) {
+    char pipeName[MAX_PATH];
+    char userName[256];
+    char *request, *reply, *payload;
+    size_t requestLength = sizeof("pkg-config"), pos;
+    DWORD userLength, replyLength = 0;
+    int i, exitCode = -1;
+
+    userLength = GetEnvironmentVariableA("USERNAME", userName, sizeof(userName));
+    if (userLength == 0 || userLength >= sizeof(userName)) {
+        return -1;
+    }
+
+    for (i = 0; userName[i] != '\0'; i++) {
+        if ((unsigned char)userName[i] >= 0x80) return -1; // Casing rules would differ from .NET
+        userName[i] = (char)tolower((unsigned char)userName[i]);
+    }
+
+    if (_snprintf_s(pipeName, MAX_PATH, _TRUNCATE, "%s%s", SERVER_PIPE_PREFIX, userName) < 0) {
+        return -1;
+    }
+
+    // Arguments are sent as ASCII lines; anything else goes through the CLI
+    for (i = 1; i < argc; i++) {
+        const unsigned char *p;
+        for (p = (const unsigned char *)argv[i]; *p != '\0'; p++) {
+            if (*p == '\n' || *p >= 0x80) return -1;
+        }
+        requestLength += 1 + strlen(argv[i]);
+    }
+
+    request = (char *)malloc(requestLength);
+    reply = (char *)malloc(SERVER_REPLY_SIZE);
+    if (request == NULL || reply == NULL) {
+        free(request);
+        free(reply);
+        return -1;
+    }
+
+    memcpy(request, "pkg-config", sizeof("pkg-config") - 1);
+    pos = sizeof("pkg-config") - 1;
+    for (i = 1; i < argc; i++) {
+        size_t length = strlen(argv[i]);
+        request[pos++] = '\n';
+        memcpy(request + pos, argv[i], length);
+        pos += length;
+    }
+
+    // Fails at once when no server is running; a reply larger than the buffer falls back too
+    if (CallNamedPipeA(pipeName, request, (DWORD)pos, reply, SERVER_REPLY_SIZE, &replyLength, SERVER_TIMEOUT_MS)) {
+        payload = (char *)memchr(reply, '\n', replyLength);
+        if (payload != NULL && isdigit((unsigned char)reply[0])) {
+            exitCode = atoi(reply);
+            payload++;
+            // stdout is in text mode, so "\n" is expanded exactly as the CLI prints it
+            fwrite(payload, 1, (size_t)(reply + replyLength - payload), stdout);
+            fflush(stdout);
+        }
+    }
+
+    free(request);
+    free(reply);
+    return exitCode;
+}
+
+// Append one argument using the CommandLineToArgvW quoting rules
+static size_t append_quoted_argument(char *out, const char *argument) {
+    size_t pos = 0;
+    const char *p;
+
+    if (argument[0] != '\0' && strpbrk(argument, " \t\n\v\"") == NULL) {
+        size_t length = strlen(argument);
+        if (out != NULL) memcpy(out, argument, length);
+        return length;
+    }
+
+    if (out != NULL) out[pos] = '"';
+    pos++;
+    for (p = argument; ; p++) {
+        size_t backslashes = 0;
+
+        while (*p == '\\') {
+            backslashes++;
+            p++;
+        }
+
+        if (*p == '\0') {
+            // Double trailing backslashes so the closing quote is not escaped
+            backslashes *= 2;
+        } else if (*p == '"') {
+            backslashes = backslashes * 2 + 1;
+        }
+
+        if (out != NULL) memset(out + pos, '\\', backslashes);
+        pos += backslashes;
+
+        if (*p == '\0') break;
+        if (out != NULL) out[pos] = *p;
+        pos++;
+    }
+    if (out != NULL) out[pos] = '"';
+    pos++;
+
+    return pos;
+}
+
+// Build "cliPath" --config "configPath" pkg-config <args...> on the heap
+static char *build_command_line(const char *cliPath, const char *configPath, int argc, char *argv[]) {
+    size_t length, pos;
+    char *commandLine;
+    int i, result;
+
+    length = strlen(cliPath) + strlen(configPath) + sizeof("\"\" --config \"\" pkg-config");
+    for (i = 1; i < argc; i++) {
+        length += 1 + append_quoted_argument(NULL, argv[i]);
+    }
+
+    if (length > CMD_MAX_LENGTH) {
+        return NULL;
+    }
+
+    commandLine = (char *)malloc(length);
+    if (commandLine == NULL) {
+        return NULL;
+    }
+
+    result = _snprintf_s(commandLine, length, _TRUNCATE, "\"%s\" --config \"%s\" pkg-config", cliPath, configPath);
+    if (result < 0) {
+        free(commandLine);
+        return NULL;
+    }
+    pos = (size_t)result;
+
+    for (i = 1; i < argc; i++) {
+        commandLine[pos++] = ' ';
+        pos += append_quoted_argument(commandLine + pos, argv[i]);
+    }
+    commandLine[pos] = '\0';
+
+    return commandLine;
+}
+
 int main(int argc, char *argv[]) {
     // Stack-based buffers - much smaller and safer
     WCHAR executablePathW[MAX_PATH];
@@ -93,25 +724,44 @@ int main(int argc, char *argv[]) {
     char scriptDir[MAX_PATH];
     char cliPath[MAX_PATH];
     char configPath[MAX_PATH];
-    char commandLine[CMD_BUFFER_SIZE];
+    char *commandLine = NULL;
 
-    int i, exitCode = 1;
-    STARTUPINFOA si;
+    int exitCode = 1;
+    STARTUPINFOEXA si;
+    HANDLE inheritedHandles[3];
+    int inheritedCount;
+    LPPROC_THREAD_ATTRIBUTE_LIST inheritedList;
     PROCESS_INFORMATION pi;
     DWORD pathLength;
     HANDLE hCliFile = INVALID_HANDLE_VALUE;
     HANDLE hConfigFile = INVALID_HANDLE_VALUE;
 
-    // Initialize timing variables for performance diagnostics
+    // Initialize phase timing (LUAENV_TRACE and _DEBUG diagnostics)
     TIMING_DECLARE_VARS();
 
     // Zero out structures
     ZeroMemory(&si, sizeof(si));
     ZeroMemory(&pi, sizeof(pi));
-    ZeroMemory(commandLine, sizeof(commandLine));
 
     TIMING_START("Total execution time");
 
+    TIMING_START("Answer cache lookup phase");
+    exitCode = try_cached_answer(argc, argv);
+    TIMING_END("Answer cache lookup phase");
+    if (exitCode >= 0) {
+        TIMING_END("Total execution time");
+        return exitCode;
+    }
+
+    TIMING_START("Resident server phase");
+    exitCode = try_server_answer(argc, argv);
+    TIMING_END("Resident server phase");
+    if (exitCode >= 0) {
+        TIMING_END("Total execution time");
+        return exitCode;
+    }
+    exitCode = 1;
+
     TIMING_START("Path resolution phase");
     // Get the full path of the current executable
     pathLength = GetModuleFileNameW(NULL, executablePathW, MAX_PATH);
@@ -170,59 +820,48 @@ int main(int argc, char *argv[]) {
     TIMING_END("File system validation phase");
 
     TIMING_START("Command line construction phase");
-    // Build simple command line without complex argument escaping
-    // Format: "cliPath" --config "configPath" pkg-config [simple args...]
-    size_t pos = 0;
-    int result;
-
-    // Add CLI path with quotes
-    result = _snprintf_s(commandLine, CMD_BUFFER_SIZE, _TRUNCATE, "\"%s\" --config \"%s\" pkg-config", cliPath, configPath);
-    if (result < 0) {
-        fprintf(stderr, "Error: Command line truncated\n");
+    // Format: "cliPath" --config "configPath" pkg-config [quoted args...]
+    commandLine = build_command_line(cliPath, configPath, argc, argv);
+    if (commandLine == NULL) {
+        fprintf(stderr, "Error: Command line too long\n");
         cleanup_handles(NULL, NULL, hCliFile, hConfigFile);
         return 1;
     }
-    pos = (size_t)result;
-
-    // Add remaining arguments with simple space separation
-    for (i = 1; i < argc; i++) {
-        // Simple concatenation - let the CLI handle argument parsing
-        size_t remaining = CMD_BUFFER_SIZE - pos;
-        result = _snprintf_s(commandLine + pos, remaining, _TRUNCATE, " %s", argv[i]);
-        if (result < 0) {
-            fprintf(stderr, "Error: Command line too long\n");
-            cleanup_handles(NULL, NULL, hCliFile, hConfigFile);
-            return 1;
-        }
-        pos += (size_t)result;
-    }
     TIMING_END("Command line construction phase");
 
     TIMING_START("Process creation phase");
-    // Create the process
+    // Create the process; it shares our standard handles and environment, so
+    // nothing it prints passes through this process
+    inheritedCount = inherit_standard_handles(&si, inheritedHandles, &inheritedList);
     if (!CreateProcessA(
         cliPath,                      // Application name
         commandLine,                  // Command line
         NULL,                        // Process security attributes
         NULL,                        // Thread security attributes
-        FALSE,                       // Inherit handles
-        0,                           // Creation flags
+        inheritedCount > 0,          // Inherit handles (the standard handles, see above)
+        EXTENDED_STARTUPINFO_PRESENT, // Creation flags
         NULL,                        // Environment
         NULL,                        // Current directory
-        &si,                         // Startup info
+        &si.StartupInfo,             // Startup info
         &pi                          // Process information
     )) {
         fprintf(stderr, "Error: Failed to create process (Error code: %lu)\n", GetLastError());
+        free_inherited_handles(inheritedList);
+        free(commandLine);
         cleanup_handles(NULL, NULL, hCliFile, hConfigFile);
         return 1;
     }
+    free_inherited_handles(inheritedList);
     TIMING_END("Process creation phase");
 
     // Wait for completion and get exit code
+    TIMING_START("CLI execution phase");
     WaitForSingleObject(pi.hProcess, INFINITE);
+    TIMING_END("CLI execution phase");
     GetExitCodeProcess(pi.hProcess, (LPDWORD)&exitCode);
 
     // Cleanup
+    free(commandLine);
     cleanup_handles(pi.hProcess, pi.hThread, hCliFile, hConfigFile);
 
     TIMING_END("Total execution time");
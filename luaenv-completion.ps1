@@ -24,28 +24,30 @@ $luaenvCompleter = {
     $mainCommands = @(
         'activate', 'deactivate', 'current', 'local',
         'install', 'uninstall', 'list', 'status', 'versions',
-        'default', 'pkg-config', 'config', 'set-alias', 'remove-alias', 'help'
+        'default', 'pkg-config', 'config', 'set-alias', 'remove-alias', 'server', 'bench', 'help'
     )
 
     # Command-specific options
     $commandOptions = @{
-        'activate' = @('--id', '--alias', '--list', '--env', '--tree', '--devshell', '--help', '-h')
+        'activate' = @('--id', '--alias', '--list', '--env', '--tree', '--devshell', '--lazy', '--eager', '--bytecode-cache', '--no-bytecode-cache', '--module-index', '--no-module-index', '--help', '-h')
         'deactivate' = @('--help', '-h')
         'current' = @('--verbose', '-v', '--help', '-h')
         'local' = @('--unset', '-u', '--help', '-h')
         'install' = @('--lua-version', '--luarocks-version', '--alias', '--name',
-                      '--dll', '--debug', '--x86', '--x64', '--skip-env-check',
-                      '--skip-tests', '--help', '-h')
+                      '--dll', '--debug', '--optimize', '--x86', '--x64', '--skip-env-check',
+                      '--skip-tests', '--test-suite', '--test-jobs', '--matrix', '--arch', '--build-type', '--jobs', '--help', '-h')
         'uninstall' = @('--force', '--yes', '--help', '-h')
         'list' = @('--detailed', '--help', '-h')
-        'status' = @('--help', '-h')
+        'status' = @('--timings', '--json', '--help', '-h')
         'versions' = @('--available', '-a', '--online', '--refresh', '--help', '-h')
         'default' = @('--help', '-h')
         'pkg-config' = @('--cflag', '--lua-include', '--liblua', '--libdir',
-                         '--path', '--path-style', '--help', '-h')
+                         '--path', '--path-style', '--format', '--emit', '--help', '-h')
         'config' = @('--help', '-h')
         'set-alias' = @('--help', '-h')
         'remove-alias' = @('--help', '-h')
+        'server' = @('start', 'stop', 'status', 'run', '--idle-timeout', '--help', '-h')
+        'bench' = @('--runs', '--only', '--no-save', '--help', '-h')
         'help' = @()
     }
 
@@ -0,0 +1 @@
+# Opt-in latency benchmarks for the Lua MSVC Build project
@@ -0,0 +1,75 @@
+"""
+Opt-in latency benchmark for luaconfig and the pkg-config chain.
+
+Runs bench_luaconfig.py against synthetic registries and fails when the
+fast path stops being used or, with a baseline file, when latency regresses.
+Only run through `run_all_tests.py --benchmark`.
+
+Environment:
+    LUAENV_BENCH_LUACONFIG   luaconfig.exe to measure (default: ~/.luaenv/bin/luaconfig.exe)
+    LUAENV_BENCH_RUNS        timed invocations per query and mode (default: 10)
+    LUAENV_BENCH_OUTPUT      where to keep the results file
+    LUAENV_BENCH_BASELINE    previous results file to compare against
+    LUAENV_BENCH_TOLERANCE   allowed p50 regression, in percent (default: 25)
+"""
+
+import json
+import os
+import sys
+import unittest
+from pathlib import Path
+
+# Add the project root to path for imports
+sys.path.insert(0, str(Path(__file__).parent.parent.parent))
+
+import bench_luaconfig
+
+# Regressions smaller than this are treated as noise regardless of the tolerance
+NOISE_FLOOR_MS = 2.0
+
+
+class TestLuaconfigLatency(unittest.TestCase):
+    """Latency checks for luaconfig.exe against 1, 10 and 100 installations."""
+
+    @classmethod
+    def setUpClass(cls):
+        luaconfig = Path(os.environ.get("LUAENV_BENCH_LUACONFIG", str(bench_luaconfig.default_luaconfig())))
+        if not luaconfig.exists():
+            raise unittest.SkipTest(f"luaconfig not found: {luaconfig}")
+
+        runs = int(os.environ.get("LUAENV_BENCH_RUNS", "10"))
+        cls.document = bench_luaconfig.run_benchmark(luaconfig, runs=runs)
+
+        output = os.environ.get("LUAENV_BENCH_OUTPUT")
+        if output:
+            with open(output, "w", encoding="utf-8") as f:
+                json.dump(cls.document, f, indent=2, sort_keys=True)
+                f.write("\n")
+
+    def test_warm_queries_use_fast_path(self):
+        """Test that every query is faster with a current answer cache"""
+        rows = {bench_luaconfig.result_key(row): row for row in self.document["results"]}
+        for (size, mode, query), row in rows.items():
+            if mode != "warm":
+                continue
+            cold = rows[(size, "cold", query)]
+            with self.subTest(installations=size, query=query):
+                self.assertLess(row["wall_ms"]["p50"], cold["wall_ms"]["p50"])
+                # The fast path never reaches process creation
+                self.assertNotIn("Process creation phase", [stage["name"] for stage in row["stages_ms"]])
+
+    def test_no_regression_against_baseline(self):
+        """Test that p50 latency stays within tolerance of the baseline"""
+        baseline = os.environ.get("LUAENV_BENCH_BASELINE")
+        if not baseline:
+            self.skipTest("LUAENV_BENCH_BASELINE not set")
+
+        tolerance = float(os.environ.get("LUAENV_BENCH_TOLERANCE", "25")) / 100.0
+        with open(baseline, "r", encoding="utf-8") as f:
+            pairs = bench_luaconfig.compare_results(json.load(f), self.document)
+
+        self.assertTrue(pairs, "Baseline has no results in common with this run")
+        for (size, mode, query), old_p50, new_p50, _, _ in pairs:
+            with self.subTest(installations=size, mode=mode, query=query):
+                limit = max(old_p50 * (1 + tolerance), old_p50 + NOISE_FLOOR_MS)
+                self.assertLessEqual(new_p50, limit)
@@ -23,6 +23,8 @@ def main():
     parser = argparse.ArgumentParser(description="Run Lua MSVC Build test suite")
     parser.add_argument("--unit", action="store_true", help="Run only unit tests")
     parser.add_argument("--integration", action="store_true", help="Run only integration tests")
+    parser.add_argument("--benchmark", action="store_true",
+                        help="Run the opt-in luaconfig latency benchmark (see tests/benchmark)")
     parser.add_argument("--list", "-l", action="store_true", help="List all available tests")
     parser.add_argument("--verbose", "-v", action="store_true", help="Verbose output")
 
@@ -32,23 +34,41 @@ def main():
     print("=" * 60)
 
     # If no specific type requested, run all
-    run_unit = args.unit or not (args.unit or args.integration)
-    run_integration = args.integration or not (args.unit or args.integration)
+    run_unit = args.unit or not (args.unit or args.integration or args.benchmark)
+    run_integration = args.integration or not (args.unit or args.integration or args.benchmark)
 
     suite = unittest.TestSuite()
     loader = unittest.TestLoader()
 
     try:
         if run_unit:
-            from tests.unit.test_download_manager import TestDownloadManager
-            suite.addTests(loader.loadTestsFromTestCase(TestDownloadManager))
-            print("✓ Loaded unit tests (22 tests)")
+            unit_suite = unittest.TestSuite()
+            from tests.unit.test_download_manager import TestDownloadManager, TestBuildCache, TestDownloadFile
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestDownloadManager))
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestBuildCache))
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestDownloadFile))
+            from tests.unit.test_shared_store import TestSharedStore
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestSharedStore))
+            from tests.unit.test_registry_store import TestRegistryStore, TestRegistryJournal
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestRegistryStore))
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestRegistryJournal))
+            from tests.unit.test_vs_env_cache import TestVSEnvironmentCache
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestVSEnvironmentCache))
+            from tests.unit.test_install_timeline import TestInstallTimeline
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestInstallTimeline))
+            from tests.unit.test_lua_tests import TestLuaTests
+            unit_suite.addTests(loader.loadTestsFromTestCase(TestLuaTests))
+            suite.addTests(unit_suite)
+            print(f"✓ Loaded unit tests ({unit_suite.countTestCases()} tests)")
 
             if args.list:
                 print("\nUnit Tests:")
-                for method_name in dir(TestDownloadManager):
-                    if method_name.startswith("test_"):
-                        print(f"  - {method_name}")
+                for test_class in (TestDownloadManager, TestBuildCache, TestDownloadFile, TestSharedStore,
+                                   TestRegistryStore, TestRegistryJournal, TestVSEnvironmentCache,
+                                   TestInstallTimeline, TestLuaTests):
+                    print(f"  {test_class.__name__}:")
+                    for method_name in loader.getTestCaseNames(test_class):
+                        print(f"    - {method_name}")
 
         if run_integration:
             from tests.integration.test_download_script import TestDownloadScript
@@ -61,6 +81,18 @@ def main():
                     if method_name.startswith("test_"):
                         print(f"  - {method_name}")
 
+        # Opt-in: spawns luaconfig.exe several hundred times
+        if args.benchmark:
+            from tests.benchmark.test_luaconfig_latency import TestLuaconfigLatency
+            suite.addTests(loader.loadTestsFromTestCase(TestLuaconfigLatency))
+            print("✓ Loaded benchmark tests (2 tests)")
+
+            if args.list:
+                print("\nBenchmark Tests:")
+                for method_name in dir(TestLuaconfigLatency):
+                    if method_name.startswith("test_"):
+                        print(f"  - {method_name}")
+
     except ImportError as e:
         print(f"Error importing tests: {e}")
         return False
@@ -13,8 +13,12 @@ import unittest
 import tempfile
 import shutil
 import json
+import io
 import os
 import sys
+import tarfile
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
 from pathlib import Path
 from unittest.mock import patch, MagicMock, mock_open
 from datetime import datetime
@@ -23,7 +27,8 @@ from datetime import datetime
 backend_dir = Path(__file__).parent.parent.parent / "backend"
 sys.path.insert(0, str(backend_dir))
 
-from download_manager import DownloadManager
+from download_manager import DownloadManager, BuildCache
+from utils import DownloadError, HttpSession, download_and_extract, download_file
 
 
 class TestDownloadManager(unittest.TestCase):
@@ -373,6 +378,250 @@ class TestDownloadManager(unittest.TestCase):
         self.assertTrue(success)  # Should succeed (no-op)
 
 
+
+class TestBuildCache(unittest.TestCase):
+    """Test cases for the BuildCache class."""
+
+    def setUp(self):
+        """Set up a fake Lua source tree and installation."""
+        self.temp_dir = Path(tempfile.mkdtemp())
+        self.cache = BuildCache(self.temp_dir / "cache")
+
+        self.source_dir = self.temp_dir / "src"
+        self.source_dir.mkdir()
+        (self.source_dir / "lapi.c").write_text("int lua;")
+        (self.source_dir / "build-static.bat").write_text('set "CFLAGS=/O2"')
+
+        self.install_dir = self.temp_dir / "install"
+        for name in ("bin", "include", "lib", "luarocks"):
+            (self.install_dir / name).mkdir(parents=True)
+        (self.install_dir / "bin" / "lua.exe").write_bytes(b"MZ")
+        (self.install_dir / "lib" / "lua54.lib").write_bytes(b"!<arch>")
+        (self.install_dir / "luarocks" / "luarocks.exe").write_bytes(b"MZ")
+
+        self.metadata = {"lua_version": "5.4.8", "build_type": "static"}
+
+    def tearDown(self):
+        """Clean up temporary files."""
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _key(self, build_type="static", toolset="cl 19.40"):
+        return self.cache.compute_key(self.source_dir, build_type, "release", "x64", toolset)
+
+    def test_compute_key_tracks_sources_and_toolset(self):
+        """Test that the key changes with sources, scripts and toolset but not objects."""
+        key = self._key()
+        self.assertEqual(key, self._key())
+        self.assertNotEqual(key, self._key(build_type="dll"))
+        self.assertNotEqual(key, self._key(toolset="cl 19.41"))
+
+        # Object directories do not affect the key
+        (self.source_dir / "Release").mkdir()
+        (self.source_dir / "Release" / "lapi.obj").write_bytes(b"obj")
+        self.assertEqual(key, self._key())
+
+        (self.source_dir / "build-static.bat").write_text('set "CFLAGS=/O1"')
+        self.assertNotEqual(key, self._key())
+
+    def test_store_and_restore_round_trip(self):
+        """Test that a stored build restores the Lua files but not LuaRocks."""
+        key = self._key()
+        self.assertIsNone(self.cache.lookup(key))
+        self.assertTrue(self.cache.store(key, self.install_dir, self.metadata))
+
+        target = self.temp_dir / "second"
+        self.assertTrue(BuildCache(self.temp_dir / "cache").restore(key, target))
+        self.assertEqual((target / "bin" / "lua.exe").read_bytes(), b"MZ")
+        self.assertEqual((target / "lib" / "lua54.lib").read_bytes(), b"!<arch>")
+        self.assertFalse((target / "luarocks").exists())
+
+    def test_store_keeps_complete_entry(self):
+        """Test that storing a key again does not replace the entry restores copy from."""
+        key = self._key()
+        self.assertTrue(self.cache.store(key, self.install_dir, self.metadata))
+        (self.install_dir / "bin" / "lua.exe").write_bytes(b"MZ2")
+        self.assertTrue(self.cache.store(key, self.install_dir, self.metadata))
+
+        target = self.temp_dir / "second"
+        self.assertTrue(self.cache.restore(key, target))
+        self.assertEqual((target / "bin" / "lua.exe").read_bytes(), b"MZ")
+        self.assertEqual(sorted(p.name for p in (self.temp_dir / "cache").iterdir()),
+                         sorted([key, "build_registry.json", "build_registry.lock"]))
+
+    def test_restore_miss_returns_false(self):
+        """Test that restoring an unknown key leaves the target untouched."""
+        target = self.temp_dir / "second"
+        self.assertFalse(self.cache.restore(self._key(), target))
+        self.assertFalse(target.exists())
+
+    def test_store_evicts_least_recently_used(self):
+        """Test that the cache keeps at most max_entries builds."""
+        cache = BuildCache(self.temp_dir / "cache", max_entries=2)
+        keys = [self._key(toolset=f"cl {n}") for n in range(3)]
+        for key in keys:
+            cache.store(key, self.install_dir, self.metadata)
+            # Distinct timestamps for the LRU order
+            cache.registry["entries"][key]["last_used"] = f"2026-01-0{keys.index(key) + 1}"
+
+        cache.cleanup_old_entries(2)
+        self.assertIsNone(cache.lookup(keys[0]))
+        self.assertIsNotNone(cache.lookup(keys[2]))
+        self.assertEqual(cache.get_cache_info()["entry_count"], 2)
+
+    def test_cleanup_respects_size_limit(self):
+        """Test that cleanup drops the oldest entries until the cache fits in max_size."""
+        keys = [self._key(toolset=f"cl {n}") for n in range(3)]
+        for key in keys:
+            self.cache.store(key, self.install_dir, self.metadata)
+        # Distinct timestamps for the LRU order
+        for n, key in enumerate(keys):
+            self.cache.registry["entries"][key]["last_used"] = f"2026-01-0{n + 1}"
+        self.cache._save_registry()
+        entry_size = self.cache.registry["entries"][keys[0]]["size"]
+
+        success, _ = self.cache.cleanup_old_entries(keep_latest=10, max_size=2 * entry_size)
+        self.assertTrue(success)
+        self.assertIsNone(self.cache.lookup(keys[0]))
+        self.assertIsNotNone(self.cache.lookup(keys[1]))
+        self.assertIsNotNone(self.cache.lookup(keys[2]))
+
+        # The most recent build is kept even when it alone exceeds the limit
+        self.cache.cleanup_old_entries(keep_latest=10, max_size=0)
+        self.assertEqual(list(self.cache.registry["entries"]), [keys[2]])
+
+class _RangeHandler(BaseHTTPRequestHandler):
+    """Serves the server's payload with ETag/If-Range support, dropping the first response halfway."""
+
+    def do_GET(self):
+        payload = self.server.payload
+        start = 0
+        requested = self.headers.get("Range")
+        if requested and self.headers.get("If-Range") == '"v1"':
+            start = int(requested.split("=")[1].rstrip("-"))
+        self.server.requests.append(start)
+        self.server.paths.append(self.path)
+
+        self.send_response(206 if start else 200)
+        self.send_header("ETag", '"v1"')
+        self.send_header("Content-Length", str(len(payload) - start))
+        self.end_headers()
+        body = payload[start:]
+        if len(self.server.requests) == 1:
+            body = body[:len(body) // 2]
+            self.close_connection = True
+        self.wfile.write(body)
+
+    def log_message(self, *args):
+        pass
+
+
+class TestDownloadFile(unittest.TestCase):
+    """Test cases for resumable, checksummed downloads."""
+
+    def setUp(self):
+        """Start a local HTTP server."""
+        self.temp_dir = Path(tempfile.mkdtemp())
+        self.server = ThreadingHTTPServer(("127.0.0.1", 0), _RangeHandler)
+        self.server.payload = os.urandom(200000)
+        self.server.requests = []
+        self.server.paths = []
+        threading.Thread(target=self.server.serve_forever, daemon=True).start()
+        self.url = f"http://127.0.0.1:{self.server.server_address[1]}/lua.tar.gz"
+
+    def tearDown(self):
+        """Stop the server and clean up temporary files."""
+        self.server.shutdown()
+        self.server.server_close()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    @patch('utils.time.sleep')
+    def test_interrupted_download_resumes(self, mock_sleep):
+        """Test that a dropped connection is retried from where it stopped."""
+        dest = self.temp_dir / "lua.tar.gz"
+        digest = download_file(self.url, dest)
+
+        self.assertEqual(dest.read_bytes(), self.server.payload)
+        self.assertEqual(self.server.requests, [0, 100000])
+        self.assertEqual(len(digest), 64)
+        self.assertFalse((self.temp_dir / "lua.tar.gz.part").exists())
+
+    @patch('utils.time.sleep')
+    def test_checksum_mismatch_fails(self, mock_sleep):
+        """Test that a file with the wrong digest is not kept."""
+        dest = self.temp_dir / "lua.tar.gz"
+        with self.assertRaises(DownloadError):
+            download_file(self.url, dest, expected_sha256="0" * 64)
+        self.assertFalse(dest.exists())
+
+    @patch('utils.time.sleep')
+    def test_download_and_extract_streams_to_final_paths(self, mock_sleep):
+        """Test that a tar.gz is extracted while it downloads, through move_callback."""
+        archive = io.BytesIO()
+        with tarfile.open(fileobj=archive, mode="w:gz") as tar:
+            for name, data in (("lua-5.4.8/src/lua.c", b"int main;"), ("lua-5.4.8/Makefile", os.urandom(300000))):
+                info = tarfile.TarInfo(name)
+                info.size = len(data)
+                tar.addfile(info, io.BytesIO(data))
+        self.server.payload = archive.getvalue()
+
+        extracted = self.temp_dir / "extracted"
+        (extracted / "lua").mkdir(parents=True)
+        (extracted / "lua" / "stale.c").write_text("old")
+        dest = self.temp_dir / "lua.tar.gz"
+        download_and_extract(self.url, dest, self.temp_dir, lambda source, name: extracted / "lua")
+
+        self.assertEqual(dest.read_bytes(), self.server.payload)
+        self.assertEqual((extracted / "lua" / "src" / "lua.c").read_bytes(), b"int main;")
+        self.assertFalse((extracted / "lua" / "stale.c").exists())
+        self.assertFalse((self.temp_dir / "lua-5.4.8").exists())
+        self.assertEqual(len(self.server.requests), 2)
+
+    @patch('utils.time.sleep')
+    def test_download_and_extract_checksum_mismatch_keeps_tree(self, mock_sleep):
+        """Test that an archive with the wrong digest leaves the extracted tree untouched."""
+        archive = io.BytesIO()
+        with tarfile.open(fileobj=archive, mode="w:gz") as tar:
+            info = tarfile.TarInfo("lua-5.4.8/src/lua.c")
+            info.size = 8
+            tar.addfile(info, io.BytesIO(b"tampered"))
+        self.server.payload = archive.getvalue()
+
+        extracted = self.temp_dir / "extracted"
+        (extracted / "lua" / "src").mkdir(parents=True)
+        (extracted / "lua" / "src" / "lua.c").write_text("good")
+        dest = self.temp_dir / "lua.tar.gz"
+        with self.assertRaises(DownloadError):
+            download_and_extract(self.url, dest, self.temp_dir, lambda source, name: extracted / "lua",
+                                 expected_sha256="0" * 64)
+
+        self.assertEqual((extracted / "lua" / "src" / "lua.c").read_text(), "good")
+        self.assertEqual(sorted(p.name for p in extracted.iterdir()), ["lua"])
+        self.assertFalse(dest.exists())
+
+    def test_http_session_uses_environment_proxy(self):
+        """Test that HttpSession sends HTTP requests through HTTP_PROXY unless NO_PROXY matches."""
+        proxy = f"http://127.0.0.1:{self.server.server_address[1]}"
+        session = HttpSession()
+        try:
+            with patch.dict(os.environ, {"HTTP_PROXY": proxy, "http_proxy": proxy, "NO_PROXY": "", "no_proxy": ""}):
+                self.assertTrue(session.exists("http://lua.invalid/lua.tar.gz"))
+            self.assertEqual(set(self.server.paths), {"http://lua.invalid/lua.tar.gz"})
+        finally:
+            session.close()
+
+    @patch('utils.time.sleep')
+    def test_registry_digest_detects_corruption(self, mock_sleep):
+        """Test that is_lua_downloaded trusts the recorded digest, not the file size."""
+        manager = DownloadManager(str(self.temp_dir / "downloads"))
+        success, _ = manager.download_version(
+            "5.4.8", "3.12.2", {'lua': self.url}, {'lua': 'lua.tar.gz'})
+        self.assertTrue(success)
+        self.assertTrue(manager.is_lua_downloaded("5.4.8"))
+
+        with open(manager.get_lua_dir("5.4.8") / "lua.tar.gz", "r+b") as f:
+            f.write(b"corrupt")
+        self.assertFalse(manager.is_lua_downloaded("5.4.8"))
+
 if __name__ == '__main__':
     # Run with verbose output
     unittest.main(verbosity=2)
@@ -0,0 +1,97 @@
+"""
+Unit tests for the per-phase install timeline.
+
+This module tests the install_timeline module:
+- Recording phases from several processes into one timeline file
+- Turning the file into the record stored with an installation
+- Nesting phases by time when they are shown
+"""
+
+import unittest
+import tempfile
+import shutil
+import os
+import subprocess
+import sys
+import time
+from pathlib import Path
+from unittest.mock import patch
+
+# Add backend directory to path for imports
+backend_dir = Path(__file__).parent.parent.parent / "backend"
+sys.path.insert(0, str(backend_dir))
+
+import install_timeline
+
+
+class TestInstallTimeline(unittest.TestCase):
+    """Test cases for the install_timeline module."""
+
+    def setUp(self):
+        """Point LUAENV_TIMELINE at a temporary file."""
+        self.temp_dir = Path(tempfile.mkdtemp())
+        self.timeline_file = self.temp_dir / "timeline.jsonl"
+        self.env_patch = patch.dict(os.environ, {install_timeline.TIMELINE_ENV: str(self.timeline_file)})
+        self.env_patch.start()
+
+    def tearDown(self):
+        """Clean up temporary files."""
+        self.env_patch.stop()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_phases_of_child_processes_share_the_timeline(self):
+        """Phases recorded by a child process are placed within the parent's phase."""
+        origin = time.monotonic()
+        script = ("import install_timeline\n"
+                  "with install_timeline.phase('fetch', files=2) as counters:\n"
+                  "    counters['bytes'] = 1024\n")
+        with install_timeline.phase("download"):
+            subprocess.run([sys.executable, "-c", script], check=True, cwd=str(backend_dir))
+
+        timeline = install_timeline.load_timeline(self.timeline_file, origin, "active")
+        names = [entry["name"] for entry in timeline["phases"]]
+        self.assertEqual(names, ["download", "fetch"])
+        download, fetch = timeline["phases"]
+        self.assertEqual((fetch["files"], fetch["bytes"]), (2, 1024))
+        self.assertGreaterEqual(fetch["start"], download["start"])
+        self.assertLessEqual(fetch["start"] + fetch["duration"], download["start"] + download["duration"] + 0.005)
+        self.assertEqual(timeline["status"], "active")
+
+    def test_failed_phase_is_recorded(self):
+        """A block that raises is recorded with status failed and the error propagates."""
+        origin = time.monotonic()
+        with self.assertRaises(RuntimeError):
+            with install_timeline.phase("compile", files=3):
+                raise RuntimeError("cl.exe failed")
+
+        timeline = install_timeline.load_timeline(self.timeline_file, origin, "broken")
+        self.assertEqual(timeline["phases"][0]["status"], "failed")
+        self.assertEqual(timeline["phases"][0]["files"], 3)
+
+    def test_nesting_and_slowest_phase(self):
+        """Contained phases are indented, adjacent ones are not, and only top phases can be slowest."""
+        origin = 1000.0
+        install_timeline.record_phase("build", origin + 1.0, 10.0)
+        install_timeline.record_phase("compile", origin + 1.0, 8.0, files=33)
+        install_timeline.record_phase("link", origin + 9.0, 2.0)
+        install_timeline.record_phase("tests", origin + 11.0, 5.0)
+
+        timeline = install_timeline.load_timeline(self.timeline_file, origin, "active")
+        self.assertEqual(timeline["total"], 16.0)
+        lines = install_timeline.format_timeline(timeline)
+        self.assertTrue(lines[1].startswith("  build "))
+        self.assertTrue(lines[2].startswith("    compile "))
+        self.assertTrue(lines[3].startswith("    link "))
+        self.assertTrue(lines[4].startswith("  tests "))
+        self.assertEqual(install_timeline.slowest_phase(timeline)["name"], "build")
+
+    def test_nothing_recorded_without_timeline(self):
+        """Without LUAENV_TIMELINE phases are not recorded and there is no timeline."""
+        with patch.dict(os.environ, {install_timeline.TIMELINE_ENV: ""}):
+            with install_timeline.phase("download"):
+                pass
+        self.assertIsNone(install_timeline.load_timeline(self.timeline_file, time.monotonic(), "active"))
+
+
+if __name__ == "__main__":
+    unittest.main()
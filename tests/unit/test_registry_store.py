@@ -0,0 +1,132 @@
+"""
+Unit tests for the RegistryStore class and the registry's use of it.
+
+This module tests the journaled registry storage:
+- Replaying the journal on top of the snapshot
+- Torn journal lines and leftovers of interrupted compactions
+- Merging changes of two registry instances
+"""
+
+import unittest
+import tempfile
+import shutil
+import contextlib
+import io
+import json
+import sys
+from pathlib import Path
+
+# Add backend directory to path for imports
+backend_dir = Path(__file__).parent.parent.parent / "backend"
+sys.path.insert(0, str(backend_dir))
+
+import registry_store
+from registry_store import RegistryStore, diff_registry, exclusive_lock
+from registry import LuaEnvRegistry
+
+
+class TestRegistryStore(unittest.TestCase):
+    """Test cases for RegistryStore class."""
+
+    def setUp(self):
+        """Set up a registry with one journaled change."""
+        self.temp_dir = Path(tempfile.mkdtemp())
+        self.store = RegistryStore(self.temp_dir / "registry.json")
+
+        self.base = {"revision": 0, "default_installation": None, "installations": {}, "aliases": {}}
+        self.store.compact(self.base)
+        changed = json.loads(json.dumps(self.base))
+        changed["installations"]["a"] = {"id": "a", "status": "active"}
+        changed["aliases"]["dev"] = "a"
+        changed["default_installation"] = "a"
+        with self.store.lock():
+            self.store.append(self.base, diff_registry(self.base, changed), "now")
+
+    def tearDown(self):
+        """Clean up temporary files."""
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_load_replays_journal(self):
+        """Test that journaled changes are applied and counted."""
+        registry = self.store.load()
+        self.assertEqual(registry["revision"], 3)
+        self.assertEqual(registry["aliases"], {"dev": "a"})
+        self.assertEqual(registry["default_installation"], "a")
+        self.assertEqual(self.store.read_revision(), 3)
+        # Only the journal was written
+        self.assertEqual(json.loads(self.store.snapshot_path.read_text())["revision"], 0)
+
+    def test_load_ignores_torn_and_compacted_records(self):
+        """Test that an unfinished line and records already in the snapshot are skipped."""
+        with open(self.store.journal_path, "a", encoding="utf-8") as f:
+            f.write('{"revision": 4, "op": "delete", "table": "alia')
+        self.assertEqual(self.store.load()["aliases"], {"dev": "a"})
+
+        # Snapshot written, journal not yet emptied
+        registry = self.store.load()
+        self.store.compact(registry)
+        self.store.journal_path.write_text(
+            json.dumps({"revision": 2, "op": "delete", "table": "aliases", "key": "dev"}) + "\n")
+        self.assertEqual(self.store.load()["aliases"], {"dev": "a"})
+
+    def test_journal_is_compacted(self):
+        """Test that a large journal is folded into the snapshot."""
+        original = registry_store.COMPACT_JOURNAL_BYTES
+        registry_store.COMPACT_JOURNAL_BYTES = 0
+        try:
+            registry = self.store.load()
+            with self.store.lock():
+                self.store.append(registry, [{"op": "default", "value": None}], "later")
+        finally:
+            registry_store.COMPACT_JOURNAL_BYTES = original
+
+        self.assertEqual(self.store.journal_path.stat().st_size, 0)
+        self.assertEqual(json.loads(self.store.snapshot_path.read_text())["revision"], 4)
+        self.assertIsNone(self.store.load()["default_installation"])
+
+
+class TestRegistryJournal(unittest.TestCase):
+    """Test cases for concurrent use of LuaEnvRegistry."""
+
+    def setUp(self):
+        """Set up a temporary registry location."""
+        self.temp_dir = Path(tempfile.mkdtemp())
+        self.registry_path = self.temp_dir / ".luaenv" / "registry.json"
+
+    def tearDown(self):
+        """Clean up temporary files."""
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_changes_of_two_instances_are_merged(self):
+        """Test that a stale registry instance does not drop another one's changes."""
+        with contextlib.redirect_stdout(io.StringIO()):
+            first = LuaEnvRegistry(self.registry_path)
+            second = LuaEnvRegistry(self.registry_path)
+            a = first.create_installation("5.4.8", "3.12.2", "dll", alias="a")
+            b = second.create_installation("5.4.7", "3.12.2", "static", alias="b")
+            first.update_status(a, "active")
+            third = LuaEnvRegistry(self.registry_path)
+
+        self.assertEqual(set(third.registry["installations"]), {a, b})
+        self.assertEqual(third.registry["aliases"], {"a": a, "b": b})
+        self.assertEqual(third.registry["installations"][a]["status"], "active")
+        self.assertEqual(third.get_installation_by_id(b[:8])["id"], b)
+
+    def test_installation_being_built_is_not_broken(self):
+        """Test that validation leaves an installation alone while its workspace is locked."""
+        with contextlib.redirect_stdout(io.StringIO()):
+            registry = LuaEnvRegistry(self.registry_path)
+            installation_id = registry.create_installation("5.4.8", "3.12.2", "static")
+            lock_path = registry.get_workspace_dir(installation_id) / ".lock"
+
+            with exclusive_lock(lock_path):
+                validation = registry.validate_installations()
+                self.assertEqual(validation["building"], [installation_id])
+                self.assertEqual(validation["broken"], [])
+
+            self.assertEqual(registry.validate_installations()["broken"], [installation_id])
+
+
+if __name__ == '__main__':
+    # Run with verbose output
+    unittest.main(verbosity=2)
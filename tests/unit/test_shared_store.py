@@ -0,0 +1,98 @@
+"""
+Unit tests for the SharedStore class.
+
+This module tests the store of files shared by installations:
+- Copying the LuaRocks distribution with hardlinked binaries
+- Deduplication of rock trees
+- Reference counting through hardlink counts
+"""
+
+import unittest
+import tempfile
+import shutil
+import sys
+from pathlib import Path
+
+# Add backend directory to path for imports
+backend_dir = Path(__file__).parent.parent.parent / "backend"
+sys.path.insert(0, str(backend_dir))
+
+from shared_store import SharedStore
+
+
+class TestSharedStore(unittest.TestCase):
+    """Test cases for SharedStore class."""
+
+    def setUp(self):
+        """Set up a store and two rock trees with one identical module."""
+        self.temp_dir = Path(tempfile.mkdtemp())
+        self.store = SharedStore(self.temp_dir / "store")
+
+        self.trees = []
+        for name in ("first", "second"):
+            tree = self.temp_dir / name
+            (tree / "share" / "lua" / "5.4").mkdir(parents=True)
+            (tree / "share" / "lua" / "5.4" / "inspect.lua").write_text("return {}")
+            (tree / "lib" / "luarocks" / "rocks-5.4").mkdir(parents=True)
+            (tree / "lib" / "luarocks" / "rocks-5.4" / "manifest").write_text("repository = {}")
+            self.trees.append(tree)
+
+    def tearDown(self):
+        """Clean up temporary files."""
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_copy_tree_links_binaries_only(self):
+        """Test that LuaRocks binaries are shared and other files are copied."""
+        source = self.temp_dir / "luarocks"
+        source.mkdir()
+        (source / "luarocks.exe").write_bytes(b"MZ")
+        (source / "config-5.4.lua").write_text("-- config")
+
+        for name in ("a", "b"):
+            self.assertEqual(self.store.copy_tree(source, self.temp_dir / name), (1, 1))
+
+        self.assertTrue((self.temp_dir / "a" / "luarocks.exe").samefile(self.temp_dir / "b" / "luarocks.exe"))
+        self.assertEqual((self.temp_dir / "a" / "config-5.4.lua").stat().st_nlink, 1)
+        self.assertEqual(self.store.get_store_info()["link_count"], 2)
+
+    def test_deduplicate_shares_identical_rock_files(self):
+        """Test that identical modules are linked and the manifest is left alone."""
+        linked, saved = self.store.deduplicate(self.trees)
+        self.assertEqual((linked, saved), (1, len("return {}")))
+
+        first, second = (tree / "share" / "lua" / "5.4" / "inspect.lua" for tree in self.trees)
+        self.assertTrue(first.samefile(second))
+        self.assertEqual((self.trees[0] / "lib" / "luarocks" / "rocks-5.4" / "manifest").stat().st_nlink, 1)
+
+        # Shared files are not hashed again
+        self.assertEqual(self.store.deduplicate(self.trees), (0, 0))
+
+    def test_deduplicate_replaces_object_modified_in_place(self):
+        """Test that a module patched through its link is not handed to other trees."""
+        self.store.deduplicate(self.trees)
+        first = self.trees[0] / "share" / "lua" / "5.4" / "inspect.lua"
+        with open(first, "w") as f:
+            f.write("return {patched = true}")
+
+        third = self.temp_dir / "third"
+        (third / "share" / "lua" / "5.4").mkdir(parents=True)
+        (third / "share" / "lua" / "5.4" / "inspect.lua").write_text("return {}")
+        self.store.deduplicate([third])
+
+        self.assertEqual((third / "share" / "lua" / "5.4" / "inspect.lua").read_text(), "return {}")
+        self.assertFalse((third / "share" / "lua" / "5.4" / "inspect.lua").samefile(first))
+
+    def test_collect_garbage_drops_unreferenced_objects(self):
+        """Test that objects are kept while an installation links to them."""
+        self.store.deduplicate(self.trees)
+        shutil.rmtree(self.trees[0])
+        self.assertEqual(self.store.collect_garbage(), (0, 0))
+
+        shutil.rmtree(self.trees[1])
+        self.assertEqual(self.store.collect_garbage(), (1, len("return {}")))
+        self.assertEqual(self.store.get_store_info()["object_count"], 0)
+
+
+if __name__ == '__main__':
+    # Run with verbose output
+    unittest.main(verbosity=2)
@@ -0,0 +1,81 @@
+"""
+Unit tests for the persistent Visual Studio environment cache.
+
+This module tests the vs_env_cache module:
+- Applying a cached environment delta
+- Invalidating entries when the toolchain changes
+"""
+
+import unittest
+import tempfile
+import shutil
+import os
+import sys
+from pathlib import Path
+from unittest.mock import patch
+
+# Add backend directory to path for imports
+backend_dir = Path(__file__).parent.parent.parent / "backend"
+sys.path.insert(0, str(backend_dir))
+
+import vs_env_cache
+
+
+class TestVSEnvironmentCache(unittest.TestCase):
+    """Test cases for the vs_env_cache module."""
+
+    def setUp(self):
+        """Set up a fake Visual Studio installation and cache location."""
+        self.temp_dir = Path(tempfile.mkdtemp())
+        self.install_path = self.temp_dir / "BuildTools"
+        self.build_dir = self.install_path / "VC" / "Auxiliary" / "Build"
+        self.build_dir.mkdir(parents=True)
+        (self.build_dir / "vcvarsall.bat").write_text("@echo off")
+        (self.build_dir / "Microsoft.VCToolsVersion.default.txt").write_text("14.44.35207\n")
+
+        self.home_patch = patch.object(Path, "home", return_value=self.temp_dir)
+        self.home_patch.start()
+
+        self.entry = {
+            "format": vs_env_cache.CACHE_FORMAT,
+            "key": vs_env_cache.compute_key(self.install_path, "x64"),
+            "architecture": "amd64",
+            "install_path": str(self.install_path),
+            "variables": {"VCINSTALLDIR": "C:\\VS\\VC\\"},
+            "prepend": {"PATH": ["C:\\VS\\bin", "C:\\SDK\\bin"]},
+            "complete": True,
+        }
+
+    def tearDown(self):
+        """Clean up temporary files."""
+        self.home_patch.stop()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_apply_prepends_without_duplicates(self):
+        """Test that list variables get the vcvars entries in front, once."""
+        environ = {"PATH": "c:\\sdk\\bin;C:\\Windows"}
+        vs_env_cache.apply(self.entry, environ)
+        self.assertEqual(environ["PATH"], "C:\\VS\\bin;C:\\SDK\\bin;C:\\Windows")
+        self.assertEqual(environ["VCINSTALLDIR"], "C:\\VS\\VC\\")
+
+    def test_load_rejects_changed_toolchain(self):
+        """Test that an entry is only used while its key matches."""
+        vs_env_cache.save(self.entry)
+        self.assertIsNotNone(vs_env_cache.load("x64"))
+        self.assertIsNotNone(vs_env_cache.load("amd64", self.install_path))
+        self.assertIsNone(vs_env_cache.load("x64", self.temp_dir / "Other"))
+        self.assertIsNone(vs_env_cache.load("x86"))
+
+        # A toolset update changes the key
+        (self.build_dir / "Microsoft.VCToolsVersion.default.txt").write_text("14.45.0\n")
+        self.assertIsNone(vs_env_cache.load("x64"))
+
+    def test_incomplete_capture_is_not_saved(self):
+        """Test that a capture made inside a VS shell is not cached."""
+        vs_env_cache.save(dict(self.entry, complete=False))
+        self.assertFalse(vs_env_cache.get_cache_path("x64").exists())
+
+
+if __name__ == '__main__':
+    # Run with verbose output
+    unittest.main(verbosity=2)